@@ -44,6 +44,7 @@
         'process_mutex.cc',
         'run_level.cc',
         'stopwatch.cc',
+        'trace.cc',
       ],
       'dependencies': [
         'base_core',
@@ -450,6 +451,17 @@
         }],
       ],
     },
+    {
+      'target_name': 'serialized_key_index',
+      'type': 'static_library',
+      'toolsets': ['host', 'target'],
+      'sources': [
+        'container/serialized_key_index.cc',
+      ],
+      'dependencies': [
+        'base_core',
+      ],
+    },
     {
       'target_name': 'serialized_string_array',
       'type': 'static_library',
@@ -59,6 +59,7 @@
         'cpu_stats_test.cc',
         'process_mutex_test.cc',
         'stopwatch_test.cc',
+        'trace_test.cc',
       ],
       'conditions': [
         ['OS=="mac"', {
@@ -341,6 +342,20 @@
         'test_size': 'small',
       },
     },
+    {
+      'target_name': 'flat_trie_test',
+      'type': 'executable',
+      'sources': [
+        'container/flat_trie_test.cc',
+      ],
+      'dependencies': [
+        '<(mozc_oss_src_dir)/testing/testing.gyp:gtest_main',
+        'base.gyp:base',
+      ],
+      'variables': {
+        'test_size': 'small',
+      },
+    },
     {
       'target_name': 'trie_test',
       'type': 'executable',
@@ -417,6 +432,18 @@
         'install_embedded_file_h',
       ],
     },
+    {
+      'target_name': 'serialized_key_index_test',
+      'type': 'executable',
+      'sources': [
+        'container/serialized_key_index_test.cc',
+      ],
+      'dependencies': [
+        '<(mozc_oss_src_dir)/testing/testing.gyp:gtest_main',
+        'base.gyp:base',
+        'base.gyp:serialized_key_index',
+      ],
+    },
     {
       'target_name': 'serialized_string_array_test',
       'type': 'executable',
@@ -468,10 +495,12 @@
         'embedded_file_test',
         'encryptor_test',
         'file_util_test',
+        'flat_trie_test',
         'hash_test',
         'multifile_test',
         'number_util_test',
         'obfuscator_support_test',
+        'serialized_key_index_test',
         'serialized_string_array_test',
         'strings_japanese_test',
         'strings_unicode_test',
@@ -0,0 +1,163 @@
+// Copyright 2010-2021, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Measures the throughput of the character classification in Util and the
+// conversions in japanese_util on short candidate-like strings.
+//
+// Usage: character_benchmark_main --iterations=20
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/flags/flag.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+#include "base/init_mozc.h"
+#include "base/stopwatch.h"
+#include "base/strings/japanese.h"
+#include "base/strings/unicode.h"
+#include "base/util.h"
+
+ABSL_FLAG(int32_t, iterations, 20, "number of passes over each corpus");
+ABSL_FLAG(int32_t, corpus_size, 1 << 20, "approximate bytes of each corpus");
+
+namespace mozc {
+namespace {
+
+// Returns words of 1 to 8 characters taken from `chars` in turn.
+std::vector<std::string> MakeCorpus(const std::vector<char32_t> &chars) {
+  std::vector<std::string> corpus;
+  size_t bytes = 0;
+  size_t index = 0;
+  const size_t corpus_size = absl::GetFlag(FLAGS_corpus_size);
+  for (size_t len = 1; bytes < corpus_size; len = len % 8 + 1) {
+    std::string word;
+    for (size_t i = 0; i < len; ++i) {
+      strings::StrAppendChar32(&word, chars[index++ % chars.size()]);
+    }
+    bytes += word.size();
+    corpus.push_back(std::move(word));
+  }
+  return corpus;
+}
+
+std::vector<char32_t> Range(char32_t first, char32_t last) {
+  std::vector<char32_t> chars;
+  for (char32_t c = first; c <= last; ++c) {
+    chars.push_back(c);
+  }
+  return chars;
+}
+
+struct Corpus {
+  absl::string_view name;
+  std::vector<std::string> words;
+};
+
+std::vector<Corpus> MakeCorpora() {
+  std::vector<char32_t> mixed = Range(0x3041, 0x3093);  // Hiragana
+  for (const char32_t c : Range(0x4E00, 0x4E80)) {      // Kanji
+    mixed.push_back(c);
+  }
+  for (const char32_t c : Range(0x30A1, 0x30F3)) {  // Katakana
+    mixed.push_back(c);
+  }
+  std::vector<Corpus> corpora;
+  corpora.push_back({"ascii", MakeCorpus(Range(0x21, 0x7E))});
+  corpora.push_back({"hiragana", MakeCorpus(Range(0x3041, 0x3093))});
+  corpora.push_back({"katakana", MakeCorpus(Range(0x30A1, 0x30F3))});
+  corpora.push_back({"fullwidth", MakeCorpus(Range(0xFF01, 0xFF5E))});
+  corpora.push_back({"mixed", MakeCorpus(mixed)});
+  return corpora;
+}
+
+// Reports the throughput of the fastest pass over the corpus.
+template <typename Func>
+void Run(absl::string_view func_name, const Corpus &corpus, Func func) {
+  size_t bytes = 0;
+  for (const std::string &word : corpus.words) {
+    bytes += word.size();
+  }
+  size_t checksum = 0;
+  absl::Duration fastest = absl::InfiniteDuration();
+  for (int i = 0; i < absl::GetFlag(FLAGS_iterations); ++i) {
+    Stopwatch stopwatch = Stopwatch::StartNew();
+    for (const std::string &word : corpus.words) {
+      checksum += func(word);
+    }
+    stopwatch.Stop();
+    fastest = std::min(fastest, stopwatch.GetElapsed());
+  }
+  const double seconds = absl::ToDoubleSeconds(fastest);
+  std::cout << std::left << std::setw(42) << func_name << std::setw(12)
+            << corpus.name << std::right << std::fixed << std::setprecision(1)
+            << std::setw(10) << bytes / seconds / (1 << 20) << " MB/s"
+            << "  (checksum " << checksum << ")" << std::endl;
+}
+
+void RunAll() {
+  for (const Corpus &corpus : MakeCorpora()) {
+    Run("Util::GetScriptType", corpus,
+        [](absl::string_view s) { return Util::GetScriptType(s); });
+    Run("Util::GetFormType", corpus,
+        [](absl::string_view s) { return Util::GetFormType(s); });
+    Run("Util::IsScriptType(HIRAGANA)", corpus, [](absl::string_view s) {
+      return Util::IsScriptType(s, Util::HIRAGANA);
+    });
+    Run("japanese::HiraganaToKatakana", corpus, [](absl::string_view s) {
+      return japanese::HiraganaToKatakana(s).size();
+    });
+    Run("japanese::KatakanaToHiragana", corpus, [](absl::string_view s) {
+      return japanese::KatakanaToHiragana(s).size();
+    });
+    Run("japanese::FullWidthToHalfWidth", corpus, [](absl::string_view s) {
+      return japanese::FullWidthToHalfWidth(s).size();
+    });
+    Run("japanese::HalfWidthAsciiToFullWidthAscii", corpus,
+        [](absl::string_view s) {
+          return japanese::HalfWidthAsciiToFullWidthAscii(s).size();
+        });
+  }
+}
+
+}  // namespace
+}  // namespace mozc
+
+int main(int argc, char **argv) {
+  mozc::InitMozc(argv[0], &argc, &argv);
+  mozc::RunAll();
+  return 0;
+}
@@ -0,0 +1,222 @@
+// Copyright 2010-2021, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Immutable trie in flat arrays, compiled from a set of keys.
+
+#ifndef MOZC_BASE_CONTAINER_FLAT_TRIE_H_
+#define MOZC_BASE_CONTAINER_FLAT_TRIE_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "absl/log/check.h"
+#include "absl/strings/string_view.h"
+
+namespace mozc {
+
+// FlatTrie provides the lookups of Trie<T> with the same semantics for keys in
+// UTF-8, but the nodes and the edges are stored in flat arrays instead of a
+// hash map per node.  A lookup walks the key byte by byte with a binary search
+// in the sorted labels of each node, and the values of a subtree are stored
+// contiguously so that LookUpPredictiveAll() just copies a range.
+//
+// The trie is immutable; build a new one to update the keys.
+template <typename T>
+class FlatTrie final {
+ public:
+  FlatTrie() { nodes_.push_back(Node()); }
+
+  // Builds the trie from the pairs of a key and a value.  Keys must be unique.
+  explicit FlatTrie(std::vector<std::pair<absl::string_view, T>> entries) {
+    std::sort(entries.begin(), entries.end(),
+              [](const auto &lhs, const auto &rhs) {
+                return lhs.first < rhs.first;
+              });
+    nodes_.reserve(entries.size() + 1);
+    values_.reserve(entries.size());
+    Build(entries, 0, entries.size(), 0);
+  }
+
+  // Movable and copyable.
+  FlatTrie(const FlatTrie &) = default;
+  FlatTrie &operator=(const FlatTrie &) = default;
+  FlatTrie(FlatTrie &&) = default;
+  FlatTrie &operator=(FlatTrie &&) = default;
+
+  size_t size() const { return values_.size(); }
+
+  bool LookUp(absl::string_view key, T *data) const {
+    const uint32_t node = FindNode(key);
+    if (node == kNotFound || !nodes_[node].has_value) {
+      return false;
+    }
+    *data = values_[nodes_[node].value_begin];
+    return true;
+  }
+
+  // Same as Trie::LookUpPrefix().  The match ends at a character boundary of
+  // `key`.
+  bool LookUpPrefix(absl::string_view key, T *data, size_t *key_length,
+                    bool *fixed) const {
+    uint32_t node = 0;
+    uint32_t matched_node = 0;
+    size_t matched_length = 0;
+    for (size_t i = 0; i < key.size(); ++i) {
+      node = FindChild(node, key[i]);
+      if (node == kNotFound) {
+        break;
+      }
+      if (i + 1 == key.size() || !IsContinuationByte(key[i + 1])) {
+        matched_node = node;
+        matched_length = i + 1;
+      }
+    }
+    *key_length = matched_length;
+    const Node &matched = nodes_[matched_node];
+    if (!matched.has_value) {
+      *fixed = true;
+      return false;
+    }
+    *data = values_[matched.value_begin];
+    *fixed = matched.edge_begin == matched.edge_end;
+    return true;
+  }
+
+  // Same as Trie::LookUpPredictiveAll() except that the results are sorted by
+  // key.
+  void LookUpPredictiveAll(absl::string_view key,
+                           std::vector<T> *data_list) const {
+    DCHECK(data_list);
+    const uint32_t node = FindNode(key);
+    if (node == kNotFound) {
+      return;
+    }
+    data_list->insert(data_list->end(),
+                      values_.begin() + nodes_[node].value_begin,
+                      values_.begin() + nodes_[node].value_end);
+  }
+
+  bool HasSubTrie(absl::string_view key) const {
+    return !key.empty() && FindNode(key) != kNotFound;
+  }
+
+ private:
+  static constexpr uint32_t kNotFound = 0xFFFFFFFF;
+
+  struct Node {
+    // Range of the edges to the children in labels_ and children_.
+    uint32_t edge_begin = 0;
+    uint32_t edge_end = 0;
+    // Range of the values of the subtree in values_.  If has_value is true,
+    // the first one is the value of this node.
+    uint32_t value_begin = 0;
+    uint32_t value_end = 0;
+    bool has_value = false;
+  };
+
+  static bool IsContinuationByte(char c) {
+    return (static_cast<uint8_t>(c) & 0xC0) == 0x80;
+  }
+
+  // Builds the node for sorted entries[begin, end), which share the first
+  // `depth` bytes, and returns its index.  Nodes and values are stored in
+  // preorder.
+  uint32_t Build(const std::vector<std::pair<absl::string_view, T>> &entries,
+                 size_t begin, size_t end, size_t depth) {
+    const uint32_t index = nodes_.size();
+    nodes_.push_back(Node());
+    nodes_[index].value_begin = values_.size();
+    if (begin < end && entries[begin].first.size() == depth) {
+      nodes_[index].has_value = true;
+      values_.push_back(entries[begin].second);
+      ++begin;
+    }
+
+    // Group the rest by the next byte.  The edges of a node are contiguous, so
+    // all of them are added before building the children.
+    std::vector<std::pair<size_t, size_t>> groups;
+    for (size_t i = begin; i < end;) {
+      const char label = entries[i].first[depth];
+      size_t j = i + 1;
+      while (j < end && entries[j].first[depth] == label) {
+        ++j;
+      }
+      groups.emplace_back(i, j);
+      i = j;
+    }
+    nodes_[index].edge_begin = labels_.size();
+    nodes_[index].edge_end = labels_.size() + groups.size();
+    for (const auto &[group_begin, unused] : groups) {
+      labels_.push_back(
+          static_cast<uint8_t>(entries[group_begin].first[depth]));
+      children_.push_back(kNotFound);
+    }
+    for (size_t i = 0; i < groups.size(); ++i) {
+      const uint32_t child =
+          Build(entries, groups[i].first, groups[i].second, depth + 1);
+      children_[nodes_[index].edge_begin + i] = child;
+    }
+    nodes_[index].value_end = values_.size();
+    return index;
+  }
+
+  uint32_t FindChild(uint32_t node, char c) const {
+    const uint8_t label = static_cast<uint8_t>(c);
+    const auto begin = labels_.begin() + nodes_[node].edge_begin;
+    const auto end = labels_.begin() + nodes_[node].edge_end;
+    const auto it = std::lower_bound(begin, end, label);
+    if (it == end || *it != label) {
+      return kNotFound;
+    }
+    return children_[it - labels_.begin()];
+  }
+
+  uint32_t FindNode(absl::string_view key) const {
+    uint32_t node = 0;
+    for (const char c : key) {
+      node = FindChild(node, c);
+      if (node == kNotFound) {
+        break;
+      }
+    }
+    return node;
+  }
+
+  std::vector<Node> nodes_;  // nodes_[0] is the root.
+  std::vector<uint8_t> labels_;
+  std::vector<uint32_t> children_;
+  std::vector<T> values_;
+};
+
+}  // namespace mozc
+
+#endif  // MOZC_BASE_CONTAINER_FLAT_TRIE_H_
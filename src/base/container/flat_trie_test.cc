@@ -0,0 +1,158 @@
+// Copyright 2010-2021, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "base/container/flat_trie.h"
+
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/string_view.h"
+#include "base/container/trie.h"
+#include "testing/gmock.h"
+#include "testing/gunit.h"
+
+namespace mozc {
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::IsEmpty;
+using ::testing::UnorderedElementsAreArray;
+
+TEST(FlatTrieTest, Empty) {
+  const FlatTrie<int> trie;
+  EXPECT_EQ(trie.size(), 0);
+  int value = 0;
+  EXPECT_FALSE(trie.LookUp("", &value));
+  EXPECT_FALSE(trie.LookUp("a", &value));
+  size_t key_length = 1;
+  bool fixed = false;
+  EXPECT_FALSE(trie.LookUpPrefix("a", &value, &key_length, &fixed));
+  EXPECT_EQ(key_length, 0);
+  EXPECT_TRUE(fixed);
+  std::vector<int> values;
+  trie.LookUpPredictiveAll("", &values);
+  EXPECT_THAT(values, IsEmpty());
+  EXPECT_FALSE(trie.HasSubTrie("a"));
+}
+
+TEST(FlatTrieTest, LookUp) {
+  const FlatTrie<int> trie({{"abc", 1}, {"abd", 2}, {"a", 3}, {"", 4}});
+  EXPECT_EQ(trie.size(), 4);
+
+  int value = 0;
+  EXPECT_TRUE(trie.LookUp("abc", &value));
+  EXPECT_EQ(value, 1);
+  EXPECT_TRUE(trie.LookUp("a", &value));
+  EXPECT_EQ(value, 3);
+  EXPECT_TRUE(trie.LookUp("", &value));
+  EXPECT_EQ(value, 4);
+  EXPECT_FALSE(trie.LookUp("ab", &value));
+  EXPECT_FALSE(trie.LookUp("abcd", &value));
+
+  EXPECT_TRUE(trie.HasSubTrie("ab"));
+  EXPECT_TRUE(trie.HasSubTrie("abc"));
+  EXPECT_FALSE(trie.HasSubTrie("abcd"));
+  EXPECT_FALSE(trie.HasSubTrie(""));
+
+  std::vector<int> values;
+  trie.LookUpPredictiveAll("ab", &values);
+  EXPECT_THAT(values, ElementsAre(1, 2));
+  values.clear();
+  trie.LookUpPredictiveAll("", &values);
+  EXPECT_THAT(values, ElementsAre(4, 3, 1, 2));
+}
+
+TEST(FlatTrieTest, LookUpPrefix) {
+  const FlatTrie<int> trie({{"abc", 1}, {"abd", 2}, {"a", 3}});
+
+  int value = 0;
+  size_t key_length = 0;
+  bool fixed = false;
+  EXPECT_TRUE(trie.LookUpPrefix("abcd", &value, &key_length, &fixed));
+  EXPECT_EQ(value, 1);
+  EXPECT_EQ(key_length, 3);
+  EXPECT_TRUE(fixed);
+
+  EXPECT_TRUE(trie.LookUpPrefix("ac", &value, &key_length, &fixed));
+  EXPECT_EQ(value, 3);
+  EXPECT_EQ(key_length, 1);
+  EXPECT_FALSE(fixed);
+
+  // "ab" has no value, and "a" is not referred.
+  EXPECT_FALSE(trie.LookUpPrefix("abe", &value, &key_length, &fixed));
+  EXPECT_EQ(key_length, 2);
+  EXPECT_TRUE(fixed);
+}
+
+TEST(FlatTrieTest, SameAsTrie) {
+  // "き" and "く" share the first two bytes in UTF-8, so the byte walk has to
+  // stop at character boundaries.
+  const std::vector<std::pair<std::string, std::string>> entries = {
+      {"きゃ", "kya"}, {"きゅ", "kyu"}, {"っ", "xtu"}, {"か", "ka"},
+      {"き", "ki"},    {"け", "ke"},    {"n", "n"},    {"nn", "nn"},
+      {"ny", ""},      {"nya", "nya"},  {"{!}", "!"},  {"\tk", "k"},
+  };
+  Trie<std::string> trie;
+  std::vector<std::pair<absl::string_view, std::string>> flat_entries;
+  for (const auto &[key, value] : entries) {
+    trie.AddEntry(key, value);
+    flat_entries.emplace_back(key, value);
+  }
+  const FlatTrie<std::string> flat_trie(flat_entries);
+
+  for (const absl::string_view key :
+       {"", "き", "きゃ", "きょ", "きゃあ", "く", "くぁ", "っあ", "かかか",
+        "n", "ny", "nyu", "nya", "x", "{", "{!}", "\t", "\tka", "け"}) {
+    std::string expected_value, value;
+    size_t expected_key_length = 0, key_length = 0;
+    bool expected_fixed = false, fixed = false;
+    EXPECT_EQ(flat_trie.LookUpPrefix(key, &value, &key_length, &fixed),
+              trie.LookUpPrefix(key, &expected_value, &expected_key_length,
+                                &expected_fixed))
+        << key;
+    EXPECT_EQ(value, expected_value) << key;
+    EXPECT_EQ(key_length, expected_key_length) << key;
+    EXPECT_EQ(fixed, expected_fixed) << key;
+
+    EXPECT_EQ(flat_trie.LookUp(key, &value), trie.LookUp(key, &expected_value))
+        << key;
+    EXPECT_EQ(value, expected_value) << key;
+    EXPECT_EQ(flat_trie.HasSubTrie(key), trie.HasSubTrie(key)) << key;
+
+    std::vector<std::string> values, expected_values;
+    flat_trie.LookUpPredictiveAll(key, &values);
+    trie.LookUpPredictiveAll(key, &expected_values);
+    EXPECT_THAT(values, UnorderedElementsAreArray(expected_values)) << key;
+  }
+}
+
+}  // namespace
+}  // namespace mozc
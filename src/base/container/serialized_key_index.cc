@@ -0,0 +1,169 @@
+// Copyright 2010-2021, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "base/container/serialized_key_index.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+
+#include "absl/base/config.h"
+#include "absl/functional/function_ref.h"
+#include "absl/log/check.h"
+#include "absl/log/log.h"
+#include "absl/numeric/bits.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
+
+namespace mozc {
+namespace {
+
+// Number of uint32_t per slot: hash, begin and end.
+constexpr uint32_t kSlotSize = 3;
+
+}  // namespace
+
+static_assert(ABSL_IS_LITTLE_ENDIAN, "Little endian is assumed");
+
+bool SerializedKeyIndex::Init(
+    absl::string_view data_aligned_at_4byte_boundary) {
+  if (VerifyData(data_aligned_at_4byte_boundary)) {
+    Set(data_aligned_at_4byte_boundary);
+    return true;
+  }
+  clear();
+  return false;
+}
+
+void SerializedKeyIndex::Set(absl::string_view data_aligned_at_4byte_boundary) {
+  DCHECK(VerifyData(data_aligned_at_4byte_boundary));
+  const uint32_t *u32_array =
+      reinterpret_cast<const uint32_t *>(data_aligned_at_4byte_boundary.data());
+  num_slots_ = u32_array[0];
+  slots_ = u32_array + 1;
+}
+
+std::optional<SerializedKeyIndex::Range> SerializedKeyIndex::Find(
+    absl::string_view key,
+    absl::FunctionRef<absl::string_view(uint32_t)> key_at) const {
+  if (empty()) {
+    return std::nullopt;
+  }
+  const uint32_t hash = Hash(key);
+  const uint32_t mask = num_slots_ - 1;
+  // The serializer keeps at least one slot empty, so the loop terminates.
+  for (uint32_t i = hash & mask;; i = (i + 1) & mask) {
+    const uint32_t *slot = slots_ + i * kSlotSize;
+    if (slot[2] == 0) {
+      return std::nullopt;
+    }
+    if (slot[0] == hash && key_at(slot[1]) == key) {
+      return Range(slot[1], slot[2]);
+    }
+  }
+}
+
+uint32_t SerializedKeyIndex::Hash(absl::string_view key) {
+  uint32_t hash = 2166136261u;
+  for (const char c : key) {
+    hash ^= static_cast<uint8_t>(c);
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+bool SerializedKeyIndex::VerifyData(absl::string_view data,
+                                    std::optional<uint32_t> array_size) {
+  if (data.size() < 4) {
+    LOG(ERROR) << "Number of slots is missing";
+    return false;
+  }
+  const uint32_t *u32_array = reinterpret_cast<const uint32_t *>(data.data());
+  const uint32_t num_slots = u32_array[0];
+  if (!absl::has_single_bit(num_slots)) {
+    LOG(ERROR) << "Number of slots is not a power of 2: " << num_slots;
+    return false;
+  }
+  if ((data.size() - 4) / 4 / kSlotSize != num_slots ||
+      (data.size() - 4) % (4 * kSlotSize) != 0) {
+    LOG(ERROR) << "Invalid data size for " << num_slots
+               << " slots: " << data.size();
+    return false;
+  }
+
+  bool has_empty_slot = false;
+  for (uint32_t i = 0; i < num_slots; ++i) {
+    const uint32_t *slot = u32_array + 1 + i * kSlotSize;
+    if (slot[2] == 0) {
+      has_empty_slot = true;
+      continue;
+    }
+    if (slot[1] >= slot[2] ||
+        (array_size.has_value() && slot[2] > *array_size)) {
+      LOG(ERROR) << "Invalid range in slot " << i << ": [" << slot[1] << ", "
+                 << slot[2] << ")";
+      return false;
+    }
+  }
+  if (!has_empty_slot) {
+    LOG(ERROR) << "No empty slot";
+    return false;
+  }
+  return true;
+}
+
+absl::string_view SerializedKeyIndex::SerializeToBuffer(
+    absl::Span<const Entry> entries, std::unique_ptr<uint32_t[]> *buffer) {
+  // Keep the load factor at most 1/2, which also guarantees an empty slot.
+  const uint32_t num_slots =
+      absl::bit_ceil(static_cast<uint32_t>(entries.size() * 2 + 1));
+  const size_t buffer_size = 1 + num_slots * kSlotSize;
+  *buffer = std::make_unique<uint32_t[]>(buffer_size);
+  uint32_t *u32_array = buffer->get();
+  u32_array[0] = num_slots;
+  uint32_t *slots = u32_array + 1;
+
+  const uint32_t mask = num_slots - 1;
+  for (const Entry &entry : entries) {
+    CHECK_LT(entry.begin, entry.end) << "Empty range for " << entry.key;
+    const uint32_t hash = Hash(entry.key);
+    uint32_t i = hash & mask;
+    while (slots[i * kSlotSize + 2] != 0) {
+      i = (i + 1) & mask;
+    }
+    slots[i * kSlotSize] = hash;
+    slots[i * kSlotSize + 1] = entry.begin;
+    slots[i * kSlotSize + 2] = entry.end;
+  }
+  return absl::string_view(reinterpret_cast<const char *>(u32_array),
+                           buffer_size * 4);
+}
+
+}  // namespace mozc
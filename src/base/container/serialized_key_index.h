@@ -0,0 +1,127 @@
+// Copyright 2010-2021, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef MOZC_BASE_CONTAINER_SERIALIZED_KEY_INDEX_H_
+#define MOZC_BASE_CONTAINER_SERIALIZED_KEY_INDEX_H_
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <utility>
+
+#include "absl/functional/function_ref.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
+
+namespace mozc {
+
+// Immutable hash index from string keys to ranges of an array sorted by key,
+// serialized in a binary image so that it can be generated at build time and
+// stored next to the array in the data set.  Looking up a key costs one hash
+// computation and, usually, a single string comparison to verify the hit,
+// instead of a binary search with string comparisons.
+//
+// * Serialized data creation
+// Use SerializedKeyIndex::SerializeToBuffer() or
+// build_tools/serialized_key_index_builder.py.
+//
+// * Binary format
+// An array of uint32_t in little endian order.  The number of slots N is a
+// power of 2.  Each key is stored in the first empty slot found by linear
+// probing from slot (Hash(key) & (N - 1)).  An empty slot has zeros in all the
+// fields.  Since the ranges are not empty, end > 0 for the other slots.
+//
+// +=====================================================================+
+// | Number of slots N  (4 byte)                                         |
+// +=====================================================================+
+// | Hash of key 0  (4 byte)                                             |
+// + - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - +
+// | Begin of the range of key 0  (4 byte)                               |
+// + - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - +
+// | End of the range of key 0  (4 byte, exclusive)                      |
+// +---------------------------------------------------------------------+
+// |                      .                                              |
+// |                      .                                              |
+// +---------------------------------------------------------------------+
+// | Hash, begin and end of slot N - 1  (12 byte)                        |
+// +=====================================================================+
+//
+// The keys themselves are not stored; the caller provides them from the
+// indexed array to Find().
+class SerializedKeyIndex {
+ public:
+  struct Entry {
+    absl::string_view key;
+    uint32_t begin;
+    uint32_t end;
+  };
+
+  using Range = std::pair<uint32_t, uint32_t>;
+
+  SerializedKeyIndex() = default;
+
+  // Initializes the index from given memory block.  The block must be aligned
+  // at 4 byte boundary.  Returns false when the data is invalid.
+  bool Init(absl::string_view data_aligned_at_4byte_boundary);
+
+  // Initializes the index from given memory block without verifying data.
+  void Set(absl::string_view data_aligned_at_4byte_boundary);
+
+  bool empty() const { return num_slots_ == 0; }
+  void clear() { *this = SerializedKeyIndex(); }
+
+  // Returns the range of `key`.  `key_at(i)` should return the key of the i-th
+  // element of the indexed array; it is called to reject the keys having the
+  // same hash as `key`.
+  std::optional<Range> Find(
+      absl::string_view key,
+      absl::FunctionRef<absl::string_view(uint32_t)> key_at) const;
+
+  // Returns the hash used in the index (32-bit FNV-1a).
+  static uint32_t Hash(absl::string_view key);
+
+  // Checks if the data is a valid index image.  If `array_size` is given, the
+  // ranges are also checked to be within it.
+  static bool VerifyData(absl::string_view data,
+                         std::optional<uint32_t> array_size = std::nullopt);
+
+  // Creates a byte image of `entries` in `buffer` and returns the memory block
+  // in `buffer` pointing to the image.  The keys of `entries` must be unique
+  // and the ranges must not be empty.
+  static absl::string_view SerializeToBuffer(
+      absl::Span<const Entry> entries, std::unique_ptr<uint32_t[]> *buffer);
+
+ private:
+  const uint32_t *slots_ = nullptr;
+  uint32_t num_slots_ = 0;
+};
+
+}  // namespace mozc
+
+#endif  // MOZC_BASE_CONTAINER_SERIALIZED_KEY_INDEX_H_
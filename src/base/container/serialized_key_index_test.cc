@@ -0,0 +1,134 @@
+// Copyright 2010-2021, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "base/container/serialized_key_index.h"
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "testing/gunit.h"
+
+namespace mozc {
+namespace {
+
+TEST(SerializedKeyIndexTest, DefaultConstructor) {
+  const SerializedKeyIndex index;
+  EXPECT_TRUE(index.empty());
+  EXPECT_EQ(index.Find("a", [](uint32_t) { return "a"; }), std::nullopt);
+}
+
+TEST(SerializedKeyIndexTest, Hash) {
+  // Test vectors of 32-bit FNV-1a. build_tools/serialized_key_index_builder.py
+  // must compute the same values.
+  EXPECT_EQ(SerializedKeyIndex::Hash(""), 0x811c9dc5);
+  EXPECT_EQ(SerializedKeyIndex::Hash("a"), 0xe40c292c);
+  EXPECT_EQ(SerializedKeyIndex::Hash("foobar"), 0xbf9cf968);
+}
+
+TEST(SerializedKeyIndexTest, Find) {
+  // Sorted array of keys with duplicates, as in SerializedDictionary.
+  const std::vector<std::string> array = {"a", "a", "b", "c", "c", "c"};
+  std::unique_ptr<uint32_t[]> buf;
+  const absl::string_view data = SerializedKeyIndex::SerializeToBuffer(
+      {{"a", 0, 2}, {"b", 2, 3}, {"c", 3, 6}}, &buf);
+  ASSERT_TRUE(SerializedKeyIndex::VerifyData(data, array.size()));
+  EXPECT_FALSE(SerializedKeyIndex::VerifyData(data, 5));
+
+  SerializedKeyIndex index;
+  ASSERT_TRUE(index.Init(data));
+  EXPECT_FALSE(index.empty());
+  const auto key_at = [&array](uint32_t i) -> absl::string_view {
+    return array[i];
+  };
+  EXPECT_EQ(index.Find("a", key_at), SerializedKeyIndex::Range(0, 2));
+  EXPECT_EQ(index.Find("b", key_at), SerializedKeyIndex::Range(2, 3));
+  EXPECT_EQ(index.Find("c", key_at), SerializedKeyIndex::Range(3, 6));
+  EXPECT_EQ(index.Find("", key_at), std::nullopt);
+  EXPECT_EQ(index.Find("d", key_at), std::nullopt);
+}
+
+TEST(SerializedKeyIndexTest, ManyKeys) {
+  std::vector<std::string> array;
+  std::vector<SerializedKeyIndex::Entry> entries;
+  for (uint32_t i = 0; i < 1000; ++i) {
+    array.push_back(absl::StrCat("key", i));
+  }
+  for (uint32_t i = 0; i < array.size(); ++i) {
+    entries.push_back({array[i], i, i + 1});
+  }
+  std::unique_ptr<uint32_t[]> buf;
+  const absl::string_view data =
+      SerializedKeyIndex::SerializeToBuffer(entries, &buf);
+  SerializedKeyIndex index;
+  ASSERT_TRUE(index.Init(data));
+
+  const auto key_at = [&array](uint32_t i) -> absl::string_view {
+    return array[i];
+  };
+  for (uint32_t i = 0; i < array.size(); ++i) {
+    EXPECT_EQ(index.Find(array[i], key_at), SerializedKeyIndex::Range(i, i + 1))
+        << array[i];
+  }
+  EXPECT_EQ(index.Find("key1000", key_at), std::nullopt);
+}
+
+TEST(SerializedKeyIndexTest, VerifyBrokenData) {
+  EXPECT_FALSE(SerializedKeyIndex::VerifyData(""));
+
+  // 3 slots is not a power of 2.
+  alignas(uint32_t) constexpr char kNotPowerOf2[] =
+      "\x03\x00\x00\x00"
+      "\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00"
+      "\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00"
+      "\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00";
+  EXPECT_FALSE(SerializedKeyIndex::VerifyData(
+      absl::string_view(kNotPowerOf2, sizeof(kNotPowerOf2) - 1)));
+
+  // The data for 2 slots is truncated.
+  alignas(uint32_t) constexpr char kTruncated[] =
+      "\x02\x00\x00\x00"
+      "\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00";
+  EXPECT_FALSE(SerializedKeyIndex::VerifyData(
+      absl::string_view(kTruncated, sizeof(kTruncated) - 1)));
+
+  // No empty slot.
+  alignas(uint32_t) constexpr char kFull[] =
+      "\x01\x00\x00\x00"
+      "\x00\x00\x00\x00\x00\x00\x00\x00\x01\x00\x00\x00";
+  EXPECT_FALSE(SerializedKeyIndex::VerifyData(
+      absl::string_view(kFull, sizeof(kFull) - 1)));
+}
+
+}  // namespace
+}  // namespace mozc
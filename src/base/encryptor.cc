@@ -111,6 +111,28 @@ std::string GetMSCryptDeriveKeyWithSHA1(const absl::string_view password,
                       UnverifiedSHA1::MakeDigest(buf2));
 }
 
+// Returns the size of the PKCS#5 padding at the end of the decrypted
+// |last_block|, or 0 if the padding is broken.
+// see. http://www.chilkatsoft.com/faq/PKCS5_Padding.html
+size_t GetPaddingSize(const char *last_block) {
+  const uint8_t padding_value =
+      static_cast<uint8_t>(last_block[Encryptor::kBlockSize - 1]);
+  const size_t padding_size = static_cast<size_t>(padding_value);
+  if (padding_value == 0x00 || padding_value > Encryptor::kBlockSize) {
+    LOG(ERROR) << "Cannot find PKCS#5 padding values: ";
+    return 0;
+  }
+
+  for (size_t i = Encryptor::kBlockSize - padding_size;
+       i < Encryptor::kBlockSize; ++i) {
+    if (static_cast<uint8_t>(last_block[i]) != padding_value) {
+      LOG(ERROR) << "invalid padding value. message is broken";
+      return 0;
+    }
+  }
+  return padding_size;
+}
+
 }  // namespace
 
 size_t Encryptor::Key::GetEncryptedSize(size_t size) const {
@@ -233,11 +255,8 @@ bool Encryptor::DecryptArray(const Encryptor::Key &key, char *buf,
       key.key_, key.iv_, reinterpret_cast<uint8_t *>(buf), size / kBlockSize);
 
   // perform PKCS#5 un-padding
-  // see. http://www.chilkatsoft.com/faq/PKCS5_Padding.html
-  const uint8_t padding_value = static_cast<uint8_t>(buf[size - 1]);
-  const size_t padding_size = static_cast<size_t>(padding_value);
-  if (padding_value == 0x00 || padding_value > kBlockSize) {
-    LOG(ERROR) << "Cannot find PKCS#5 padding values: ";
+  const size_t padding_size = GetPaddingSize(buf + size - kBlockSize);
+  if (padding_size == 0) {
     return false;
   }
 
@@ -246,13 +265,118 @@ bool Encryptor::DecryptArray(const Encryptor::Key &key, char *buf,
     return false;
   }
 
-  for (size_t i = size - padding_size; i < size; ++i) {
-    if (static_cast<uint8_t>(buf[i]) != padding_value) {
-      LOG(ERROR) << "invalid padding value. message is broken";
-      return false;
+  *buf_size -= padding_size;  // remove padding part
+  return true;
+}
+
+Encryptor::StreamEncrypter::StreamEncrypter(const Key &key) {
+  DCHECK(key.IsAvailable());
+  internal::UnverifiedAES256::ExpandKey(key.key_, &schedule_);
+  std::copy_n(key.iv_, kBlockSize, iv_);
+}
+
+void Encryptor::StreamEncrypter::Update(absl::string_view input,
+                                        std::string *output) {
+  const auto encrypt = [&](absl::string_view blocks) {
+    const size_t pos = output->size();
+    output->append(blocks.data(), blocks.size());
+    internal::UnverifiedAES256::TransformCBCChunk(
+        schedule_, iv_, reinterpret_cast<uint8_t *>(output->data() + pos),
+        blocks.size() / kBlockSize);
+  };
+
+  // Completes the pending block first.
+  if (!pending_.empty()) {
+    const size_t size = std::min(kBlockSize - pending_.size(), input.size());
+    pending_.append(input.data(), size);
+    input.remove_prefix(size);
+    if (pending_.size() < kBlockSize) {
+      return;
     }
+    encrypt(pending_);
+    pending_.clear();
   }
-  *buf_size -= padding_size;  // remove padding part
+
+  const size_t size = input.size() - input.size() % kBlockSize;
+  if (size > 0) {
+    encrypt(input.substr(0, size));
+  }
+  input.remove_prefix(size);
+  pending_.append(input.data(), input.size());
+}
+
+void Encryptor::StreamEncrypter::Finish(std::string *output) {
+  // perform PKCS#5 padding
+  const size_t padding_size = kBlockSize - pending_.size();
+  pending_.append(padding_size, static_cast<char>(padding_size));
+  const size_t pos = output->size();
+  output->append(pending_);
+  pending_.clear();
+  internal::UnverifiedAES256::TransformCBCChunk(
+      schedule_, iv_, reinterpret_cast<uint8_t *>(output->data() + pos), 1);
+}
+
+Encryptor::StreamDecrypter::StreamDecrypter(const Key &key) {
+  DCHECK(key.IsAvailable());
+  internal::UnverifiedAES256::ExpandKey(key.key_, &schedule_);
+  std::copy_n(key.iv_, kBlockSize, iv_);
+}
+
+void Encryptor::StreamDecrypter::Update(absl::string_view input,
+                                        std::string *output) {
+  const auto decrypt = [&](absl::string_view blocks) {
+    const size_t pos = output->size();
+    output->append(blocks.data(), blocks.size());
+    internal::UnverifiedAES256::InverseTransformCBCChunk(
+        schedule_, iv_, reinterpret_cast<uint8_t *>(output->data() + pos),
+        blocks.size() / kBlockSize);
+    has_blocks_ = true;
+  };
+
+  // Completes the pending block first.
+  if (pending_.size() < kBlockSize) {
+    const size_t size = std::min(kBlockSize - pending_.size(), input.size());
+    pending_.append(input.data(), size);
+    input.remove_prefix(size);
+  }
+  if (input.empty()) {
+    return;
+  }
+  // The pending block is not the last one.
+  decrypt(pending_);
+  pending_.clear();
+
+  size_t last_size = input.size() % kBlockSize;
+  if (last_size == 0) {
+    last_size = kBlockSize;
+  }
+  const size_t size = input.size() - last_size;
+  if (size > 0) {
+    decrypt(input.substr(0, size));
+  }
+  input.remove_prefix(size);
+  pending_.append(input.data(), input.size());
+}
+
+bool Encryptor::StreamDecrypter::Finish(std::string *output) {
+  if (pending_.size() != kBlockSize) {
+    LOG(ERROR) << "message size is not multiples of " << kBlockSize;
+    return false;
+  }
+  internal::UnverifiedAES256::InverseTransformCBCChunk(
+      schedule_, iv_, reinterpret_cast<uint8_t *>(pending_.data()), 1);
+  const size_t padding_size = GetPaddingSize(pending_.data());
+  if (padding_size == 0) {
+    return false;
+  }
+
+  if (!has_blocks_ && padding_size == kBlockSize) {
+    LOG(ERROR) << "padding size is no smaller than original message";
+    return false;
+  }
+
+  output->append(pending_.data(), kBlockSize - padding_size);
+  pending_.clear();
   return true;
 }
 
@@ -35,6 +35,7 @@
 #include <string>
 
 #include "absl/strings/string_view.h"
+#include "base/unverified_aes256.h"
 
 namespace mozc {
 
@@ -114,6 +115,56 @@ class Encryptor {
   // Encrypt string with key.
   static bool DecryptString(const Key &key, std::string *data);
 
+  // Encrypts a message chunk by chunk. The result is the same as
+  // EncryptString() for the concatenation of the chunks, but the message
+  // doesn't need to be in memory as a whole. As with EncryptString(), the
+  // message must not be empty.
+  class StreamEncrypter {
+   public:
+    explicit StreamEncrypter(const Key &key);
+    StreamEncrypter(const StreamEncrypter &) = delete;
+    StreamEncrypter &operator=(const StreamEncrypter &) = delete;
+
+    // Appends the encrypted blocks completed by |input| to |output|.
+    void Update(absl::string_view input, std::string *output);
+
+    // Appends the last block with the padding to |output|. Must be called
+    // once after all the chunks are given.
+    void Finish(std::string *output);
+
+   private:
+    internal::UnverifiedAES256::KeySchedule schedule_;
+    uint8_t iv_[kBlockSize];
+    // The input which doesn't fill a block yet.
+    std::string pending_;
+  };
+
+  // Decrypts a message encrypted by EncryptString() or StreamEncrypter chunk
+  // by chunk.
+  class StreamDecrypter {
+   public:
+    explicit StreamDecrypter(const Key &key);
+    StreamDecrypter(const StreamDecrypter &) = delete;
+    StreamDecrypter &operator=(const StreamDecrypter &) = delete;
+
+    // Appends the decrypted blocks of |input| to |output|. The last block is
+    // held until Finish() as it may contain the padding.
+    void Update(absl::string_view input, std::string *output);
+
+    // Appends the last block without the padding to |output|. Returns false
+    // if the message is broken.
+    bool Finish(std::string *output);
+
+   private:
+    internal::UnverifiedAES256::KeySchedule schedule_;
+    uint8_t iv_[kBlockSize];
+    // The input which isn't decrypted yet, which has at most one block after
+    // Update().
+    std::string pending_;
+    // True if any block before the last one has been decrypted.
+    bool has_blocks_ = false;
+  };
+
   // Encrypt string to protect plain_text which may contain
   // sensitive data, like auth_token, password ..etc.
   // It uses CryptProtectData API to encrypt data on Windows.
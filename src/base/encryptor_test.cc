@@ -34,6 +34,7 @@
 #include <iterator>
 #include <string>
 
+#include "absl/strings/string_view.h"
 #include "base/random.h"
 #include "testing/gunit.h"
 #include "testing/mozctest.h"
@@ -223,6 +224,71 @@ TEST_F(EncryptorTest, EncryptBatch) {
   }
 }
 
+TEST_F(EncryptorTest, Stream) {
+  constexpr size_t kSizeTable[] = {1, 15, 16, 17, 100, 1000, 100000};
+  constexpr size_t kChunkSizeTable[] = {1, 7, 16, 33, 4096};
+
+  Encryptor::Key key;
+  ASSERT_TRUE(key.DeriveFromPassword("test", "salt"));
+
+  Random random;
+  for (const size_t size : kSizeTable) {
+    const std::string original = random.ByteString(size);
+    std::string expected = original;
+    ASSERT_TRUE(Encryptor::EncryptString(key, &expected));
+
+    for (const size_t chunk_size : kChunkSizeTable) {
+      Encryptor::StreamEncrypter encrypter(key);
+      std::string encrypted;
+      for (size_t pos = 0; pos < original.size(); pos += chunk_size) {
+        encrypter.Update(absl::string_view(original).substr(pos, chunk_size),
+                         &encrypted);
+      }
+      encrypter.Finish(&encrypted);
+      EXPECT_EQ(encrypted, expected) << size << " " << chunk_size;
+
+      Encryptor::StreamDecrypter decrypter(key);
+      std::string decrypted;
+      for (size_t pos = 0; pos < encrypted.size(); pos += chunk_size) {
+        decrypter.Update(absl::string_view(encrypted).substr(pos, chunk_size),
+                         &decrypted);
+      }
+      EXPECT_TRUE(decrypter.Finish(&decrypted));
+      EXPECT_EQ(decrypted, original) << size << " " << chunk_size;
+    }
+  }
+}
+
+TEST_F(EncryptorTest, StreamBroken) {
+  Encryptor::Key key1, key2;
+  ASSERT_TRUE(key1.DeriveFromPassword("test", "salt"));
+  ASSERT_TRUE(key2.DeriveFromPassword("test2", "salt"));
+
+  std::string encrypted = "message";
+  ASSERT_TRUE(Encryptor::EncryptString(key1, &encrypted));
+
+  {
+    // Truncated.
+    Encryptor::StreamDecrypter decrypter(key1);
+    std::string decrypted;
+    decrypter.Update(absl::string_view(encrypted).substr(1), &decrypted);
+    EXPECT_FALSE(decrypter.Finish(&decrypted));
+  }
+  {
+    // Empty.
+    Encryptor::StreamDecrypter decrypter(key1);
+    std::string decrypted;
+    EXPECT_FALSE(decrypter.Finish(&decrypted));
+  }
+  {
+    // Wrong key.
+    Encryptor::StreamDecrypter decrypter(key2);
+    std::string decrypted;
+    decrypter.Update(encrypted, &decrypted);
+    EXPECT_FALSE(decrypter.Finish(&decrypted) && decrypted == "message");
+  }
+}
+
 TEST_F(EncryptorTest, ProtectData) {
   constexpr size_t kSizeTable[] = {1, 10, 100, 1000, 10000, 100000};
 
@@ -92,6 +92,10 @@ std::string ConvertUsingDoubleArray(const DoubleArray *da, const char *ctable,
                                     const absl::string_view input) {
   int mblen = 0;
   std::string output;
+  output.reserve(input.size());
+  // Characters not found in the table are copied from input at once when the
+  // next match is found.
+  size_t unmatched_begin = 0;
   for (size_t i = 0; i < input.size(); i += mblen) {
     const LookupResult result = LookupDoubleArray(da, input.substr(i));
     if (result.seekto > 0) {
@@ -99,14 +103,22 @@ std::string ConvertUsingDoubleArray(const DoubleArray *da, const char *ctable,
       // - null-terminated string
       // - one byte offset to rewind the input
       const absl::string_view s(ctable + result.index);
-      absl::StrAppend(&output, s);
+      if (unmatched_begin < i) {
+        output.append(input.data() + unmatched_begin, i - unmatched_begin);
+      }
+      output.append(s.data(), s.size());
       mblen = AdvanceInputBy(ctable, result, s.size());
+      unmatched_begin = i + mblen;
     } else {
-      // Not found in the table. Copy from input.
+      // Not found in the table. Copied from input with the following
+      // unmatched characters.
       mblen = OneCharLen(input[i]);
-      absl::StrAppend(&output, input.substr(i, mblen));
     }
   }
+  if (unmatched_begin < input.size()) {
+    output.append(input.data() + unmatched_begin,
+                  input.size() - unmatched_begin);
+  }
   return output;
 }
 
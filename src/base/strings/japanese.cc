@@ -29,6 +29,8 @@
 
 #include "base/strings/japanese.h"
 
+#include <cstddef>
+#include <cstdint>
 #include <string>
 #include <utility>
 #include <vector>
@@ -41,7 +43,60 @@ namespace mozc::japanese {
 
 using ::mozc::japanese::internal::ConvertUsingDoubleArray;
 
+namespace {
+
+// Hiragana letters [ぁ-ゔ] and katakana letters [ァ-ヴ] are mapped to each
+// other one by one in the tables.
+constexpr char32_t kFirstHiraganaLetter = 0x3041;
+constexpr char32_t kLastHiraganaLetter = 0x3094;
+constexpr int kKatakanaOffset = 0x60;
+constexpr char32_t kProlongedSoundMark = 0x30FC;  // "ー"
+
+// Converts `input` to `output` by shifting the letters in [`first`, `last`]
+// by `offset`, if `input` consists only of these letters, ASCII and the
+// prolonged sound mark.  None of them is the beginning of a multi-character
+// rule in the hiragana and katakana tables, e.g. "う゛" -> "ヴ", so the
+// result is the same as the tables for these strings.  Returns false
+// otherwise.
+bool ShiftKanaLetters(const absl::string_view input, const char32_t first,
+                      const char32_t last, const int offset,
+                      std::string *output) {
+  output->resize(input.size());
+  for (size_t i = 0; i < input.size();) {
+    const uint8_t c = input[i];
+    if (c < 0x80) {
+      (*output)[i++] = c;
+      continue;
+    }
+    // All the letters are 3 bytes in UTF-8 starting with 0xE3.
+    if (c != 0xE3 || i + 3 > input.size() ||
+        (input[i + 1] & 0xC0) != 0x80 || (input[i + 2] & 0xC0) != 0x80) {
+      return false;
+    }
+    const char32_t codepoint = 0x3000 | ((input[i + 1] & 0x3F) << 6) |
+                               (input[i + 2] & 0x3F);
+    char32_t result = codepoint;
+    if (first <= codepoint && codepoint <= last) {
+      result = static_cast<char32_t>(codepoint + offset);
+    } else if (codepoint != kProlongedSoundMark) {
+      return false;
+    }
+    (*output)[i] = c;
+    (*output)[i + 1] = 0x80 | ((result >> 6) & 0x3F);
+    (*output)[i + 2] = 0x80 | (result & 0x3F);
+    i += 3;
+  }
+  return true;
+}
+
+}  // namespace
+
 std::string HiraganaToKatakana(const absl::string_view input) {
+  std::string output;
+  if (ShiftKanaLetters(input, kFirstHiraganaLetter, kLastHiraganaLetter,
+                       kKatakanaOffset, &output)) {
+    return output;
+  }
   return ConvertUsingDoubleArray(internal::hiragana_to_katakana_da,
                                  internal::hiragana_to_katakana_table, input);
 }
@@ -78,6 +133,12 @@ std::string RomanjiToHiragana(const absl::string_view input) {
 }
 
 std::string KatakanaToHiragana(absl::string_view input) {
+  std::string output;
+  if (ShiftKanaLetters(input, kFirstHiraganaLetter + kKatakanaOffset,
+                       kLastHiraganaLetter + kKatakanaOffset,
+                       -kKatakanaOffset, &output)) {
+    return output;
+  }
   return ConvertUsingDoubleArray(internal::katakana_to_hiragana_da,
                                  internal::katakana_to_hiragana_table, input);
 }
@@ -33,7 +33,11 @@
 #include <utility>
 #include <vector>
 
+#include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
+#include "base/strings/internal/double_array.h"
+#include "base/strings/internal/japanese_rules.h"
+#include "base/strings/unicode.h"
 #include "testing/gunit.h"
 
 namespace mozc::japanese {
@@ -89,6 +93,31 @@ TEST(JapaneseUtilTest, KatakanaToHiragana) {
   }
 }
 
+TEST(JapaneseUtilTest, KanaConversionSameAsTables) {
+  // The kana conversions have a fast path for the strings of kana letters.
+  // Their results must be the same as the tables.
+  std::vector<std::string> inputs = {
+      "", "abc", "ー", "う゛", "ウ゛", "かーabc", "ヴぁ", "\xE3\x81",
+      "\xE3\x41\x41", "ゕゖヵヶ", "ゝゞヽヾ",
+  };
+  for (char32_t c = 0x3000; c < 0x3100; ++c) {
+    inputs.push_back(strings::Char32ToUtf8(c));
+    inputs.push_back(absl::StrCat("あ", strings::Char32ToUtf8(c), "ア"));
+  }
+  for (const std::string &input : inputs) {
+    EXPECT_EQ(HiraganaToKatakana(input),
+              internal::ConvertUsingDoubleArray(
+                  internal::hiragana_to_katakana_da,
+                  internal::hiragana_to_katakana_table, input))
+        << input;
+    EXPECT_EQ(KatakanaToHiragana(input),
+              internal::ConvertUsingDoubleArray(
+                  internal::katakana_to_hiragana_da,
+                  internal::katakana_to_hiragana_table, input))
+        << input;
+  }
+}
+
 TEST(JapaneseUtilTest, RomanjiToHiragana) {
   struct {
     const char *input;
@@ -39,6 +39,7 @@
 #include "absl/synchronization/mutex.h"
 #include "base/const.h"
 #include "base/environ.h"
+#include "base/file_stream.h"
 #include "base/file_util.h"
 #include "base/singleton.h"
 
@@ -48,6 +49,7 @@
 
 #ifdef __APPLE__
 #include <TargetConditionals.h>  // for TARGET_OS_*
+#include <mach/mach.h>
 #include <sys/stat.h>
 #include <sys/sysctl.h>
 
@@ -60,6 +62,7 @@
 // clang-format off
 #include <windows.h>
 #include <lmcons.h>
+#include <psapi.h>
 #include <sddl.h>
 #include <shlobj.h>
 #include <versionhelpers.h>
@@ -846,4 +849,39 @@ uint64_t SystemUtil::GetTotalPhysicalMemory() {
   // because of no return value.
 }
 
+uint64_t SystemUtil::GetResidentMemorySize() {
+#if defined(_WIN32)
+  PROCESS_MEMORY_COUNTERS counters = {sizeof(PROCESS_MEMORY_COUNTERS)};
+  if (!::K32GetProcessMemoryInfo(::GetCurrentProcess(), &counters,
+                                 sizeof(counters))) {
+    return 0;
+  }
+  return counters.WorkingSetSize;
+#endif  // _WIN32
+
+#if defined(__APPLE__)
+  mach_task_basic_info_data_t info;
+  mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+  if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO,
+                reinterpret_cast<task_info_t>(&info), &count) != KERN_SUCCESS) {
+    return 0;
+  }
+  return info.resident_size;
+#endif  // __APPLE__
+
+#if defined(__linux__) || defined(__wasm__)
+  // The second field of /proc/self/statm is the number of resident pages.
+  InputFileStream statm("/proc/self/statm");
+  uint64_t size_pages = 0;
+  uint64_t resident_pages = 0;
+  if (!(statm >> size_pages >> resident_pages)) {
+    return 0;
+  }
+  return resident_pages * sysconf(_SC_PAGESIZE);
+#endif  // __linux__ || __wasm__
+
+  // If none of the above platforms is specified, the compiler raises an error
+  // because of no return value.
+}
+
 }  // namespace mozc
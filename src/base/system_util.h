@@ -136,6 +136,10 @@ class SystemUtil {
 
   // retrieve total physical memory. returns 0 if any error occurs.
   static uint64_t GetTotalPhysicalMemory();
+
+  // Returns the resident memory size of the current process in bytes.
+  // Returns 0 if any error occurs.
+  static uint64_t GetResidentMemorySize();
 };
 
 }  // namespace mozc
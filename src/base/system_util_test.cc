@@ -107,6 +107,12 @@ TEST_F(SystemUtilTest, GetTotalPhysicalMemoryTest) {
   EXPECT_GT(SystemUtil::GetTotalPhysicalMemory(), 0);
 }
 
+TEST_F(SystemUtilTest, GetResidentMemorySizeTest) {
+  const uint64_t resident = SystemUtil::GetResidentMemorySize();
+  EXPECT_GT(resident, 0);
+  EXPECT_LE(resident, SystemUtil::GetTotalPhysicalMemory());
+}
+
 #ifdef __ANDROID__
 TEST_F(SystemUtilTest, GetOSVersionStringTestForAndroid) {
   std::string result = SystemUtil::GetOSVersionString();
@@ -0,0 +1,111 @@
+// Copyright 2010-2021, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "base/trace.h"
+
+#include <cstddef>
+#include <string>
+
+#include "absl/base/attributes.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/str_replace.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+#include "base/clock.h"
+#include "base/stopwatch.h"
+
+namespace mozc {
+namespace {
+
+ABSL_CONST_INIT thread_local TraceBuffer *current_buffer = nullptr;
+
+}  // namespace
+
+TraceBuffer::TraceBuffer() : begin_(Clock::GetAbslTime()) {}
+
+void TraceBuffer::Clear() {
+  begin_ = Clock::GetAbslTime();
+  depth_ = 0;
+  spans_.clear();
+}
+
+std::string TraceBuffer::ToChromeTraceJson() const {
+  std::string json = "{\"traceEvents\":[";
+  for (size_t i = 0; i < spans_.size(); ++i) {
+    const Span &span = spans_[i];
+    if (i > 0) {
+      absl::StrAppend(&json, ",");
+    }
+    // "X" is a complete event, which has both the start time and the duration.
+    absl::StrAppendFormat(
+        &json,
+        "\n{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%d,\"dur\":%d,"
+        "\"pid\":0,\"tid\":0}",
+        absl::StrReplaceAll(span.name, {{"\\", "\\\\"}, {"\"", "\\\""}}),
+        absl::ToInt64Microseconds(span.start),
+        absl::ToInt64Microseconds(span.duration));
+  }
+  absl::StrAppend(&json, "\n]}\n");
+  return json;
+}
+
+TraceBuffer *TraceBuffer::GetCurrent() { return current_buffer; }
+
+ScopedTraceBuffer::ScopedTraceBuffer(TraceBuffer *buffer)
+    : prev_(current_buffer) {
+  current_buffer = buffer;
+}
+
+ScopedTraceBuffer::~ScopedTraceBuffer() { current_buffer = prev_; }
+
+ScopedTraceSpan::ScopedTraceSpan(absl::string_view name)
+    : buffer_(current_buffer) {
+  if (buffer_ == nullptr) {
+    return;
+  }
+  // The span is added here so that the spans are ordered by the start time.
+  index_ = buffer_->spans_.size();
+  TraceBuffer::Span &span = buffer_->spans_.emplace_back();
+  span.name = name;
+  span.start = Clock::GetAbslTime() - buffer_->begin_;
+  span.depth = buffer_->depth_++;
+  stopwatch_.Start();
+}
+
+ScopedTraceSpan::~ScopedTraceSpan() {
+  if (buffer_ == nullptr) {
+    return;
+  }
+  stopwatch_.Stop();
+  buffer_->spans_[index_].duration = stopwatch_.GetElapsed();
+  --buffer_->depth_;
+}
+
+}  // namespace mozc
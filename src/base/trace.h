@@ -0,0 +1,131 @@
+// Copyright 2010-2021, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef MOZC_BASE_TRACE_H_
+#define MOZC_BASE_TRACE_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+#include "base/stopwatch.h"
+
+namespace mozc {
+
+// Lightweight per-request latency tracing.
+//
+// A TraceBuffer collects the spans recorded on the current thread while it is
+// installed with ScopedTraceBuffer. ScopedTraceSpan measures the lifetime of
+// a scope and appends it to the installed buffer, or does nothing when no
+// buffer is installed, so that the spans can stay in the hot paths.
+//
+// Example:
+//   TraceBuffer buffer;
+//   {
+//     ScopedTraceBuffer scoped_buffer(&buffer);
+//     ScopedTraceSpan span("Converter::StartConversion");
+//     ...
+//   }
+//   for (const TraceBuffer::Span &span : buffer.spans()) { ... }
+class TraceBuffer {
+ public:
+  struct Span {
+    // The name must outlive the buffer, e.g. a string literal.
+    absl::string_view name;
+    // Start time relative to the creation of the buffer.
+    absl::Duration start;
+    absl::Duration duration;
+    // Nesting level of the span. The outermost span has depth 0.
+    int depth = 0;
+  };
+
+  TraceBuffer();
+
+  TraceBuffer(const TraceBuffer &) = delete;
+  TraceBuffer &operator=(const TraceBuffer &) = delete;
+
+  // Removes all the spans and restarts the buffer from the current time. Must
+  // not be called while a span is open.
+  void Clear();
+
+  // Returns the spans in the order they were started. Spans that are still
+  // open have zero duration.
+  const std::vector<Span> &spans() const { return spans_; }
+
+  // Returns the spans in the JSON format of Chrome trace events, which can be
+  // loaded into chrome://tracing or Perfetto.
+  std::string ToChromeTraceJson() const;
+
+  // Returns the buffer installed on the current thread, or nullptr.
+  static TraceBuffer *GetCurrent();
+
+ private:
+  friend class ScopedTraceBuffer;
+  friend class ScopedTraceSpan;
+
+  absl::Time begin_;
+  int depth_ = 0;
+  std::vector<Span> spans_;
+};
+
+// Installs `buffer` on the current thread for the lifetime of this object.
+// The previously installed buffer is restored on destruction.
+class ScopedTraceBuffer {
+ public:
+  explicit ScopedTraceBuffer(TraceBuffer *buffer);
+  ~ScopedTraceBuffer();
+
+  ScopedTraceBuffer(const ScopedTraceBuffer &) = delete;
+  ScopedTraceBuffer &operator=(const ScopedTraceBuffer &) = delete;
+
+ private:
+  TraceBuffer *prev_;
+};
+
+// Records the lifetime of this object as a span named `name` into the buffer
+// installed on the current thread.
+class ScopedTraceSpan {
+ public:
+  explicit ScopedTraceSpan(absl::string_view name);
+  ~ScopedTraceSpan();
+
+  ScopedTraceSpan(const ScopedTraceSpan &) = delete;
+  ScopedTraceSpan &operator=(const ScopedTraceSpan &) = delete;
+
+ private:
+  TraceBuffer *buffer_;
+  size_t index_ = 0;
+  Stopwatch stopwatch_;
+};
+
+}  // namespace mozc
+
+#endif  // MOZC_BASE_TRACE_H_
@@ -0,0 +1,136 @@
+// Copyright 2010-2021, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "base/trace.h"
+
+#include "absl/time/time.h"
+#include "base/clock_mock.h"
+#include "testing/gunit.h"
+
+namespace mozc {
+namespace {
+
+TEST(TraceTest, NoBuffer) {
+  EXPECT_EQ(TraceBuffer::GetCurrent(), nullptr);
+  // Must be a no-op.
+  ScopedTraceSpan span("span");
+  EXPECT_EQ(TraceBuffer::GetCurrent(), nullptr);
+}
+
+TEST(TraceTest, NestedSpans) {
+  ScopedClockMock clock(absl::UnixEpoch());
+  TraceBuffer buffer;
+  {
+    ScopedTraceBuffer scoped_buffer(&buffer);
+    EXPECT_EQ(TraceBuffer::GetCurrent(), &buffer);
+    clock->Advance(absl::Microseconds(1));
+    ScopedTraceSpan outer("outer");
+    clock->Advance(absl::Microseconds(2));
+    {
+      ScopedTraceSpan inner1("inner1");
+      clock->Advance(absl::Microseconds(3));
+    }
+    {
+      ScopedTraceSpan inner2("inner2");
+      clock->Advance(absl::Microseconds(4));
+    }
+  }
+  EXPECT_EQ(TraceBuffer::GetCurrent(), nullptr);
+
+  ASSERT_EQ(buffer.spans().size(), 3);
+  const TraceBuffer::Span &outer = buffer.spans()[0];
+  EXPECT_EQ(outer.name, "outer");
+  EXPECT_EQ(outer.start, absl::Microseconds(1));
+  EXPECT_EQ(outer.duration, absl::Microseconds(9));
+  EXPECT_EQ(outer.depth, 0);
+
+  const TraceBuffer::Span &inner1 = buffer.spans()[1];
+  EXPECT_EQ(inner1.name, "inner1");
+  EXPECT_EQ(inner1.start, absl::Microseconds(3));
+  EXPECT_EQ(inner1.duration, absl::Microseconds(3));
+  EXPECT_EQ(inner1.depth, 1);
+
+  const TraceBuffer::Span &inner2 = buffer.spans()[2];
+  EXPECT_EQ(inner2.name, "inner2");
+  EXPECT_EQ(inner2.start, absl::Microseconds(6));
+  EXPECT_EQ(inner2.duration, absl::Microseconds(4));
+  EXPECT_EQ(inner2.depth, 1);
+}
+
+TEST(TraceTest, NestedBuffers) {
+  TraceBuffer outer_buffer, inner_buffer;
+  ScopedTraceBuffer scoped_outer(&outer_buffer);
+  {
+    ScopedTraceBuffer scoped_inner(&inner_buffer);
+    ScopedTraceSpan span("inner");
+  }
+  EXPECT_EQ(TraceBuffer::GetCurrent(), &outer_buffer);
+  ScopedTraceSpan span("outer");
+  EXPECT_EQ(inner_buffer.spans().size(), 1);
+  ASSERT_EQ(outer_buffer.spans().size(), 1);
+  EXPECT_EQ(outer_buffer.spans()[0].name, "outer");
+}
+
+TEST(TraceTest, Clear) {
+  ScopedClockMock clock(absl::UnixEpoch());
+  TraceBuffer buffer;
+  ScopedTraceBuffer scoped_buffer(&buffer);
+  { ScopedTraceSpan span("first"); }
+  clock->Advance(absl::Microseconds(5));
+  buffer.Clear();
+  EXPECT_TRUE(buffer.spans().empty());
+  { ScopedTraceSpan span("second"); }
+  ASSERT_EQ(buffer.spans().size(), 1);
+  EXPECT_EQ(buffer.spans()[0].name, "second");
+  EXPECT_EQ(buffer.spans()[0].start, absl::ZeroDuration());
+  EXPECT_EQ(buffer.spans()[0].depth, 0);
+}
+
+TEST(TraceTest, ToChromeTraceJson) {
+  ScopedClockMock clock(absl::UnixEpoch());
+  TraceBuffer buffer;
+  EXPECT_EQ(buffer.ToChromeTraceJson(), "{\"traceEvents\":[\n]}\n");
+  {
+    ScopedTraceBuffer scoped_buffer(&buffer);
+    ScopedTraceSpan outer("outer");
+    clock->Advance(absl::Microseconds(1));
+    ScopedTraceSpan inner("\"inner\"");
+    clock->Advance(absl::Microseconds(2));
+  }
+  EXPECT_EQ(buffer.ToChromeTraceJson(),
+            "{\"traceEvents\":[\n"
+            "{\"name\":\"outer\",\"ph\":\"X\",\"ts\":0,\"dur\":3,"
+            "\"pid\":0,\"tid\":0},\n"
+            "{\"name\":\"\\\"inner\\\"\",\"ph\":\"X\",\"ts\":1,\"dur\":2,"
+            "\"pid\":0,\"tid\":0}\n"
+            "]}\n");
+}
+
+}  // namespace
+}  // namespace mozc
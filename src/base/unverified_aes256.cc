@@ -36,6 +36,12 @@
 
 #include "absl/log/check.h"
 
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define MOZC_UNVERIFIED_AES256_USE_AESNI
+#include <emmintrin.h>
+#include <wmmintrin.h>
+#endif  // __x86_64__ && (__GNUC__ || __clang__)
+
 namespace mozc {
 namespace internal {
 namespace {
@@ -138,43 +144,195 @@ void InvMixColumnsImpl(uint8_t column[4]) {
   column[3] = a11[0] ^ a13[1] ^ a9[2] ^ a14[3];
 }
 
+#ifdef MOZC_UNVERIFIED_AES256_USE_AESNI
+// The functions below are compiled for the AES-NI instructions and must be
+// called only when the CPU supports them. The round keys are the same as the
+// key schedule of the portable implementation.
+
+__attribute__((target("aes,sse2"))) void LoadRoundKeys(
+    const uint8_t (&w)[UnverifiedAES256::kKeyScheduleBytes],
+    __m128i round_keys[kNr + 1]) {
+  for (size_t round = 0; round <= kNr; ++round) {
+    round_keys[round] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(
+        &w[UnverifiedAES256::kBlockBytes * round]));
+  }
+}
+
+__attribute__((target("aes,sse2"))) void TransformCBCAesNi(
+    const uint8_t (&w)[UnverifiedAES256::kKeyScheduleBytes],
+    uint8_t (&iv)[UnverifiedAES256::kBlockBytes], uint8_t *block,
+    size_t block_count) {
+  __m128i round_keys[kNr + 1];
+  LoadRoundKeys(w, round_keys);
+
+  // Each block depends on the previous one, so the blocks are encrypted one by
+  // one.
+  __m128i vec = _mm_loadu_si128(reinterpret_cast<const __m128i *>(iv));
+  for (size_t i = 0; i < block_count; ++i) {
+    __m128i *src =
+        reinterpret_cast<__m128i *>(block + i * UnverifiedAES256::kBlockBytes);
+    __m128i x = _mm_xor_si128(_mm_loadu_si128(src), vec);
+    x = _mm_xor_si128(x, round_keys[0]);
+    for (size_t round = 1; round < kNr; ++round) {
+      x = _mm_aesenc_si128(x, round_keys[round]);
+    }
+    vec = _mm_aesenclast_si128(x, round_keys[kNr]);
+    _mm_storeu_si128(src, vec);
+  }
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(iv), vec);
+}
+
+__attribute__((target("aes,sse2"))) __m128i InverseTransformECBAesNi(
+    const __m128i round_keys[kNr + 1], __m128i x) {
+  x = _mm_xor_si128(x, round_keys[0]);
+  for (size_t round = 1; round < kNr; ++round) {
+    x = _mm_aesdec_si128(x, round_keys[round]);
+  }
+  return _mm_aesdeclast_si128(x, round_keys[kNr]);
+}
+
+__attribute__((target("aes,sse2"))) void InverseTransformCBCAesNi(
+    const uint8_t (&w)[UnverifiedAES256::kKeyScheduleBytes],
+    uint8_t (&iv)[UnverifiedAES256::kBlockBytes], uint8_t *block,
+    size_t block_count) {
+  __m128i enc_round_keys[kNr + 1];
+  LoadRoundKeys(w, enc_round_keys);
+  // The equivalent inverse cipher takes the round keys in the reverse order
+  // with InvMixColumns applied to the middle ones.
+  __m128i round_keys[kNr + 1];
+  round_keys[0] = enc_round_keys[kNr];
+  for (size_t round = 1; round < kNr; ++round) {
+    round_keys[round] = _mm_aesimc_si128(enc_round_keys[kNr - round]);
+  }
+  round_keys[kNr] = enc_round_keys[0];
+
+  // Unlike encryption, the blocks can be decrypted independently, so four
+  // blocks are processed at once to fill the pipeline of the CPU.
+  __m128i prev = _mm_loadu_si128(reinterpret_cast<const __m128i *>(iv));
+  __m128i *blocks = reinterpret_cast<__m128i *>(block);
+  size_t i = 0;
+  for (; i + 4 <= block_count; i += 4) {
+    const __m128i c0 = _mm_loadu_si128(blocks + i);
+    const __m128i c1 = _mm_loadu_si128(blocks + i + 1);
+    const __m128i c2 = _mm_loadu_si128(blocks + i + 2);
+    const __m128i c3 = _mm_loadu_si128(blocks + i + 3);
+    __m128i x0 = _mm_xor_si128(c0, round_keys[0]);
+    __m128i x1 = _mm_xor_si128(c1, round_keys[0]);
+    __m128i x2 = _mm_xor_si128(c2, round_keys[0]);
+    __m128i x3 = _mm_xor_si128(c3, round_keys[0]);
+    for (size_t round = 1; round < kNr; ++round) {
+      x0 = _mm_aesdec_si128(x0, round_keys[round]);
+      x1 = _mm_aesdec_si128(x1, round_keys[round]);
+      x2 = _mm_aesdec_si128(x2, round_keys[round]);
+      x3 = _mm_aesdec_si128(x3, round_keys[round]);
+    }
+    x0 = _mm_aesdeclast_si128(x0, round_keys[kNr]);
+    x1 = _mm_aesdeclast_si128(x1, round_keys[kNr]);
+    x2 = _mm_aesdeclast_si128(x2, round_keys[kNr]);
+    x3 = _mm_aesdeclast_si128(x3, round_keys[kNr]);
+    _mm_storeu_si128(blocks + i, _mm_xor_si128(x0, prev));
+    _mm_storeu_si128(blocks + i + 1, _mm_xor_si128(x1, c0));
+    _mm_storeu_si128(blocks + i + 2, _mm_xor_si128(x2, c1));
+    _mm_storeu_si128(blocks + i + 3, _mm_xor_si128(x3, c2));
+    prev = c3;
+  }
+  for (; i < block_count; ++i) {
+    const __m128i c = _mm_loadu_si128(blocks + i);
+    const __m128i x = InverseTransformECBAesNi(round_keys, c);
+    _mm_storeu_si128(blocks + i, _mm_xor_si128(x, prev));
+    prev = c;
+  }
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(iv), prev);
+}
+#endif  // MOZC_UNVERIFIED_AES256_USE_AESNI
+
 }  // namespace
 
+bool UnverifiedAES256::IsAccelerated() {
+#ifdef MOZC_UNVERIFIED_AES256_USE_AESNI
+  static const bool kHasAesNi = __builtin_cpu_supports("aes");
+  return kHasAesNi;
+#else   // MOZC_UNVERIFIED_AES256_USE_AESNI
+  return false;
+#endif  // MOZC_UNVERIFIED_AES256_USE_AESNI
+}
+
+void UnverifiedAES256::ExpandKey(const uint8_t (&key)[kKeyBytes],
+                                 KeySchedule *schedule) {
+  MakeKeySchedule(key, schedule->w);
+}
+
 void UnverifiedAES256::TransformCBC(const uint8_t (&key)[kKeyBytes],
                                     const uint8_t (&iv)[kBlockBytes],
                                     uint8_t *block, size_t block_count) {
-  uint8_t w[kKeyScheduleBytes];
-  MakeKeySchedule(key, w);
+  KeySchedule schedule;
+  ExpandKey(key, &schedule);
+  uint8_t vec[kBlockBytes];
+  std::copy_n(iv, kBlockBytes, vec);
+  TransformCBCChunk(schedule, vec, block, block_count);
+}
 
+void UnverifiedAES256::InverseTransformCBC(const uint8_t (&key)[kKeyBytes],
+                                           const uint8_t (&iv)[kBlockBytes],
+                                           uint8_t *block, size_t block_count) {
+  KeySchedule schedule;
+  ExpandKey(key, &schedule);
   uint8_t vec[kBlockBytes];
   std::copy_n(iv, kBlockBytes, vec);
+  InverseTransformCBCChunk(schedule, vec, block, block_count);
+}
+
+void UnverifiedAES256::TransformCBCChunk(const KeySchedule &schedule,
+                                         uint8_t (&iv)[kBlockBytes],
+                                         uint8_t *block, size_t block_count) {
+#ifdef MOZC_UNVERIFIED_AES256_USE_AESNI
+  if (IsAccelerated()) {
+    TransformCBCAesNi(schedule.w, iv, block, block_count);
+    return;
+  }
+#endif  // MOZC_UNVERIFIED_AES256_USE_AESNI
+  TransformCBCChunkPortable(schedule, iv, block, block_count);
+}
+
+void UnverifiedAES256::InverseTransformCBCChunk(const KeySchedule &schedule,
+                                                uint8_t (&iv)[kBlockBytes],
+                                                uint8_t *block,
+                                                size_t block_count) {
+#ifdef MOZC_UNVERIFIED_AES256_USE_AESNI
+  if (IsAccelerated()) {
+    InverseTransformCBCAesNi(schedule.w, iv, block, block_count);
+    return;
+  }
+#endif  // MOZC_UNVERIFIED_AES256_USE_AESNI
+  InverseTransformCBCChunkPortable(schedule, iv, block, block_count);
+}
+
+void UnverifiedAES256::TransformCBCChunkPortable(const KeySchedule &schedule,
+                                                 uint8_t (&iv)[kBlockBytes],
+                                                 uint8_t *block,
+                                                 size_t block_count) {
   for (size_t i = 0; i < block_count; ++i) {
     uint8_t *src = block + (i * kBlockBytes);
     for (size_t j = 0; j < kBlockBytes; ++j) {
-      src[j] ^= vec[j];
+      src[j] ^= iv[j];
     }
-    TransformECB(w, src);
-    std::copy_n(src, kBlockBytes, vec);
+    TransformECB(schedule.w, src);
+    std::copy_n(src, kBlockBytes, iv);
   }
 }
 
-void UnverifiedAES256::InverseTransformCBC(const uint8_t (&key)[kKeyBytes],
-                                           const uint8_t (&iv)[kBlockBytes],
-                                           uint8_t *block, size_t block_count) {
-  uint8_t w[kKeyScheduleBytes];
-  MakeKeySchedule(key, w);
-
-  uint8_t prev_block[kBlockBytes];
-  std::copy_n(iv, kBlockBytes, prev_block);
+void UnverifiedAES256::InverseTransformCBCChunkPortable(
+    const KeySchedule &schedule, uint8_t (&iv)[kBlockBytes], uint8_t *block,
+    size_t block_count) {
   for (size_t i = 0; i < block_count; ++i) {
     uint8_t original_current_block[kBlockBytes];
     uint8_t *current_block = block + (i * kBlockBytes);
     std::copy_n(current_block, kBlockBytes, original_current_block);
-    InverseTransformECB(w, current_block);
+    InverseTransformECB(schedule.w, current_block);
     for (size_t j = 0; j < kBlockBytes; ++j) {
-      current_block[j] ^= prev_block[j];
+      current_block[j] ^= iv[j];
     }
-    std::copy_n(original_current_block, kBlockBytes, prev_block);
+    std::copy_n(original_current_block, kBlockBytes, iv);
   }
 }
 
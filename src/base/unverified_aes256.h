@@ -64,7 +64,37 @@ class UnverifiedAES256 {
                                   const uint8_t (&iv)[kBlockBytes],
                                   uint8_t *block, size_t block_count);
 
+  // Expanded key, which can be reused to transform a message chunk by chunk.
+  struct KeySchedule {
+    uint8_t w[kKeyScheduleBytes];
+  };
+  static void ExpandKey(const uint8_t (&key)[kKeyBytes], KeySchedule *schedule);
+
+  // Same as TransformCBC() and InverseTransformCBC(), but updates |iv| to the
+  // value for the next blocks so that a message can be transformed chunk by
+  // chunk.
+  static void TransformCBCChunk(const KeySchedule &schedule,
+                                uint8_t (&iv)[kBlockBytes], uint8_t *block,
+                                size_t block_count);
+  static void InverseTransformCBCChunk(const KeySchedule &schedule,
+                                       uint8_t (&iv)[kBlockBytes],
+                                       uint8_t *block, size_t block_count);
+
+  // Returns true if the CBC transformations use the AES-NI instructions of the
+  // CPU instead of the portable implementation.
+  static bool IsAccelerated();
+
  protected:
+  // Portable implementations of the CBC transformations. Declared as
+  // protected for unit test.
+  static void TransformCBCChunkPortable(const KeySchedule &schedule,
+                                        uint8_t (&iv)[kBlockBytes],
+                                        uint8_t *block, size_t block_count);
+  static void InverseTransformCBCChunkPortable(const KeySchedule &schedule,
+                                               uint8_t (&iv)[kBlockBytes],
+                                               uint8_t *block,
+                                               size_t block_count);
+
   // Does AES256 ECB transformation.
   // CAVEATS: See the above comment.
   static void TransformECB(const uint8_t (&w)[kKeyScheduleBytes],
@@ -29,8 +29,10 @@
 
 #include "base/unverified_aes256.h"
 
+#include <algorithm>
 #include <cstddef>
 #include <cstdint>
+#include <vector>
 
 #include "testing/gunit.h"
 
@@ -49,6 +51,7 @@ class TestableUnverifiedAES256 : public UnverifiedAES256 {
   TestableUnverifiedAES256& operator=(const TestableUnverifiedAES256&) = delete;
 
   // Change access rights:
+  using UnverifiedAES256::InverseTransformCBCChunkPortable;
   using UnverifiedAES256::InverseTransformECB;
   using UnverifiedAES256::InvMixColumns;
   using UnverifiedAES256::InvShiftRows;
@@ -57,6 +60,7 @@ class TestableUnverifiedAES256 : public UnverifiedAES256 {
   using UnverifiedAES256::MixColumns;
   using UnverifiedAES256::ShiftRows;
   using UnverifiedAES256::SubBytes;
+  using UnverifiedAES256::TransformCBCChunkPortable;
   using UnverifiedAES256::TransformECB;
 };
 
@@ -442,6 +446,57 @@ TEST(UnverifiedAES256Test, InverseTransformCBC_NonZero) {
   EXPECT_EQ_ARRAY(kExpected, block);
 }
 
+TEST(UnverifiedAES256Test, TransformCBCChunk) {
+  // Compares the chunked transformations, which may use the AES-NI
+  // instructions, with the portable implementation.
+  uint8_t key[UnverifiedAES256::kKeyBytes];
+  for (size_t i = 0; i < UnverifiedAES256::kKeyBytes; ++i) {
+    key[i] = static_cast<uint8_t>(i * 7 + 3);
+  }
+  constexpr size_t kNumBlocks = 23;
+  std::vector<uint8_t> plain(UnverifiedAES256::kBlockBytes * kNumBlocks);
+  for (size_t i = 0; i < plain.size(); ++i) {
+    plain[i] = static_cast<uint8_t>(i * 31 + 1);
+  }
+
+  UnverifiedAES256::KeySchedule schedule;
+  UnverifiedAES256::ExpandKey(key, &schedule);
+
+  std::vector<uint8_t> expected = plain;
+  uint8_t expected_iv[UnverifiedAES256::kBlockBytes] = {};
+  TestableUnverifiedAES256::TransformCBCChunkPortable(
+      schedule, expected_iv, expected.data(), kNumBlocks);
+
+  // Splits the message into chunks of various sizes.
+  std::vector<uint8_t> actual = plain;
+  uint8_t iv[UnverifiedAES256::kBlockBytes] = {};
+  for (size_t begin = 0, size = 1; begin < kNumBlocks; begin += size, ++size) {
+    size = std::min(size, kNumBlocks - begin);
+    UnverifiedAES256::TransformCBCChunk(
+        schedule, iv, actual.data() + UnverifiedAES256::kBlockBytes * begin,
+        size);
+  }
+  EXPECT_EQ(actual, expected);
+  EXPECT_EQ_ARRAY(expected_iv, iv);
+
+  std::vector<uint8_t> decrypted = expected;
+  uint8_t inverse_iv[UnverifiedAES256::kBlockBytes] = {};
+  for (size_t begin = 0, size = 5; begin < kNumBlocks; begin += size) {
+    size = std::min(size, kNumBlocks - begin);
+    UnverifiedAES256::InverseTransformCBCChunk(
+        schedule, inverse_iv,
+        decrypted.data() + UnverifiedAES256::kBlockBytes * begin, size);
+  }
+  EXPECT_EQ(decrypted, plain);
+  EXPECT_EQ_ARRAY(expected_iv, inverse_iv);
+
+  std::vector<uint8_t> portable_decrypted = expected;
+  uint8_t portable_iv[UnverifiedAES256::kBlockBytes] = {};
+  TestableUnverifiedAES256::InverseTransformCBCChunkPortable(
+      schedule, portable_iv, portable_decrypted.data(), kNumBlocks);
+  EXPECT_EQ(portable_decrypted, plain);
+}
+
 // TODO(yukawa): Add more tests based on well-known test vectors.
 
 }  // namespace
@@ -31,7 +31,6 @@
 
 #include <algorithm>
 #include <array>
-#include <bitset>
 #include <cstddef>
 #include <cstdint>
 #include <cstdlib>
@@ -806,34 +805,24 @@ bool Util::IsEnglishTransliteration(absl::string_view value) {
   return true;
 }
 
-#define INRANGE(w, a, b) ((w) >= (a) && (w) <= (b))
+namespace {
+
+struct CodePointRange {
+  char32_t first;
+  char32_t last;
+  uint8_t type;
+};
 
 // script type
 // TODO(yukawa, team): Make a mechanism to keep this classifier up-to-date
 //   based on the original data from Unicode.org.
-Util::ScriptType Util::GetScriptType(char32_t codepoint) {
-  if (INRANGE(codepoint, 0x0030, 0x0039) ||  // ascii number
-      INRANGE(codepoint, 0xFF10, 0xFF19)) {  // full width number
-    return NUMBER;
-  } else if (INRANGE(codepoint, 0x0041, 0x005A) ||  // ascii upper
-             INRANGE(codepoint, 0x0061, 0x007A) ||  // ascii lower
-             INRANGE(codepoint, 0xFF21, 0xFF3A) ||  // fullwidth ascii upper
-             INRANGE(codepoint, 0xFF41, 0xFF5A)) {  // fullwidth ascii lower
-    return ALPHABET;
-  } else if (codepoint == 0x3005 ||  // IDEOGRAPHIC ITERATION MARK "々"
-             INRANGE(codepoint, 0x3400,
-                     0x4DBF) ||  // CJK Unified Ideographs Extension A
-             INRANGE(codepoint, 0x4E00, 0x9FFF) ||  // CJK Unified Ideographs
-             INRANGE(codepoint, 0xF900,
-                     0xFAFF) ||  // CJK Compatibility Ideographs
-             INRANGE(codepoint, 0x20000,
-                     0x2A6DF) ||  // CJK Unified Ideographs Extension B
-             INRANGE(codepoint, 0x2A700,
-                     0x2B73F) ||  // CJK Unified Ideographs Extension C
-             INRANGE(codepoint, 0x2B740,
-                     0x2B81F) ||  // CJK Unified Ideographs Extension D
-             INRANGE(codepoint, 0x2F800,
-                     0x2FA1F)) {  // CJK Compatibility Ideographs
+constexpr CodePointRange kScriptTypeRanges[] = {
+    {0x0030, 0x0039, Util::NUMBER},    // ascii number
+    {0xFF10, 0xFF19, Util::NUMBER},    // full width number
+    {0x0041, 0x005A, Util::ALPHABET},  // ascii upper
+    {0x0061, 0x007A, Util::ALPHABET},  // ascii lower
+    {0xFF21, 0xFF3A, Util::ALPHABET},  // fullwidth ascii upper
+    {0xFF41, 0xFF5A, Util::ALPHABET},  // fullwidth ascii lower
     // As of Unicode 6.0.2, each block has the following characters assigned.
     // [U+3400, U+4DB5]:   CJK Unified Ideographs Extension A
     // [U+4E00, U+9FCB]:   CJK Unified Ideographs
@@ -842,80 +831,237 @@ Util::ScriptType Util::GetScriptType(char32_t codepoint) {
     // [U+2A700, U+2B734]: CJK Unified Ideographs Extension C
     // [U+2B740, U+2B81D]: CJK Unified Ideographs Extension D
     // [U+2F800, U+2FA1D]: CJK Compatibility Ideographs
-    return KANJI;
-  } else if (INRANGE(codepoint, 0x3041, 0x309F) ||  // hiragana
-             codepoint == 0x1B001) {  // HIRAGANA LETTER ARCHAIC YE
-    return HIRAGANA;
-  } else if (INRANGE(codepoint, 0x30A1, 0x30FF) ||  // full width katakana
-             INRANGE(codepoint, 0x31F0,
-                     0x31FF) ||  // Katakana Phonetic Extensions for Ainu
-             INRANGE(codepoint, 0xFF65, 0xFF9F) ||  // half width katakana
-             codepoint == 0x1B000) {                // KATAKANA LETTER ARCHAIC E
-    return KATAKANA;
-  } else if (INRANGE(codepoint, 0x02300, 0x023F3) ||  // Miscellaneous Technical
-             INRANGE(codepoint, 0x02700, 0x027BF) ||  // Dingbats
-             INRANGE(codepoint, 0x1F000, 0x1F02F) ||  // Mahjong tiles
-             INRANGE(codepoint, 0x1F030, 0x1F09F) ||  // Domino tiles
-             INRANGE(codepoint, 0x1F0A0, 0x1F0FF) ||  // Playing cards
-             INRANGE(codepoint, 0x1F100,
-                     0x1F2FF) ||  // Enclosed Alphanumeric Supplement
-             INRANGE(codepoint, 0x1F200,
-                     0x1F2FF) ||  // Enclosed Ideographic Supplement
-             INRANGE(codepoint, 0x1F300,
-                     0x1F5FF) ||  // Miscellaneous Symbols And Pictographs
-             INRANGE(codepoint, 0x1F600, 0x1F64F) ||  // Emoticons
-             INRANGE(codepoint, 0x1F680,
-                     0x1F6FF) ||  // Transport And Map Symbols
-             INRANGE(codepoint, 0x1F700, 0x1F77F) ||  // Alchemical Symbols
-             codepoint == 0x26CE) {                   // Ophiuchus
-    return EMOJI;
-  }
-
-  return UNKNOWN_SCRIPT;
+    {0x3005, 0x3005, Util::KANJI},    // IDEOGRAPHIC ITERATION MARK "々"
+    {0x3400, 0x4DBF, Util::KANJI},    // CJK Unified Ideographs Extension A
+    {0x4E00, 0x9FFF, Util::KANJI},    // CJK Unified Ideographs
+    {0xF900, 0xFAFF, Util::KANJI},    // CJK Compatibility Ideographs
+    {0x20000, 0x2A6DF, Util::KANJI},  // CJK Unified Ideographs Extension B
+    {0x2A700, 0x2B73F, Util::KANJI},  // CJK Unified Ideographs Extension C
+    {0x2B740, 0x2B81F, Util::KANJI},  // CJK Unified Ideographs Extension D
+    {0x2F800, 0x2FA1F, Util::KANJI},  // CJK Compatibility Ideographs
+    {0x3041, 0x309F, Util::HIRAGANA},    // hiragana
+    {0x1B001, 0x1B001, Util::HIRAGANA},  // HIRAGANA LETTER ARCHAIC YE
+    {0x30A1, 0x30FF, Util::KATAKANA},    // full width katakana
+    {0x31F0, 0x31FF, Util::KATAKANA},  // Katakana Phonetic Extensions for Ainu
+    {0xFF65, 0xFF9F, Util::KATAKANA},  // half width katakana
+    {0x1B000, 0x1B000, Util::KATAKANA},  // KATAKANA LETTER ARCHAIC E
+    {0x02300, 0x023F3, Util::EMOJI},     // Miscellaneous Technical
+    {0x02700, 0x027BF, Util::EMOJI},     // Dingbats
+    {0x1F000, 0x1F02F, Util::EMOJI},     // Mahjong tiles
+    {0x1F030, 0x1F09F, Util::EMOJI},     // Domino tiles
+    {0x1F0A0, 0x1F0FF, Util::EMOJI},     // Playing cards
+    {0x1F100, 0x1F2FF, Util::EMOJI},  // Enclosed Alphanumeric Supplement
+    {0x1F200, 0x1F2FF, Util::EMOJI},  // Enclosed Ideographic Supplement
+    {0x1F300, 0x1F5FF, Util::EMOJI},  // Miscellaneous Symbols And Pictographs
+    {0x1F600, 0x1F64F, Util::EMOJI},  // Emoticons
+    {0x1F680, 0x1F6FF, Util::EMOJI},  // Transport And Map Symbols
+    {0x1F700, 0x1F77F, Util::EMOJI},  // Alchemical Symbols
+    {0x026CE, 0x026CE, Util::EMOJI},  // Ophiuchus
+};
+
+// 'Unicode Standard Annex #11: EAST ASIAN WIDTH'
+// http://www.unicode.org/reports/tr11/
+// The other characters are FULL_WIDTH.
+constexpr CodePointRange kHalfWidthRanges[] = {
+    // Characters marked as 'Na' in
+    // http://www.unicode.org/Public/UNIDATA/EastAsianWidth.txt
+    {0x0020, 0x007F, Util::HALF_WIDTH},  // ascii
+    {0x27E6, 0x27ED, Util::HALF_WIDTH},  // narrow mathematical symbols
+    {0x2985, 0x2986, Util::HALF_WIDTH},  // narrow white parentheses
+    {0x00A2, 0x00A3, Util::HALF_WIDTH},  // CENT SIGN, POUND SIGN
+    {0x00A5, 0x00A6, Util::HALF_WIDTH},  // YEN SIGN, BROKEN BAR
+    {0x00AC, 0x00AC, Util::HALF_WIDTH},  // NOT SIGN
+    {0x00AF, 0x00AF, Util::HALF_WIDTH},  // MACRON
+    // Characters marked as 'H' in
+    // http://www.unicode.org/Public/UNIDATA/EastAsianWidth.txt
+    {0x20A9, 0x20A9, Util::HALF_WIDTH},  // WON SIGN
+    {0xFF61, 0xFF9F, Util::HALF_WIDTH},  // half-width katakana
+    {0xFFA0, 0xFFBE, Util::HALF_WIDTH},  // half-width hangul
+    {0xFFC2, 0xFFCF, Util::HALF_WIDTH},  // half-width hangul
+    {0xFFD2, 0xFFD7, Util::HALF_WIDTH},  // half-width hangul
+    {0xFFDA, 0xFFDC, Util::HALF_WIDTH},  // half-width hangul
+    {0xFFE8, 0xFFEE, Util::HALF_WIDTH},  // half-width symbols
+};
+
+// Character classes pack a ScriptType in the lower 4 bits and a FormType in
+// the upper 4 bits.
+constexpr uint8_t kDefaultCharacterClass = Util::UNKNOWN_SCRIPT |
+                                           (Util::FULL_WIDTH << 4);
+
+constexpr uint8_t GetCharacterClassFromRanges(const char32_t codepoint) {
+  uint8_t script = Util::UNKNOWN_SCRIPT;
+  uint8_t form = Util::FULL_WIDTH;
+  for (const CodePointRange &range : kScriptTypeRanges) {
+    if (range.first <= codepoint && codepoint <= range.last) {
+      script = range.type;
+    }
+  }
+  for (const CodePointRange &range : kHalfWidthRanges) {
+    if (range.first <= codepoint && codepoint <= range.last) {
+      form = range.type;
+    }
+  }
+  return script | (form << 4);
 }
 
-Util::FormType Util::GetFormType(char32_t codepoint) {
-  // 'Unicode Standard Annex #11: EAST ASIAN WIDTH'
-  // http://www.unicode.org/reports/tr11/
-
-  // Characters marked as 'Na' in
-  // http://www.unicode.org/Public/UNIDATA/EastAsianWidth.txt
-  if (INRANGE(codepoint, 0x0020, 0x007F) ||  // ascii
-      INRANGE(codepoint, 0x27E6, 0x27ED) ||  // narrow mathematical symbols
-      INRANGE(codepoint, 0x2985, 0x2986)) {  // narrow white parentheses
-    return HALF_WIDTH;
-  }
-
-  // Other characters marked as 'Na' in
-  // http://www.unicode.org/Public/UNIDATA/EastAsianWidth.txt
-  if (INRANGE(codepoint, 0x00A2, 0x00AF)) {
-    switch (codepoint) {
-      case 0x00A2:  // CENT SIGN
-      case 0x00A3:  // POUND SIGN
-      case 0x00A5:  // YEN SIGN
-      case 0x00A6:  // BROKEN BAR
-      case 0x00AC:  // NOT SIGN
-      case 0x00AF:  // MACRON
-        return HALF_WIDTH;
+// The classes of the BMP are looked up in two levels of 256 code points.
+// Blocks not overlapping with a boundary of the ranges have the same class
+// for all the code points, and are stored in the first level directly.  The
+// other blocks have a table of 256 classes.
+constexpr size_t kBlockBits = 8;
+constexpr size_t kBlockSize = 1 << kBlockBits;
+constexpr size_t kNumBlocks = 0x10000 >> kBlockBits;
+constexpr uint8_t kMixedBlock = 0x80;
+
+constexpr bool IsMixedBlock(const size_t block) {
+  const char32_t first = block << kBlockBits;
+  const char32_t last = first + kBlockSize - 1;
+  auto overlaps_partially = [&](const CodePointRange &range) {
+    return range.first <= last && first <= range.last &&
+           (first < range.first || range.last < last);
+  };
+  for (const CodePointRange &range : kScriptTypeRanges) {
+    if (overlaps_partially(range)) {
+      return true;
+    }
+  }
+  for (const CodePointRange &range : kHalfWidthRanges) {
+    if (overlaps_partially(range)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+constexpr size_t CountMixedBlocks() {
+  size_t count = 0;
+  for (size_t block = 0; block < kNumBlocks; ++block) {
+    count += IsMixedBlock(block) ? 1 : 0;
+  }
+  return count;
+}
+
+template <size_t kNumMixedBlocks>
+struct CharacterClassTable {
+  static_assert(kNumMixedBlocks < kMixedBlock);
+
+  // Either the class of the block or kMixedBlock | index into `mixed`.
+  std::array<uint8_t, kNumBlocks> blocks = {};
+  std::array<std::array<uint8_t, kBlockSize>, kNumMixedBlocks> mixed = {};
+};
+
+template <size_t kNumMixedBlocks>
+constexpr CharacterClassTable<kNumMixedBlocks> BuildCharacterClassTable() {
+  CharacterClassTable<kNumMixedBlocks> table;
+  size_t index = 0;
+  for (size_t block = 0; block < kNumBlocks; ++block) {
+    const char32_t first = block << kBlockBits;
+    if (!IsMixedBlock(block)) {
+      table.blocks[block] = GetCharacterClassFromRanges(first);
+      continue;
+    }
+    table.blocks[block] = kMixedBlock | index;
+    std::array<uint8_t, kBlockSize> &classes = table.mixed[index++];
+    for (uint8_t &c : classes) {
+      c = kDefaultCharacterClass;
+    }
+    // Fills the intersections with the ranges.
+    auto fill = [&](const CodePointRange &range, const uint8_t mask,
+                    const uint8_t value) {
+      const char32_t last = first + kBlockSize - 1;
+      if (range.last < first || last < range.first) {
+        return;
+      }
+      const char32_t begin = range.first < first ? first : range.first;
+      const char32_t end = range.last < last ? range.last : last;
+      for (char32_t codepoint = begin; codepoint <= end; ++codepoint) {
+        uint8_t &c = classes[codepoint - first];
+        c = (c & ~mask) | value;
+      }
+    };
+    for (const CodePointRange &range : kScriptTypeRanges) {
+      fill(range, 0x0F, range.type);
+    }
+    for (const CodePointRange &range : kHalfWidthRanges) {
+      fill(range, 0xF0, range.type << 4);
     }
   }
+  return table;
+}
+
+constexpr auto kCharacterClassTable =
+    BuildCharacterClassTable<CountMixedBlocks()>();
+
+inline uint8_t GetCharacterClass(const char32_t codepoint) {
+  if (codepoint > 0xFFFF) {
+    return GetCharacterClassFromRanges(codepoint);
+  }
+  const uint8_t block = kCharacterClassTable.blocks[codepoint >> kBlockBits];
+  if (!(block & kMixedBlock)) {
+    return block;
+  }
+  return kCharacterClassTable
+      .mixed[block & ~kMixedBlock][codepoint & (kBlockSize - 1)];
+}
+
+// Decodes the character at `pos` in `str` if it is ASCII or a 3 byte
+// character other than a surrogate, which covers kana, kanji and full width
+// forms.  Returns its byte length, or 0 for the other characters, which are
+// decoded by the callers as before.
+inline size_t DecodeCommonChar(const absl::string_view str, const size_t pos,
+                               char32_t *codepoint) {
+  const uint8_t c0 = str[pos];
+  if (c0 < 0x80) {
+    *codepoint = c0;
+    return 1;
+  }
+  if ((c0 & 0xF0) != 0xE0 || pos + 3 > str.size()) {
+    return 0;
+  }
+  const uint8_t c1 = str[pos + 1];
+  const uint8_t c2 = str[pos + 2];
+  if ((c1 & 0xC0) != 0x80 || (c2 & 0xC0) != 0x80) {
+    return 0;
+  }
+  const char32_t result =
+      ((c0 & 0x0F) << 12) | ((c1 & 0x3F) << 6) | (c2 & 0x3F);
+  if (result < 0x800 || (0xD800 <= result && result <= 0xDFFF)) {
+    return 0;
+  }
+  *codepoint = result;
+  return 3;
+}
 
-  // Characters marked as 'H' in
-  // http://www.unicode.org/Public/UNIDATA/EastAsianWidth.txt
-  if (codepoint == 0x20A9 ||                 // WON SIGN
-      INRANGE(codepoint, 0xFF61, 0xFF9F) ||  // half-width katakana
-      INRANGE(codepoint, 0xFFA0, 0xFFBE) ||  // half-width hangul
-      INRANGE(codepoint, 0xFFC2, 0xFFCF) ||  // half-width hangul
-      INRANGE(codepoint, 0xFFD2, 0xFFD7) ||  // half-width hangul
-      INRANGE(codepoint, 0xFFDA, 0xFFDC) ||  // half-width hangul
-      INRANGE(codepoint, 0xFFE8, 0xFFEE)) {  // half-width symbols
-    return HALF_WIDTH;
+// Calls `func` with each character in `str` as ConstChar32Iterator until it
+// returns false.
+template <typename Func>
+void ForEachChar32(absl::string_view str, Func func) {
+  for (size_t pos = 0; pos < str.size();) {
+    char32_t codepoint = 0;
+    size_t len = DecodeCommonChar(str, pos, &codepoint);
+    if (len == 0) {
+      absl::string_view rest;
+      if (!Util::SplitFirstChar32(str.substr(pos), &codepoint, &rest)) {
+        return;
+      }
+      len = str.size() - pos - rest.size();
+    }
+    if (!func(codepoint)) {
+      return;
+    }
+    pos += len;
   }
+}
+
+}  // namespace
 
-  return FULL_WIDTH;
+Util::ScriptType Util::GetScriptType(char32_t codepoint) {
+  return static_cast<ScriptType>(GetCharacterClass(codepoint) & 0x0F);
 }
 
-#undef INRANGE
+Util::FormType Util::GetFormType(char32_t codepoint) {
+  return static_cast<FormType>(GetCharacterClass(codepoint) >> 4);
+}
 
 // Returns the script type of the first character in `str`.
 Util::ScriptType Util::GetFirstScriptType(absl::string_view str,
@@ -934,32 +1080,39 @@ Util::ScriptType Util::GetFirstScriptType(absl::string_view str,
 }
 
 namespace {
-using ScriptTypeBitSet = std::bitset<Util::SCRIPT_TYPE_SIZE>;
-constexpr ScriptTypeBitSet kNumBs(1 << Util::NUMBER);
-constexpr ScriptTypeBitSet kKanaBs((1 << Util::HIRAGANA) |
-                                   (1 << Util::KATAKANA));
+constexpr uint32_t kAllScriptTypes = (1 << Util::SCRIPT_TYPE_SIZE) - 1;
+constexpr uint32_t kNumTypes = 1 << Util::NUMBER;
+constexpr uint32_t kKanaTypes = (1 << Util::HIRAGANA) | (1 << Util::KATAKANA);
 
 Util::ScriptType GetScriptTypeInternal(absl::string_view str,
                                        bool ignore_symbols) {
-  ScriptTypeBitSet bs(-1);
-  DCHECK(bs.all());
+  uint32_t types = kAllScriptTypes;
 
-  for (const char32_t codepoint : Utf8AsChars32(str)) {
-    if (bs.count() == 0) {
+  for (size_t pos = 0; pos < str.size();) {
+    if (types == 0) {
       return Util::UNKNOWN_SCRIPT;
     }
 
+    char32_t codepoint = 0;
+    size_t len = DecodeCommonChar(str, pos, &codepoint);
+    if (len == 0) {
+      const Utf8AsChars32::iterator it = Utf8AsChars32(str.substr(pos)).begin();
+      codepoint = *it;
+      len = it.size();
+    }
+    pos += len;
+
     // PROLONGED SOUND MARK|MIDLE_DOT|VOICED_SOUND_MARKS
     // are HIRAGANA or KATAKANA as well.
     if (codepoint == U'ー' || codepoint == U'・' ||
         (codepoint >= 0x3099 && codepoint <= 0x309C)) {
-      bs &= kKanaBs;
+      types &= kKanaTypes;
       continue;
     }
 
     // Periods ('．' U+FF0E and '.' U+002E) are NUMBER as well, if they are not
     // the first character.
-    if ((codepoint == U'．' || codepoint == U'.') && bs == kNumBs) {
+    if ((codepoint == U'．' || codepoint == U'.') && types == kNumTypes) {
       continue;
     }
 
@@ -970,16 +1123,14 @@ Util::ScriptType GetScriptTypeInternal(absl::string_view str,
       continue;
     }
 
-    ScriptTypeBitSet type_bs(1 << type);
-    bs &= type_bs;
+    types &= 1 << type;
   }
 
-  if (bs.count() != 1) {
+  if (absl::popcount(types) != 1) {
     return Util::UNKNOWN_SCRIPT;
   }
 
-  const uint32_t onehot = static_cast<uint32_t>(bs.to_ulong());
-  return static_cast<Util::ScriptType>(absl::countr_zero(onehot));
+  return static_cast<Util::ScriptType>(absl::countr_zero(types));
 }
 }  // namespace
 
@@ -993,25 +1144,26 @@ Util::ScriptType Util::GetScriptTypeWithoutSymbols(absl::string_view str) {
 
 // return true if all script_type in str is "type"
 bool Util::IsScriptType(absl::string_view str, Util::ScriptType type) {
-  for (ConstChar32Iterator iter(str); !iter.Done(); iter.Next()) {
-    const char32_t codepoint = iter.Get();
+  bool result = true;
+  ForEachChar32(str, [&](const char32_t codepoint) {
     // Exception: 30FC (PROLONGEDSOUND MARK is categorized as HIRAGANA as well)
     if (type != GetScriptType(codepoint) &&
         (codepoint != 0x30FC || type != HIRAGANA)) {
-      return false;
+      result = false;
     }
-  }
-  return true;
+    return result;
+  });
+  return result;
 }
 
 // return true if the string contains script_type char
 bool Util::ContainsScriptType(absl::string_view str, ScriptType type) {
-  for (ConstChar32Iterator iter(str); !iter.Done(); iter.Next()) {
-    if (type == GetScriptType(iter.Get())) {
-      return true;
-    }
-  }
-  return false;
+  bool result = false;
+  ForEachChar32(str, [&](const char32_t codepoint) {
+    result = type == GetScriptType(codepoint);
+    return !result;
+  });
+  return result;
 }
 
 // return the Form Type of string
@@ -1019,13 +1171,15 @@ Util::FormType Util::GetFormType(absl::string_view str) {
   // TODO(hidehiko): get rid of using FORM_TYPE_SIZE.
   FormType result = FORM_TYPE_SIZE;
 
-  for (ConstChar32Iterator iter(str); !iter.Done(); iter.Next()) {
-    const FormType type = GetFormType(iter.Get());
+  ForEachChar32(str, [&](const char32_t codepoint) {
+    const FormType type = GetFormType(codepoint);
     if (type == UNKNOWN_FORM || (result != FORM_TYPE_SIZE && type != result)) {
-      return UNKNOWN_FORM;
+      result = UNKNOWN_FORM;
+      return false;
     }
     result = type;
-  }
+    return true;
+  });
 
   return result;
 }
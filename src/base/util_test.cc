@@ -863,6 +863,40 @@ TEST(UtilTest, FormType) {
   EXPECT_EQ(Util::GetFormType("@!#"), Util::HALF_WIDTH);
 }
 
+TEST(UtilTest, ScriptTypeAndFormTypeOfCodepoint) {
+  // Boundaries of the ranges inside and across the blocks of the table.
+  EXPECT_EQ(Util::GetScriptType(U')'), Util::UNKNOWN_SCRIPT);
+  EXPECT_EQ(Util::GetScriptType(U'0'), Util::NUMBER);
+  EXPECT_EQ(Util::GetScriptType(U'〄'), Util::UNKNOWN_SCRIPT);
+  EXPECT_EQ(Util::GetScriptType(U'々'), Util::KANJI);
+  EXPECT_EQ(Util::GetScriptType(U'〆'), Util::UNKNOWN_SCRIPT);
+  EXPECT_EQ(Util::GetScriptType(U'ゟ'), Util::HIRAGANA);
+  EXPECT_EQ(Util::GetScriptType(U'゠'), Util::UNKNOWN_SCRIPT);
+  EXPECT_EQ(Util::GetScriptType(U'ァ'), Util::KATAKANA);
+  EXPECT_EQ(Util::GetScriptType(U'䶿'), Util::KANJI);
+  EXPECT_EQ(Util::GetScriptType(U'䷀'), Util::UNKNOWN_SCRIPT);
+  EXPECT_EQ(Util::GetScriptType(U'一'), Util::KANJI);
+  EXPECT_EQ(Util::GetScriptType(U'鿿'), Util::KANJI);
+  EXPECT_EQ(Util::GetScriptType(U'ꀀ'), Util::UNKNOWN_SCRIPT);
+  EXPECT_EQ(Util::GetScriptType(U'\U0001B000'), Util::KATAKANA);
+  EXPECT_EQ(Util::GetScriptType(U'\U0001F600'), Util::EMOJI);
+  EXPECT_EQ(Util::GetScriptType(U'\U0002A6DF'), Util::KANJI);
+  EXPECT_EQ(Util::GetScriptType(U'\U0002A6E0'), Util::UNKNOWN_SCRIPT);
+  EXPECT_EQ(Util::GetScriptType(U'\U0010FFFF'), Util::UNKNOWN_SCRIPT);
+
+  EXPECT_EQ(Util::GetFormType(U'\u001F'), Util::FULL_WIDTH);
+  EXPECT_EQ(Util::GetFormType(U' '), Util::HALF_WIDTH);
+  EXPECT_EQ(Util::GetFormType(U'\u007F'), Util::HALF_WIDTH);
+  EXPECT_EQ(Util::GetFormType(U'\u0080'), Util::FULL_WIDTH);
+  EXPECT_EQ(Util::GetFormType(U'¤'), Util::FULL_WIDTH);
+  EXPECT_EQ(Util::GetFormType(U'¥'), Util::HALF_WIDTH);
+  EXPECT_EQ(Util::GetFormType(U'｠'), Util::FULL_WIDTH);
+  EXPECT_EQ(Util::GetFormType(U'｡'), Util::HALF_WIDTH);
+  EXPECT_EQ(Util::GetFormType(U'￮'), Util::HALF_WIDTH);
+  EXPECT_EQ(Util::GetFormType(U'￯'), Util::FULL_WIDTH);
+  EXPECT_EQ(Util::GetFormType(U'\U0001F600'), Util::FULL_WIDTH);
+}
+
 TEST(UtilTest, IsAscii) {
   EXPECT_FALSE(Util::IsAscii("あいうえお"));
   EXPECT_TRUE(Util::IsAscii("abc"));
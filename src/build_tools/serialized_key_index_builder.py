@@ -0,0 +1,75 @@
+# -*- coding: utf-8 -*-
+# Copyright 2010-2021, Google Inc.
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are
+# met:
+#
+#     * Redistributions of source code must retain the above copyright
+# notice, this list of conditions and the following disclaimer.
+#     * Redistributions in binary form must reproduce the above
+# copyright notice, this list of conditions and the following disclaimer
+# in the documentation and/or other materials provided with the
+# distribution.
+#     * Neither the name of Google Inc. nor the names of its
+# contributors may be used to endorse or promote products derived from
+# this software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+# "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+# LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+# A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+# OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+# SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+# LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+# DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+# THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+# (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+# OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+"""Generate a binary image of SerializedKeyIndex."""
+
+import struct
+
+
+def Hash(key):
+  """Returns 32-bit FNV-1a hash of key, same as SerializedKeyIndex::Hash."""
+  if isinstance(key, str):
+    key = key.encode('utf-8')
+  value = 2166136261
+  for byte in key:
+    value = ((value ^ byte) * 16777619) & 0xFFFFFFFF
+  return value
+
+
+def SerializeToFile(entries, filename):
+  """Builds a binary image of a key index.
+
+  For file format, see base/container/serialized_key_index.h.
+
+  Args:
+    entries: A list of (key, begin, end) tuples, where [begin, end) is the
+      non-empty range of the key in the indexed array.  Keys must be unique.
+    filename: Output binary file.
+  """
+  # Keep the load factor at most 1/2, which also guarantees an empty slot.
+  num_slots = 1
+  while num_slots < len(entries) * 2 + 1:
+    num_slots *= 2
+  mask = num_slots - 1
+
+  slots = [(0, 0, 0)] * num_slots
+  for key, begin, end in entries:
+    if begin >= end:
+      raise ValueError('Empty range for %s' % key)
+    key_hash = Hash(key)
+    i = key_hash & mask
+    while slots[i][2] != 0:
+      i = (i + 1) & mask
+    slots[i] = (key_hash, begin, end)
+
+  with open(filename, 'wb') as f:
+    f.write(struct.pack('<I', num_slots))
+    for slot in slots:
+      f.write(struct.pack('<III', *slot))
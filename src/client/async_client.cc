@@ -0,0 +1,222 @@
+// Copyright 2010-2021, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "client/async_client.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/log/check.h"
+#include "absl/log/log.h"
+#include "absl/synchronization/mutex.h"
+#include "base/thread.h"
+#include "client/client_interface.h"
+#include "protocol/commands.pb.h"
+
+namespace mozc {
+namespace client {
+
+AsyncClient::AsyncClient(std::unique_ptr<ClientInterface> client)
+    : client_(std::move(client)) {
+  DCHECK(client_);
+  thread_ = Thread([this] { ThreadMain(); });
+}
+
+AsyncClient::~AsyncClient() {
+  {
+    absl::MutexLock l(&mutex_);
+    terminating_ = true;
+  }
+  thread_.Join();
+}
+
+uint64_t AsyncClient::SendKeyAsync(const commands::KeyEvent &key,
+                                   const commands::Context &context,
+                                   Callback callback) {
+  commands::Input input;
+  input.set_type(commands::Input::SEND_KEY);
+  *input.mutable_key() = key;
+  // If the pointer of |context| is not the default_instance, update the data.
+  if (&context != &commands::Context::default_instance()) {
+    *input.mutable_context() = context;
+  }
+  return Enqueue(std::move(input), std::move(callback));
+}
+
+uint64_t AsyncClient::SendCommandAsync(const commands::SessionCommand &command,
+                                       const commands::Context &context,
+                                       Callback callback) {
+  commands::Input input;
+  input.set_type(commands::Input::SEND_COMMAND);
+  *input.mutable_command() = command;
+  // If the pointer of |context| is not the default_instance, update the data.
+  if (&context != &commands::Context::default_instance()) {
+    *input.mutable_context() = context;
+  }
+  return Enqueue(std::move(input), std::move(callback));
+}
+
+uint64_t AsyncClient::Enqueue(commands::Input input, Callback callback) {
+  absl::MutexLock l(&mutex_);
+  const uint64_t request_id = next_request_id_++;
+  input.set_request_id(request_id);
+  queue_.push_back({std::move(input), std::move(callback)});
+  return request_id;
+}
+
+void AsyncClient::Wait(uint64_t request_id) {
+  absl::MutexLock l(&mutex_);
+  const auto processed = [this, request_id]()
+                             ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
+                               return last_processed_id_ >= request_id;
+                             };
+  mutex_.Await(absl::Condition(&processed));
+}
+
+void AsyncClient::Flush() {
+  uint64_t last_request_id = 0;
+  {
+    absl::MutexLock l(&mutex_);
+    last_request_id = next_request_id_ - 1;
+  }
+  Wait(last_request_id);
+}
+
+void AsyncClient::set_latest_output_only(bool latest_output_only) {
+  absl::MutexLock l(&mutex_);
+  latest_output_only_ = latest_output_only;
+}
+
+void AsyncClient::set_max_batch_size(size_t max_batch_size) {
+  absl::MutexLock l(&mutex_);
+  max_batch_size_ = std::max<size_t>(max_batch_size, 1);
+}
+
+void AsyncClient::ThreadMain() {
+  while (true) {
+    std::vector<Request> requests;
+    bool latest_output_only = false;
+    {
+      absl::MutexLock l(&mutex_);
+      const auto ready = [this]() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
+        return terminating_ || !queue_.empty();
+      };
+      mutex_.Await(absl::Condition(&ready));
+      if (queue_.empty()) {
+        // terminating_ is set and all the requests are processed.
+        return;
+      }
+      // Takes all the requests accumulated while the previous batch was in
+      // flight.
+      const size_t size = std::min(queue_.size(), max_batch_size_);
+      requests.reserve(size);
+      for (size_t i = 0; i < size; ++i) {
+        requests.push_back(std::move(queue_.front()));
+        queue_.pop_front();
+      }
+      latest_output_only = latest_output_only_;
+    }
+
+    const uint64_t last_request_id = requests.back().input.request_id();
+    Process(std::move(requests), latest_output_only);
+
+    absl::MutexLock l(&mutex_);
+    last_processed_id_ = last_request_id;
+  }
+}
+
+bool AsyncClient::ProcessSingle(const commands::Input &input,
+                                commands::Output *output) {
+  switch (input.type()) {
+    case commands::Input::SEND_KEY:
+      return client_->SendKeyWithContext(input.key(), input.context(), output);
+    case commands::Input::SEND_COMMAND:
+      return client_->SendCommandWithContext(input.command(), input.context(),
+                                             output);
+    default:
+      LOG(DFATAL) << "Unexpected input type: " << input.type();
+      return false;
+  }
+}
+
+void AsyncClient::Process(std::vector<Request> requests,
+                          bool latest_output_only) {
+  Response response;
+  if (requests.size() == 1) {
+    Request &request = requests.front();
+    response.request_id = request.input.request_id();
+    response.success = ProcessSingle(request.input, &response.output);
+    if (request.callback) {
+      request.callback(response);
+    }
+    return;
+  }
+
+  commands::CommandList command_list;
+  command_list.set_output_last_only(latest_output_only);
+  for (const Request &request : requests) {
+    *command_list.add_commands()->mutable_input() = request.input;
+  }
+
+  commands::CommandList results;
+  const bool success = client_->SendCommandList(command_list, &results);
+  if (!success) {
+    LOG(ERROR) << "SendCommandList failed. size: " << requests.size();
+  }
+
+  absl::flat_hash_map<uint64_t, commands::Output *> outputs;
+  for (commands::Command &result : *results.mutable_commands()) {
+    outputs.emplace(result.input().request_id(), result.mutable_output());
+  }
+
+  for (Request &request : requests) {
+    response.request_id = request.input.request_id();
+    response.output.Clear();
+    const auto it = outputs.find(response.request_id);
+    if (it != outputs.end()) {
+      response.success = success;
+      response.superseded = false;
+      response.output = std::move(*it->second);
+    } else {
+      response.success = success && latest_output_only;
+      response.superseded = response.success;
+    }
+    if (request.callback) {
+      request.callback(response);
+    }
+  }
+}
+
+}  // namespace client
+}  // namespace mozc
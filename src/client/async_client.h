@@ -0,0 +1,144 @@
+// Copyright 2010-2021, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Asynchronous wrapper of ClientInterface.
+//
+// Requests are queued and sent to the server in order on a background thread,
+// so the caller is not blocked by the IPC. Front ends which have to report
+// whether a key is consumed synchronously (e.g. ibus) keep using the blocking
+// ClientInterface. While a request is in flight, the following requests are
+// accumulated and sent together as a single SEND_COMMAND_LIST request. This
+// amortizes the IPC cost when the user types faster than the server responds.
+//
+// Usage:
+//   AsyncClient client(ClientFactory::NewClient());
+//   client.SendKeyAsync(key, context, [](const AsyncClient::Response &r) {
+//     // Invoked on the background thread.
+//   });
+//   ...
+//   client.Flush();  // Waits for all the pending requests.
+
+#ifndef MOZC_CLIENT_ASYNC_CLIENT_H_
+#define MOZC_CLIENT_ASYNC_CLIENT_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/functional/any_invocable.h"
+#include "absl/synchronization/mutex.h"
+#include "base/thread.h"
+#include "client/client_interface.h"
+#include "protocol/commands.pb.h"
+
+namespace mozc {
+namespace client {
+
+class AsyncClient {
+ public:
+  struct Response {
+    // The id returned by SendKeyAsync or SendCommandAsync.
+    uint64_t request_id = 0;
+    bool success = false;
+    // True if the output was omitted because a newer request in the same batch
+    // superseded it. This happens only when latest_output_only is enabled.
+    bool superseded = false;
+    commands::Output output;
+  };
+
+  // Callbacks are invoked on the background thread in the request order.
+  using Callback = absl::AnyInvocable<void(const Response &)>;
+
+  explicit AsyncClient(std::unique_ptr<ClientInterface> client);
+  AsyncClient(const AsyncClient &) = delete;
+  AsyncClient &operator=(const AsyncClient &) = delete;
+
+  // Processes all the pending requests and joins the background thread.
+  ~AsyncClient();
+
+  // Enqueues a request and returns its request id immediately. `callback`
+  // can be nullptr if the response is not necessary.
+  uint64_t SendKeyAsync(const commands::KeyEvent &key,
+                        const commands::Context &context, Callback callback)
+      ABSL_LOCKS_EXCLUDED(mutex_);
+  uint64_t SendCommandAsync(const commands::SessionCommand &command,
+                            const commands::Context &context,
+                            Callback callback) ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Blocks until the request of `request_id` and all the preceding requests
+  // are processed.
+  void Wait(uint64_t request_id) ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Blocks until all the requests enqueued so far are processed.
+  void Flush() ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // If true, the server returns only the output of the last request of each
+  // batch, and the callbacks of the other requests are invoked with
+  // `superseded` = true. This reduces the response size but drops the
+  // intermediate results, so it should be enabled only by clients which
+  // need the latest state alone, e.g. replaying keys.
+  void set_latest_output_only(bool latest_output_only)
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Maximum number of requests sent in one IPC call.
+  void set_max_batch_size(size_t max_batch_size) ABSL_LOCKS_EXCLUDED(mutex_);
+
+ private:
+  struct Request {
+    commands::Input input;
+    Callback callback;
+  };
+
+  uint64_t Enqueue(commands::Input input, Callback callback)
+      ABSL_LOCKS_EXCLUDED(mutex_);
+  void ThreadMain();
+  // Sends `requests` to the server and invokes their callbacks.
+  void Process(std::vector<Request> requests, bool latest_output_only);
+  bool ProcessSingle(const commands::Input &input, commands::Output *output);
+
+  // Accessed only from the background thread after the construction.
+  std::unique_ptr<ClientInterface> client_;
+
+  absl::Mutex mutex_;
+  std::deque<Request> queue_ ABSL_GUARDED_BY(mutex_);
+  uint64_t next_request_id_ ABSL_GUARDED_BY(mutex_) = 1;
+  uint64_t last_processed_id_ ABSL_GUARDED_BY(mutex_) = 0;
+  bool latest_output_only_ ABSL_GUARDED_BY(mutex_) = false;
+  size_t max_batch_size_ ABSL_GUARDED_BY(mutex_) = 64;
+  bool terminating_ ABSL_GUARDED_BY(mutex_) = false;
+  Thread thread_;
+};
+
+}  // namespace client
+}  // namespace mozc
+
+#endif  // MOZC_CLIENT_ASYNC_CLIENT_H_
@@ -0,0 +1,215 @@
+// Copyright 2010-2021, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "client/async_client.h"
+
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "absl/synchronization/mutex.h"
+#include "absl/synchronization/notification.h"
+#include "client/client_mock.h"
+#include "protocol/commands.pb.h"
+#include "testing/gmock.h"
+#include "testing/gunit.h"
+
+namespace mozc {
+namespace client {
+namespace {
+
+using ::testing::_;
+using ::testing::DoAll;
+using ::testing::Invoke;
+using ::testing::Return;
+
+commands::KeyEvent MakeKey(char key_code) {
+  commands::KeyEvent key;
+  key.set_key_code(key_code);
+  return key;
+}
+
+class ResponseRecorder {
+ public:
+  AsyncClient::Callback Callback() {
+    return [this](const AsyncClient::Response &response) {
+      absl::MutexLock l(&mutex_);
+      responses_.push_back(response);
+    };
+  }
+
+  std::vector<AsyncClient::Response> responses() {
+    absl::MutexLock l(&mutex_);
+    return responses_;
+  }
+
+ private:
+  absl::Mutex mutex_;
+  std::vector<AsyncClient::Response> responses_;
+};
+
+TEST(AsyncClientTest, SendKeyAsync) {
+  auto mock = std::make_unique<ClientMock>();
+  commands::Output output;
+  output.set_consumed(true);
+  EXPECT_CALL(*mock, SendKeyWithContext(_, _, _))
+      .WillOnce(DoAll(::testing::SetArgPointee<2>(output), Return(true)));
+
+  ResponseRecorder recorder;
+  AsyncClient client(std::move(mock));
+  const uint64_t id = client.SendKeyAsync(
+      MakeKey('a'), commands::Context::default_instance(), recorder.Callback());
+  client.Wait(id);
+
+  const std::vector<AsyncClient::Response> responses = recorder.responses();
+  ASSERT_EQ(responses.size(), 1);
+  EXPECT_EQ(responses[0].request_id, id);
+  EXPECT_TRUE(responses[0].success);
+  EXPECT_FALSE(responses[0].superseded);
+  EXPECT_TRUE(responses[0].output.consumed());
+}
+
+// Requests enqueued while another request is in flight are sent as a single
+// SEND_COMMAND_LIST request.
+TEST(AsyncClientTest, PipelinedRequestsAreBatched) {
+  auto mock = std::make_unique<ClientMock>();
+  absl::Notification started, release;
+  EXPECT_CALL(*mock, SendKeyWithContext(_, _, _))
+      .WillOnce(Invoke([&](const commands::KeyEvent &key,
+                           const commands::Context &context,
+                           commands::Output *output) {
+        started.Notify();
+        release.WaitForNotification();
+        return true;
+      }));
+  EXPECT_CALL(*mock, SendCommandList(_, _))
+      .WillOnce(Invoke([](const commands::CommandList &commands,
+                          commands::CommandList *results) {
+        EXPECT_EQ(commands.commands_size(), 2);
+        EXPECT_FALSE(commands.output_last_only());
+        for (const commands::Command &command : commands.commands()) {
+          commands::Command *result = results->add_commands();
+          *result->mutable_input() = command.input();
+          result->mutable_output()->set_consumed(true);
+          result->mutable_output()->set_request_id(
+              command.input().request_id());
+        }
+        return true;
+      }));
+
+  ResponseRecorder recorder;
+  AsyncClient client(std::move(mock));
+  const commands::Context &context = commands::Context::default_instance();
+  const uint64_t id1 = client.SendKeyAsync(MakeKey('k'), context,
+                                           recorder.Callback());
+  started.WaitForNotification();
+  const uint64_t id2 = client.SendKeyAsync(MakeKey('a'), context,
+                                           recorder.Callback());
+  commands::SessionCommand command;
+  command.set_type(commands::SessionCommand::SUBMIT);
+  const uint64_t id3 =
+      client.SendCommandAsync(command, context, recorder.Callback());
+  release.Notify();
+  client.Flush();
+
+  const std::vector<AsyncClient::Response> responses = recorder.responses();
+  ASSERT_EQ(responses.size(), 3);
+  EXPECT_EQ(responses[0].request_id, id1);
+  EXPECT_EQ(responses[1].request_id, id2);
+  EXPECT_EQ(responses[2].request_id, id3);
+  for (const AsyncClient::Response &response : responses) {
+    EXPECT_TRUE(response.success);
+    EXPECT_FALSE(response.superseded);
+  }
+  EXPECT_TRUE(responses[2].output.consumed());
+}
+
+TEST(AsyncClientTest, LatestOutputOnly) {
+  auto mock = std::make_unique<ClientMock>();
+  absl::Notification started, release;
+  EXPECT_CALL(*mock, SendKeyWithContext(_, _, _))
+      .WillOnce(Invoke([&](const commands::KeyEvent &key,
+                           const commands::Context &context,
+                           commands::Output *output) {
+        started.Notify();
+        release.WaitForNotification();
+        return true;
+      }));
+  EXPECT_CALL(*mock, SendCommandList(_, _))
+      .WillOnce(Invoke([](const commands::CommandList &commands,
+                          commands::CommandList *results) {
+        EXPECT_TRUE(commands.output_last_only());
+        *results->add_commands() = commands.commands(commands.commands_size() -
+                                                     1);
+        return true;
+      }));
+
+  ResponseRecorder recorder;
+  AsyncClient client(std::move(mock));
+  client.set_latest_output_only(true);
+  const commands::Context &context = commands::Context::default_instance();
+  client.SendKeyAsync(MakeKey('k'), context, recorder.Callback());
+  started.WaitForNotification();
+  const uint64_t id2 =
+      client.SendKeyAsync(MakeKey('a'), context, recorder.Callback());
+  const uint64_t id3 =
+      client.SendKeyAsync(MakeKey('n'), context, recorder.Callback());
+  release.Notify();
+  client.Wait(id3);
+
+  const std::vector<AsyncClient::Response> responses = recorder.responses();
+  ASSERT_EQ(responses.size(), 3);
+  EXPECT_EQ(responses[1].request_id, id2);
+  EXPECT_TRUE(responses[1].success);
+  EXPECT_TRUE(responses[1].superseded);
+  EXPECT_EQ(responses[2].request_id, id3);
+  EXPECT_TRUE(responses[2].success);
+  EXPECT_FALSE(responses[2].superseded);
+}
+
+TEST(AsyncClientTest, DestructorProcessesPendingRequests) {
+  auto mock = std::make_unique<ClientMock>();
+  EXPECT_CALL(*mock, SendKeyWithContext(_, _, _)).WillRepeatedly(Return(true));
+  EXPECT_CALL(*mock, SendCommandList(_, _)).WillRepeatedly(Return(true));
+
+  ResponseRecorder recorder;
+  {
+    AsyncClient client(std::move(mock));
+    for (char c = 'a'; c <= 'z'; ++c) {
+      client.SendKeyAsync(MakeKey(c), commands::Context::default_instance(),
+                          recorder.Callback());
+    }
+  }
+  EXPECT_EQ(recorder.responses().size(), 26);
+}
+
+}  // namespace
+}  // namespace client
+}  // namespace mozc
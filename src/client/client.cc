@@ -37,6 +37,7 @@
 #include <memory>
 #include <ostream>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "absl/base/attributes.h"
@@ -261,6 +262,30 @@ void Client::PlaybackHistory() {
 
 void Client::PushHistory(const commands::Input &input,
                          const commands::Output &output) {
+  if (input.type() == commands::Input::SEND_COMMAND_LIST) {
+    const commands::CommandList &inputs = input.command_list();
+    const commands::CommandList &outputs = output.command_list();
+    if (inputs.output_last_only()) {
+      // The intermediate outputs are not available. Remembers all the inputs
+      // so that the playback can restore the state.
+      for (const commands::Command &command : inputs.commands()) {
+        if (history_inputs_.size() < kMaxPlayBackSize) {
+          history_inputs_.push_back(command.input());
+        }
+      }
+      if (!outputs.commands().empty() &&
+          outputs.commands(0).input().type() == commands::Input::SEND_KEY &&
+          outputs.commands(0).output().has_result()) {
+        ResetHistory();
+      }
+      return;
+    }
+    for (const commands::Command &command : outputs.commands()) {
+      PushHistory(command.input(), command.output());
+    }
+    return;
+  }
+
   if (!output.has_consumed() || !output.consumed()) {
     // Do not remember unconsumed input.
     return;
@@ -354,6 +379,22 @@ bool Client::SendCommandWithContext(const commands::SessionCommand &command,
   return EnsureCallCommand(&input, output);
 }
 
+bool Client::SendCommandList(const commands::CommandList &commands,
+                             commands::CommandList *results) {
+  commands::Input input;
+  input.set_type(commands::Input::SEND_COMMAND_LIST);
+  *input.mutable_command_list() = commands;
+  commands::Output output;
+  if (!EnsureCallCommand(&input, &output)) {
+    return false;
+  }
+  if (output.error_code() != commands::Output::SESSION_SUCCESS) {
+    return false;
+  }
+  *results = std::move(*output.mutable_command_list());
+  return true;
+}
+
 bool Client::CheckVersionOrRestartServer() {
   commands::Input input;
   commands::Output output;
@@ -568,6 +609,24 @@ bool Client::Reload() { return CallCommand(commands::Input::RELOAD); }
 
 bool Client::Cleanup() { return CallCommand(commands::Input::CLEANUP); }
 
+bool Client::GetServerStats(commands::ServerStats *stats) {
+  commands::Input input;
+  InitInput(&input);
+  input.set_type(commands::Input::GET_SERVER_STATS);
+
+  commands::Output output;
+  if (!Call(input, &output)) {
+    return false;
+  }
+
+  if (!output.has_server_stats()) {
+    return false;
+  }
+
+  *stats = output.server_stats();
+  return true;
+}
+
 bool Client::NoOperation() {
   return CallCommand(commands::Input::NO_OPERATION);
 }
@@ -738,6 +797,12 @@ void Client::InitInput(commands::Input *input) const {
   if (preferences_ != nullptr) {
     *input->mutable_config() = *preferences_;
   }
+  if (input->has_command_list()) {
+    for (commands::Command &command :
+         *input->mutable_command_list()->mutable_commands()) {
+      InitInput(command.mutable_input());
+    }
+  }
 }
 
 bool Client::CheckVersionOrRestartServerInternal(const commands::Input &input,
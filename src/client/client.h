@@ -130,6 +130,8 @@ class Client : public ClientInterface {
   bool SendCommandWithContext(const commands::SessionCommand &command,
                               const commands::Context &context,
                               commands::Output *output) override;
+  bool SendCommandList(const commands::CommandList &commands,
+                       commands::CommandList *results) override;
 
   bool IsDirectModeCommand(const commands::KeyEvent &key) const override;
 
@@ -143,6 +145,7 @@ class Client : public ClientInterface {
   bool SyncData() override;
   bool Reload() override;
   bool Cleanup() override;
+  bool GetServerStats(commands::ServerStats *stats) override;
 
   bool NoOperation() override;
   bool PingServer() const override;
@@ -147,6 +147,12 @@ class ClientInterface {
                                       const commands::Context &context,
                                       commands::Output *output) = 0;
 
+  // Sends all the inputs in |commands| in a single IPC call. The session id of
+  // each input is filled automatically. |results| receives the inputs with
+  // their outputs, or only the last one if |commands.output_last_only()|.
+  virtual bool SendCommandList(const commands::CommandList &commands,
+                               commands::CommandList *results) = 0;
+
   // The methods below don't call
   // StartServer even if server is not available. This treatment
   // avoids unexceptional and continuous server restart trials.
@@ -177,6 +183,9 @@ class ClientInterface {
   // Cleanup un-used sessions
   virtual bool Cleanup() = 0;
 
+  // Gets the statistics of the server.
+  virtual bool GetServerStats(commands::ServerStats *stats) = 0;
+
   // Resets internal state (changes the state to be SERVER_UNKNOWN)
   virtual void Reset() = 0;
 
@@ -67,6 +67,10 @@ class ClientMock : public client::ClientInterface {
               (const commands::SessionCommand &argument,
                const commands::Context &context, commands::Output *output),
               (override));
+  MOCK_METHOD(bool, SendCommandList,
+              (const commands::CommandList &commands,
+               commands::CommandList *results),
+              (override));
 
   MOCK_METHOD(bool, IsDirectModeCommand, (const commands::KeyEvent &key),
               (const, override));
@@ -79,6 +83,8 @@ class ClientMock : public client::ClientInterface {
   MOCK_METHOD(bool, SyncData, (), (override));
   MOCK_METHOD(bool, Reload, (), (override));
   MOCK_METHOD(bool, Cleanup, (), (override));
+  MOCK_METHOD(bool, GetServerStats, (commands::ServerStats * stats),
+              (override));
   MOCK_METHOD(void, Reset, (), (override));
   MOCK_METHOD(bool, PingServer, (), (const, override));
   MOCK_METHOD(bool, NoOperation, (), (override));
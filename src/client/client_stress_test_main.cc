@@ -27,6 +27,7 @@
 // (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 // OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
+#include <algorithm>
 #include <cstddef>
 #include <cstdint>
 #include <iostream>
@@ -45,9 +46,11 @@
 #include "absl/flags/flag.h"
 #include "absl/log/check.h"
 #include "absl/log/log.h"
+#include "absl/synchronization/mutex.h"
 #include "absl/time/clock.h"
 #include "absl/time/time.h"
 #include "base/init_mozc.h"
+#include "base/thread.h"
 #include "base/vlog.h"
 #include "client/client.h"
 #include "protocol/commands.pb.h"
@@ -65,10 +68,104 @@ ABSL_FLAG(std::string, server_path, "", "specify server path");
 ABSL_FLAG(int32_t, key_duration, 10, "key duration (msec)");
 ABSL_FLAG(bool, test_renderer, false, "test renderer");
 ABSL_FLAG(bool, test_testsendkey, true, "test TestSendKey");
+ABSL_FLAG(int32_t, num_clients, 1,
+          "number of concurrent clients. If more than 1, |max_keyevents| key "
+          "events are sent by the clients in parallel and the latency "
+          "statistics are reported.");
+
+namespace {
+
+// Sends random key events from |num_clients| clients concurrently, and
+// reports the throughput and the latency of SendKey.
+int RunConcurrentClients(int num_clients) {
+  const size_t keyevents_per_client =
+      std::max(1, absl::GetFlag(FLAGS_max_keyevents) / num_clients);
+  const absl::Duration key_duration =
+      absl::Milliseconds(absl::GetFlag(FLAGS_key_duration));
+
+  absl::Mutex mutex;
+  std::vector<absl::Duration> latencies;
+  int failures = 0;
+
+  const absl::Time start_time = absl::Now();
+  std::vector<mozc::Thread> threads;
+  threads.reserve(num_clients);
+  for (int i = 0; i < num_clients; ++i) {
+    threads.emplace_back([&] {
+      mozc::client::Client client;
+      if (!absl::GetFlag(FLAGS_server_path).empty()) {
+        client.set_server_program(absl::GetFlag(FLAGS_server_path));
+      }
+      CHECK(client.EnsureSession()) << "EnsureSession failed";
+
+      std::vector<absl::Duration> local_latencies;
+      local_latencies.reserve(keyevents_per_client);
+      int local_failures = 0;
+      mozc::session::RandomKeyEventsGenerator key_events_generator;
+      std::vector<mozc::commands::KeyEvent> keys;
+      mozc::commands::Output output;
+      while (local_latencies.size() < keyevents_per_client) {
+        key_events_generator.GenerateSequence(&keys);
+        for (const mozc::commands::KeyEvent &key : keys) {
+          if (local_latencies.size() >= keyevents_per_client) {
+            break;
+          }
+          absl::SleepFor(key_duration);
+          const absl::Time key_start = absl::Now();
+          if (!client.SendKey(key, &output)) {
+            ++local_failures;
+          }
+          local_latencies.push_back(absl::Now() - key_start);
+        }
+      }
+
+      absl::MutexLock l(&mutex);
+      latencies.insert(latencies.end(), local_latencies.begin(),
+                       local_latencies.end());
+      failures += local_failures;
+    });
+  }
+  for (mozc::Thread &thread : threads) {
+    thread.Join();
+  }
+  const absl::Duration elapsed = absl::Now() - start_time;
+
+  absl::MutexLock l(&mutex);
+  if (latencies.empty()) {
+    return 1;
+  }
+  std::sort(latencies.begin(), latencies.end());
+  absl::Duration total = absl::ZeroDuration();
+  for (const absl::Duration latency : latencies) {
+    total += latency;
+  }
+  auto percentile = [&latencies](int p) {
+    return latencies[(latencies.size() - 1) * p / 100];
+  };
+  std::cout << "clients: " << num_clients << std::endl
+            << "key events: " << latencies.size() << std::endl
+            << "failures: " << failures << std::endl
+            << "elapsed: " << elapsed << std::endl
+            << "throughput: "
+            << latencies.size() / absl::ToDoubleSeconds(elapsed)
+            << " keys/sec" << std::endl
+            << "latency avg: " << total / latencies.size() << std::endl
+            << "latency p50: " << percentile(50) << std::endl
+            << "latency p90: " << percentile(90) << std::endl
+            << "latency p99: " << percentile(99) << std::endl
+            << "latency max: " << latencies.back() << std::endl;
+  return failures == 0 ? 0 : 1;
+}
+
+}  // namespace
 
 int main(int argc, char **argv) {
   mozc::InitMozc(argv[0], &argc, &argv);
 
+  if (absl::GetFlag(FLAGS_num_clients) > 1) {
+    return RunConcurrentClients(absl::GetFlag(FLAGS_num_clients));
+  }
+
   mozc::client::Client client;
   if (!absl::GetFlag(FLAGS_server_path).empty()) {
     client.set_server_program(absl::GetFlag(FLAGS_server_path));
@@ -0,0 +1,109 @@
+// Copyright 2010-2021, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Command line tool to poll the statistics of mozc_server.
+//
+// Usage:
+// server_stats_main --iterations 10 --polling_interval 1s
+//
+// The stage latencies are reported only when mozc_server runs with
+// --record_stage_latencies.
+
+#include <cstdint>
+#include <iostream>
+#include <ostream>
+
+#include "absl/flags/flag.h"
+#include "absl/log/log.h"
+#include "absl/strings/str_format.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "base/init_mozc.h"
+#include "client/client.h"
+#include "protocol/commands.pb.h"
+
+ABSL_FLAG(int32_t, iterations, 1, "number of polls. 0 to poll forever");
+ABSL_FLAG(absl::Duration, polling_interval, absl::Seconds(1),
+          "polling interval e.g. 1s, 500ms");
+
+namespace mozc {
+namespace {
+
+void PrintStats(const commands::ServerStats &stats) {
+  std::cout << absl::StrFormat(
+      "sessions: %d  pending commands: %d  data: %d KiB  resident: %d KiB\n",
+      stats.session_count(), stats.pending_command_count(),
+      stats.data_size_bytes() / 1024, stats.resident_memory_bytes() / 1024);
+
+  for (const commands::ServerStats::Cache &cache : stats.caches()) {
+    const uint64_t total = cache.hits() + cache.misses();
+    std::cout << absl::StrFormat(
+        "cache %-12s hits: %10d  misses: %10d  hit rate: %5.1f%%\n",
+        cache.name(), cache.hits(), cache.misses(),
+        total == 0 ? 0.0 : 100.0 * cache.hits() / total);
+  }
+
+  std::cout << absl::StrFormat("%-40s %8s %8s %8s %8s %8s\n", "stage (usec)",
+                               "num", "p50", "p90", "p99", "max");
+  for (const commands::ServerStats::Latency &latency :
+       stats.stage_latencies()) {
+    std::cout << absl::StrFormat("%-40s %8d %8d %8d %8d %8d\n", latency.name(),
+                                 latency.num(), latency.p50_usec(),
+                                 latency.p90_usec(), latency.p99_usec(),
+                                 latency.max_usec());
+  }
+  std::cout << std::endl;
+}
+
+}  // namespace
+}  // namespace mozc
+
+int main(int argc, char **argv) {
+  mozc::InitMozc(argv[0], &argc, &argv);
+  mozc::client::Client client;
+
+  if (!client.PingServer()) {
+    LOG(INFO) << "mozc_server is not running";
+    return 1;
+  }
+
+  const int32_t iterations = absl::GetFlag(FLAGS_iterations);
+  for (int32_t i = 0; iterations == 0 || i < iterations; ++i) {
+    if (i > 0) {
+      absl::SleepFor(absl::GetFlag(FLAGS_polling_interval));
+    }
+    mozc::commands::ServerStats stats;
+    if (!client.GetServerStats(&stats)) {
+      LOG(ERROR) << "GET_SERVER_STATS failed";
+      return 1;
+    }
+    mozc::PrintStats(stats);
+  }
+  return 0;
+}
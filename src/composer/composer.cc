@@ -31,8 +31,10 @@
 
 #include "composer/composer.h"
 
+#include <array>
 #include <cstddef>
 #include <cstdint>
+#include <optional>
 #include <string>
 #include <tuple>
 #include <unordered_map>
@@ -439,12 +441,19 @@ std::string GetSubTransliteration(
 void GetSubTransliterations(
     const Composition &composition, const size_t position, const size_t size,
     transliteration::Transliterations *transliterations) {
+  // Several types share a transliterator (e.g. HALF_ASCII_UPPER and
+  // HALF_ASCII_LOWER), so the text of each transliterator is built once.
+  std::array<std::optional<std::string>, Transliterators::NUM_OF_TRANSLITERATOR>
+      texts;
   for (size_t i = 0; i < transliteration::NUM_T13N_TYPES; ++i) {
     const transliteration::TransliterationType t13n_type =
         transliteration::TransliterationTypeArray[i];
-    const std::string t13n =
-        GetSubTransliteration(composition, t13n_type, position, size);
-    transliterations->push_back(t13n);
+    const Transliterators::Transliterator t12r = GetTransliterator(t13n_type);
+    std::optional<std::string> &text = texts[t12r];
+    if (!text.has_value()) {
+      text = GetTransliteratedText(composition, t12r, position, size);
+    }
+    transliterations->push_back(Transliterate(t13n_type, *text));
   }
 }
 
@@ -29,6 +29,7 @@
 
 #include "composer/internal/composition.h"
 
+#include <algorithm>
 #include <cstddef>
 #include <iterator>
 #include <string>
@@ -53,7 +54,10 @@
 namespace mozc {
 namespace composer {
 
-void Composition::Erase() { chunks_.clear(); }
+void Composition::Erase() {
+  chunks_.clear();
+  TruncatePrefix(0);
+}
 
 size_t Composition::InsertAt(size_t pos, std::string input) {
   CompositionInput composition_input;
@@ -146,6 +150,10 @@ size_t Composition::ConvertPosition(
     return position_from;
   }
 
+  // Both positions are looked up in the prefixes.
+  ExtendPrefix(transliterator_from);
+  ExtendPrefix(transliterator_to);
+
   size_t inner_position_from;
   auto chunk_it =
       GetChunkAt(position_from, transliterator_from, &inner_position_from);
@@ -234,7 +242,13 @@ Transliterators::Transliterator Composition::GetTransliterator(
 }
 
 size_t Composition::GetLength() const {
-  return GetPosition(Transliterators::LOCAL, chunks_.end());
+  if (chunks_.empty()) {
+    return 0;
+  }
+  const Prefix &prefix = ExtendPrefix(Transliterators::LOCAL);
+  const size_t prefix_length =
+      prefix.ends.empty() ? 0 : prefix.ends.back().length;
+  return prefix_length + chunks_.back().GetLength(Transliterators::LOCAL);
 }
 
 std::string Composition::GetStringWithModes(
@@ -246,11 +260,8 @@ std::string Composition::GetStringWithModes(
     return std::string();
   }
 
-  CharChunkList::const_iterator it;
-  std::string composition;
-  for (it = chunks_.begin(); it != std::prev(chunks_.end()); ++it) {
-    it->AppendResult(transliterator, &composition);
-  }
+  CharChunkList::const_iterator it = std::prev(chunks_.end());
+  std::string composition = ExtendPrefix(transliterator).text;
 
   switch (trim_mode) {
     case TRIM:
@@ -277,12 +288,7 @@ Composition::GetExpandedStrings() const {
     return std::make_pair(std::string(), absl::btree_set<std::string>());
   }
 
-  std::string base;
-  CharChunkList::const_iterator it;
-  for (it = chunks_.begin(); it != std::prev(chunks_.end()); ++it) {
-    it->AppendResult(transliterator, &base);
-  }
-
+  std::string base = ExtendPrefix(transliterator).text;
   chunks_.back().AppendTrimedResult(transliterator, &base);
   // Get expanded from the last chunk
   const absl::btree_set<std::string> expanded =
@@ -296,11 +302,8 @@ std::string Composition::GetString() const {
     return std::string();
   }
 
-  std::string composition;
-  for (CharChunkList::const_iterator it = chunks_.begin(); it != chunks_.end();
-       ++it) {
-    it->AppendResult(Transliterators::LOCAL, &composition);
-  }
+  std::string composition = ExtendPrefix(Transliterators::LOCAL).text;
+  chunks_.back().AppendResult(Transliterators::LOCAL, &composition);
   return composition;
 }
 
@@ -321,52 +324,138 @@ void Composition::GetPreedit(size_t position, std::string *left,
   Util::Utf8SubString(composition, position + 1, std::string::npos, right);
 }
 
-// This function is essentially a const function, but it cannot be const because
-// it outputs a mutable CharChunkList::iterator.  Const version is provided
-// below.
 CharChunkList::iterator Composition::GetChunkAt(
     const size_t position, Transliterators::Transliterator transliterator,
     size_t *inner_position) {
+  size_t index;
+  const CharChunkList::const_iterator it =
+      FindChunk(position, transliterator, inner_position, &index);
+  // The caller may modify the returned chunk.
+  TruncatePrefix(index);
+  // Converts the const_iterator to an iterator.
+  return chunks_.erase(it, it);
+}
+
+CharChunkList::const_iterator Composition::GetChunkAt(
+    size_t position, Transliterators::Transliterator transliterator,
+    size_t *inner_position) const {
+  size_t index;
+  return FindChunk(position, transliterator, inner_position, &index);
+}
+
+CharChunkList::const_iterator Composition::FindChunk(
+    const size_t position, Transliterators::Transliterator transliterator,
+    size_t *inner_position, size_t *index) const {
   if (chunks_.empty()) {
     *inner_position = 0;
+    *index = 0;
     return chunks_.begin();
   }
 
+  size_t chunk_index = 0;
   size_t chunk_offset = 0;
+  CharChunkList::const_iterator it = chunks_.begin();
+  const std::vector<PrefixEnd> &ends = prefixes_[transliterator].ends;
+  if (!ends.empty()) {
+    // The first cached chunk whose end reaches the position.
+    const auto cached = std::lower_bound(
+        ends.begin(), ends.end(), position,
+        [](const PrefixEnd &end, size_t pos) { return end.length < pos; });
+    if (cached != ends.end()) {
+      *index = cached - ends.begin();
+      *inner_position = position - (*index == 0 ? 0 : ends[*index - 1].length);
+      return GetIterator(*index);
+    }
+    chunk_index = ends.size();
+    chunk_offset = ends.back().length;
+    it = GetIterator(chunk_index);
+  }
+
   size_t chunk_length = 0;
-  for (auto it = chunks_.begin(); it != chunks_.end(); ++it) {
+  for (; it != chunks_.end(); ++it, ++chunk_index) {
     chunk_length = it->GetLength(transliterator);
     if (chunk_offset + chunk_length < position) {
       chunk_offset += chunk_length;
       continue;
     }
     *inner_position = position - chunk_offset;
+    *index = chunk_index;
     return it;
   }
-  auto it = std::prev(chunks_.end());
   // Inner position here is the end of the last chunk.
   *inner_position = chunk_length;
-  return it;
-}
-
-CharChunkList::const_iterator Composition::GetChunkAt(
-    size_t position, Transliterators::Transliterator transliterator,
-    size_t *inner_position) const {
-  // This const_cast is safe as GetChunkAt() above doesn't mutate any members.
-  return const_cast<Composition *>(this)->GetChunkAt(position, transliterator,
-                                                     inner_position);
+  *index = chunks_.size() - 1;
+  return std::prev(chunks_.end());
 }
 
 size_t Composition::GetPosition(Transliterators::Transliterator transliterator,
                                 CharChunkList::const_iterator cur_it) const {
   size_t position = 0;
-  CharChunkList::const_iterator it;
-  for (it = chunks_.begin(); it != cur_it; ++it) {
+  CharChunkList::const_iterator it = chunks_.begin();
+  const std::vector<PrefixEnd> &ends = prefixes_[transliterator].ends;
+  if (!ends.empty()) {
+    const size_t index = GetIndex(cur_it);
+    if (index <= ends.size()) {
+      return index == 0 ? 0 : ends[index - 1].length;
+    }
+    position = ends.back().length;
+    it = GetIterator(ends.size());
+  }
+  for (; it != cur_it; ++it) {
     position += it->GetLength(transliterator);
   }
   return position;
 }
 
+size_t Composition::GetIndex(CharChunkList::const_iterator it) const {
+  // Iterators near the end are the common case.  Walking from the end is
+  // bounded by the distance, while std::distance from begin() is not.
+  size_t from_end = 0;
+  for (CharChunkList::const_iterator end_it = chunks_.end(); end_it != it;
+       --end_it) {
+    ++from_end;
+  }
+  return chunks_.size() - from_end;
+}
+
+CharChunkList::const_iterator Composition::GetIterator(size_t index) const {
+  DCHECK_LE(index, chunks_.size());
+  if (index < chunks_.size() / 2) {
+    return std::next(chunks_.begin(), index);
+  }
+  return std::prev(chunks_.end(), chunks_.size() - index);
+}
+
+const Composition::Prefix &Composition::ExtendPrefix(
+    const Transliterators::Transliterator transliterator) const {
+  Prefix &prefix = prefixes_[transliterator];
+  if (prefix.ends.empty()) {
+    prefix.text.clear();
+  }
+  if (chunks_.size() <= prefix.ends.size() + 1) {
+    return prefix;
+  }
+  size_t length = prefix.ends.empty() ? 0 : prefix.ends.back().length;
+  const CharChunkList::const_iterator last = std::prev(chunks_.end());
+  for (CharChunkList::const_iterator it = GetIterator(prefix.ends.size());
+       it != last; ++it) {
+    it->AppendResult(transliterator, &prefix.text);
+    length += it->GetLength(transliterator);
+    prefix.ends.push_back({prefix.text.size(), length});
+  }
+  return prefix;
+}
+
+void Composition::TruncatePrefix(size_t index) {
+  for (Prefix &prefix : prefixes_) {
+    if (index >= prefix.ends.size()) {
+      continue;
+    }
+    prefix.ends.resize(index);
+    prefix.text.resize(index == 0 ? 0 : prefix.ends.back().bytes);
+  }
+}
+
 // Return the iterator to the right side CharChunk at the `position`.
 // If the `position` is in the middle of a CharChunk, that CharChunk is split.
 CharChunkList::iterator Composition::MaybeSplitChunkAt(const size_t position) {
@@ -408,6 +497,7 @@ void Composition::CombinePendingChunks(CharChunkList::iterator it,
       return;
     }
 
+    TruncatePrefix(GetIndex(left_it));
     it->Combine(*left_it);
     chunks_.erase(left_it);
   }
@@ -416,6 +506,7 @@ void Composition::CombinePendingChunks(CharChunkList::iterator it,
 // Insert a chunk to the prev of it.
 CharChunkList::iterator Composition::InsertChunk(
     CharChunkList::const_iterator it) {
+  TruncatePrefix(GetIndex(it));
   return chunks_.insert(it, CharChunk(input_t12r_, table_));
 }
 
@@ -435,6 +526,7 @@ CharChunkList::iterator Composition::GetInsertionChunk(
 
   const CharChunkList::iterator left_it = std::prev(it);
   if (left_it->IsAppendable(input_t12r_, table_)) {
+    TruncatePrefix(GetIndex(left_it));
     return left_it;
   }
   return InsertChunk(it);
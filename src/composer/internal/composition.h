@@ -30,10 +30,12 @@
 #ifndef MOZC_COMPOSER_INTERNAL_COMPOSITION_H_
 #define MOZC_COMPOSER_INTERNAL_COMPOSITION_H_
 
+#include <array>
 #include <cstddef>
 #include <list>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "absl/container/btree_set.h"
 #include "absl/strings/str_format.h"
@@ -145,6 +147,10 @@ class Composition final {
 
   // Following methods are declared as public for unit test.
 
+  // NOTE: The methods returning a mutable CharChunkList::iterator assume that
+  // the caller modifies the returned CharChunk or the ones on its right only.
+  // See prefixes_ below.
+
   // Return the focused CharChunk iterator at the `position`,
   // and fill `inner_position` as the position inside the returned CharChunk.
   // ["a", "bc", "e"].GetChunkAt(2) returns "bc" and fills inner_position to 1,
@@ -213,12 +219,50 @@ class Composition final {
   }
 
  private:
+  struct PrefixEnd {
+    size_t bytes;   // Size of Prefix::text up to the chunk.
+    size_t length;  // Sum of the lengths up to the chunk.
+  };
+  struct Prefix {
+    std::string text;
+    std::vector<PrefixEnd> ends;
+  };
+
   std::string GetStringWithModes(Transliterators::Transliterator transliterator,
                                  TrimMode trim_mode) const;
 
+  // Returns the chunk at `position` as GetChunkAt() and its index in
+  // `index`.
+  CharChunkList::const_iterator FindChunk(
+      size_t position, Transliterators::Transliterator transliterator,
+      size_t *inner_position, size_t *index) const;
+
+  // Conversions between iterators and indices of chunks_.  They walk from
+  // the nearer end of the list.
+  size_t GetIndex(CharChunkList::const_iterator it) const;
+  CharChunkList::const_iterator GetIterator(size_t index) const;
+
+  // Makes the prefix of `transliterator` cover all the chunks but the last
+  // one, and returns it.
+  const Prefix &ExtendPrefix(
+      Transliterators::Transliterator transliterator) const;
+  // Drops the chunks from `index` from all the prefixes.  Must be called
+  // before the chunk at `index` or on its right is modified, inserted or
+  // erased.
+  void TruncatePrefix(size_t index);
+
   const Table *table_;
   CharChunkList chunks_;
   Transliterators::Transliterator input_t12r_;
+
+  // Concatenated results of the first Prefix::ends.size() chunks for each
+  // transliterator.  Key events usually edit only the tail of the
+  // composition, so the preedit, the queries and the transliterations are
+  // built from these and the last chunk without walking all the chunks.  A
+  // prefix is built on the first access with its transliterator.  The last
+  // chunk is never cached as its result depends on TrimMode.
+  mutable std::array<Prefix, Transliterators::NUM_OF_TRANSLITERATOR>
+      prefixes_;
 };
 
 }  // namespace composer
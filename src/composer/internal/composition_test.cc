@@ -36,6 +36,7 @@
 #include <vector>
 
 #include "absl/status/statusor.h"
+#include "absl/strings/match.h"
 #include "absl/strings/string_view.h"
 #include "composer/internal/char_chunk.h"
 #include "composer/internal/composition_input.h"
@@ -1704,5 +1705,114 @@ TEST_F(CompositionTest, IsToggleable) {
   EXPECT_FALSE(composition_.IsToggleable(0));
 }
 
+TEST_F(CompositionTest, EditInMiddle) {
+  // Edits before and after the tail must keep the results consistent with
+  // the chunks, which are concatenated here without Composition.
+  auto expected_string = [](const Composition& composition) {
+    std::string result;
+    for (const CharChunk& chunk : composition.chunks()) {
+      chunk.AppendResult(Transliterators::LOCAL, &result);
+    }
+    return result;
+  };
+  auto expected_length = [](const Composition& composition) {
+    size_t length = 0;
+    for (const CharChunk& chunk : composition.chunks()) {
+      length += chunk.GetLength(Transliterators::LOCAL);
+    }
+    return length;
+  };
+
+  table_.AddRule("a", "あ", "");
+  table_.AddRule("ka", "か", "");
+  table_.AddRule("ki", "き", "");
+  table_.AddRule("n", "ん", "");
+  table_.AddRule("nn", "ん", "");
+  table_.AddRule("na", "な", "");
+  composition_.SetInputMode(Transliterators::HIRAGANA);
+
+  size_t pos = InsertCharacters("kanaka", 0, composition_);
+  EXPECT_EQ(composition_.GetString(), "かなか");
+  EXPECT_EQ(composition_.GetLength(), 3);
+
+  // Insert in the middle after the prefix is built.
+  InsertCharacters("ki", 1, composition_);
+  EXPECT_EQ(composition_.GetString(), expected_string(composition_));
+  EXPECT_EQ(composition_.GetString(), "かきなか");
+  EXPECT_EQ(composition_.GetLength(), expected_length(composition_));
+
+  // Delete in the middle.
+  composition_.DeleteAt(2);
+  EXPECT_EQ(composition_.GetString(), "かきか");
+  EXPECT_EQ(composition_.GetLength(), expected_length(composition_));
+
+  // Change the transliterator of the leading chunks.
+  composition_.SetTransliterator(0, 1, Transliterators::FULL_KATAKANA);
+  EXPECT_EQ(composition_.GetString(), expected_string(composition_));
+  EXPECT_EQ(composition_.GetStringWithTrimMode(ASIS),
+            expected_string(composition_));
+
+  // Append at the end with a pending chunk.
+  pos = composition_.GetLength();
+  pos = InsertCharacters("n", pos, composition_);
+  EXPECT_EQ(composition_.GetStringWithTrimMode(ASIS),
+            expected_string(composition_));
+  EXPECT_TRUE(absl::EndsWith(composition_.GetStringWithTrimMode(FIX), "ん"));
+  EXPECT_EQ(composition_.GetLength(), expected_length(composition_));
+  EXPECT_EQ(composition_.ConvertPosition(pos, Transliterators::LOCAL,
+                                         Transliterators::RAW_STRING),
+            7);
+
+  composition_.Erase();
+  EXPECT_EQ(composition_.GetString(), "");
+  EXPECT_EQ(composition_.GetLength(), 0);
+  InsertCharacters("a", 0, composition_);
+  EXPECT_EQ(composition_.GetString(), "あ");
+}
+
+TEST_F(CompositionTest, TransliterateAfterEdit) {
+  table_.AddRule("a", "あ", "");
+  table_.AddRule("ka", "か", "");
+  table_.AddRule("ki", "き", "");
+  table_.AddRule("na", "な", "");
+  composition_.SetInputMode(Transliterators::HIRAGANA);
+
+  InsertCharacters("kanaka", 0, composition_);
+  EXPECT_EQ(composition_.GetStringWithTransliterator(Transliterators::HIRAGANA),
+            "かなか");
+  EXPECT_EQ(
+      composition_.GetStringWithTransliterator(Transliterators::HALF_ASCII),
+      "kanaka");
+  EXPECT_EQ(composition_.ConvertPosition(2, Transliterators::LOCAL,
+                                         Transliterators::HALF_ASCII),
+            4);
+
+  // Edits in the middle invalidate the cached results of all the
+  // transliterators.
+  InsertCharacters("ki", 1, composition_);
+  EXPECT_EQ(composition_.GetStringWithTransliterator(Transliterators::HIRAGANA),
+            "かきなか");
+  EXPECT_EQ(
+      composition_.GetStringWithTransliterator(Transliterators::HALF_ASCII),
+      "kakinaka");
+  EXPECT_EQ(
+      composition_.GetStringWithTransliterator(Transliterators::FULL_KATAKANA),
+      "カキナカ");
+  EXPECT_EQ(composition_.ConvertPosition(2, Transliterators::LOCAL,
+                                         Transliterators::HALF_ASCII),
+            4);
+  EXPECT_EQ(composition_.ConvertPosition(6, Transliterators::HALF_ASCII,
+                                         Transliterators::LOCAL),
+            3);
+
+  composition_.DeleteAt(0);
+  EXPECT_EQ(
+      composition_.GetStringWithTransliterator(Transliterators::HALF_ASCII),
+      "kinaka");
+  EXPECT_EQ(composition_.ConvertPosition(1, Transliterators::LOCAL,
+                                         Transliterators::HALF_ASCII),
+            2);
+}
+
 }  // namespace composer
 }  // namespace mozc
@@ -40,6 +40,8 @@
 #include <utility>
 #include <vector>
 
+#include "absl/algorithm/container.h"
+#include "absl/base/no_destructor.h"
 #include "absl/log/check.h"
 #include "absl/log/log.h"
 #include "absl/strings/match.h"
@@ -381,6 +383,7 @@ const Entry *Table::AddRuleWithAttributes(
   Entry *entry_ptr = entry.get();
   entries_.AddEntry(input, entry_ptr);
   entry_set_.insert(std::move(entry));
+  compiled_ = false;
 
   // Check if the input has a large capital character.
   // Invisible character is exception.
@@ -411,6 +414,7 @@ void Table::DeleteRule(const absl::string_view input) {
     DeleteEntry(old_entry);
   }
   entries_.DeleteEntry(input);
+  compiled_ = false;
 }
 
 bool Table::LoadFromString(const std::string &str) {
@@ -477,42 +481,67 @@ bool Table::LoadFromStream(std::istream *is) {
     }
   }
 
+  Compile();
   return true;
 }
 
+void Table::Compile() {
+  std::vector<std::pair<absl::string_view, const Entry *>> entries;
+  entries.reserve(entry_set_.size());
+  for (const std::unique_ptr<Entry> &entry : entry_set_) {
+    entries.emplace_back(entry->input(), entry.get());
+  }
+  compiled_entries_ = FlatTrie<const Entry *>(std::move(entries));
+  compiled_ = true;
+}
+
+absl::string_view Table::NormalizeInput(const absl::string_view input,
+                                        std::string *buffer) const {
+  // Util::LowerString() converts 'A'-'Z' and full width 'Ａ'-'Ｚ', which start
+  // with 0xEF in UTF-8.
+  if (case_sensitive_ || !absl::c_any_of(input, [](const char c) {
+        return ('A' <= c && c <= 'Z') || c == '\xEF';
+      })) {
+    return input;
+  }
+  buffer->assign(input.data(), input.size());
+  Util::LowerString(buffer);
+  return *buffer;
+}
+
 const Entry *Table::LookUp(const absl::string_view input) const {
+  std::string buffer;
+  const absl::string_view key = NormalizeInput(input, &buffer);
   const Entry *entry = nullptr;
-  if (case_sensitive_) {
-    entries_.LookUp(input, &entry);
+  if (compiled_) {
+    compiled_entries_.LookUp(key, &entry);
   } else {
-    std::string normalized_input(input);
-    Util::LowerString(&normalized_input);
-    entries_.LookUp(normalized_input, &entry);
+    entries_.LookUp(key, &entry);
   }
   return entry;
 }
 
 const Entry *Table::LookUpPrefix(const absl::string_view input,
                                  size_t *key_length, bool *fixed) const {
+  std::string buffer;
+  const absl::string_view key = NormalizeInput(input, &buffer);
   const Entry *entry = nullptr;
-  if (case_sensitive_) {
-    entries_.LookUpPrefix(input, &entry, key_length, fixed);
+  if (compiled_) {
+    compiled_entries_.LookUpPrefix(key, &entry, key_length, fixed);
   } else {
-    std::string normalized_input(input);
-    Util::LowerString(&normalized_input);
-    entries_.LookUpPrefix(normalized_input, &entry, key_length, fixed);
+    entries_.LookUpPrefix(key, &entry, key_length, fixed);
   }
   return entry;
 }
 
 void Table::LookUpPredictiveAll(const absl::string_view input,
                                 std::vector<const Entry *> *results) const {
-  if (case_sensitive_) {
-    entries_.LookUpPredictiveAll(input, results);
+  std::string buffer;
+  const absl::string_view key = NormalizeInput(input, &buffer);
+  if (compiled_) {
+    compiled_entries_.LookUpPredictiveAll(key, results);
   } else {
-    std::string normalized_input(input);
-    Util::LowerString(&normalized_input);
-    entries_.LookUpPredictiveAll(normalized_input, results);
+    entries_.LookUpPredictiveAll(key, results);
   }
 }
 
@@ -533,13 +562,12 @@ bool Table::HasNewChunkEntry(const absl::string_view input) const {
 }
 
 bool Table::HasSubRules(const absl::string_view input) const {
-  if (case_sensitive_) {
-    return entries_.HasSubTrie(input);
-  } else {
-    std::string normalized_input(input);
-    Util::LowerString(&normalized_input);
-    return entries_.HasSubTrie(normalized_input);
+  std::string buffer;
+  const absl::string_view key = NormalizeInput(input, &buffer);
+  if (compiled_) {
+    return compiled_entries_.HasSubTrie(key);
   }
+  return entries_.HasSubTrie(key);
 }
 
 void Table::DeleteEntry(const Entry *entry) { entry_set_.erase(entry); }
@@ -552,10 +580,7 @@ void Table::set_case_sensitive(const bool case_sensitive) {
 
 // static
 const Table &Table::GetDefaultTable() {
-  static Table *default_table = nullptr;
-  if (!default_table) {
-    default_table = new Table();
-  }
+  static const absl::NoDestructor<Table> default_table;
   return *default_table;
 }
 
@@ -42,6 +42,7 @@
 #include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
 #include "absl/strings/string_view.h"
+#include "base/container/flat_trie.h"
 #include "base/container/trie.h"
 #include "composer/internal/special_key.h"
 #include "protocol/commands.pb.h"
@@ -139,8 +140,20 @@ class Table final {
   bool LoadFromStream(std::istream *is);
   void DeleteEntry(const Entry *entry);
 
+  // Compiles entries_ into compiled_entries_.
+  void Compile();
+  // Returns `input` with its alphabets normalized to lower case unless the
+  // table is case sensitive.  `buffer` is used only if the input changes.
+  absl::string_view NormalizeInput(absl::string_view input,
+                                   std::string *buffer) const;
+
   using EntryTrie = Trie<const Entry *>;
   EntryTrie entries_;
+  // Flat copy of entries_ for lookups, compiled when rules are loaded from a
+  // file or a string.  Rules added or deleted individually afterwards are
+  // looked up in entries_ until the next load.
+  FlatTrie<const Entry *> compiled_entries_;
+  bool compiled_ = false;
   using EntrySet = absl::flat_hash_set<std::unique_ptr<Entry>>;
   EntrySet entry_set_;
 
@@ -157,6 +170,7 @@ class TableManager {
   ~TableManager() = default;
   // Return Table for the request and the config
   // TableManager has ownership of the return value;
+  // The returned table is compiled and cached per request and config.
   const Table *GetTable(const commands::Request &request,
                         const config::Config &config);
 
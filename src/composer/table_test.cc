@@ -906,6 +906,46 @@ TEST_F(TableTest, LoadFromString) {
   EXPECT_EQ(entry->pending(), "");
 }
 
+TEST_F(TableTest, AddRuleAfterLoadFromString) {
+  Table table;
+  table.LoadFromString("ka\t[KA]\nki\t[KI]\nn\t[N]\nnn\t[NN]\n");
+
+  size_t key_length = 0;
+  bool fixed = false;
+  const Entry *entry = table.LookUpPrefix("kaki", &key_length, &fixed);
+  ASSERT_NE(entry, nullptr);
+  EXPECT_EQ(entry->result(), "[KA]");
+  EXPECT_EQ(key_length, 2);
+  EXPECT_TRUE(fixed);
+  entry = table.LookUpPrefix("nk", &key_length, &fixed);
+  ASSERT_NE(entry, nullptr);
+  EXPECT_EQ(entry->result(), "[N]");
+  EXPECT_EQ(key_length, 1);
+  EXPECT_FALSE(fixed);
+  EXPECT_TRUE(table.HasSubRules("k"));
+  EXPECT_FALSE(table.HasSubRules("s"));
+
+  // Rules added or deleted after loading are reflected.
+  table.AddRule("sa", "[SA]", "");
+  table.DeleteRule("ki");
+  entry = table.LookUp("sa");
+  ASSERT_NE(entry, nullptr);
+  EXPECT_EQ(entry->result(), "[SA]");
+  EXPECT_EQ(table.LookUp("ki"), nullptr);
+  EXPECT_TRUE(table.HasSubRules("s"));
+
+  std::vector<const Entry *> results;
+  table.LookUpPredictiveAll("k", &results);
+  ASSERT_EQ(results.size(), 1);
+  EXPECT_EQ(results[0]->result(), "[KA]");
+
+  // Loading again compiles all the rules including the added one.
+  table.LoadFromString("ta\t[TA]\n");
+  EXPECT_NE(table.LookUp("sa"), nullptr);
+  EXPECT_NE(table.LookUp("ta"), nullptr);
+  EXPECT_NE(table.LookUp("KA"), nullptr);
+}
+
 TEST_F(TableTest, SpecialKeys) {
   {
     Table table;
@@ -66,6 +66,7 @@
         'character_form_manager.cc',
       ],
       'dependencies': [
+        '<(mozc_oss_src_dir)/base/absl.gyp:absl_synchronization',
         'config_handler',
         '<(mozc_oss_src_dir)/base/base.gyp:base',
         '<(mozc_oss_src_dir)/base/base.gyp:config_file_stream',
@@ -29,24 +29,28 @@
 
 #include "converter/connector.h"
 
+#include <atomic>
 #include <cstddef>
 #include <cstdint>
 #include <limits>
+#include <memory>
 #include <new>
 #include <optional>
 #include <string>
 #include <utility>
 #include <vector>
 
-#include "absl/algorithm/container.h"
 #include "absl/base/attributes.h"
 #include "absl/base/const_init.h"
+#include "absl/log/check.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/escaping.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
+#include "absl/types/span.h"
 #include "data_manager/data_manager.h"
+#include "storage/derived_data_cache.h"
 #include "storage/louds/simple_succinct_bit_vector_index.h"
 
 
@@ -54,8 +58,15 @@ namespace mozc {
 namespace {
 
 constexpr uint32_t kInvalidCacheKey = 0xFFFFFFFF;
+// Names of the cache stats, indexed by kCacheHitId and kCacheMissId.
+constexpr absl::string_view kCacheStatNames[] = {"ConnectorCacheHit",
+                                                 "ConnectorCacheMiss"};
+constexpr size_t kCacheHitId = 0;
+constexpr size_t kCacheMissId = 1;
 constexpr uint16_t kConnectorMagicNumber = 0xCDAB;
 constexpr uint8_t kInvalid1ByteCostValue = 255;
+// Chunk size of the bit vector indices of a row.
+constexpr int kRowIndexChunkSize = sizeof(uint32_t);
 
 inline uint32_t GetHashValue(uint16_t rid, uint16_t lid, uint32_t hash_mask) {
   return (3 * static_cast<uint32_t>(rid) + lid) & hash_mask;
@@ -70,6 +81,10 @@ inline uint32_t EncodeKey(uint16_t rid, uint16_t lid) {
   return (static_cast<uint32_t>(rid) << 16) | lid;
 }
 
+inline uint64_t EncodeCacheEntry(uint32_t key, int cost) {
+  return (static_cast<uint64_t>(key) << 32) | static_cast<uint32_t>(cost);
+}
+
 absl::Status IsMemoryAligned32(const void *ptr) {
   const auto addr = reinterpret_cast<std::uintptr_t>(ptr);
   const auto alignment = addr % 4;
@@ -148,6 +163,63 @@ void Connector::Row::Init(const uint8_t *chunk_bits, size_t chunk_bits_size,
   use_1byte_value_ = use_1byte_value;
 }
 
+bool Connector::Row::Init(const uint8_t *chunk_bits, size_t chunk_bits_size,
+                          const uint8_t *compact_bits, size_t compact_bits_size,
+                          const uint8_t *values, bool use_1byte_value,
+                          absl::Span<const int> *indices) {
+  // Each index has an entry for each chunk and a sentinel.
+  const size_t chunk_index_size =
+      (chunk_bits_size + kRowIndexChunkSize - 1) / kRowIndexChunkSize + 1;
+  const size_t compact_index_size =
+      (compact_bits_size + kRowIndexChunkSize - 1) / kRowIndexChunkSize + 1;
+  const absl::Span<const int> row_indices = *indices;
+  if (!ConsumeIndices(chunk_bits_size, compact_bits_size, indices)) {
+    return false;
+  }
+  CHECK(chunk_bits_index_.Init(chunk_bits, chunk_bits_size,
+                               row_indices.first(chunk_index_size), 0, 0));
+  CHECK(compact_bits_index_.Init(
+      compact_bits, compact_bits_size,
+      row_indices.subspan(chunk_index_size, compact_index_size), 0, 0));
+  values_ = values;
+  use_1byte_value_ = use_1byte_value;
+  return true;
+}
+
+void Connector::Row::AppendIndices(const uint8_t *chunk_bits,
+                                   size_t chunk_bits_size,
+                                   const uint8_t *compact_bits,
+                                   size_t compact_bits_size,
+                                   std::vector<int> *indices) {
+  using ::mozc::storage::louds::SimpleSuccinctBitVectorIndex;
+  for (const int value : SimpleSuccinctBitVectorIndex::BuildIndex(
+           chunk_bits, chunk_bits_size, kRowIndexChunkSize)) {
+    indices->push_back(value);
+  }
+  for (const int value : SimpleSuccinctBitVectorIndex::BuildIndex(
+           compact_bits, compact_bits_size, kRowIndexChunkSize)) {
+    indices->push_back(value);
+  }
+}
+
+bool Connector::Row::ConsumeIndices(size_t chunk_bits_size,
+                                    size_t compact_bits_size,
+                                    absl::Span<const int> *indices) {
+  using ::mozc::storage::louds::SimpleSuccinctBitVectorIndex;
+  for (const size_t bits_size : {chunk_bits_size, compact_bits_size}) {
+    // Each index has an entry for each chunk and a sentinel.
+    const size_t index_size =
+        (bits_size + kRowIndexChunkSize - 1) / kRowIndexChunkSize + 1;
+    if (indices->size() < index_size ||
+        !SimpleSuccinctBitVectorIndex::IsValidIndex(
+            bits_size, kRowIndexChunkSize, indices->first(index_size))) {
+      return false;
+    }
+    indices->remove_prefix(index_size);
+  }
+  return true;
+}
+
 std::optional<uint16_t> Connector::Row::GetValue(uint16_t index) const {
   int chunk_bit_position = index / 8;
   if (!chunk_bits_index_.Get(chunk_bit_position)) {
@@ -174,34 +246,44 @@ std::optional<uint16_t> Connector::Row::GetValue(uint16_t index) const {
 
 absl::StatusOr<Connector> Connector::CreateFromDataManager(
     const DataManager &data_manager) {
+  return CreateFromDataManager(data_manager, nullptr);
+}
+
+absl::StatusOr<Connector> Connector::CreateFromDataManager(
+    const DataManager &data_manager, storage::DerivedDataCache *cache) {
 #ifdef __ANDROID__
   constexpr int kCacheSize = 256;
 #else   // __ANDROID__
   constexpr int kCacheSize = 1024;
 #endif  // __ANDROID__
-  return Create(data_manager.GetConnectorData(), kCacheSize);
+  return Create(data_manager.GetConnectorData(), kCacheSize, cache);
 }
 
 absl::StatusOr<Connector> Connector::Create(absl::string_view connection_data,
                                             int cache_size) {
+  return Create(connection_data, cache_size, nullptr);
+}
+
+absl::StatusOr<Connector> Connector::Create(absl::string_view connection_data,
+                                            int cache_size,
+                                            storage::DerivedDataCache *cache) {
   Connector connector;
-  absl::Status status = connector.Init(connection_data, cache_size);
+  absl::Status status = connector.Init(connection_data, cache_size, cache);
   if (!status.ok()) {
     return status;
   }
   return connector;
 }
 
-absl::Status Connector::Init(absl::string_view connection_data,
-                             int cache_size) {
+absl::Status Connector::Init(absl::string_view connection_data, int cache_size,
+                             storage::DerivedDataCache *cache) {
   // Check if the cache_size is the power of 2.
   if ((cache_size & (cache_size - 1)) != 0) {
     return absl::InvalidArgumentError(absl::StrCat(
         "connector.cc: Cache size must be 2^n: size=", cache_size));
   }
   cache_hash_mask_ = cache_size - 1;
-  cache_key_.resize(cache_size);
-  cache_value_.resize(cache_size);
+  cache_ = std::make_unique<Cache>(cache_size, kCacheStatNames);
 
   absl::StatusOr<Metadata> metadata =
       ParseMetadata(connection_data.data(), connection_data.size());
@@ -259,7 +341,14 @@ absl::Status Connector::Init(absl::string_view connection_data,
 
   const size_t chunk_bits_size = metadata->ChunkBitsSize();
   const uint16_t rsize = metadata->rsize;
-  rows_.resize(rsize);
+  struct RowImage {
+    const uint8_t *chunk_bits;
+    const uint8_t *compact_bits;
+    size_t compact_bits_size;
+    const uint8_t *values;
+  };
+  std::vector<RowImage> row_images;
+  row_images.reserve(rsize);
   for (size_t i = 0; i < rsize; ++i) {
     // Each row is formatted as follows:
     // +-------------------+-------------+------------+------------+-----------+
@@ -293,10 +382,47 @@ absl::Status Connector::Init(absl::string_view connection_data,
     VALIDATE_ALIGNMENT(values);
     ptr += values_size;
 
-    rows_[i].Init(chunk_bits, chunk_bits_size, compact_bits, compact_bits_size,
-                  values, metadata->Use1ByteValue());
+    row_images.push_back({chunk_bits, compact_bits, compact_bits_size, values});
   }
   VALIDATE_SIZE(ptr, 0, "Data end");
+
+  rows_.resize(rsize);
+  if (cache != nullptr) {
+    // The indices of all the rows are stored in a section in the row order.
+    absl::Span<const int> indices = cache->GetOrBuild(
+        "connector/row_indices",
+        [&]() {
+          std::vector<int> indices;
+          for (const RowImage &image : row_images) {
+            Row::AppendIndices(image.chunk_bits, chunk_bits_size,
+                               image.compact_bits, image.compact_bits_size,
+                               &indices);
+          }
+          return indices;
+        },
+        [&](absl::Span<const int> indices) {
+          for (const RowImage &image : row_images) {
+            if (!Row::ConsumeIndices(chunk_bits_size, image.compact_bits_size,
+                                     &indices)) {
+              return false;
+            }
+          }
+          return indices.empty();
+        });
+    for (size_t i = 0; i < rsize; ++i) {
+      const RowImage &image = row_images[i];
+      CHECK(rows_[i].Init(image.chunk_bits, chunk_bits_size, image.compact_bits,
+                          image.compact_bits_size, image.values,
+                          metadata->Use1ByteValue(), &indices));
+    }
+  } else {
+    for (size_t i = 0; i < rsize; ++i) {
+      const RowImage &image = row_images[i];
+      rows_[i].Init(image.chunk_bits, chunk_bits_size, image.compact_bits,
+                    image.compact_bits_size, image.values,
+                    metadata->Use1ByteValue());
+    }
+  }
   ClearCache();
   return absl::Status();
 
@@ -308,16 +434,36 @@ absl::Status Connector::Init(absl::string_view connection_data,
 int Connector::GetTransitionCost(uint16_t rid, uint16_t lid) const {
   const uint32_t index = EncodeKey(rid, lid);
   const uint32_t bucket = GetHashValue(rid, lid, cache_hash_mask_);
-  if (cache_key_[bucket] == index) {
-    return cache_value_[bucket];
+  std::atomic<uint64_t> &entry = cache_->entries[bucket];
+  const uint64_t cached = entry.load(std::memory_order_relaxed);
+  if (static_cast<uint32_t>(cached >> 32) == index) {
+    cache_->stats.IncrementCountBy(kCacheHitId, 1);
+    return static_cast<int32_t>(static_cast<uint32_t>(cached));
   }
+  cache_->stats.IncrementCountBy(kCacheMissId, 1);
   const int value = LookupCost(rid, lid);
-  cache_key_[bucket] = index;
-  cache_value_[bucket] = value;
+  entry.store(EncodeCacheEntry(index, value), std::memory_order_relaxed);
   return value;
 }
 
-void Connector::ClearCache() { absl::c_fill(cache_key_, kInvalidCacheKey); }
+void Connector::ClearCache() {
+  for (std::atomic<uint64_t> &entry : cache_->entries) {
+    entry.store(EncodeCacheEntry(kInvalidCacheKey, 0),
+                std::memory_order_relaxed);
+  }
+}
+
+Connector::CacheStats Connector::GetCacheStats() const {
+  const usage_stats::MetricsSnapshot snapshot = cache_->stats.GetSnapshot();
+  const auto get_count = [&snapshot](size_t id) -> uint64_t {
+    const auto it = snapshot.counts.find(std::string(kCacheStatNames[id]));
+    return it == snapshot.counts.end() ? 0 : it->second;
+  };
+  return {
+      .hits = get_count(kCacheHitId),
+      .misses = get_count(kCacheMissId),
+  };
+}
 
 int Connector::LookupCost(uint16_t rid, uint16_t lid) const {
   std::optional<uint16_t> value = rows_[rid].GetValue(lid);
@@ -30,15 +30,21 @@
 #ifndef MOZC_CONVERTER_CONNECTOR_H_
 #define MOZC_CONVERTER_CONNECTOR_H_
 
+#include <atomic>
 #include <cstddef>
 #include <cstdint>
+#include <memory>
 #include <optional>
 #include <vector>
 
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
 #include "data_manager/data_manager.h"
+#include "storage/derived_data_cache.h"
 #include "storage/louds/simple_succinct_bit_vector_index.h"
+#include "usage_stats/metrics_registry.h"
 
 namespace mozc {
 
@@ -49,18 +55,35 @@ class Connector final {
   static absl::StatusOr<Connector> CreateFromDataManager(
       const DataManager &data_manager);
 
+  // Same as above, but the rank indices of the rows are obtained from `cache`
+  // so that they are shared among processes. `cache` needs to outlive the
+  // returned connector.
+  static absl::StatusOr<Connector> CreateFromDataManager(
+      const DataManager &data_manager, storage::DerivedDataCache *cache);
+
   static absl::StatusOr<Connector> Create(absl::string_view connection_data,
                                           int cache_size);
+  static absl::StatusOr<Connector> Create(absl::string_view connection_data,
+                                          int cache_size,
+                                          storage::DerivedDataCache *cache);
 
   int GetTransitionCost(uint16_t rid, uint16_t lid) const;
   int GetResolution() const { return resolution_; }
 
   void ClearCache();
 
+  // Number of the lookups of GetTransitionCost() served from the cache.
+  struct CacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+  };
+  CacheStats GetCacheStats() const;
+
  private:
   class Row;
 
-  absl::Status Init(absl::string_view connection_data, int cache_size);
+  absl::Status Init(absl::string_view connection_data, int cache_size,
+                    storage::DerivedDataCache *cache);
 
   int LookupCost(uint16_t rid, uint16_t lid) const;
 
@@ -68,8 +91,21 @@ class Connector final {
   const uint16_t *default_cost_ = nullptr;
   int resolution_ = 0;
   uint32_t cache_hash_mask_ = 0;
-  mutable std::vector<uint32_t> cache_key_;
-  mutable std::vector<int> cache_value_;
+
+  // GetTransitionCost() is called concurrently by the conversions of different
+  // sessions. Each entry packs the key in the upper 32 bits and the cost in
+  // the lower 32 bits, so that a lookup never sees the key of one entry with
+  // the cost of another.
+  // The hits and misses are counted in a MetricsRegistry, whose counts are
+  // sharded per thread, so that the lookups from different threads don't
+  // contend on the same counter.
+  struct Cache {
+    Cache(size_t size, absl::Span<const absl::string_view> stat_names)
+        : entries(size), stats(stat_names) {}
+    std::vector<std::atomic<uint64_t>> entries;
+    usage_stats::MetricsRegistry stats;
+  };
+  std::unique_ptr<Cache> cache_;
 };
 
 class Connector::Row final {
@@ -81,6 +117,22 @@ class Connector::Row final {
   void Init(const uint8_t *chunk_bits, size_t chunk_bits_size,
             const uint8_t *compact_bits, size_t compact_bits_size,
             const uint8_t *values, bool use_1byte_value);
+  // Initializes the row with the indices built by AppendIndices(), consuming
+  // them from the front of `indices`. Returns false if `indices` is too short
+  // or broken.
+  bool Init(const uint8_t *chunk_bits, size_t chunk_bits_size,
+            const uint8_t *compact_bits, size_t compact_bits_size,
+            const uint8_t *values, bool use_1byte_value,
+            absl::Span<const int> *indices);
+  // Appends the rank indices of the bit vectors of a row to `indices`.
+  static void AppendIndices(const uint8_t *chunk_bits, size_t chunk_bits_size,
+                            const uint8_t *compact_bits,
+                            size_t compact_bits_size,
+                            std::vector<int> *indices);
+  // Removes the indices of a row from the front of `indices`. Returns false if
+  // they are not valid for the bit vectors of the given sizes.
+  static bool ConsumeIndices(size_t chunk_bits_size, size_t compact_bits_size,
+                             absl::Span<const int> *indices);
   // Returns the value in the row if found.
   std::optional<uint16_t> GetValue(uint16_t index) const;
 
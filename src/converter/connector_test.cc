@@ -92,6 +92,23 @@ TEST(ConnectorTest, CompareWithRawData) {
   }
 }
 
+TEST(ConnectorTest, CacheStats) {
+  const std::string path = testing::GetSourceFileOrDie(
+      {MOZC_SRC_COMPONENTS("data_manager"), "testing", "connection.data"});
+  absl::StatusOr<Mmap> cmmap = Mmap::Map(path);
+  ASSERT_OK(cmmap) << cmmap.status();
+  absl::StatusOr<Connector> connector =
+      Connector::Create(cmmap->string_view(), 256);
+  ASSERT_OK(connector);
+
+  connector->GetTransitionCost(1, 2);
+  connector->GetTransitionCost(1, 2);
+  connector->GetTransitionCost(3, 4);
+  const Connector::CacheStats stats = connector->GetCacheStats();
+  EXPECT_EQ(stats.hits, 1);
+  EXPECT_EQ(stats.misses, 2);
+}
+
 TEST(ConnectorTest, BrokenData) {
   const std::string path = testing::GetSourceFileOrDie(
       {MOZC_SRC_COMPONENTS("data_manager"), "testing", "connection.data"});
@@ -44,16 +44,24 @@
 #include "absl/base/optimization.h"
 #include "absl/log/check.h"
 #include "absl/log/log.h"
+#include "absl/strings/numbers.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
 #include "absl/types/span.h"
+#include "base/clock.h"
+#include "base/hash.h"
+#include "base/trace.h"
 #include "base/util.h"
 #include "base/vlog.h"
 #include "composer/composer.h"
 #include "converter/history_reconstructor.h"
 #include "converter/immutable_converter_interface.h"
+#include "converter/learning_queue.h"
 #include "converter/reverse_converter.h"
 #include "converter/segments.h"
+#include "dictionary/dictionary_interface.h"
 #include "dictionary/pos_matcher.h"
 #include "dictionary/suppression_dictionary.h"
 #include "engine/modules.h"
@@ -71,6 +79,20 @@ using ::mozc::usage_stats::UsageStats;
 
 constexpr size_t kErrorIndex = static_cast<size_t>(-1);
 
+// The number of the results of StartConversion() and StartPrediction() kept in
+// the result cache. Each entry holds up to a few hundred candidates.
+constexpr size_t kResultCacheSize = 32;
+
+// The number of the results of the learning kept until the next call of the
+// converter copies them back to the committed Segments. A session reads its
+// result at the next key event, so a few entries are enough even when several
+// sessions commit at once.
+constexpr size_t kLearnedResultsSize = 16;
+
+// RevertEntry::id of the placeholder for the learning in progress. The key is
+// the id of the learning.
+constexpr uint16_t kLearningRevertId = 3;
+
 size_t GetSegmentIndex(const Segments *segments, size_t segment_index) {
   const size_t history_segments_size = segments->history_segments_size();
   const size_t result = history_segments_size + segment_index;
@@ -150,7 +172,9 @@ Converter::Converter(
       suppression_dictionary_(*modules_->GetSuppressionDictionary()),
       history_reconstructor_(*modules_->GetPosMatcher()),
       reverse_converter_(*immutable_converter_),
-      general_noun_id_(pos_matcher_.GetGeneralNounId()) {
+      general_noun_id_(pos_matcher_.GetGeneralNounId()),
+      result_cache_(kResultCacheSize),
+      learned_results_(kLearnedResultsSize) {
   DCHECK(immutable_converter_);
   predictor_ = predictor_factory(*modules_, this, immutable_converter_.get());
   rewriter_ = rewriter_factory(*modules_);
@@ -160,6 +184,7 @@ Converter::Converter(
 
 bool Converter::StartConversion(const ConversionRequest &request,
                                 Segments *segments) const {
+  ScopedTraceSpan span("Converter::StartConversion");
   DCHECK_EQ(request.request_type(), ConversionRequest::CONVERSION);
 
   absl::string_view key = request.key();
@@ -167,8 +192,22 @@ bool Converter::StartConversion(const ConversionRequest &request,
     return false;
   }
 
+  ApplyPendingLearning(segments);
+  absl::ReaderMutexLock l(&user_data_mutex_);
   SetKey(segments, key);
-  ApplyConversion(segments, request);
+  const std::optional<uint64_t> cache_key =
+      GetResultCacheKey(request, *segments);
+  uint64_t cache_generation = 0;
+  if (cache_key.has_value() &&
+      LookupResultCache(*cache_key, segments, &cache_generation)) {
+    UsageStats::IncrementCount("ConversionCacheHit");
+    return IsValidSegments(request, *segments);
+  }
+  ApplyConversionLocked(segments, request);
+  if (cache_key.has_value()) {
+    UsageStats::IncrementCount("ConversionCacheMiss");
+    InsertResultCache(*cache_key, cache_generation, *segments);
+  }
   return IsValidSegments(request, *segments);
 }
 
@@ -180,6 +219,9 @@ bool Converter::StartReverseConversion(Segments *segments,
   }
   SetKey(segments, key);
 
+  // The reverse conversion populates the reverse lookup cache of the system
+  // dictionary, which is shared by all the sessions.
+  absl::WriterMutexLock l(&user_data_mutex_);
   return reverse_converter_.ReverseConvert(key, segments);
 }
 
@@ -233,14 +275,30 @@ bool ValidateConversionRequestForPrediction(const ConversionRequest &request) {
 
 bool Converter::StartPrediction(const ConversionRequest &request,
                                 Segments *segments) const {
+  ScopedTraceSpan span("Converter::StartPrediction");
   DCHECK(ValidateConversionRequestForPrediction(request));
+  // The prediction doesn't wait for the pending learning. The predictors see
+  // the pending commits through AddPendingLearning(), while the rewriters see
+  // them after the learning.
+  ApplyLearnedResults(segments);
+  absl::ReaderMutexLock l(&user_data_mutex_);
 
   absl::string_view key = request.key();
+  // The cache is used only when the segments are reset, as otherwise the
+  // predictor extends the current candidates.
+  std::optional<uint64_t> cache_key;
   if (ShouldSetKeyForPrediction(key, *segments)) {
     SetKey(segments, key);
+    cache_key = GetResultCacheKey(request, *segments);
   }
   DCHECK_EQ(segments->conversion_segments_size(), 1);
   DCHECK_EQ(segments->conversion_segment(0).key(), key);
+  uint64_t cache_generation = 0;
+  if (cache_key.has_value() &&
+      LookupResultCache(*cache_key, segments, &cache_generation)) {
+    UsageStats::IncrementCount("PredictionCacheHit");
+    return IsValidSegments(request, *segments);
+  }
 
   if (!predictor_->PredictForRequest(request, segments)) {
     // Prediction can fail for keys like "12". Even in such cases, rewriters
@@ -265,11 +323,19 @@ bool Converter::StartPrediction(const ConversionRequest &request,
     MaybeSetConsumedKeySizeToSegment(Util::CharsLen(key),
                                      segments->mutable_conversion_segment(0));
   }
+  if (cache_key.has_value()) {
+    UsageStats::IncrementCount("PredictionCacheMiss");
+    InsertResultCache(*cache_key, cache_generation, *segments);
+  }
   return IsValidSegments(request, *segments);
 }
 
 void Converter::FinishConversion(const ConversionRequest &request,
                                  Segments *segments) const {
+  // The commit doesn't wait for the pending learning either. The learning of
+  // the previous commit is applied to the copy of `segments` by the task
+  // below, which runs after it.
+  ApplyLearnedResults(segments);
   CommitUsageStats(segments, segments->history_segments_size(),
                    segments->conversion_segments_size());
 
@@ -287,10 +353,55 @@ void Converter::FinishConversion(const ConversionRequest &request,
     }
   }
 
+  // The learning runs on the background thread so that the commit doesn't
+  // wait for the updates of the user history. It works on a copy of the
+  // segments, and the result is copied back to `segments` by the next call of
+  // ApplyLearnedResults(). Until then, the predictors look up the commit as a
+  // pending learning. The other readers of the learned data wait for the
+  // learning.
+  const uint64_t learning_id = next_learning_id_++;
+  predictor_->AddPendingLearning(learning_id, request, *segments);
+  // Drops the results looked up without the pending learning. This must
+  // follow AddPendingLearning(), as a lookup between the two would otherwise
+  // cache a result without the commit.
+  ClearResultCache();
+  learning_queue_.Push([this, learning_id, request,
+                        learning_segments = Segments(*segments)]() mutable {
+    ScopedTraceSpan span("Converter::FinishConversion::Learn");
+    // The learning of the previous commit has finished.
+    ApplyLearnedResults(&learning_segments);
+    learning_segments.clear_revert_entries();
+    {
+      absl::WriterMutexLock l(&user_data_mutex_);
+      rewriter_->Finish(request, &learning_segments);
+      predictor_->Finish(request, &learning_segments);
+      predictor_->RemovePendingLearning(learning_id);
+      // Drops the results looked up with the pending learning.
+      ClearResultCache();
+    }
+    MakeHistorySegments(&learning_segments);
+
+    auto result = std::make_shared<LearnedResult>();
+    for (const Segment &segment : learning_segments) {
+      result->history_segments.push_back(segment);
+    }
+    for (size_t i = 0; i < learning_segments.revert_entries_size(); ++i) {
+      result->revert_entries.push_back(learning_segments.revert_entry(i));
+    }
+    absl::MutexLock l(&learned_results_mutex_);
+    learned_results_.Insert(learning_id, std::move(result));
+    last_learned_id_.store(learning_id, std::memory_order_release);
+  });
+
   segments->clear_revert_entries();
-  rewriter_->Finish(request, segments);
-  predictor_->Finish(request, segments);
+  Segments::RevertEntry *entry = segments->push_back_revert_entry();
+  entry->id = kLearningRevertId;
+  entry->key = absl::StrCat(learning_id);
+  MakeHistorySegments(segments);
+}
 
+// static
+void Converter::MakeHistorySegments(Segments *segments) {
   // Remove the front segments except for some segments which will be
   // used as history segments.
   const int start_index = std::max<int>(
@@ -305,6 +416,76 @@ void Converter::FinishConversion(const ConversionRequest &request,
   }
 }
 
+void Converter::ApplyPendingLearning(Segments *segments) const {
+  learning_queue_.Wait();
+  ApplyLearnedResults(segments);
+}
+
+void Converter::ApplyLearnedResults(Segments *segments) const {
+  std::vector<Segments::RevertEntry> revert_entries;
+  bool has_placeholder = false;
+  for (size_t i = 0; i < segments->revert_entries_size(); ++i) {
+    const Segments::RevertEntry &entry = segments->revert_entry(i);
+    if (entry.id != kLearningRevertId) {
+      revert_entries.push_back(entry);
+      continue;
+    }
+    has_placeholder = true;
+    uint64_t learning_id = 0;
+    if (!absl::SimpleAtoi(entry.key, &learning_id)) {
+      continue;
+    }
+    // Loaded before the lookup, as the result is inserted before the id is
+    // updated.
+    const bool learned =
+        learning_id <= last_learned_id_.load(std::memory_order_acquire);
+    std::shared_ptr<const LearnedResult> result;
+    {
+      absl::MutexLock l(&learned_results_mutex_);
+      const auto *cached = learned_results_.LookupWithoutInsert(learning_id);
+      if (cached != nullptr) {
+        result = *cached;
+      }
+      learned_results_.Erase(learning_id);
+    }
+    if (result == nullptr) {
+      if (!learned) {
+        // Still in progress. The placeholder is kept for the later calls.
+        revert_entries.push_back(entry);
+      }
+      // Otherwise, evicted by the learning of the other sessions. The learning
+      // itself has been done, but it can't be reverted.
+      continue;
+    }
+    revert_entries.insert(revert_entries.end(), result->revert_entries.begin(),
+                          result->revert_entries.end());
+
+    // The history segments are replaced only when they are still the ones
+    // committed, e.g., not reconstructed from the preceding text.
+    const size_t history_size = segments->history_segments_size();
+    bool same_history = history_size == result->history_segments.size();
+    for (size_t j = 0; same_history && j < history_size; ++j) {
+      const Segment &current = segments->history_segment(j);
+      const Segment &learned = result->history_segments[j];
+      same_history = current.candidates_size() == learned.candidates_size() &&
+                     (current.candidates_size() == 0 ||
+                      current.candidate(0).value == learned.candidate(0).value);
+    }
+    if (same_history) {
+      for (size_t j = 0; j < history_size; ++j) {
+        *segments->mutable_history_segment(j) = result->history_segments[j];
+      }
+    }
+  }
+  if (!has_placeholder) {
+    return;
+  }
+  segments->clear_revert_entries();
+  for (Segments::RevertEntry &entry : revert_entries) {
+    *segments->push_back_revert_entry() = std::move(entry);
+  }
+}
+
 void Converter::CancelConversion(Segments *segments) const {
   segments->clear_conversion_segments();
 }
@@ -312,11 +493,16 @@ void Converter::CancelConversion(Segments *segments) const {
 void Converter::ResetConversion(Segments *segments) const { segments->Clear(); }
 
 void Converter::RevertConversion(Segments *segments) const {
+  ApplyPendingLearning(segments);
   if (segments->revert_entries_size() == 0) {
     return;
   }
-  rewriter_->Revert(segments);
-  predictor_->Revert(segments);
+  ClearResultCache();
+  {
+    absl::WriterMutexLock l(&user_data_mutex_);
+    rewriter_->Revert(segments);
+    predictor_->Revert(segments);
+  }
   segments->clear_revert_entries();
 }
 
@@ -327,6 +513,9 @@ bool Converter::DeleteCandidateFromHistory(const Segments &segments,
   const Segment &segment = segments.segment(segment_index);
   DCHECK(segment.is_valid_index(candidate_index));
   const Segment::Candidate &candidate = segment.candidate(candidate_index);
+  learning_queue_.Wait();
+  ClearResultCache();
+  absl::WriterMutexLock l(&user_data_mutex_);
   bool result = false;
   result |=
       rewriter_->ClearHistoryEntry(segments, segment_index, candidate_index);
@@ -337,7 +526,9 @@ bool Converter::DeleteCandidateFromHistory(const Segments &segments,
 
 bool Converter::ReconstructHistory(
     Segments *segments, const absl::string_view preceding_text) const {
+  learning_queue_.Wait();
   segments->Clear();
+  absl::ReaderMutexLock l(&user_data_mutex_);
   return history_reconstructor_.ReconstructHistory(preceding_text, segments);
 }
 
@@ -407,11 +598,13 @@ bool Converter::CommitPartialSuggestionSegmentValue(
 
 bool Converter::FocusSegmentValue(Segments *segments, size_t segment_index,
                                   int candidate_index) const {
+  ApplyPendingLearning(segments);
   segment_index = GetSegmentIndex(segments, segment_index);
   if (segment_index == kErrorIndex) {
     return false;
   }
 
+  absl::ReaderMutexLock l(&user_data_mutex_);
   return rewriter_->Focus(segments, segment_index, candidate_index);
 }
 
@@ -466,6 +659,16 @@ bool Converter::ResizeSegments(Segments *segments,
                                const ConversionRequest &request,
                                size_t start_segment_index,
                                absl::Span<const uint8_t> new_size_array) const {
+  ApplyPendingLearning(segments);
+  absl::ReaderMutexLock l(&user_data_mutex_);
+  return ResizeSegmentsLocked(segments, request, start_segment_index,
+                              new_size_array);
+}
+
+bool Converter::ResizeSegmentsLocked(
+    Segments *segments, const ConversionRequest &request,
+    size_t start_segment_index,
+    absl::Span<const uint8_t> new_size_array) const {
   if (request.request_type() != ConversionRequest::CONVERSION) {
     return false;
   }
@@ -535,12 +738,19 @@ bool Converter::ResizeSegments(Segments *segments,
 
   segments->set_resized(true);
 
-  ApplyConversion(segments, request);
+  ApplyConversionLocked(segments, request);
   return true;
 }
 
 void Converter::ApplyConversion(Segments *segments,
                                 const ConversionRequest &request) const {
+  ApplyPendingLearning(segments);
+  absl::ReaderMutexLock l(&user_data_mutex_);
+  ApplyConversionLocked(segments, request);
+}
+
+void Converter::ApplyConversionLocked(Segments *segments,
+                                      const ConversionRequest &request) const {
   if (!immutable_converter_->ConvertForRequest(request, segments)) {
     // Conversion can fail for keys like "12". Even in such cases, rewriters
     // (e.g., number and variant rewriters) can populate some candidates.
@@ -623,8 +833,8 @@ void Converter::RewriteAndSuppressCandidates(const ConversionRequest &request,
   if (std::optional<RewriterInterface::ResizeSegmentsRequest> resize_request =
           rewriter_->CheckResizeSegmentsRequest(request, *segments);
       resize_request.has_value()) {
-    if (ResizeSegments(segments, request, resize_request->segment_index,
-                       resize_request->segment_sizes)) {
+    if (ResizeSegmentsLocked(segments, request, resize_request->segment_index,
+                             resize_request->segment_sizes)) {
       // If the segments are resized, ResizeSegments recursively executed
       // RewriteAndSuppressCandidates with resized segments. No need to execute
       // them again.
@@ -714,17 +924,25 @@ void Converter::CommitUsageStats(const Segments *segments,
 }
 
 bool Converter::Reload() {
+  // The user dictionary is reloaded asynchronously. The results converted
+  // before the reload completes are invalidated by its generation in the cache
+  // key.
+  learning_queue_.Wait();
+  ClearResultCache();
   if (modules()->GetUserDictionary()) {
     modules()->GetUserDictionary()->Reload();
   }
-  return rewriter()->Reload() && predictor()->Reload();
+  absl::WriterMutexLock l(&user_data_mutex_);
+  return rewriter_->Reload() && predictor_->Reload();
 }
 
 bool Converter::Sync() {
   if (modules()->GetUserDictionary()) {
     modules()->GetUserDictionary()->Sync();
   }
-  return rewriter()->Sync() && predictor()->Sync();
+  learning_queue_.Wait();
+  absl::WriterMutexLock l(&user_data_mutex_);
+  return rewriter_->Sync() && predictor_->Sync();
 }
 
 bool Converter::Wait() {
@@ -734,4 +952,149 @@ bool Converter::Wait() {
   return predictor()->Wait();
 }
 
+void Converter::ClearResultCache() const {
+  absl::MutexLock l(&result_cache_mutex_);
+  result_cache_.Clear();
+  ++result_cache_generation_;
+}
+
+void Converter::ClearUserHistory() {
+  learning_queue_.Wait();
+  ClearResultCache();
+  absl::WriterMutexLock l(&user_data_mutex_);
+  rewriter_->Clear();
+}
+
+bool Converter::ClearUserPrediction() {
+  learning_queue_.Wait();
+  ClearResultCache();
+  absl::WriterMutexLock l(&user_data_mutex_);
+  return predictor_->ClearAllHistory();
+}
+
+bool Converter::ClearUnusedUserPrediction() {
+  learning_queue_.Wait();
+  ClearResultCache();
+  absl::WriterMutexLock l(&user_data_mutex_);
+  return predictor_->ClearUnusedHistory();
+}
+
+std::optional<uint64_t> Converter::GetResultCacheKey(
+    const ConversionRequest &request, const Segments &segments) const {
+  const ConversionRequest::Options &options = request.options();
+  // The request and the config are too large to be fingerprinted for each
+  // conversion, so the results are cached only when the caller provides
+  // their fingerprint.
+  if (options.settings_fingerprint == 0) {
+    return std::nullopt;
+  }
+  const composer::ComposerData &composer = request.composer();
+  if (!composer.GetHandwritingCompositions().empty()) {
+    return std::nullopt;
+  }
+  if (!rewriter_->IsDeterministic(request, segments)) {
+    return std::nullopt;
+  }
+
+  // Variable length fields are prefixed by their length so that different
+  // requests never result in the same string.
+  std::string buffer;
+  auto append = [&buffer](absl::string_view field) {
+    absl::StrAppend(&buffer, field.size(), ":", field);
+  };
+
+  const int flags = options.use_actual_converter_for_realtime_conversion |
+                    options.skip_slow_rewriters << 1 |
+                    options.create_partial_candidates << 2 |
+                    options.enable_user_history_for_conversion << 3 |
+                    options.kana_modifier_insensitive_conversion << 4 |
+                    options.use_already_typing_corrected_key << 5;
+  absl::StrAppend(
+      &buffer, options.settings_fingerprint, ",",
+      static_cast<int>(options.request_type), ",",
+      static_cast<int>(options.composer_key_selection), ",",
+      options.max_conversion_candidates_size, ",",
+      options.max_user_history_prediction_candidates_size, ",",
+      options.max_user_history_prediction_candidates_size_for_zero_query, ",",
+      options.max_dictionary_prediction_candidates_size, ",", flags, ",");
+  append(request.key());
+
+  // Rewriters and predictors also look at the raw input, e.g., for the
+  // expansion of the trailing romaji. The transliterations follow from the
+  // raw input, the input mode and the table in the config.
+  absl::StrAppend(&buffer, static_cast<int>(composer.GetInputMode()), ",",
+                  composer.GetCursor(), ",");
+  append(composer.GetRawString());
+  append(composer.GetStringForPreedit());
+  append(composer.source_text());
+
+  absl::StrAppend(&buffer, static_cast<int>(segments.resized()), ",",
+                  segments.history_segments_size(), ",");
+  for (const Segment &segment : segments.history_segments()) {
+    absl::StrAppend(&buffer, static_cast<int>(segment.segment_type()), ",");
+    append(segment.key());
+    if (segment.candidates_size() == 0) {
+      continue;
+    }
+    const Segment::Candidate &candidate = segment.candidate(0);
+    append(candidate.key);
+    append(candidate.value);
+    append(candidate.content_key);
+    append(candidate.content_value);
+    absl::StrAppend(&buffer, candidate.lid, ",", candidate.rid, ",",
+                    candidate.attributes, ",");
+  }
+
+  if (const dictionary::UserDictionaryInterface *user_dictionary =
+          modules_->GetUserDictionary();
+      user_dictionary != nullptr) {
+    absl::StrAppend(&buffer, user_dictionary->generation(), ",");
+  }
+
+  // Some rewriters depend on the current time, e.g., "いま" is converted to the
+  // current time in minutes. Hence the results expire every minute.
+  absl::StrAppend(&buffer, absl::ToUnixSeconds(Clock::GetAbslTime()) / 60);
+
+  return Fingerprint(buffer);
+}
+
+bool Converter::LookupResultCache(uint64_t cache_key, Segments *segments,
+                                  uint64_t *generation) const {
+  std::shared_ptr<const CachedResult> result;
+  {
+    absl::MutexLock l(&result_cache_mutex_);
+    *generation = result_cache_generation_;
+    const std::shared_ptr<const CachedResult> *value =
+        result_cache_.Lookup(cache_key);
+    if (value == nullptr) {
+      return false;
+    }
+    result = *value;
+  }
+  segments->clear_conversion_segments();
+  for (const Segment &segment : result->conversion_segments) {
+    *segments->add_segment() = segment;
+  }
+  segments->set_resized(result->resized);
+  return true;
+}
+
+void Converter::InsertResultCache(uint64_t cache_key, uint64_t generation,
+                                  const Segments &segments) const {
+  auto result = std::make_shared<CachedResult>();
+  result->conversion_segments.reserve(segments.conversion_segments_size());
+  for (const Segment &segment : segments.conversion_segments()) {
+    result->conversion_segments.push_back(segment);
+  }
+  result->resized = segments.resized();
+
+  absl::MutexLock l(&result_cache_mutex_);
+  if (generation != result_cache_generation_) {
+    // The cache was cleared while the result was computed, which may not
+    // reflect the commit that cleared it.
+    return;
+  }
+  result_cache_.Insert(cache_key, std::move(result));
+}
+
 }  // namespace mozc
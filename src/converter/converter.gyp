@@ -40,6 +40,7 @@
         '<(gen_out_mozc_dir)/dictionary/pos_matcher_impl.inc',
         'converter.cc',
         'history_reconstructor.cc',
+        'learning_queue.cc',
         'reverse_converter.cc',
       ],
       'dependencies': [
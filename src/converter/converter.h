@@ -30,19 +30,25 @@
 #ifndef MOZC_CONVERTER_CONVERTER_H_
 #define MOZC_CONVERTER_CONVERTER_H_
 
+#include <atomic>
 #include <cstddef>
 #include <cstdint>
 #include <functional>
 #include <limits>
 #include <memory>
+#include <optional>
 #include <string>
+#include <vector>
 
 #include "absl/base/attributes.h"
+#include "absl/base/thread_annotations.h"
 #include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
 #include "absl/types/span.h"
 #include "converter/converter_interface.h"
 #include "converter/history_reconstructor.h"
 #include "converter/immutable_converter_interface.h"
+#include "converter/learning_queue.h"
 #include "converter/reverse_converter.h"
 #include "converter/segments.h"
 #include "dictionary/pos_matcher.h"
@@ -51,6 +57,7 @@
 #include "prediction/predictor_interface.h"
 #include "request/conversion_request.h"
 #include "rewriter/rewriter_interface.h"
+#include "storage/lru_cache.h"
 #include "testing/friend_test.h"
 
 namespace mozc {
@@ -137,12 +144,34 @@ class Converter final : public ConverterInterface {
   // Synchronizes internal data, e.g., user dictionary, etc.
   bool Sync();
 
-  // Waits for pending operations executed in different threads.
+  // Waits for pending operations executed in different threads, including the
+  // learning started by FinishConversion().
   bool Wait();
 
-  prediction::PredictorInterface *predictor() const { return predictor_.get(); }
+  // Drops the cached results of StartConversion() and StartPrediction().
+  // Must be called when the learned data that the rewriters and the predictors
+  // depend on is modified outside of the converter, e.g., on clearing the user
+  // history.
+  void ClearResultCache() const;
+
+  // Clears the history learned by the rewriters.
+  void ClearUserHistory();
+  // Clears all or unused history learned by the predictors.
+  bool ClearUserPrediction();
+  bool ClearUnusedUserPrediction();
+
+  // The accessors below wait for the learning started by FinishConversion()
+  // so that the callers see (or clear) the learned data. They are not
+  // synchronized with the conversions of the other threads.
+  prediction::PredictorInterface *predictor() const {
+    learning_queue_.Wait();
+    return predictor_.get();
+  }
 
-  RewriterInterface *rewriter() const { return rewriter_.get(); }
+  RewriterInterface *rewriter() const {
+    learning_queue_.Wait();
+    return rewriter_.get();
+  }
 
   const ImmutableConverterInterface *immutable_converter() const {
     return immutable_converter_.get();
@@ -179,7 +208,19 @@ class Converter final : public ConverterInterface {
 
   // Rewrites and applies the suppression dictionary.
   void RewriteAndSuppressCandidates(const ConversionRequest &request,
-                                    Segments *segments) const;
+                                    Segments *segments) const
+      ABSL_SHARED_LOCKS_REQUIRED(user_data_mutex_);
+
+  // ResizeSegments() and ApplyConversion() without taking the locks. The
+  // pending learning must have been applied by the caller.
+  bool ResizeSegmentsLocked(Segments *segments,
+                            const ConversionRequest &request,
+                            size_t start_segment_index,
+                            absl::Span<const uint8_t> new_size_array) const
+      ABSL_SHARED_LOCKS_REQUIRED(user_data_mutex_);
+  void ApplyConversionLocked(Segments *segments,
+                             const ConversionRequest &request) const
+      ABSL_SHARED_LOCKS_REQUIRED(user_data_mutex_);
 
   // Limits the number of candidates based on a request.
   // This method doesn't drop meta candidates for T13n conversion.
@@ -197,6 +238,53 @@ class Converter final : public ConverterInterface {
   bool GetLastConnectivePart(absl::string_view preceding_text, std::string *key,
                              std::string *value, uint16_t *id) const;
 
+  // Result of StartConversion() or StartPrediction() shared by the cache and
+  // the in-flight lookups. Entries are never modified once inserted; a hit
+  // copies them into the caller's Segments outside of the lock.
+  struct CachedResult {
+    std::vector<Segment> conversion_segments;
+    bool resized = false;
+  };
+
+  // Returns the cache key for the conversion of the last conversion segment
+  // of `segments`, which must have been just reset by SetKey(). Returns
+  // nullopt if the result of the request must not be cached.
+  std::optional<uint64_t> GetResultCacheKey(const ConversionRequest &request,
+                                            const Segments &segments) const;
+
+  // Replaces the conversion segments with the cached ones and returns true if
+  // `cache_key` is cached. `generation` is set to the generation of the cache,
+  // which is passed to InsertResultCache() on a miss.
+  bool LookupResultCache(uint64_t cache_key, Segments *segments,
+                         uint64_t *generation) const;
+
+  // Caches the conversion segments unless the cache has been cleared since
+  // the lookup of `generation`.
+  void InsertResultCache(uint64_t cache_key, uint64_t generation,
+                         const Segments &segments) const;
+
+  // Result of the learning run on learning_queue_ by FinishConversion(). The
+  // learning updates the committed segments (e.g., the reading of a predicted
+  // candidate) and adds the revert entries, which are copied back to the
+  // caller's Segments by ApplyLearnedResults().
+  struct LearnedResult {
+    std::vector<Segment> history_segments;
+    std::vector<Segments::RevertEntry> revert_entries;
+  };
+
+  // Waits for the learning in progress, and calls ApplyLearnedResults(). Every
+  // method which reads the history segments, the revert entries or the learned
+  // data calls this first, except for StartPrediction() and FinishConversion().
+  void ApplyPendingLearning(Segments *segments) const;
+
+  // Replaces the placeholder revert entry added by FinishConversion() in
+  // `segments` with the learned result if the learning has finished. Otherwise
+  // the placeholder is kept.
+  void ApplyLearnedResults(Segments *segments) const;
+
+  // Keeps the last max_history_segments_size() segments as history segments.
+  static void MakeHistorySegments(Segments *segments);
+
   std::unique_ptr<engine::Modules> modules_;
   std::unique_ptr<const ImmutableConverterInterface> immutable_converter_;
   std::unique_ptr<prediction::PredictorInterface> predictor_;
@@ -207,6 +295,41 @@ class Converter final : public ConverterInterface {
   const converter::HistoryReconstructor history_reconstructor_;
   const converter::ReverseConverter reverse_converter_;
   const uint16_t general_noun_id_ = std::numeric_limits<uint16_t>::max();
+
+  // Guards the data learned by the rewriters and the predictors, which are not
+  // thread-safe for updates. The conversions of different sessions read it
+  // concurrently under the reader lock, while the learning, the revert and the
+  // other updates take the writer lock. The pending learning is waited for
+  // before taking the lock, as the learning itself takes the writer lock.
+  // StartPrediction() doesn't wait for it, and only waits for the lock while
+  // a learning is running.
+  //
+  // Under the reader lock, the immutable converter, PredictForRequest() and
+  // Rewrite() must not modify the state shared between the calls. They keep
+  // the state of a call on the stack or in the segments. The few shared
+  // caches they update have their own synchronization: the connector cache,
+  // the previous top result of DictionaryPredictor, the fortune of
+  // FortuneRewriter, the interned usages of UsageRewriter and
+  // CharacterFormManager.
+  mutable absl::Mutex user_data_mutex_;
+
+  mutable absl::Mutex result_cache_mutex_;
+  mutable storage::LruCache<uint64_t, std::shared_ptr<const CachedResult>>
+      result_cache_ ABSL_GUARDED_BY(result_cache_mutex_);
+  // Incremented by ClearResultCache().
+  mutable uint64_t result_cache_generation_
+      ABSL_GUARDED_BY(result_cache_mutex_) = 0;
+
+  mutable std::atomic<uint64_t> next_learning_id_ = 1;
+  // The id of the last learning whose result is in learned_results_.
+  mutable std::atomic<uint64_t> last_learned_id_ = 0;
+  mutable absl::Mutex learned_results_mutex_;
+  mutable storage::LruCache<uint64_t, std::shared_ptr<const LearnedResult>>
+      learned_results_ ABSL_GUARDED_BY(learned_results_mutex_);
+
+  // Declared last so that the pending learning finishes before the members
+  // above are destroyed.
+  mutable converter::LearningQueue learning_queue_;
 };
 
 }  // namespace mozc
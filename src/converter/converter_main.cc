@@ -38,6 +38,7 @@
 #include <utility>
 #include <vector>
 
+#include "absl/container/flat_hash_set.h"
 #include "absl/flags/flag.h"
 #include "absl/log/check.h"
 #include "absl/log/log.h"
@@ -86,6 +87,8 @@ ABSL_FLAG(bool, output_debug_string, true,
 ABSL_FLAG(size_t, max_candidates_to_show, 100,
           "Max number of candidates to show per segment");
 ABSL_FLAG(bool, show_meta_candidates, false, "if true, show meta candidates");
+ABSL_FLAG(bool, show_memory_usage, false,
+          "if true, show the memory footprint of the candidates");
 
 // Advanced options for data files.  These are automatically set when --engine
 // is used but they can be overridden by specifying these flags.
@@ -279,6 +282,56 @@ void PrintSegments(const Segments &segments, std::ostream *os) {
   }
 }
 
+// Prints the memory footprint of the candidates in `segments`. Strings longer
+// than the small string buffer and inner segment boundaries longer than the
+// inline storage are counted as heap allocations. A usage shared by several
+// candidates is counted once.
+void PrintMemoryUsage(const Segments &segments, std::ostream *os) {
+  static const size_t kInlineStringCapacity = std::string().capacity();
+  size_t num_candidates = 0;
+  size_t num_allocations = 0;
+  size_t heap_bytes = 0;
+  const auto add_string = [&](const std::string &str) {
+    if (str.capacity() > kInlineStringCapacity) {
+      ++num_allocations;
+      heap_bytes += str.capacity() + 1;
+    }
+  };
+  absl::flat_hash_set<const Segment::Candidate::Usage *> usages;
+  for (const Segment &segment : segments) {
+    for (const Segment::Candidate *cand : segment.candidates()) {
+      ++num_candidates;
+      for (const std::string *str :
+           {&cand->key, &cand->value, &cand->content_key, &cand->content_value,
+            &cand->prefix, &cand->suffix, &cand->description,
+            &cand->a11y_description}) {
+        add_string(*str);
+      }
+      if (cand->usage != nullptr && usages.insert(cand->usage.get()).second) {
+        // The control block and the usage are allocated together.
+        ++num_allocations;
+        heap_bytes += sizeof(Segment::Candidate::Usage);
+        add_string(cand->usage->title);
+        add_string(cand->usage->description);
+      }
+      const Segment::Candidate::InnerSegmentBoundary &boundary =
+          cand->inner_segment_boundary;
+      if (boundary.capacity() > Segment::Candidate::InnerSegmentBoundary()
+                                    .capacity()) {
+        ++num_allocations;
+        heap_bytes += boundary.capacity() * sizeof(uint32_t);
+      }
+    }
+  }
+  (*os) << "---------- Memory usage ----------" << std::endl
+        << "candidates: " << num_candidates << std::endl
+        << "sizeof(Candidate): " << sizeof(Segment::Candidate) << std::endl
+        << "inline bytes: " << num_candidates * sizeof(Segment::Candidate)
+        << std::endl
+        << "heap allocations: " << num_allocations << std::endl
+        << "heap bytes: " << heap_bytes << std::endl;
+}
+
 bool ExecCommand(const ConverterInterface &converter, const std::string &line,
                  const commands::Request &request, config::Config *config,
                  Segments *segments) {
@@ -481,6 +534,9 @@ void RunLoop(std::unique_ptr<Engine> engine, commands::Request &&request,
       if (absl::GetFlag(FLAGS_output_debug_string)) {
         PrintSegments(segments, &std::cout);
       }
+      if (absl::GetFlag(FLAGS_show_memory_usage)) {
+        PrintMemoryUsage(segments, &std::cout);
+      }
     } else {
       std::cout << "ExecCommand() return false" << std::endl;
     }
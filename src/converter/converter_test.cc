@@ -46,7 +46,9 @@
 #include "absl/memory/memory.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
+#include "absl/time/time.h"
 #include "absl/types/span.h"
+#include "base/clock_mock.h"
 #include "base/util.h"
 #include "composer/composer.h"
 #include "composer/table.h"
@@ -86,6 +88,7 @@
 #include "testing/gunit.h"
 #include "testing/mozctest.h"
 #include "transliteration/transliteration.h"
+#include "usage_stats/metrics_registry.h"
 #include "usage_stats/usage_stats.h"
 #include "usage_stats/usage_stats_testing_util.h"
 
@@ -107,6 +110,8 @@ using ::mozc::prediction::UserHistoryPredictor;
 using ::mozc::usage_stats::UsageStats;
 using ::testing::_;
 using ::testing::AnyNumber;
+using ::testing::InSequence;
+using ::testing::Return;
 using ::testing::StrEq;
 
 Segment &AddSegment(absl::string_view key, Segment::SegmentType type,
@@ -215,6 +220,27 @@ ConversionRequest ConvReq(absl::string_view key,
       .Build();
 }
 
+// Same as ConvReq() but the result is cached by the converter.
+ConversionRequest CacheableConvReq(
+    absl::string_view key, ConversionRequest::RequestType request_type) {
+  composer::Composer composer;
+  composer.SetPreeditTextForTestOnly(key);
+  ConversionRequest::Options options;
+  options.settings_fingerprint = 1;
+  return ConversionRequestBuilder()
+      .SetComposer(composer)
+      .SetOptions(std::move(options))
+      .SetRequestType(request_type)
+      .Build();
+}
+
+uint64_t GetCount(const std::string &name) {
+  const usage_stats::MetricsSnapshot snapshot =
+      UsageStats::GetMetricsSnapshot();
+  const auto it = snapshot.counts.find(name);
+  return it == snapshot.counts.end() ? 0 : it->second;
+}
+
 }  // namespace
 
 class MockPredictor : public mozc::prediction::PredictorInterface {
@@ -225,16 +251,27 @@ class MockPredictor : public mozc::prediction::PredictorInterface {
   MOCK_METHOD(bool, PredictForRequest, (const ConversionRequest &, Segments *),
               (const, override));
   MOCK_METHOD(void, Revert, (Segments *), (override));
+  MOCK_METHOD(void, AddPendingLearning,
+              (uint64_t, const ConversionRequest &, const Segments &),
+              (override));
+  MOCK_METHOD(void, RemovePendingLearning, (uint64_t), (override));
   MOCK_METHOD(const std::string &, GetPredictorName, (), (const, override));
 };
 
 class MockRewriter : public RewriterInterface {
  public:
-  MockRewriter() = default;
+  MockRewriter() {
+    ON_CALL(*this, IsDeterministic).WillByDefault(Return(true));
+  }
   ~MockRewriter() override = default;
 
   MOCK_METHOD(bool, Rewrite, (const ConversionRequest &, Segments *),
               (const, override));
+  MOCK_METHOD(bool, IsDeterministic,
+              (const ConversionRequest &, const Segments &),
+              (const, override));
+  MOCK_METHOD(void, Finish, (const ConversionRequest &, Segments *),
+              (override));
   MOCK_METHOD(void, Revert, (Segments *), (override));
 };
 
@@ -1951,6 +1988,177 @@ TEST_F(ConverterTest, RevertConversion) {
   converter->RevertConversion(&segments);
 }
 
+TEST_F(ConverterTest, FinishConversionLearnsInBackground) {
+  auto mock_rewriter = std::make_unique<MockRewriter>();
+  EXPECT_CALL(*mock_rewriter, Rewrite(_, _)).WillRepeatedly(Return(true));
+  // The learning adds a revert entry and updates the committed segment.
+  EXPECT_CALL(*mock_rewriter, Finish(_, _))
+      .WillOnce([](const ConversionRequest &, Segments *segments) {
+        Segments::RevertEntry *entry = segments->push_back_revert_entry();
+        entry->id = 2;
+        entry->key = "learned";
+        segments->mutable_segment(0)->mutable_candidate(0)->description =
+            "learned";
+      });
+  // RevertConversion() passes the revert entry added by the learning.
+  EXPECT_CALL(*mock_rewriter, Revert(_)).WillOnce([](Segments *segments) {
+    ASSERT_EQ(segments->revert_entries_size(), 1);
+    EXPECT_EQ(segments->revert_entry(0).id, 2);
+    EXPECT_EQ(segments->revert_entry(0).key, "learned");
+  });
+  std::unique_ptr<Converter> converter =
+      CreateConverter(std::move(mock_rewriter), STUB_PREDICTOR);
+
+  const ConversionRequest convreq =
+      ConvReq("わたしは", ConversionRequest::CONVERSION);
+  Segments segments;
+  ASSERT_TRUE(converter->StartConversion(convreq, &segments));
+  ASSERT_TRUE(converter->CommitSegmentValue(&segments, 0, 0));
+  converter->FinishConversion(convreq, &segments);
+  EXPECT_EQ(segments.conversion_segments_size(), 0);
+  EXPECT_GT(segments.history_segments_size(), 0);
+
+  // The result of the learning is copied back by the next call.
+  converter->RevertConversion(&segments);
+  EXPECT_EQ(segments.revert_entries_size(), 0);
+  EXPECT_EQ(segments.history_segment(0).candidate(0).description, "learned");
+}
+
+TEST_F(ConverterTest, FinishConversionAddsPendingLearning) {
+  auto mock_predictor = std::make_unique<MockPredictor>();
+  auto mock_rewriter = std::make_unique<MockRewriter>();
+  EXPECT_CALL(*mock_rewriter, Rewrite(_, _)).WillRepeatedly(Return(true));
+  EXPECT_CALL(*mock_rewriter, Revert(_)).Times(AnyNumber());
+
+  // The commit is registered to the predictor before FinishConversion()
+  // returns, and is removed once the learning has been applied.
+  uint64_t pending_id = 0;
+  {
+    InSequence seq;
+    EXPECT_CALL(*mock_predictor, AddPendingLearning(_, _, _))
+        .WillOnce([&pending_id](uint64_t id, const ConversionRequest &,
+                                const Segments &segments) {
+          pending_id = id;
+          EXPECT_EQ(segments.conversion_segments_size(), 1);
+        });
+    EXPECT_CALL(*mock_rewriter, Finish(_, _));
+    EXPECT_CALL(*mock_predictor, RemovePendingLearning(_))
+        .WillOnce([&pending_id](uint64_t id) { EXPECT_EQ(id, pending_id); });
+  }
+  EXPECT_CALL(*mock_predictor, Revert(_)).Times(AnyNumber());
+
+  auto modules = std::make_unique<engine::Modules>();
+  modules->PresetUserDictionary(std::make_unique<UserDictionaryStub>());
+  CHECK_OK(modules->Init(std::make_unique<testing::MockDataManager>()));
+
+  std::unique_ptr<Converter> converter = std::make_unique<Converter>(
+      std::move(modules),
+      [](const engine::Modules &modules) {
+        return std::make_unique<ImmutableConverter>(modules);
+      },
+      [&mock_predictor](
+          const engine::Modules &modules, const ConverterInterface *converter,
+          const ImmutableConverterInterface *immutable_converter) {
+        return std::move(mock_predictor);
+      },
+      [&mock_rewriter](const engine::Modules &modules) {
+        return std::move(mock_rewriter);
+      });
+
+  const ConversionRequest convreq =
+      ConvReq("わたしは", ConversionRequest::CONVERSION);
+  Segments segments;
+  ASSERT_TRUE(converter->StartConversion(convreq, &segments));
+  ASSERT_TRUE(converter->CommitSegmentValue(&segments, 0, 0));
+  converter->FinishConversion(convreq, &segments);
+  EXPECT_NE(pending_id, 0);
+
+  // RevertConversion() waits for the learning.
+  converter->RevertConversion(&segments);
+}
+
+TEST_F(ConverterTest, ResultCache) {
+  ScopedClockMock clock(absl::FromUnixSeconds(1000));
+  auto mock_rewriter = std::make_unique<MockRewriter>();
+  // Rewrite() is called only for the conversions that miss the cache.
+  EXPECT_CALL(*mock_rewriter, Rewrite(_, _))
+      .Times(3)
+      .WillRepeatedly(Return(true));
+  std::unique_ptr<Converter> converter =
+      CreateConverter(std::move(mock_rewriter), STUB_PREDICTOR);
+
+  const ConversionRequest convreq =
+      CacheableConvReq("わたしはなかのです", ConversionRequest::CONVERSION);
+  Segments segments1;
+  ASSERT_TRUE(converter->StartConversion(convreq, &segments1));
+  Segments segments2;
+  ASSERT_TRUE(converter->StartConversion(convreq, &segments2));
+  EXPECT_EQ(segments2.DebugString(), segments1.DebugString());
+  EXPECT_EQ(GetCount("ConversionCacheMiss"), 1);
+  EXPECT_EQ(GetCount("ConversionCacheHit"), 1);
+
+  // The cached result is not affected by the modification of the returned
+  // segments.
+  segments2.mutable_conversion_segment(0)->clear_candidates();
+  Segments segments3;
+  ASSERT_TRUE(converter->StartConversion(convreq, &segments3));
+  EXPECT_EQ(segments3.DebugString(), segments1.DebugString());
+  EXPECT_EQ(GetCount("ConversionCacheHit"), 2);
+
+  // A different key misses the cache.
+  Segments segments4;
+  ASSERT_TRUE(converter->StartConversion(
+      CacheableConvReq("わたしは", ConversionRequest::CONVERSION),
+      &segments4));
+  EXPECT_EQ(GetCount("ConversionCacheMiss"), 2);
+
+  // Learning invalidates the cache.
+  ASSERT_TRUE(converter->CommitSegmentValue(&segments3, 0, 0));
+  converter->FinishConversion(convreq, &segments3);
+  Segments segments5;
+  ASSERT_TRUE(converter->StartConversion(convreq, &segments5));
+  EXPECT_EQ(GetCount("ConversionCacheMiss"), 3);
+  EXPECT_EQ(GetCount("ConversionCacheHit"), 2);
+}
+
+TEST_F(ConverterTest, ResultCacheIsNotUsedWithoutSettingsFingerprint) {
+  auto mock_rewriter = std::make_unique<MockRewriter>();
+  EXPECT_CALL(*mock_rewriter, Rewrite(_, _))
+      .Times(2)
+      .WillRepeatedly(Return(true));
+  std::unique_ptr<Converter> converter =
+      CreateConverter(std::move(mock_rewriter), STUB_PREDICTOR);
+
+  const ConversionRequest convreq =
+      ConvReq("わたしはなかのです", ConversionRequest::CONVERSION);
+  for (int i = 0; i < 2; ++i) {
+    Segments segments;
+    ASSERT_TRUE(converter->StartConversion(convreq, &segments));
+  }
+  EXPECT_EQ(GetCount("ConversionCacheMiss"), 0);
+  EXPECT_EQ(GetCount("ConversionCacheHit"), 0);
+}
+
+TEST_F(ConverterTest, ResultCacheIsNotUsedForNondeterministicRewriters) {
+  auto mock_rewriter = std::make_unique<MockRewriter>();
+  EXPECT_CALL(*mock_rewriter, IsDeterministic(_, _))
+      .WillRepeatedly(Return(false));
+  EXPECT_CALL(*mock_rewriter, Rewrite(_, _))
+      .Times(2)
+      .WillRepeatedly(Return(true));
+  std::unique_ptr<Converter> converter =
+      CreateConverter(std::move(mock_rewriter), STUB_PREDICTOR);
+
+  const ConversionRequest convreq =
+      CacheableConvReq("さいころ", ConversionRequest::CONVERSION);
+  for (int i = 0; i < 2; ++i) {
+    Segments segments;
+    ASSERT_TRUE(converter->StartConversion(convreq, &segments));
+  }
+  EXPECT_EQ(GetCount("ConversionCacheMiss"), 0);
+  EXPECT_EQ(GetCount("ConversionCacheHit"), 0);
+}
+
 TEST_F(ConverterTest, ResizeSegmentWithOffset) {
   constexpr Segment::SegmentType kFixedBoundary = Segment::FIXED_BOUNDARY;
   constexpr Segment::SegmentType kFree = Segment::FREE;
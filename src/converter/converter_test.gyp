@@ -42,6 +42,7 @@
         'immutable_converter_test.cc',
         'key_corrector_test.cc',
         'lattice_test.cc',
+        'learning_queue_test.cc',
         'nbest_generator_test.cc',
         'segments_matchers_test.cc',
         'segments_test.cc',
@@ -52,6 +52,7 @@
 #include "base/container/trie.h"
 #include "base/japanese_util.h"
 #include "base/strings/unicode.h"
+#include "base/trace.h"
 #include "base/util.h"
 #include "base/vlog.h"
 #include "converter/connector.h"
@@ -2219,6 +2220,7 @@ void ImmutableConverter::MakeGroup(const Segments &segments,
 
 bool ImmutableConverter::ConvertForRequest(const ConversionRequest &request,
                                            Segments *segments) const {
+  ScopedTraceSpan span("ImmutableConverter::ConvertForRequest");
   const bool is_prediction =
       (request.request_type() == ConversionRequest::PREDICTION ||
        request.request_type() == ConversionRequest::SUGGESTION);
@@ -0,0 +1,106 @@
+// Copyright 2010-2021, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "converter/learning_queue.h"
+
+#include <cstdint>
+#include <thread>  // NOLINT
+#include <utility>
+
+#include "absl/synchronization/mutex.h"
+#include "base/thread.h"
+
+namespace mozc {
+namespace converter {
+
+LearningQueue::~LearningQueue() {
+  {
+    absl::MutexLock l(&mutex_);
+    terminating_ = true;
+  }
+  if (thread_.Joinable()) {
+    thread_.Join();
+  }
+}
+
+uint64_t LearningQueue::Push(Task task) {
+  absl::MutexLock l(&mutex_);
+  if (!thread_.Joinable()) {
+    thread_ = Thread([this] { ThreadMain(); });
+  }
+  queue_.push_back(std::move(task));
+  return next_task_id_++;
+}
+
+void LearningQueue::Wait() {
+  absl::MutexLock l(&mutex_);
+  if (worker_id_ == std::this_thread::get_id()) {
+    return;
+  }
+  const uint64_t last_task_id = next_task_id_ - 1;
+  const auto finished = [this, last_task_id]()
+                            ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
+                              return last_finished_id_ >= last_task_id;
+                            };
+  mutex_.Await(absl::Condition(&finished));
+}
+
+bool LearningQueue::IsIdle() const {
+  absl::MutexLock l(&mutex_);
+  return last_finished_id_ + 1 == next_task_id_;
+}
+
+void LearningQueue::ThreadMain() {
+  {
+    absl::MutexLock l(&mutex_);
+    worker_id_ = std::this_thread::get_id();
+  }
+  while (true) {
+    Task task;
+    {
+      absl::MutexLock l(&mutex_);
+      const auto ready = [this]() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
+        return terminating_ || !queue_.empty();
+      };
+      mutex_.Await(absl::Condition(&ready));
+      if (queue_.empty()) {
+        // terminating_ is set and all the tasks are finished.
+        return;
+      }
+      task = std::move(queue_.front());
+      queue_.pop_front();
+    }
+    std::move(task)();
+    absl::MutexLock l(&mutex_);
+    ++last_finished_id_;
+  }
+}
+
+}  // namespace converter
+}  // namespace mozc
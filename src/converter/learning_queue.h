@@ -0,0 +1,91 @@
+// Copyright 2010-2021, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Single background worker which runs tasks in the enqueued order.
+//
+// Converter uses this to move the learning of the committed segments (the
+// Finish() of the rewriters and the predictors) off the commit path. The
+// owner calls Wait() before it reads the learned data again, so the result of
+// a commit is visible to the next conversion. The predictions don't wait, and
+// see the pending commits through PredictorInterface::AddPendingLearning().
+
+#ifndef MOZC_CONVERTER_LEARNING_QUEUE_H_
+#define MOZC_CONVERTER_LEARNING_QUEUE_H_
+
+#include <cstdint>
+#include <deque>
+#include <thread>  // NOLINT
+
+#include "absl/base/thread_annotations.h"
+#include "absl/functional/any_invocable.h"
+#include "absl/synchronization/mutex.h"
+#include "base/thread.h"
+
+namespace mozc {
+namespace converter {
+
+class LearningQueue {
+ public:
+  using Task = absl::AnyInvocable<void() &&>;
+
+  LearningQueue() = default;
+  LearningQueue(const LearningQueue &) = delete;
+  LearningQueue &operator=(const LearningQueue &) = delete;
+
+  // Runs all the pending tasks and joins the background thread.
+  ~LearningQueue();
+
+  // Enqueues `task` and returns its id immediately. The ids start from 1 and
+  // increase by one. The background thread is started on the first call.
+  uint64_t Push(Task task) ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Blocks until all the tasks enqueued so far are finished. Returns
+  // immediately when called from a task, as the task itself can't finish
+  // before it returns.
+  void Wait() ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Returns true if there is no task waiting or running.
+  bool IsIdle() const ABSL_LOCKS_EXCLUDED(mutex_);
+
+ private:
+  void ThreadMain();
+
+  mutable absl::Mutex mutex_;
+  std::deque<Task> queue_ ABSL_GUARDED_BY(mutex_);
+  uint64_t next_task_id_ ABSL_GUARDED_BY(mutex_) = 1;
+  uint64_t last_finished_id_ ABSL_GUARDED_BY(mutex_) = 0;
+  std::thread::id worker_id_ ABSL_GUARDED_BY(mutex_);
+  bool terminating_ ABSL_GUARDED_BY(mutex_) = false;
+  Thread thread_;
+};
+
+}  // namespace converter
+}  // namespace mozc
+
+#endif  // MOZC_CONVERTER_LEARNING_QUEUE_H_
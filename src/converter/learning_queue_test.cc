@@ -0,0 +1,115 @@
+// Copyright 2010-2021, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "converter/learning_queue.h"
+
+#include <cstdint>
+#include <vector>
+
+#include "absl/synchronization/mutex.h"
+#include "absl/synchronization/notification.h"
+#include "testing/gunit.h"
+
+namespace mozc {
+namespace converter {
+namespace {
+
+TEST(LearningQueueTest, RunsTasksInOrder) {
+  absl::Mutex mutex;
+  std::vector<int> order;
+  LearningQueue queue;
+  EXPECT_TRUE(queue.IsIdle());
+  for (int i = 0; i < 100; ++i) {
+    const uint64_t id = queue.Push([&, i] {
+      absl::MutexLock l(&mutex);
+      order.push_back(i);
+    });
+    EXPECT_EQ(id, i + 1);
+  }
+  queue.Wait();
+  EXPECT_TRUE(queue.IsIdle());
+  absl::MutexLock l(&mutex);
+  ASSERT_EQ(order.size(), 100);
+  for (int i = 0; i < 100; ++i) {
+    EXPECT_EQ(order[i], i);
+  }
+}
+
+TEST(LearningQueueTest, PushDoesNotBlock) {
+  absl::Notification start;
+  bool finished = false;
+  LearningQueue queue;
+  queue.Push([&] {
+    start.WaitForNotification();
+    finished = true;
+  });
+  EXPECT_FALSE(queue.IsIdle());
+  start.Notify();
+  queue.Wait();
+  EXPECT_TRUE(finished);
+  EXPECT_TRUE(queue.IsIdle());
+}
+
+TEST(LearningQueueTest, WaitFromTask) {
+  LearningQueue queue;
+  bool nested_finished = false;
+  queue.Push([&] {
+    // Must not deadlock.
+    queue.Wait();
+    nested_finished = true;
+  });
+  queue.Wait();
+  EXPECT_TRUE(nested_finished);
+}
+
+TEST(LearningQueueTest, DestructorRunsPendingTasks) {
+  int count = 0;
+  {
+    absl::Notification start;
+    LearningQueue queue;
+    for (int i = 0; i < 10; ++i) {
+      queue.Push([&] {
+        start.WaitForNotification();
+        ++count;
+      });
+    }
+    start.Notify();
+  }
+  EXPECT_EQ(count, 10);
+}
+
+TEST(LearningQueueTest, WaitWithoutTask) {
+  LearningQueue queue;
+  queue.Wait();
+  EXPECT_TRUE(queue.IsIdle());
+}
+
+}  // namespace
+}  // namespace converter
+}  // namespace mozc
@@ -68,8 +68,8 @@ void Segment::Candidate::Clear() {
   prefix.clear();
   suffix.clear();
   description.clear();
-  usage_title.clear();
-  usage_description.clear();
+  a11y_description.clear();
+  usage.reset();
   cost = 0;
   structure_cost = 0;
   wcost = 0;
@@ -78,9 +78,11 @@ void Segment::Candidate::Clear() {
   usage_id = 0;
   attributes = 0;
   source_info = SOURCE_INFO_NONE;
+  category = DEFAULT_CATEGORY;
   style = NumberUtil::NumberString::DEFAULT_STYLE;
   command = DEFAULT_COMMAND;
   inner_segment_boundary.clear();
+  cost_before_rescoring = 0;
 #ifndef NDEBUG
   log.clear();
 #endif  // NDEBUG
@@ -234,6 +236,9 @@ Segment::Segment(const Segment &x)
 }
 
 Segment &Segment::operator=(const Segment &x) {
+  if (this == &x) {
+    return *this;
+  }
   removed_candidates_for_debug_ = x.removed_candidates_for_debug_;
   segment_type_ = x.segment_type_;
   key_ = x.key_;
@@ -246,22 +251,45 @@ Segment &Segment::operator=(const Segment &x) {
 }
 
 void Segment::clear_candidates() {
-  pool_.clear();
+  // The candidate objects are kept in pool_ and reused by AllocCandidate().
+  pool_size_in_use_ = 0;
   candidates_.clear();
+  if (pool_.size() > kMaxPooledCandidates) {
+    pool_.resize(kMaxPooledCandidates);
+    pool_.shrink_to_fit();
+  }
 }
 
-Segment::Candidate *Segment::push_back_candidate() {
-  auto candidate = std::make_unique<Candidate>();
+Segment::Candidate *Segment::AllocCandidate() {
+  if (pool_size_in_use_ < pool_.size()) {
+    Candidate *candidate = pool_[pool_size_in_use_++].get();
+    candidate->Clear();
+    return candidate;
+  }
+  ++pool_size_in_use_;
+  return pool_.emplace_back(std::make_unique<Candidate>()).get();
+}
+
+Segment::Candidate *Segment::AdoptCandidate(
+    std::unique_ptr<Candidate> candidate) {
   Candidate *ptr = candidate.get();
+  if (ptr == nullptr) {
+    return nullptr;
+  }
+  // Keeps the candidates in use at the front of pool_.
   pool_.push_back(std::move(candidate));
+  std::swap(pool_[pool_size_in_use_++], pool_.back());
+  return ptr;
+}
+
+Segment::Candidate *Segment::push_back_candidate() {
+  Candidate *ptr = AllocCandidate();
   candidates_.push_back(ptr);
   return ptr;
 }
 
 Segment::Candidate *Segment::push_front_candidate() {
-  auto candidate = std::make_unique<Candidate>();
-  Candidate *ptr = candidate.get();
-  pool_.push_back(std::move(candidate));
+  Candidate *ptr = AllocCandidate();
   candidates_.push_front(ptr);
   return ptr;
 }
@@ -277,14 +305,13 @@ Segment::Candidate *Segment::insert_candidate(int i) {
                 << candidates_.size();
     i = static_cast<int>(candidates_.size());
   }
-  Candidate *candidate =
-      pool_.emplace_back(std::make_unique<Candidate>()).get();
+  Candidate *candidate = AllocCandidate();
   candidates_.insert(candidates_.begin() + i, candidate);
   return candidate;
 }
 
 void Segment::insert_candidate(int i, std::unique_ptr<Candidate> candidate) {
-  Candidate *cand_ptr = pool_.emplace_back(std::move(candidate)).get();
+  Candidate *cand_ptr = AdoptCandidate(std::move(candidate));
   if (i <= 0) {
     candidates_.push_front(cand_ptr);
   } else if (i >= static_cast<int>(candidates_.size())) {
@@ -306,24 +333,21 @@ void Segment::insert_candidates(
   candidates_.resize(orig_size + candidates.size());
   std::copy_backward(candidates_.begin() + i, candidates_.begin() + orig_size,
                      candidates_.end());
-  for (const auto &candidate : candidates) {
-    candidates_[i++] = candidate.get();
+  for (std::unique_ptr<Candidate> &candidate : candidates) {
+    candidates_[i++] = AdoptCandidate(std::move(candidate));
   }
-
-  pool_.insert(pool_.end(), std::make_move_iterator(candidates.begin()),
-               std::make_move_iterator(candidates.end()));
 }
 
 void Segment::pop_front_candidate() {
   if (!candidates_.empty()) {
-    // The unique_ptr in pool_ is deleted when the candidate is deleted.
+    // The candidate in pool_ is reused after clear_candidates().
     candidates_.pop_front();
   }
 }
 
 void Segment::pop_back_candidate() {
   if (!candidates_.empty()) {
-    // The unique_ptr in pool_ is deleted when the candidate is deleted.
+    // The candidate in pool_ is reused after clear_candidates().
     candidates_.pop_back();
   }
 }
@@ -405,12 +429,13 @@ void Segment::Clear() {
 }
 
 void Segment::DeepCopyCandidates(const std::deque<Candidate *> &candidates) {
-  DCHECK(pool_.empty());
+  DCHECK_EQ(pool_size_in_use_, 0);
   pool_.reserve(candidates.size());
   for (const Candidate *cand : candidates) {
-    auto new_cand = std::make_unique<Candidate>(*cand);
-    candidates_.push_back(new_cand.get());
-    pool_.push_back(std::move(new_cand));
+    // Copy-assigning to a reused candidate reuses its string buffers.
+    Candidate *new_cand = AllocCandidate();
+    *new_cand = *cand;
+    candidates_.push_back(new_cand);
   }
 }
 
@@ -578,7 +603,11 @@ void Segments::Clear() {
 }
 
 void Segments::clear_segments() {
-  pool_.Free();
+  // Returns the segments to the pool instead of freeing them so that the next
+  // conversion reuses the segments and their candidates without allocations.
+  for (Segment *segment : segments_) {
+    pool_.Release(segment);
+  }
   resized_ = false;
   segments_.clear();
 }
@@ -41,6 +41,7 @@
 #include <utility>
 #include <vector>
 
+#include "absl/container/inlined_vector.h"
 #include "absl/log/check.h"
 #include "absl/strings/string_view.h"
 #include "absl/types/span.h"
@@ -138,7 +139,7 @@ class Segment final {
     };
     // LINT.ThenChange(//converter/converter_main.cc)
 
-    enum Command {
+    enum Command : uint8_t {
       DEFAULT_COMMAND = 0,
       ENABLE_INCOGNITO_MODE,      // enables "incognito mode".
       DISABLE_INCOGNITO_MODE,     // disables "incognito mode".
@@ -167,20 +168,32 @@ class Segment final {
       USER_HISTORY_PREDICTOR = 1 << 6,
     };
 
-    enum Category {
+    enum Category : uint8_t {
       DEFAULT_CATEGORY,  // Realtime conversion, history prediction, etc
       SYMBOL,            // Symbol, emoji
       OTHER,             // Misc candidate
     };
 
+    // Most candidates have only a few inner segments, so they are stored
+    // inline without a heap allocation.
+    using InnerSegmentBoundary = absl::InlinedVector<uint32_t, 4>;
+
+    // Usage of the candidate shown in the information list. It is immutable
+    // once set, so the candidates of the same usage dictionary entry share
+    // one instance (see UsageRewriter).
+    struct Usage {
+      std::string title;
+      std::string description;
+    };
+
     // LINT.IfChange
+    // The fields are ordered so that the scalar members are packed without
+    // padding between the strings.
     std::string key;    // reading
     std::string value;  // surface form
     std::string content_key;
     std::string content_value;
 
-    size_t consumed_key_size = 0;
-
     // Meta information
     std::string prefix;
     std::string suffix;
@@ -189,12 +202,19 @@ class Segment final {
     // Description for A11y support (e.g. "あ。ヒラガナ あ")
     std::string a11y_description;
 
+    // Usage containing the basic form of this candidate and its meaning.
+    // nullptr if the candidate has no usage.
+    std::shared_ptr<const Usage> usage;
+
+    // Boundary information for real time conversion.  This will be set only for
+    // real time conversion result candidates.  Each element is the encoded
+    // lengths of key, value, content key and content value.
+    InnerSegmentBoundary inner_segment_boundary;
+
+    size_t consumed_key_size = 0;
+
     // Usage ID
     int32_t usage_id = 0;
-    // Title of the usage containing basic form of this candidate.
-    std::string usage_title;
-    // Content of the usage.
-    std::string usage_description;
 
     // Context "sensitive" candidate cost.
     // Taking adjacent words/nodes into consideration.
@@ -219,21 +239,16 @@ class Segment final {
     // Candidate's source info which will be used for usage stats.
     uint32_t source_info = SOURCE_INFO_NONE;
 
-    Category category = DEFAULT_CATEGORY;
-
     // Candidate style. This is not a bit-field.
     // The style is defined in enum |Style|.
     NumberUtil::NumberString::Style style =
         NumberUtil::NumberString::DEFAULT_STYLE;
 
+    Category category = DEFAULT_CATEGORY;
+
     // Command of this candidate. This is not a bit-field.
     // The style is defined in enum |Command|.
     Command command = DEFAULT_COMMAND;
-
-    // Boundary information for real time conversion.  This will be set only for
-    // real time conversion result candidates.  Each element is the encoded
-    // lengths of key, value, content key and content value.
-    std::vector<uint32_t> inner_segment_boundary;
     // LINT.ThenChange(//converter/segments_matchers.h)
 
     // The original cost before rescoring. Used for debugging purpose.
@@ -317,6 +332,15 @@ class Segment final {
     // value.substr(content_value.size(), value.size() - content_value.size());
     absl::string_view functional_value() const;
 
+    // Returns the title and the content of the usage, or empty strings if the
+    // candidate has no usage.
+    absl::string_view usage_title() const {
+      return usage == nullptr ? absl::string_view() : usage->title;
+    }
+    absl::string_view usage_description() const {
+      return usage == nullptr ? absl::string_view() : usage->description;
+    }
+
     // Returns whether the inner_segment_boundary member is consistent with
     // key and value.
     // Note: content_key and content_value are not checked here.
@@ -337,7 +361,7 @@ class Segment final {
     }
   };
 
-  Segment() : segment_type_(FREE), pool_(kCandidatesPoolSize) {}
+  Segment() : segment_type_(FREE) { pool_.reserve(kCandidatesPoolSize); }
 
   Segment(const Segment &x);
   Segment &operator=(const Segment &x);
@@ -384,6 +408,8 @@ class Segment final {
 
   // erase all candidates
   // do not erase meta candidates
+  // The candidate objects are kept and reused by the following insertions, so
+  // a cleared segment doesn't allocate until it exceeds its previous size.
   void clear_candidates();
 
   // meta candidates
@@ -420,9 +446,23 @@ class Segment final {
   std::vector<Candidate> removed_candidates_for_debug_;
 
  private:
+  FRIEND_TEST(SegmentTest, ShrinkCandidatePoolOnClear);
+
   void DeepCopyCandidates(const std::deque<Candidate *> &candidates);
 
+  // Returns a cleared candidate, reusing one released by clear_candidates() if
+  // available.
+  Candidate *AllocCandidate();
+  // Takes the ownership of `candidate`.
+  Candidate *AdoptCandidate(std::unique_ptr<Candidate> candidate);
+
   static constexpr int kCandidatesPoolSize = 16;
+  // The maximum number of the candidates kept in pool_ after
+  // clear_candidates(). A segment rarely has more candidates than this, e.g.,
+  // max_conversion_candidates_size is 200 by default, so the steady-state
+  // conversion still reuses all of them, while a segment which once had an
+  // unusually long list doesn't hold the memory forever.
+  static constexpr size_t kMaxPooledCandidates = 256;
 
   // LINT.IfChange
   SegmentType segment_type_;
@@ -436,7 +476,10 @@ class Segment final {
   std::string key_;
   std::deque<Candidate *> candidates_;
   std::vector<Candidate> meta_candidates_;
+  // Owns all the candidates. pool_[0, pool_size_in_use_) are allocated to
+  // this segment, including the erased ones, and the rest are free to reuse.
   std::vector<std::unique_ptr<Candidate>> pool_;
+  size_t pool_size_in_use_ = 0;
   // LINT.ThenChange(//converter/segments_matchers.h)
 };
 
@@ -470,8 +513,9 @@ class Segments final {
       UPDATE_ENTRY,
     };
     uint16_t revert_entry_type = 0;
-    // UserHitoryPredictor uses '1', UserSegmentHistoryRewriter uses '2' for
-    // now. Do not use duplicate keys.
+    // UserHitoryPredictor uses '1', UserSegmentHistoryRewriter uses '2' and
+    // Converter uses '3' for the learning in progress for now. Do not use
+    // duplicate keys.
     uint16_t id = 0;
     uint32_t timestamp = 0;
     std::string key;
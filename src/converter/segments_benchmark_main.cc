@@ -0,0 +1,182 @@
+// Copyright 2010-2021, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Measures the cost to fill and to copy Segments, which the converter does for
+// every conversion and SessionConverter does for undo and the prediction
+// cache. Reports the time and the number of heap allocations per operation.
+//
+// Usage: segments_benchmark_main --ops=10000
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <ostream>
+
+#include "absl/flags/flag.h"
+#include "absl/log/check.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+#include "base/init_mozc.h"
+#include "base/stopwatch.h"
+#include "converter/segments.h"
+
+ABSL_FLAG(int32_t, iterations, 5, "number of repetitions of each measurement");
+ABSL_FLAG(int32_t, ops, 10000, "number of operations per measurement");
+
+namespace {
+
+std::atomic<int64_t> g_allocations = 0;
+
+}  // namespace
+
+// Counts the heap allocations of the whole binary.
+void *operator new(size_t size) {
+  g_allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void *ptr = std::malloc(size == 0 ? 1 : size)) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+void operator delete(void *ptr, size_t) noexcept { std::free(ptr); }
+
+namespace mozc {
+namespace {
+
+// The shapes of typical results: a conversion with a few segments and a
+// prediction with one segment of many candidates.
+struct Shape {
+  absl::string_view name;
+  size_t num_segments;
+  size_t num_candidates;
+};
+constexpr Shape kShapes[] = {
+    {"Conversion", 3, 20},
+    {"Prediction", 1, 100},
+};
+
+void Fill(const Shape &shape, Segments *segments) {
+  segments->Clear();
+  for (size_t i = 0; i < shape.num_segments; ++i) {
+    Segment *segment = segments->add_segment();
+    segment->set_key("へんかん");
+    for (size_t j = 0; j < shape.num_candidates; ++j) {
+      Segment::Candidate *candidate = segment->add_candidate();
+      candidate->key = "へんかん";
+      candidate->content_key = candidate->key;
+      // Longer than the small string buffer.
+      candidate->value = "変換候補の値変換候補の値";
+      candidate->content_value = candidate->value;
+      candidate->cost = static_cast<int32_t>(j);
+    }
+  }
+}
+
+struct Result {
+  absl::Duration elapsed;
+  int64_t allocations;
+};
+
+// Returns the fastest duration of `func` over the iterations, and the number
+// of allocations in it.
+template <typename Func>
+Result Measure(Func func) {
+  Result fastest = {absl::InfiniteDuration(), 0};
+  for (int i = 0; i < absl::GetFlag(FLAGS_iterations); ++i) {
+    const int64_t allocations = g_allocations.load();
+    Stopwatch stopwatch = Stopwatch::StartNew();
+    func();
+    stopwatch.Stop();
+    if (stopwatch.GetElapsed() < fastest.elapsed) {
+      fastest = {stopwatch.GetElapsed(), g_allocations.load() - allocations};
+    }
+  }
+  return fastest;
+}
+
+void Report(const Shape &shape, absl::string_view name, const Result &result) {
+  const int ops = absl::GetFlag(FLAGS_ops);
+  std::cout << std::left << std::setw(12) << shape.name << std::setw(10)
+            << name << std::right << std::setw(12)
+            << absl::StrCat(
+                   static_cast<int64_t>(
+                       absl::ToDoubleNanoseconds(result.elapsed) / ops),
+                   " ns")
+            << std::setw(12)
+            << absl::StrCat(result.allocations / ops, " allocs") << std::endl;
+}
+
+void Run(const Shape &shape) {
+  const int ops = absl::GetFlag(FLAGS_ops);
+  Segments segments;
+  Fill(shape, &segments);
+
+  // Refills the Segments, which reuses the cleared segments and candidates.
+  Report(shape, "Fill", Measure([&] {
+           for (int i = 0; i < ops; ++i) {
+             Fill(shape, &segments);
+           }
+         }));
+
+  // Copies into a Segments used before, e.g., the undo buffer.
+  Segments copy = segments;
+  Report(shape, "Copy", Measure([&] {
+           for (int i = 0; i < ops; ++i) {
+             copy = segments;
+           }
+         }));
+
+  // Copies into a new Segments, which allocates everything.
+  size_t size = 0;
+  Report(shape, "CopyNew", Measure([&] {
+           for (int i = 0; i < ops; ++i) {
+             const Segments new_copy = segments;
+             size += new_copy.segments_size();
+           }
+         }));
+  CHECK_GT(size, 0);
+}
+
+}  // namespace
+}  // namespace mozc
+
+int main(int argc, char **argv) {
+  mozc::InitMozc(argv[0], &argc, &argv);
+  for (const mozc::Shape &shape : mozc::kShapes) {
+    mozc::Run(shape);
+  }
+  return 0;
+}
@@ -66,8 +66,8 @@ MATCHER_P(EqualsCandidate, candidate, "") {
   COMPARE_FIELD(description);
   COMPARE_FIELD(a11y_description);
   COMPARE_FIELD(usage_id);
-  COMPARE_FIELD(usage_title);
-  COMPARE_FIELD(usage_description);
+  COMPARE_FIELD(usage_title());
+  COMPARE_FIELD(usage_description());
   COMPARE_FIELD(cost);
   COMPARE_FIELD(wcost);
   COMPARE_FIELD(structure_cost);
@@ -84,9 +84,10 @@ MATCHER_P(EqualsCandidate, candidate, "") {
 }
 
 // Checks if a segment exactly matches the given segment except for the
-// following two fields:
+// following fields:
 //   * removed_candidates_for_debug_
 //   * pool_
+//   * pool_size_in_use_
 // Note: this is more useful than defining operator==() in testing as it can
 // display which field is different.
 //
@@ -294,8 +294,9 @@ TEST(CandidateTest, IsValid) {
   c.prefix = "prefix";
   c.suffix = "suffix";
   c.description = "description";
-  c.usage_title = "usage_title";
-  c.usage_description = "usage_description";
+  c.usage = std::make_shared<const Segment::Candidate::Usage>(
+      Segment::Candidate::Usage{.title = "usage_title",
+                                .description = "usage_description"});
   c.cost = 1;
   c.wcost = 2;
   c.structure_cost = 3;
@@ -402,6 +403,24 @@ TEST(SegmentsTest, CopyTest) {
   }
 }
 
+TEST(SegmentsTest, ReuseSegmentsAfterClear) {
+  Segments segments;
+  Segment *segment = segments.add_segment();
+  segment->set_key("key");
+  Segment::Candidate *candidate = segment->add_candidate();
+  candidate->value = "value";
+
+  segments.Clear();
+  EXPECT_EQ(segments.segments_size(), 0);
+
+  Segment *reused = segments.add_segment();
+  EXPECT_EQ(reused, segment);
+  EXPECT_TRUE(reused->key().empty());
+  EXPECT_EQ(reused->candidates_size(), 0);
+  EXPECT_EQ(reused->add_candidate(), candidate);
+  EXPECT_TRUE(candidate->value.empty());
+}
+
 TEST(CandidateTest, functional_key) {
   Segment::Candidate candidate;
 
@@ -550,6 +569,57 @@ TEST(SegmentTest, Copy) {
   EXPECT_EQ(dest.meta_candidate(0).key, src.meta_candidate(0).key);
 }
 
+TEST(SegmentTest, ReuseCandidatesAfterClear) {
+  Segment segment;
+  Segment::Candidate *candidate1 = segment.add_candidate();
+  candidate1->key = "key1";
+  candidate1->value = "value1";
+  candidate1->cost = 100;
+  candidate1->inner_segment_boundary.push_back(1);
+  Segment::Candidate *candidate2 = segment.add_candidate();
+  candidate2->key = "key2";
+  segment.insert_candidate(0, std::make_unique<Segment::Candidate>());
+
+  segment.Clear();
+  EXPECT_EQ(segment.candidates_size(), 0);
+
+  // The candidate objects are reused and cleared.
+  const Segment::Candidate *reused = segment.add_candidate();
+  EXPECT_EQ(reused, candidate1);
+  EXPECT_TRUE(reused->key.empty());
+  EXPECT_TRUE(reused->value.empty());
+  EXPECT_EQ(reused->cost, 0);
+  EXPECT_TRUE(reused->inner_segment_boundary.empty());
+  EXPECT_EQ(segment.push_front_candidate(), candidate2);
+
+  // Adopted candidates don't overwrite the candidates in use.
+  auto adopted = std::make_unique<Segment::Candidate>();
+  adopted->key = "adopted";
+  segment.insert_candidate(2, std::move(adopted));
+  Segment::Candidate *candidate3 = segment.add_candidate();
+  EXPECT_NE(candidate3, candidate1);
+  EXPECT_NE(candidate3, candidate2);
+  EXPECT_EQ(segment.candidate(2).key, "adopted");
+  EXPECT_TRUE(candidate3->key.empty());
+}
+
+TEST(SegmentTest, ShrinkCandidatePoolOnClear) {
+  Segment segment;
+  for (size_t i = 0; i < Segment::kMaxPooledCandidates + 10; ++i) {
+    segment.add_candidate();
+  }
+  EXPECT_EQ(segment.pool_.size(), Segment::kMaxPooledCandidates + 10);
+
+  // The candidates over the limit are released.
+  segment.clear_candidates();
+  EXPECT_EQ(segment.pool_.size(), Segment::kMaxPooledCandidates);
+
+  // The candidates under the limit are kept for reuse.
+  segment.add_candidate();
+  segment.clear_candidates();
+  EXPECT_EQ(segment.pool_.size(), Segment::kMaxPooledCandidates);
+}
+
 TEST(SegmentTest, MetaCandidateTest) {
   Segment segment;
 
@@ -48,6 +48,7 @@
 #include "absl/strings/str_split.h"
 #include "absl/strings/string_view.h"
 #include "absl/types/span.h"
+#include "base/container/serialized_key_index.h"
 #include "base/container/serialized_string_array.h"
 #include "base/mmap.h"
 #include "base/version.h"
@@ -164,6 +165,7 @@ DataManager::Status DataManager::InitFromArray(absl::string_view array,
     LOG(ERROR) << "Binary data of size " << array.size() << " is broken";
     return DataManager::Status::DATA_BROKEN;
   }
+  data_size_ = array.size();
   return InitFromReader(reader);
 }
 
@@ -174,6 +176,7 @@ DataManager::Status DataManager::InitFromArray(absl::string_view array,
     LOG(ERROR) << "Binary data of size " << array.size() << " is broken";
     return DataManager::Status::DATA_BROKEN;
   }
+  data_size_ = array.size();
   return InitFromReader(reader);
 }
 
@@ -306,8 +309,12 @@ DataManager::Status DataManager::InitFromReader(const DataSetReader &reader) {
     LOG(ERROR) << "Cannot find a symbol string array or data is broken";
     return Status::DATA_MISSING;
   }
+  // The key indices are optional; data without them falls back to binary
+  // search.
+  reader.Get("symbol_key_index", &symbol_key_index_data_);
   if (!SerializedDictionary::VerifyData(symbol_token_array_data_,
-                                        symbol_string_array_data_)) {
+                                        symbol_string_array_data_,
+                                        symbol_key_index_data_)) {
     LOG(ERROR) << "Symbol dictionary data is broken";
     return Status::DATA_BROKEN;
   }
@@ -319,8 +326,10 @@ DataManager::Status DataManager::InitFromReader(const DataSetReader &reader) {
     LOG(ERROR) << "Cannot find an emoticon string array or data is broken";
     return Status::DATA_MISSING;
   }
+  reader.Get("emoticon_key_index", &emoticon_key_index_data_);
   if (!SerializedDictionary::VerifyData(emoticon_token_array_data_,
-                                        emoticon_string_array_data_)) {
+                                        emoticon_string_array_data_,
+                                        emoticon_key_index_data_)) {
     LOG(ERROR) << "Emoticon dictionary data is broken";
     return Status::DATA_BROKEN;
   }
@@ -336,6 +345,16 @@ DataManager::Status DataManager::InitFromReader(const DataSetReader &reader) {
     LOG(ERROR) << "Emoji rewriter string array data is broken";
     return Status::DATA_BROKEN;
   }
+  if (reader.Get("emoji_key_index", &emoji_key_index_data_)) {
+    // Each emoji token consists of 7 uint32_t values.
+    constexpr size_t kEmojiTokenByteSize = 7 * sizeof(uint32_t);
+    if (!SerializedKeyIndex::VerifyData(
+            emoji_key_index_data_,
+            emoji_token_array_data_.size() / kEmojiTokenByteSize)) {
+      LOG(ERROR) << "Emoji rewriter key index data is broken";
+      return Status::DATA_BROKEN;
+    }
+  }
   if (!reader.Get("single_kanji_token", &single_kanji_token_array_data_) ||
       !reader.Get("single_kanji_string", &single_kanji_string_array_data_) ||
       !reader.Get("single_kanji_variant_type",
@@ -565,6 +584,18 @@ void DataManager::GetEmojiRewriterData(
   *string_array_data = emoji_string_array_data_;
 }
 
+absl::string_view DataManager::GetSymbolRewriterKeyIndexData() const {
+  return symbol_key_index_data_;
+}
+
+absl::string_view DataManager::GetEmoticonRewriterKeyIndexData() const {
+  return emoticon_key_index_data_;
+}
+
+absl::string_view DataManager::GetEmojiRewriterKeyIndexData() const {
+  return emoji_key_index_data_;
+}
+
 void DataManager::GetSingleKanjiRewriterData(
     absl::string_view *token_array_data, absl::string_view *string_array_data,
     absl::string_view *variant_type_array_data,
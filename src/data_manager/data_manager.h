@@ -134,6 +134,11 @@ class DataManager {
       absl::string_view *string_array_data) const;
   virtual void GetEmojiRewriterData(absl::string_view *token_array_data,
                                     absl::string_view *string_array_data) const;
+  // Optional SerializedKeyIndex images for the above three data.  Empty if the
+  // data set doesn't have them.
+  virtual absl::string_view GetSymbolRewriterKeyIndexData() const;
+  virtual absl::string_view GetEmoticonRewriterKeyIndexData() const;
+  virtual absl::string_view GetEmojiRewriterKeyIndexData() const;
   virtual void GetSingleKanjiRewriterData(
       absl::string_view *token_array_data, absl::string_view *string_array_data,
       absl::string_view *variant_type_array_data,
@@ -161,6 +166,9 @@ class DataManager {
 
   virtual absl::string_view GetDataVersion() const;
 
+  // Returns the size of the whole data set in bytes.
+  size_t GetDataSize() const { return data_size_; }
+
   virtual std::optional<std::pair<size_t, size_t>> GetOffsetAndSize(
       absl::string_view name) const;
 
@@ -169,6 +177,7 @@ class DataManager {
 
   std::optional<std::string> filename_ = std::nullopt;
   Mmap mmap_;
+  size_t data_size_ = 0;
   absl::string_view pos_matcher_data_;
   absl::string_view user_pos_token_array_data_;
   absl::string_view user_pos_string_array_data_;
@@ -193,10 +202,13 @@ class DataManager {
   absl::string_view reading_correction_correction_array_data_;
   absl::string_view symbol_token_array_data_;
   absl::string_view symbol_string_array_data_;
+  absl::string_view symbol_key_index_data_;
   absl::string_view emoticon_token_array_data_;
   absl::string_view emoticon_string_array_data_;
+  absl::string_view emoticon_key_index_data_;
   absl::string_view emoji_token_array_data_;
   absl::string_view emoji_string_array_data_;
+  absl::string_view emoji_key_index_data_;
   absl::string_view single_kanji_token_array_data_;
   absl::string_view single_kanji_string_array_data_;
   absl::string_view single_kanji_variant_type_data_;
@@ -44,6 +44,7 @@
         '<(mozc_oss_src_dir)/base/absl.gyp:absl_status',
         '<(mozc_oss_src_dir)/base/absl.gyp:absl_strings',
         '<(mozc_oss_src_dir)/base/base.gyp:base',
+        '<(mozc_oss_src_dir)/base/base.gyp:serialized_key_index',
         '<(mozc_oss_src_dir)/base/base.gyp:serialized_string_array',
         '<(mozc_oss_src_dir)/base/base.gyp:version',
         '<(mozc_oss_src_dir)/protocol/protocol.gyp:segmenter_data_proto',
@@ -132,6 +133,7 @@
         '<(mozc_oss_src_dir)/base/absl.gyp:absl_strings',
         '<(mozc_oss_src_dir)/base/base.gyp:base',
         '<(mozc_oss_src_dir)/base/base.gyp:number_util',
+        '<(mozc_oss_src_dir)/base/base.gyp:serialized_key_index',
         '<(mozc_oss_src_dir)/base/base.gyp:serialized_string_array',
       ],
     },
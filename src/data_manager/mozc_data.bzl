@@ -186,10 +186,13 @@ def mozc_dataset(
         "reading_correction_correction:32:$(@D)/reading_correction_correction.data " +
         "symbol_token:32:$(@D)/symbol_token.data " +
         "symbol_string:32:$(@D)/symbol_string.data " +
+        "symbol_key_index:32:$(@D)/symbol_key_index.data " +
         "emoticon_token:32:$(@D)/emoticon_token.data " +
         "emoticon_string:32:$(@D)/emoticon_string.data " +
+        "emoticon_key_index:32:$(@D)/emoticon_key_index.data " +
         "emoji_token:32:$(@D)/emoji_token.data " +
         "emoji_string:32:$(@D)/emoji_string.data " +
+        "emoji_key_index:32:$(@D)/emoji_key_index.data " +
         "single_kanji_token:32:$(@D)/single_kanji_token.data " +
         "single_kanji_string:32:$(@D)/single_kanji_string.data " +
         "single_kanji_variant_type:32:$(@D)/single_kanji_variant_type.data " +
@@ -531,6 +534,7 @@ def mozc_dataset(
         outs = [
             "symbol_token.data",
             "symbol_string.data",
+            "symbol_key_index.data",
         ],
         cmd = (
             "$(location //rewriter:gen_symbol_rewriter_dictionary_main) " +
@@ -539,7 +543,8 @@ def mozc_dataset(
             "--sorting_table=$(location " + sorting_map + ") " +
             "--ordering_rule=$(location " + symbol_ordering_rule + ") " +
             "--output_token_array=$(location :symbol_token.data) " +
-            "--output_string_array=$(location :symbol_string.data)"
+            "--output_string_array=$(location :symbol_string.data) " +
+            "--output_key_index=$(location :symbol_key_index.data)"
         ),
         tools = ["//rewriter:gen_symbol_rewriter_dictionary_main"],
     )
@@ -550,12 +555,14 @@ def mozc_dataset(
         outs = [
             "emoticon_token.data",
             "emoticon_string.data",
+            "emoticon_key_index.data",
         ],
         cmd = (
             "$(location //rewriter:gen_emoticon_rewriter_data) " +
             "--input=$< " +
             "--output_token_array=$(location :emoticon_token.data) " +
-            "--output_string_array=$(location :emoticon_string.data)"
+            "--output_string_array=$(location :emoticon_string.data) " +
+            "--output_key_index=$(location :emoticon_key_index.data)"
         ),
         tools = ["//rewriter:gen_emoticon_rewriter_data"],
     )
@@ -566,12 +573,14 @@ def mozc_dataset(
         outs = [
             "emoji_token.data",
             "emoji_string.data",
+            "emoji_key_index.data",
         ],
         cmd = (
             "$(location //rewriter:gen_emoji_rewriter_data) " +
             "--input=$< " +
             "--output_token_array=$(location :emoji_token.data) " +
-            "--output_string_array=$(location :emoji_string.data)"
+            "--output_string_array=$(location :emoji_string.data) " +
+            "--output_key_index=$(location :emoji_key_index.data)"
         ),
         tools = ["//rewriter:gen_emoji_rewriter_data"],
     )
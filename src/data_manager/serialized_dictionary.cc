@@ -35,6 +35,7 @@
 #include <istream>
 #include <map>
 #include <memory>
+#include <optional>
 #include <string>
 #include <utility>
 #include <vector>
@@ -45,6 +46,7 @@
 #include "absl/strings/str_split.h"
 #include "absl/strings/string_view.h"
 #include "base/bits.h"
+#include "base/container/serialized_key_index.h"
 #include "base/container/serialized_string_array.h"
 #include "base/file_stream.h"
 #include "base/file_util.h"
@@ -89,17 +91,27 @@ void LoadTokens(std::istream *ifs, std::map<std::string, TokenList> *dic) {
 }  // namespace
 
 SerializedDictionary::SerializedDictionary(absl::string_view token_array,
-                                           absl::string_view string_array_data)
+                                           absl::string_view string_array_data,
+                                           absl::string_view key_index_data)
     : token_array_(token_array) {
-  DCHECK(VerifyData(token_array, string_array_data));
+  DCHECK(VerifyData(token_array, string_array_data, key_index_data));
   string_array_.Set(string_array_data);
+  if (!key_index_data.empty()) {
+    key_index_.Set(key_index_data);
+  }
 }
 
 SerializedDictionary::IterRange SerializedDictionary::equal_range(
     absl::string_view key) const {
-  // TODO(noriyukit): Instead of comparing key as string, we can do binary
-  // search using key index to minimize string comparison cost.
-  return std::equal_range(begin(), end(), key);
+  if (key_index_.empty()) {
+    return std::equal_range(begin(), end(), key);
+  }
+  const std::optional<SerializedKeyIndex::Range> range = key_index_.Find(
+      key, [this](uint32_t i) { return (begin() + i).key(); });
+  if (!range.has_value()) {
+    return IterRange(end(), end());
+  }
+  return IterRange(begin() + range->first, begin() + range->second);
 }
 
 std::pair<absl::string_view, absl::string_view> SerializedDictionary::Compile(
@@ -189,26 +201,54 @@ std::pair<absl::string_view, absl::string_view> SerializedDictionary::Compile(
                                                          string_array);
 }
 
+absl::string_view SerializedDictionary::CompileKeyIndex(
+    absl::string_view token_array, absl::string_view string_array,
+    std::unique_ptr<uint32_t[]> *output_key_index_buf) {
+  const SerializedDictionary dic(token_array, string_array);
+  // Tokens are sorted by key, so each key occupies a contiguous range.
+  std::vector<SerializedKeyIndex::Entry> entries;
+  uint32_t begin = 0;
+  for (uint32_t i = 1; i <= dic.size(); ++i) {
+    if (i < dic.size() &&
+        (dic.begin() + i).key_index() == (dic.begin() + begin).key_index()) {
+      continue;
+    }
+    entries.push_back({(dic.begin() + begin).key(), begin, i});
+    begin = i;
+  }
+  return SerializedKeyIndex::SerializeToBuffer(entries, output_key_index_buf);
+}
+
 void SerializedDictionary::CompileToFiles(
     const std::string &input, const std::string &output_token_array,
-    const std::string &output_string_array) {
+    const std::string &output_string_array,
+    const std::string &output_key_index) {
   InputFileStream ifs(input);
   CHECK(ifs.good());
   std::map<std::string, TokenList> dic;
   LoadTokens(&ifs, &dic);
-  CompileToFiles(dic, output_token_array, output_string_array);
+  CompileToFiles(dic, output_token_array, output_string_array,
+                 output_key_index);
 }
 
 void SerializedDictionary::CompileToFiles(
     const std::map<std::string, TokenList> &dic,
     const std::string &output_token_array,
-    const std::string &output_string_array) {
+    const std::string &output_string_array,
+    const std::string &output_key_index) {
   std::unique_ptr<uint32_t[]> buf1, buf2;
   const std::pair<absl::string_view, absl::string_view> data =
       Compile(dic, &buf1, &buf2);
   CHECK(VerifyData(data.first, data.second));
   CHECK_OK(FileUtil::SetContents(output_token_array, data.first));
   CHECK_OK(FileUtil::SetContents(output_string_array, data.second));
+  if (!output_key_index.empty()) {
+    std::unique_ptr<uint32_t[]> buf3;
+    const absl::string_view key_index =
+        CompileKeyIndex(data.first, data.second, &buf3);
+    CHECK(VerifyData(data.first, data.second, key_index));
+    CHECK_OK(FileUtil::SetContents(output_key_index, key_index));
+  }
 }
 
 bool SerializedDictionary::VerifyData(absl::string_view token_array_data,
@@ -234,4 +274,15 @@ bool SerializedDictionary::VerifyData(absl::string_view token_array_data,
   return true;
 }
 
+bool SerializedDictionary::VerifyData(absl::string_view token_array_data,
+                                      absl::string_view string_array_data,
+                                      absl::string_view key_index_data) {
+  if (!VerifyData(token_array_data, string_array_data)) {
+    return false;
+  }
+  return key_index_data.empty() ||
+         SerializedKeyIndex::VerifyData(
+             key_index_data, token_array_data.size() / kTokenByteLength);
+}
+
 }  // namespace mozc
@@ -42,6 +42,7 @@
 
 #include "absl/log/check.h"
 #include "absl/strings/string_view.h"
+#include "base/container/serialized_key_index.h"
 #include "base/container/serialized_string_array.h"
 
 namespace mozc {
@@ -109,6 +110,12 @@ namespace mozc {
 // byte boundary by the insertion of padding.  String values of a token (key,
 // value, description, additional_description) can be retrieved from the string
 // array by index.
+//
+// ** Key index (optional)
+// SerializedKeyIndex from each key to its range in the token array.  When it is
+// given, equal_range() finds the range by hash instead of binary search with
+// string comparisons.  Use SerializedDictionary::CompileKeyIndex() to create
+// it.
 class SerializedDictionary {
  public:
   struct CompilerToken {
@@ -316,22 +323,34 @@ class SerializedDictionary {
       std::unique_ptr<uint32_t[]> *output_token_array_buf,
       std::unique_ptr<uint32_t[]> *output_string_array_buf);
 
-  // Creates serialized data and writes them to files.
+  // Creates the key index of the serialized data into the buffer.
+  static absl::string_view CompileKeyIndex(
+      absl::string_view token_array, absl::string_view string_array,
+      std::unique_ptr<uint32_t[]> *output_key_index_buf);
+
+  // Creates serialized data and writes them to files.  The key index is
+  // written only if |output_key_index| is not empty.
   static void CompileToFiles(const std::string &input,
                              const std::string &output_token_array,
-                             const std::string &output_string_array);
+                             const std::string &output_string_array,
+                             const std::string &output_key_index = "");
   static void CompileToFiles(const std::map<std::string, TokenList> &dic,
                              const std::string &output_token_array,
-                             const std::string &output_string_array);
+                             const std::string &output_string_array,
+                             const std::string &output_key_index = "");
 
   // Validates the serialized data.
   static bool VerifyData(absl::string_view token_array_data,
                          absl::string_view string_array_data);
+  static bool VerifyData(absl::string_view token_array_data,
+                         absl::string_view string_array_data,
+                         absl::string_view key_index_data);
 
-  // Both |token_array| and |string_array_data| must be aligned at 4-byte
-  // boundary.
+  // |token_array|, |string_array_data| and |key_index_data| must be aligned at
+  // 4-byte boundary.  |key_index_data| may be empty.
   SerializedDictionary(absl::string_view token_array,
-                       absl::string_view string_array_data);
+                       absl::string_view string_array_data,
+                       absl::string_view key_index_data = "");
   ~SerializedDictionary() = default;
 
   std::size_t size() const { return token_array_.size() / kTokenByteLength; }
@@ -349,12 +368,14 @@ class SerializedDictionary {
   }
 
   // Returns the range of iterators whose keys match the given key.  The range
-  // is sorted in ascending order of cost.
+  // is sorted in ascending order of cost.  If the key is not found, the range
+  // is empty but, with the key index, doesn't point to the insertion position.
   IterRange equal_range(absl::string_view key) const;
 
  private:
   absl::string_view token_array_;
   SerializedStringArray string_array_;
+  SerializedKeyIndex key_index_;
 };
 
 }  // namespace mozc
@@ -184,5 +184,32 @@ TEST_F(SerializedDictionaryTest, EqualRange) {
   }
 }
 
+TEST_F(SerializedDictionaryTest, EqualRangeWithKeyIndex) {
+  std::unique_ptr<uint32_t[]> buf;
+  const absl::string_view key_index = SerializedDictionary::CompileKeyIndex(
+      token_array_data_, string_array_data_, &buf);
+  ASSERT_TRUE(SerializedDictionary::VerifyData(
+      token_array_data_, string_array_data_, key_index));
+
+  const SerializedDictionary dic(token_array_data_, string_array_data_,
+                                 key_index);
+  const SerializedDictionary expected(token_array_data_, string_array_data_);
+  for (const absl::string_view key : {"key1", "key2", "mozc"}) {
+    EXPECT_EQ(dic.equal_range(key).first - dic.begin(),
+              expected.equal_range(key).first - expected.begin())
+        << key;
+    EXPECT_EQ(dic.equal_range(key).second - dic.begin(),
+              expected.equal_range(key).second - expected.begin())
+        << key;
+  }
+  for (const absl::string_view key : {"", "key", "key10"}) {
+    const SerializedDictionary::IterRange range = dic.equal_range(key);
+    EXPECT_EQ(range.first, range.second) << key;
+  }
+  const SerializedDictionary::IterRange range = dic.equal_range("key1");
+  EXPECT_EQ(range.second - range.first, 2);
+  EXPECT_EQ(range.first.value(), "value2");
+}
+
 }  // namespace
 }  // namespace mozc
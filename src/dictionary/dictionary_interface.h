@@ -30,6 +30,7 @@
 #ifndef MOZC_DICTIONARY_DICTIONARY_INTERFACE_H_
 #define MOZC_DICTIONARY_DICTIONARY_INTERFACE_H_
 
+#include <cstdint>
 #include <string>
 #include <vector>
 
@@ -180,6 +181,11 @@ class UserDictionaryInterface : public DictionaryInterface {
   // Loads dictionary from UserDictionaryStorage.
   // mainly for unit testing
   virtual bool Load(const user_dictionary::UserDictionaryStorage &storage) = 0;
+
+  // Returns a number that changes whenever the entries are replaced, either by
+  // Load() or by the asynchronous reloader. Callers caching lookup results can
+  // compare it to detect stale results.
+  virtual uint64_t generation() const { return 0; }
 };
 
 }  // namespace dictionary
@@ -57,6 +57,7 @@
 #include <utility>
 #include <vector>
 
+#include "absl/algorithm/container.h"
 #include "absl/container/btree_set.h"
 #include "absl/log/check.h"
 #include "absl/log/log.h"
@@ -64,6 +65,7 @@
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/string_view.h"
+#include "absl/types/span.h"
 #include "base/japanese_util.h"
 #include "base/mmap.h"
 #include "base/strings/unicode.h"
@@ -78,6 +80,7 @@
 #include "dictionary/system/token_decode_iterator.h"
 #include "dictionary/system/words_info.h"
 #include "request/conversion_request.h"
+#include "storage/derived_data_cache.h"
 #include "storage/louds/bit_vector_based_array.h"
 #include "storage/louds/louds_trie.h"
 
@@ -273,12 +276,54 @@ class SystemDictionary::ReverseLookupCache {
   std::multimap<int, ReverseLookupResult> results;
 };
 
+// The index from value id to the reverse lookup results. The results of all
+// the value ids are stored in one int array so that it can be shared through
+// DerivedDataCache:
+//
+//   [number of value ids: N]
+//   [offsets: N + 1 ints]  (the results of id i are in [offsets[i],
+//                           offsets[i + 1]) of the results array)
+//   [results: (tokens_offset, id_in_key_trie) for each result]
 class SystemDictionary::ReverseLookupIndex {
  public:
   ReverseLookupIndex(const ReverseLookupIndex &) = delete;
   ReverseLookupIndex &operator=(const ReverseLookupIndex &) = delete;
   ReverseLookupIndex(const SystemDictionaryCodecInterface *codec,
-                     const BitVectorBasedArray &token_array) {
+                     const BitVectorBasedArray &token_array,
+                     storage::DerivedDataCache *cache) {
+    if (cache == nullptr) {
+      storage_ = BuildIndex(codec, token_array);
+      CHECK(Init(storage_));
+      return;
+    }
+    const absl::Span<const int> index = cache->GetOrBuild(
+        "system_dictionary/reverse_lookup_index",
+        [&]() { return BuildIndex(codec, token_array); }, &IsValidIndex);
+    CHECK(Init(index));
+  }
+
+  ~ReverseLookupIndex() = default;
+
+  void FillResultMap(const absl::btree_set<int> &id_set,
+                     std::multimap<int, ReverseLookupResult> *result_map) {
+    for (absl::btree_set<int>::const_iterator id_itr = id_set.begin();
+         id_itr != id_set.end(); ++id_itr) {
+      if (*id_itr < 0 || *id_itr >= index_size_) {
+        continue;
+      }
+      for (int i = offsets_[*id_itr]; i < offsets_[*id_itr + 1]; ++i) {
+        ReverseLookupResult result;
+        result.tokens_offset = results_[2 * i];
+        result.id_in_key_trie = results_[2 * i + 1];
+        result_map->insert(std::make_pair(*id_itr, result));
+      }
+    }
+  }
+
+ private:
+  static std::vector<int> BuildIndex(
+      const SystemDictionaryCodecInterface *codec,
+      const BitVectorBasedArray &token_array) {
     // Gets id size.
     int value_id_max = -1;
     for (TokenScanIterator iter(codec, token_array); !iter.Done();
@@ -288,80 +333,75 @@ class SystemDictionary::ReverseLookupIndex {
     }
 
     CHECK_GE(value_id_max, 0);
-    index_size_ = value_id_max + 1;
-    index_ = std::make_unique<ReverseLookupResultArray[]>(index_size_);
+    const int index_size = value_id_max + 1;
 
-    // Gets result size for each ids.
+    // Gets result size for each ids, and converts them to the offsets.
+    std::vector<int> offsets(index_size + 1, 0);
     for (TokenScanIterator iter(codec, token_array); !iter.Done();
          iter.Next()) {
       const TokenScanIterator::Result &result = iter.Get();
       if (result.value_id != -1) {
-        DCHECK_LT(result.value_id, index_size_);
-        ++(index_[result.value_id].size);
+        DCHECK_LT(result.value_id, index_size);
+        ++offsets[result.value_id + 1];
       }
     }
-
-    for (size_t i = 0; i < index_size_; ++i) {
-      index_[i].results =
-          std::make_unique<ReverseLookupResult[]>(index_[i].size);
+    for (int i = 0; i < index_size; ++i) {
+      offsets[i + 1] += offsets[i];
     }
 
-    // Builds index.
+    std::vector<int> index;
+    index.reserve(1 + offsets.size() + 2 * offsets.back());
+    index.push_back(index_size);
+    index.insert(index.end(), offsets.begin(), offsets.end());
+    const size_t results_begin = index.size();
+    index.resize(results_begin + 2 * offsets.back());
+
+    // Builds index. The results of each id are stored in the scan order.
     for (TokenScanIterator iter(codec, token_array); !iter.Done();
          iter.Next()) {
       const TokenScanIterator::Result &result = iter.Get();
       if (result.value_id == -1) {
         continue;
       }
-
-      DCHECK_LT(result.value_id, index_size_);
-      ReverseLookupResultArray *result_array = &index_[result.value_id];
-
-      // Finds uninitialized result.
-      size_t result_index = 0;
-      for (result_index = 0; result_index < result_array->size;
-           ++result_index) {
-        const ReverseLookupResult &lookup_result =
-            result_array->results[result_index];
-        if (lookup_result.tokens_offset == -1 &&
-            lookup_result.id_in_key_trie == -1) {
-          result_array->results[result_index].tokens_offset =
-              result.tokens_offset;
-          result_array->results[result_index].id_in_key_trie = result.index;
-          break;
-        }
-      }
+      const int pos = offsets[result.value_id]++;
+      index[results_begin + 2 * pos] = result.tokens_offset;
+      index[results_begin + 2 * pos + 1] = result.index;
     }
-
-    CHECK(index_ != nullptr);
+    return index;
   }
 
-  ~ReverseLookupIndex() = default;
-
-  void FillResultMap(const absl::btree_set<int> &id_set,
-                     std::multimap<int, ReverseLookupResult> *result_map) {
-    for (absl::btree_set<int>::const_iterator id_itr = id_set.begin();
-         id_itr != id_set.end(); ++id_itr) {
-      const ReverseLookupResultArray &result_array = index_[*id_itr];
-      for (size_t i = 0; i < result_array.size; ++i) {
-        result_map->insert(std::make_pair(*id_itr, result_array.results[i]));
-      }
+  // Returns true if `index` is well-formed, i.e. the offsets start with 0, are
+  // monotonic and end at the number of the results.
+  static bool IsValidIndex(absl::Span<const int> index) {
+    if (index.empty() || index[0] < 0 ||
+        index.size() < static_cast<size_t>(index[0]) + 2) {
+      return false;
     }
+    const absl::Span<const int> offsets = index.subspan(1, index[0] + 1);
+    const absl::Span<const int> results = index.subspan(index[0] + 2);
+    if (offsets.front() != 0 || !absl::c_is_sorted(offsets)) {
+      return false;
+    }
+    return results.size() == 2 * static_cast<size_t>(offsets.back());
   }
 
- private:
-  struct ReverseLookupResultArray {
-    ReverseLookupResultArray() : size(0) {}
-    // Use std::unique_ptr for reducing memory consumption as possible.
-    // Using vector requires 90 MB even when we call resize explicitly.
-    // On the other hand, std::unique_ptr requires 57 MB.
-    std::unique_ptr<ReverseLookupResult[]> results;
-    size_t size;
-  };
+  // Points the members to the arrays in `index`. Returns false if `index` is
+  // broken.
+  bool Init(absl::Span<const int> index) {
+    if (!IsValidIndex(index)) {
+      return false;
+    }
+    index_size_ = index[0];
+    offsets_ = index.subspan(1, index_size_ + 1);
+    results_ = index.subspan(index_size_ + 2);
+    return true;
+  }
 
-  // Use scoped array for reducing memory consumption as possible.
-  std::unique_ptr<ReverseLookupResultArray[]> index_;
-  size_t index_size_;
+  int index_size_ = 0;
+  absl::Span<const int> offsets_;
+  absl::Span<const int> results_;
+  // Owns the index when it is not in DerivedDataCache.
+  std::vector<int> storage_;
 };
 
 struct SystemDictionary::PredictiveLookupSearchState {
@@ -395,6 +435,12 @@ SystemDictionary::Builder &SystemDictionary::Builder::SetCodec(
   return *this;
 }
 
+SystemDictionary::Builder &SystemDictionary::Builder::SetDerivedDataCache(
+    storage::DerivedDataCache *cache) {
+  spec_->derived_data_cache = cache;
+  return *this;
+}
+
 absl::StatusOr<std::unique_ptr<SystemDictionary>>
 SystemDictionary::Builder::Build() {
   if (spec_->codec == nullptr) {
@@ -435,7 +481,8 @@ SystemDictionary::Builder::Build() {
   }
 
   if (!instance->OpenDictionaryFile(
-          (spec_->options & ENABLE_REVERSE_LOOKUP_INDEX) != 0)) {
+          (spec_->options & ENABLE_REVERSE_LOOKUP_INDEX) != 0,
+          spec_->derived_data_cache)) {
     return absl::UnknownError("Failed to create system dictionary");
   }
 
@@ -451,14 +498,16 @@ SystemDictionary::SystemDictionary(
 
 SystemDictionary::~SystemDictionary() = default;
 
-bool SystemDictionary::OpenDictionaryFile(bool enable_reverse_lookup_index) {
+bool SystemDictionary::OpenDictionaryFile(bool enable_reverse_lookup_index,
+                                          storage::DerivedDataCache *cache) {
   int len;
 
   const uint8_t *key_image = reinterpret_cast<const uint8_t *>(
       dictionary_file_->GetSection(codec_->GetSectionNameForKey(), &len));
   if (!key_trie_.Open(key_image, kKeyTrieLb0CacheSize, kKeyTrieLb1CacheSize,
                       kKeyTrieSelect0CacheSize, kKeyTrieSelect1CacheSize,
-                      kKeyTrieTermvecCacheSize)) {
+                      kKeyTrieTermvecCacheSize, cache,
+                      "system_dictionary/key_trie")) {
     LOG(ERROR) << "cannot open key trie";
     return false;
   }
@@ -470,14 +519,15 @@ bool SystemDictionary::OpenDictionaryFile(bool enable_reverse_lookup_index) {
   if (!value_trie_.Open(value_image, kValueTrieLb0CacheSize,
                         kValueTrieLb1CacheSize, kValueTrieSelect0CacheSize,
                         kValueTrieSelect1CacheSize,
-                        kValueTrieTermvecCacheSize)) {
+                        kValueTrieTermvecCacheSize, cache,
+                        "system_dictionary/value_trie")) {
     LOG(ERROR) << "can not open value trie";
     return false;
   }
 
   const unsigned char *token_image = reinterpret_cast<const unsigned char *>(
       dictionary_file_->GetSection(codec_->GetSectionNameForTokens(), &len));
-  token_array_.Open(token_image);
+  token_array_.Open(token_image, cache, "system_dictionary/token_array");
 
   frequent_pos_ = reinterpret_cast<const uint32_t *>(
       dictionary_file_->GetSection(codec_->GetSectionNameForPos(), &len));
@@ -487,18 +537,19 @@ bool SystemDictionary::OpenDictionaryFile(bool enable_reverse_lookup_index) {
   }
 
   if (enable_reverse_lookup_index) {
-    InitReverseLookupIndex();
+    InitReverseLookupIndex(cache);
   }
 
   return true;
 }
 
-void SystemDictionary::InitReverseLookupIndex() {
+void SystemDictionary::InitReverseLookupIndex(
+    storage::DerivedDataCache *cache) {
   if (reverse_lookup_index_ != nullptr) {
     return;
   }
   reverse_lookup_index_ =
-      std::make_unique<ReverseLookupIndex>(codec_, token_array_);
+      std::make_unique<ReverseLookupIndex>(codec_, token_array_, cache);
 }
 
 bool SystemDictionary::HasKey(absl::string_view key) const {
@@ -45,6 +45,7 @@
 #include "dictionary/system/codec_interface.h"
 #include "dictionary/system/key_expansion_table.h"
 #include "request/conversion_request.h"
+#include "storage/derived_data_cache.h"
 #include "storage/louds/bit_vector_based_array.h"
 #include "storage/louds/louds_trie.h"
 
@@ -88,6 +89,12 @@ class SystemDictionary : public DictionaryInterface {
     // Doesn't take the ownership of |codec|.
     Builder &SetCodec(const SystemDictionaryCodecInterface *codec);
 
+    // Sets the cache of the derived structures, e.g. the indices of the tries
+    // (default: nullptr). They are built on the heap if this is nullptr.
+    // Doesn't take the ownership of |cache|, which needs to outlive the
+    // dictionary.
+    Builder &SetDerivedDataCache(storage::DerivedDataCache *cache);
+
     // Builds and returns system dictionary.
     absl::StatusOr<std::unique_ptr<SystemDictionary>> Build();
 
@@ -107,7 +114,8 @@ class SystemDictionary : public DictionaryInterface {
             len(l),
             options(o),
             codec(codec),
-            file_codec(file_codec) {}
+            file_codec(file_codec),
+            derived_data_cache(nullptr) {}
 
       InputType type;
 
@@ -121,6 +129,7 @@ class SystemDictionary : public DictionaryInterface {
       Options options;
       const SystemDictionaryCodecInterface *codec;
       const DictionaryFileCodecInterface *file_codec;
+      storage::DerivedDataCache *derived_data_cache;
     };
 
     std::unique_ptr<Specification> spec_;
@@ -164,7 +173,8 @@ class SystemDictionary : public DictionaryInterface {
   SystemDictionary(const SystemDictionaryCodecInterface *codec,
                    const DictionaryFileCodecInterface *file_codec);
 
-  bool OpenDictionaryFile(bool enable_reverse_lookup_index);
+  bool OpenDictionaryFile(bool enable_reverse_lookup_index,
+                          storage::DerivedDataCache *cache);
 
   void RegisterReverseLookupTokensForT13N(absl::string_view value,
                                           Callback *callback) const;
@@ -175,7 +185,7 @@ class SystemDictionary : public DictionaryInterface {
   void RegisterReverseLookupResults(const absl::btree_set<int> &id_set,
                                     const ReverseLookupCache &cache,
                                     Callback *callback) const;
-  void InitReverseLookupIndex();
+  void InitReverseLookupIndex(storage::DerivedDataCache *cache);
 
   Callback::ResultType LookupPrefixWithKeyExpansionImpl(
       const char *key, absl::string_view encoded_key,
@@ -569,6 +569,7 @@ void UserDictionary::Swap(std::unique_ptr<TokensIndex> new_tokens) {
   DCHECK(new_tokens);
   absl::WriterMutexLock l(&mutex_);
   tokens_ = std::move(new_tokens);
+  generation_.fetch_add(1, std::memory_order_release);
 }
 
 bool UserDictionary::Load(
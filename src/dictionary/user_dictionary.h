@@ -30,6 +30,8 @@
 #ifndef MOZC_DICTIONARY_USER_DICTIONARY_H_
 #define MOZC_DICTIONARY_USER_DICTIONARY_H_
 
+#include <atomic>
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <vector>
@@ -97,6 +99,10 @@ class UserDictionary : public UserDictionaryInterface {
   // Gets the user POS list.
   std::vector<std::string> GetPosList() const override;
 
+  uint64_t generation() const override {
+    return generation_.load(std::memory_order_acquire);
+  }
+
   // Sets user dictionary filename for unit testing
   static void SetUserDictionaryName(absl::string_view filename);
 
@@ -122,6 +128,7 @@ class UserDictionary : public UserDictionaryInterface {
   SuppressionDictionary *suppression_dictionary_;
   std::unique_ptr<TokensIndex> tokens_ ABSL_GUARDED_BY(mutex_);
   mutable absl::Mutex mutex_;
+  std::atomic<uint64_t> generation_ = 0;
 
   friend class UserDictionaryTest;
 };
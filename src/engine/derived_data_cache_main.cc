@@ -0,0 +1,66 @@
+// Copyright 2010-2021, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Precomputes the cache file of the structures derived from the data set, so
+// that the mozc_server processes sharing --derived_data_cache_dir map it from
+// the start.
+//
+// Usage:
+//   derived_data_cache_main --derived_data_cache_dir=/var/cache/mozc
+
+#include <memory>
+#include <string>
+
+#include "absl/flags/declare.h"
+#include "absl/flags/flag.h"
+#include "absl/log/log.h"
+#include "absl/status/statusor.h"
+#include "base/init_mozc.h"
+#include "engine/engine_factory.h"
+#include "engine/engine_interface.h"
+
+ABSL_DECLARE_FLAG(std::string, derived_data_cache_dir);
+
+int main(int argc, char **argv) {
+  mozc::InitMozc(argv[0], &argc, &argv);
+  if (absl::GetFlag(FLAGS_derived_data_cache_dir).empty()) {
+    LOG(ERROR) << "--derived_data_cache_dir is required";
+    return 1;
+  }
+  // The cache file is written while the modules of the engine are initialized.
+  absl::StatusOr<std::unique_ptr<mozc::EngineInterface>> engine =
+      mozc::EngineFactory::Create();
+  if (!engine.ok()) {
+    LOG(ERROR) << "Failed to create the engine: " << engine.status();
+    return 1;
+  }
+  LOG(INFO) << "Derived data cache is ready in "
+            << absl::GetFlag(FLAGS_derived_data_cache_dir);
+  return 0;
+}
@@ -0,0 +1,219 @@
+// Copyright 2010-2021, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "engine/embedded_converter.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/log/log.h"
+#include "absl/memory/memory.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "absl/types/span.h"
+#include "base/clock.h"
+#include "base/thread.h"
+#include "config/config_handler.h"
+#include "converter/converter_interface.h"
+#include "converter/segments.h"
+#include "engine/engine.h"
+#include "engine/eval_engine_factory.h"
+#include "protocol/config.pb.h"
+#include "request/conversion_request.h"
+
+namespace mozc {
+namespace {
+
+std::string GetTopCandidates(const Segments &segments) {
+  std::string result;
+  for (const Segment &segment : segments.conversion_segments()) {
+    if (segment.candidates_size() == 0) {
+      result.append(segment.key());
+      continue;
+    }
+    result.append(segment.candidate(0).value);
+  }
+  return result;
+}
+
+}  // namespace
+
+double EmbeddedConverter::Stats::SentencesPerSecond() const {
+  const double seconds = absl::ToDoubleSeconds(elapsed_time);
+  if (seconds <= 0) {
+    return 0;
+  }
+  return num_sentences / seconds;
+}
+
+absl::StatusOr<std::unique_ptr<EmbeddedConverter>> EmbeddedConverter::Create(
+    EngineFactory engine_factory, int num_workers) {
+  num_workers = std::max(num_workers, 1);
+  std::vector<std::unique_ptr<Engine>> engines;
+  engines.reserve(num_workers);
+  for (int i = 0; i < num_workers; ++i) {
+    absl::StatusOr<std::unique_ptr<Engine>> engine = engine_factory();
+    if (!engine.ok()) {
+      return std::move(engine).status();
+    }
+    engines.push_back(*std::move(engine));
+  }
+  return absl::WrapUnique(new EmbeddedConverter(std::move(engines)));
+}
+
+absl::StatusOr<std::unique_ptr<EmbeddedConverter>>
+EmbeddedConverter::CreateFromFile(absl::string_view data_file_path,
+                                  absl::string_view data_type,
+                                  absl::string_view engine_type,
+                                  int num_workers) {
+  return Create(
+      [data_file_path, data_type, engine_type]() {
+        return CreateEvalEngine(data_file_path, data_type, engine_type);
+      },
+      num_workers);
+}
+
+EmbeddedConverter::EmbeddedConverter(
+    std::vector<std::unique_ptr<Engine>> engines)
+    : engines_(std::move(engines)) {
+  workers_.reserve(engines_.size());
+  for (const std::unique_ptr<Engine> &engine : engines_) {
+    workers_.emplace_back(
+        [this, &engine = *engine]() { RunWorker(engine); });
+  }
+}
+
+EmbeddedConverter::~EmbeddedConverter() {
+  {
+    absl::MutexLock lock(&mutex_);
+    terminating_ = true;
+  }
+  for (Thread &worker : workers_) {
+    worker.Join();
+  }
+}
+
+std::vector<std::string> EmbeddedConverter::ConvertBatch(
+    absl::Span<const absl::string_view> keys) {
+  std::vector<std::string> results(keys.size());
+  if (keys.empty()) {
+    return results;
+  }
+
+  absl::MutexLock batch_lock(&batch_mutex_);
+  const absl::Time start_time = Clock::GetAbslTime();
+  absl::MutexLock lock(&mutex_);
+  keys_ = &keys;
+  results_ = &results;
+  next_index_ = 0;
+  num_done_ = 0;
+
+  const auto done = [this]() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
+    return num_done_ == keys_->size();
+  };
+  mutex_.Await(absl::Condition(&done));
+
+  keys_ = nullptr;
+  results_ = nullptr;
+  stats_.num_sentences += keys.size();
+  stats_.elapsed_time += Clock::GetAbslTime() - start_time;
+  return results;
+}
+
+std::string EmbeddedConverter::Convert(absl::string_view key) {
+  std::vector<std::string> results = ConvertBatch({key});
+  return std::move(results.front());
+}
+
+EmbeddedConverter::Stats EmbeddedConverter::GetStats() const {
+  absl::MutexLock lock(&mutex_);
+  return stats_;
+}
+
+void EmbeddedConverter::RunWorker(const Engine &engine) {
+  const ConverterInterface &converter = *engine.GetConverter();
+  // Per-worker state. Nothing here is shared with the other workers.
+  Segments segments;
+  // The user data files are shared with the other workers, so nothing may be
+  // learned. See the class comment.
+  config::Config config = config::ConfigHandler::DefaultConfig();
+  config.set_incognito_mode(true);
+  const ConversionRequest base_request =
+      ConversionRequestBuilder()
+          .SetConfig(config)
+          .SetOptions({
+              .request_type = ConversionRequest::CONVERSION,
+              // Batch results should not depend on the order of the inputs.
+              .enable_user_history_for_conversion = false,
+          })
+          .Build();
+
+  const auto has_task = [this]() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
+    return terminating_ ||
+           (keys_ != nullptr && next_index_ < keys_->size());
+  };
+
+  while (true) {
+    absl::string_view key;
+    size_t index = 0;
+    {
+      absl::MutexLock lock(&mutex_);
+      mutex_.Await(absl::Condition(&has_task));
+      if (terminating_) {
+        return;
+      }
+      index = next_index_++;
+      key = (*keys_)[index];
+    }
+
+    std::string result;
+    segments.Clear();
+    const ConversionRequest request = ConversionRequestBuilder()
+                                          .SetConversionRequest(base_request)
+                                          .SetKey(key)
+                                          .Build();
+    if (converter.StartConversion(request, &segments)) {
+      result = GetTopCandidates(segments);
+    } else {
+      LOG(WARNING) << "Conversion failed: " << key;
+    }
+
+    absl::MutexLock lock(&mutex_);
+    (*results_)[index] = std::move(result);
+    ++num_done_;
+  }
+}
+
+}  // namespace mozc
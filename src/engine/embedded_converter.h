@@ -0,0 +1,144 @@
+// Copyright 2010-2021, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef MOZC_ENGINE_EMBEDDED_CONVERTER_H_
+#define MOZC_ENGINE_EMBEDDED_CONVERTER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/functional/any_invocable.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "absl/types/span.h"
+#include "base/thread.h"
+#include "engine/engine.h"
+
+namespace mozc {
+
+// In-process kana-kanji converter for bulk (offline) conversion.
+//
+// EmbeddedConverter drives Converter directly without the IPC and
+// SessionHandler layers. It owns a fixed pool of worker threads, and each
+// worker owns its own Engine, Segments and ConversionRequest, because Converter
+// and the rewriters/predictors behind it are not thread-safe. Engines created
+// from the same data file share the mmap-ed data pages, so the extra memory
+// per worker is limited to the mutable state.
+//
+// The engines are read-only users of the user data. Every engine loads the
+// same user history, LRU and dictionary files of the user profile, and there
+// is no coordination among them. Hence the workers convert in incognito mode
+// and never commit (FinishConversion() is not called), so that no engine
+// learns anything or writes the files back.
+//
+// ConvertBatch() is thread-safe. Concurrent batches are processed one after
+// another, each of them using all the workers.
+//
+// Example:
+//   absl::StatusOr<std::unique_ptr<EmbeddedConverter>> converter =
+//       EmbeddedConverter::CreateFromFile("mozc.data", "oss", "desktop", 4);
+//   std::vector<std::string> results = (*converter)->ConvertBatch(keys);
+class EmbeddedConverter {
+ public:
+  using EngineFactory =
+      absl::AnyInvocable<absl::StatusOr<std::unique_ptr<Engine>>()>;
+
+  struct Stats {
+    // Number of keys converted so far.
+    uint64_t num_sentences = 0;
+    // Accumulated wall time spent in ConvertBatch().
+    absl::Duration elapsed_time = absl::ZeroDuration();
+
+    double SentencesPerSecond() const;
+  };
+
+  // Creates a converter with `num_workers` workers. `engine_factory` is called
+  // once per worker. `num_workers` less than 1 is treated as 1.
+  static absl::StatusOr<std::unique_ptr<EmbeddedConverter>> Create(
+      EngineFactory engine_factory, int num_workers);
+
+  // Creates a converter whose engines are loaded from `data_file_path`.
+  // `data_type` and `engine_type` are the same as CreateEvalEngine(), e.g.
+  // "oss" and "desktop".
+  static absl::StatusOr<std::unique_ptr<EmbeddedConverter>> CreateFromFile(
+      absl::string_view data_file_path, absl::string_view data_type,
+      absl::string_view engine_type, int num_workers);
+
+  EmbeddedConverter(const EmbeddedConverter &) = delete;
+  EmbeddedConverter &operator=(const EmbeddedConverter &) = delete;
+
+  ~EmbeddedConverter();
+
+  // Converts each key (Hiragana) and returns the concatenated top candidates
+  // in the same order as `keys`. An empty string is returned for a key that
+  // fails to be converted.
+  std::vector<std::string> ConvertBatch(absl::Span<const absl::string_view> keys)
+      ABSL_LOCKS_EXCLUDED(batch_mutex_, mutex_);
+
+  // Converts a single key. Equivalent to ConvertBatch() with one key.
+  std::string Convert(absl::string_view key)
+      ABSL_LOCKS_EXCLUDED(batch_mutex_, mutex_);
+
+  size_t num_workers() const { return engines_.size(); }
+
+  Stats GetStats() const ABSL_LOCKS_EXCLUDED(mutex_);
+
+ private:
+  explicit EmbeddedConverter(std::vector<std::unique_ptr<Engine>> engines);
+
+  // Main loop of the worker thread that owns `engine`.
+  void RunWorker(const Engine &engine) ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Serializes the batches.
+  absl::Mutex batch_mutex_;
+  mutable absl::Mutex mutex_;
+  // The batch in progress. Both are null while no batch is running.
+  const absl::Span<const absl::string_view> *keys_ ABSL_GUARDED_BY(mutex_) =
+      nullptr;
+  std::vector<std::string> *results_ ABSL_GUARDED_BY(mutex_) = nullptr;
+  // Index of the next key to be taken by a worker.
+  size_t next_index_ ABSL_GUARDED_BY(mutex_) = 0;
+  // Number of keys whose conversions have finished.
+  size_t num_done_ ABSL_GUARDED_BY(mutex_) = 0;
+  bool terminating_ ABSL_GUARDED_BY(mutex_) = false;
+  Stats stats_ ABSL_GUARDED_BY(mutex_);
+
+  std::vector<std::unique_ptr<Engine>> engines_;
+  std::vector<Thread> workers_;
+};
+
+}  // namespace mozc
+
+#endif  // MOZC_ENGINE_EMBEDDED_CONVERTER_H_
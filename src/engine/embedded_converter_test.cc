@@ -0,0 +1,136 @@
+// Copyright 2010-2021, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "engine/embedded_converter.h"
+
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/strings/string_view.h"
+#include "base/file_util.h"
+#include "base/thread.h"
+#include "engine/mock_data_engine_factory.h"
+#include "prediction/user_history_predictor.h"
+#include "testing/gmock.h"
+#include "testing/gunit.h"
+#include "testing/mozctest.h"
+
+namespace mozc {
+namespace {
+
+using ::testing::Each;
+using ::testing::IsEmpty;
+using ::testing::Not;
+
+class EmbeddedConverterTest : public testing::TestWithTempUserProfile {
+ protected:
+  static std::unique_ptr<EmbeddedConverter> CreateConverter(int num_workers) {
+    return EmbeddedConverter::Create(&MockDataEngineFactory::Create,
+                                     num_workers)
+        .value();
+  }
+};
+
+constexpr absl::string_view kKeys[] = {
+    "わたしのなまえはなかのです",
+    "きょうはいいてんきです",
+    "かんじへんかん",
+    "とうきょう",
+};
+
+TEST_F(EmbeddedConverterTest, ConvertBatch) {
+  std::unique_ptr<EmbeddedConverter> converter = CreateConverter(2);
+  EXPECT_EQ(converter->num_workers(), 2);
+
+  const std::vector<std::string> results = converter->ConvertBatch(kKeys);
+  ASSERT_EQ(results.size(), std::size(kKeys));
+  EXPECT_THAT(results, Each(Not(IsEmpty())));
+  for (size_t i = 0; i < results.size(); ++i) {
+    // The result of a batch is the same as the individual conversion.
+    EXPECT_EQ(results[i], converter->Convert(kKeys[i]));
+  }
+
+  EXPECT_TRUE(converter->ConvertBatch({}).empty());
+
+  const EmbeddedConverter::Stats stats = converter->GetStats();
+  EXPECT_EQ(stats.num_sentences, 2 * std::size(kKeys));
+  EXPECT_GE(stats.SentencesPerSecond(), 0);
+}
+
+TEST_F(EmbeddedConverterTest, ResultsDoNotDependOnNumberOfWorkers) {
+  const std::vector<std::string> expected =
+      CreateConverter(1)->ConvertBatch(kKeys);
+  EXPECT_EQ(CreateConverter(4)->ConvertBatch(kKeys), expected);
+}
+
+TEST_F(EmbeddedConverterTest, ConcurrentBatches) {
+  std::unique_ptr<EmbeddedConverter> converter = CreateConverter(2);
+  const std::vector<std::string> expected = converter->ConvertBatch(kKeys);
+
+  constexpr int kNumThreads = 4;
+  constexpr int kNumBatches = 10;
+  std::vector<std::vector<std::string>> results(kNumThreads);
+  std::vector<Thread> threads;
+  for (int i = 0; i < kNumThreads; ++i) {
+    threads.emplace_back([&converter, &result = results[i]]() {
+      for (int j = 0; j < kNumBatches; ++j) {
+        result = converter->ConvertBatch(kKeys);
+      }
+    });
+  }
+  for (Thread &thread : threads) {
+    thread.Join();
+  }
+  EXPECT_THAT(results, Each(expected));
+  EXPECT_EQ(converter->GetStats().num_sentences,
+            (kNumThreads * kNumBatches + 1) * std::size(kKeys));
+}
+
+TEST_F(EmbeddedConverterTest, DoesNotWriteUserHistory) {
+  const std::string filename =
+      prediction::UserHistoryPredictor::GetUserHistoryFileName();
+  ASSERT_FALSE(FileUtil::FileExists(filename).ok());
+  CreateConverter(2)->ConvertBatch(kKeys);
+  // The engines are destroyed here, which saves the user history if any
+  // engine learned something.
+  EXPECT_FALSE(FileUtil::FileExists(filename).ok());
+}
+
+TEST_F(EmbeddedConverterTest, CreateFromInvalidFile) {
+  EXPECT_FALSE(
+      EmbeddedConverter::CreateFromFile("/nonexistent/mozc.data", "oss",
+                                        "desktop", 1)
+          .ok());
+}
+
+}  // namespace
+}  // namespace mozc
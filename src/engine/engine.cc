@@ -39,7 +39,9 @@
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
 #include "base/vlog.h"
+#include "converter/connector.h"
 #include "converter/converter.h"
 #include "converter/converter_interface.h"
 #include "converter/immutable_converter.h"
@@ -54,6 +56,7 @@
 #include "prediction/predictor.h"
 #include "prediction/predictor_interface.h"
 #include "prediction/user_history_predictor.h"
+#include "protocol/commands.pb.h"
 #include "protocol/engine_builder.pb.h"
 #include "protocol/user_dictionary_storage.pb.h"
 #include "rewriter/rewriter.h"
@@ -103,13 +106,25 @@ Engine::Engine() : minimal_converter_(CreateMinimalConverter()) {}
 
 absl::Status Engine::ReloadModules(std::unique_ptr<engine::Modules> modules,
                                    bool is_mobile) {
-  ReloadAndWait();
+  // Flushes the user data before the new converter loads it.
+  Sync();
+  Wait();
   return Init(std::move(modules), is_mobile);
 }
 
 absl::Status Engine::Init(std::unique_ptr<engine::Modules> modules,
                           bool is_mobile) {
+  std::unique_ptr<Converter> converter =
+      BuildConverter(std::move(modules), is_mobile);
+  if (!converter) {
+    return absl::ResourceExhaustedError("engine.cc: converter_ is null");
+  }
+  converter_ = std::move(converter);
+  return absl::OkStatus();
+}
 
+std::unique_ptr<Converter> Engine::BuildConverter(
+    std::unique_ptr<engine::Modules> modules, bool is_mobile) {
   auto immutable_converter_factory = [](const engine::Modules &modules) {
     return std::make_unique<ImmutableConverter>(modules);
   };
@@ -139,17 +154,21 @@ absl::Status Engine::Init(std::unique_ptr<engine::Modules> modules,
     return std::make_unique<Rewriter>(modules);
   };
 
-  auto converter = std::make_unique<Converter>(
-      std::move(modules), immutable_converter_factory, predictor_factory,
-      rewriter_factory);
+  return std::make_unique<Converter>(std::move(modules),
+                                     immutable_converter_factory,
+                                     predictor_factory, rewriter_factory);
+}
 
-  if (!converter) {
-    return absl::ResourceExhaustedError("engine.cc: converter_ is null");
+void Engine::SwapConverter(std::unique_ptr<Converter> converter) {
+  if (converter_) {
+    converter_->Sync();
+    converter_->Wait();
   }
-
+  // `converter` loaded the user data in the loader's thread, possibly before
+  // the flush above. Reloads it so that the learning made by the current
+  // converter in the meantime is not lost.
+  converter->Reload();
   converter_ = std::move(converter);
-
-  return absl::OkStatus();
 }
 
 bool Engine::Reload() { return converter_ && converter_->Reload(); }
@@ -162,17 +181,31 @@ bool Engine::ReloadAndWait() { return Reload() && Wait(); }
 
 bool Engine::ClearUserHistory() {
   if (converter_) {
-    converter_->rewriter()->Clear();
+    converter_->ClearUserHistory();
   }
   return true;
 }
 
 bool Engine::ClearUserPrediction() {
-  return converter_ && converter_->predictor()->ClearAllHistory();
+  return converter_ && converter_->ClearUserPrediction();
 }
 
 bool Engine::ClearUnusedUserPrediction() {
-  return converter_ && converter_->predictor()->ClearUnusedHistory();
+  return converter_ && converter_->ClearUnusedUserPrediction();
+}
+
+void Engine::FillServerStats(commands::ServerStats *stats) const {
+  if (!converter_) {
+    return;
+  }
+  const engine::Modules &modules = *converter_->modules();
+  const Connector::CacheStats connector_stats =
+      modules.GetConnector().GetCacheStats();
+  commands::ServerStats::Cache *cache = stats->add_caches();
+  cache->set_name("Connector");
+  cache->set_hits(connector_stats.hits);
+  cache->set_misses(connector_stats.misses);
+  stats->set_data_size_bytes(modules.GetDataManager().GetDataSize());
 }
 
 bool Engine::MaybeReloadEngine(EngineReloadResponse *response) {
@@ -180,28 +213,46 @@ bool Engine::MaybeReloadEngine(EngineReloadResponse *response) {
     loader_.Wait();
   }
 
-  if (loader_.IsRunning() || !loader_response_) {
+  if (loader_.IsRunning()) {
     return false;
   }
 
-  const bool is_mobile = loader_response_->response.request().engine_type() ==
-                         EngineReloadRequest::MOBILE;
-  *response = std::move(loader_response_->response);
-
-  const absl::Status reload_status =
-      ReloadModules(std::move(loader_response_->modules), is_mobile);
-  if (reload_status.ok()) {
-    response->set_status(EngineReloadResponse::RELOADED);
+  std::unique_ptr<PreparedConverter> prepared;
+  {
+    absl::MutexLock l(&prepared_mutex_);
+    prepared = std::move(prepared_converter_);
+  }
+  if (!prepared) {
+    return false;
   }
-  loader_response_.reset();
 
-  return reload_status.ok();
+  // The converter is already built, so only the pointer is swapped here.
+  // The caller must not hold sessions using the previous converter, as both
+  // converters would then update the same user data.
+  SwapConverter(std::move(prepared->converter));
+  *response = std::move(prepared->response);
+  response->set_status(EngineReloadResponse::RELOADED);
+  return true;
 }
 
 bool Engine::SendEngineReloadRequest(const EngineReloadRequest &request) {
   return loader_.StartNewDataBuildTask(
       request, [this](std::unique_ptr<DataLoader::Response> response) {
-        loader_response_ = std::move(response);
+        // Executed in the loader's thread. Builds the whole converter stack
+        // here so that MaybeReloadEngine() doesn't block the session thread.
+        const bool is_mobile = response->response.request().engine_type() ==
+                               EngineReloadRequest::MOBILE;
+        auto prepared = std::make_unique<PreparedConverter>();
+        prepared->response = std::move(response->response);
+        prepared->converter =
+            BuildConverter(std::move(response->modules), is_mobile);
+        if (!prepared->converter) {
+          return absl::ResourceExhaustedError("engine.cc: converter is null");
+        }
+        // Waits for the initial load of the user data.
+        prepared->converter->Wait();
+        absl::MutexLock l(&prepared_mutex_);
+        prepared_converter_ = std::move(prepared);
         return absl::OkStatus();
       });
 }
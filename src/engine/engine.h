@@ -36,8 +36,10 @@
 #include <vector>
 
 #include "absl/status/status.h"
+#include "absl/base/thread_annotations.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
 #include "converter/converter.h"
 #include "converter/converter_interface.h"
 #include "data_manager/data_manager.h"
@@ -48,6 +50,7 @@
 #include "engine/modules.h"
 #include "engine/supplemental_model_interface.h"
 #include "prediction/predictor_interface.h"
+#include "protocol/commands.pb.h"
 #include "rewriter/rewriter_interface.h"
 
 namespace mozc {
@@ -121,6 +124,8 @@ class Engine : public EngineInterface {
     return {};
   }
 
+  void FillServerStats(commands::ServerStats *stats) const override;
+
   // For testing only.
   engine::Modules *GetModulesForTesting() const {
     return converter_->modules();
@@ -141,21 +146,41 @@ class Engine : public EngineInterface {
  private:
   Engine();
 
+  // A converter built in the loader's thread, waiting to be swapped in.
+  struct PreparedConverter {
+    EngineReloadResponse response;
+    std::unique_ptr<Converter> converter;
+  };
+
   // Initializes the engine object by the given modules and is_mobile flag.
   // The is_mobile flag is used to select DefaultPredictor and MobilePredictor.
   absl::Status Init(std::unique_ptr<engine::Modules> modules, bool is_mobile);
 
-  DataLoader loader_;
+  // Builds the converter stack on the given modules. This function doesn't
+  // touch the engine, so it can be called from the loader's thread.
+  static std::unique_ptr<Converter> BuildConverter(
+      std::unique_ptr<engine::Modules> modules, bool is_mobile);
+
+  // Replaces converter_ with `converter`. The user data of the current
+  // converter is flushed to the local files first, and `converter`, which
+  // loaded them when it was built, reloads them to start from the latest
+  // state. The current converter must not be used by any session.
+  void SwapConverter(std::unique_ptr<Converter> converter);
 
   std::unique_ptr<engine::SupplementalModelInterface> supplemental_model_;
   std::unique_ptr<Converter> converter_;
   std::unique_ptr<ConverterInterface> minimal_converter_;
-  std::unique_ptr<DataLoader::Response> loader_response_;
+  absl::Mutex prepared_mutex_;
+  std::unique_ptr<PreparedConverter> prepared_converter_
+      ABSL_GUARDED_BY(prepared_mutex_);
   // Do not initialized with Init() because the cost of initialization is
   // negligible.
   user_dictionary::UserDictionarySessionHandler
       user_dictionary_session_handler_;
   bool always_wait_for_testing_ = false;
+  // Declared last so that the loader's thread, which sets
+  // prepared_converter_, is joined before the other members are destroyed.
+  DataLoader loader_;
 };
 
 }  // namespace mozc
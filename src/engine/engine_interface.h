@@ -37,6 +37,7 @@
 #include "absl/status/status.h"
 #include "absl/strings/string_view.h"
 #include "converter/converter_interface.h"
+#include "protocol/commands.pb.h"
 #include "protocol/engine_builder.pb.h"
 #include "protocol/user_dictionary_storage.pb.h"
 
@@ -90,6 +91,9 @@ class EngineInterface {
   // Gets the user POS list.
   virtual std::vector<std::string> GetPosList() const { return {}; }
 
+  // Fills the statistics of the engine, e.g. cache hit rates.
+  virtual void FillServerStats(commands::ServerStats *stats) const {}
+
   // Maybe reload a new data manager. Returns true if reloaded.
   virtual bool MaybeReloadEngine(EngineReloadResponse *response) {
     return false;
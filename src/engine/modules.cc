@@ -36,12 +36,16 @@
 #include <string>
 #include <utility>
 
+#include "absl/flags/flag.h"
 #include "absl/log/check.h"
 #include "absl/log/log.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
 #include "absl/types/span.h"
+#include "base/file_util.h"
+#include "base/hash.h"
 #include "converter/connector.h"
 #include "converter/segmenter.h"
 #include "data_manager/data_manager.h"
@@ -57,6 +61,12 @@
 #include "dictionary/user_pos.h"
 #include "prediction/single_kanji_prediction_aggregator.h"
 #include "prediction/suggestion_filter.h"
+#include "storage/derived_data_cache.h"
+
+ABSL_FLAG(std::string, derived_data_cache_dir, "",
+          "Directory of the cache files of the structures derived from the "
+          "data set. The processes using the same data set share the cache "
+          "file. Disabled if empty.");
 
 using ::mozc::dictionary::DictionaryImpl;
 using ::mozc::dictionary::PosGroup;
@@ -82,6 +92,20 @@ absl::Status Modules::Init(std::unique_ptr<const DataManager> data_manager) {
   RETURN_IF_NULL(data_manager);
   data_manager_ = std::move(data_manager);
 
+  // The cache file is named after the data version, and also checks the data
+  // size to detect data sets sharing the version, e.g. in development.
+  std::string derived_data_cache_path;
+  const std::string cache_dir = absl::GetFlag(FLAGS_derived_data_cache_dir);
+  if (!cache_dir.empty()) {
+    const absl::string_view data_version = data_manager_->GetDataVersion();
+    derived_data_cache_path = FileUtil::JoinPath(
+        cache_dir, absl::StrCat("derived_data_",
+                                absl::Hex(Fingerprint(data_version)), ".cache"));
+    derived_data_cache_ = storage::DerivedDataCache::Open(
+        derived_data_cache_path,
+        absl::StrCat(data_version, ":", data_manager_->GetDataSize()));
+  }
+
   if (!suppression_dictionary_) {
     suppression_dictionary_ = std::make_unique<SuppressionDictionary>();
     RETURN_IF_NULL(suppression_dictionary_);
@@ -110,6 +134,7 @@ absl::Status Modules::Init(std::unique_ptr<const DataManager> data_manager) {
     absl::StatusOr<std::unique_ptr<SystemDictionary>> sysdic =
         SystemDictionary::Builder(dictionary_data.data(),
                                   dictionary_data.size())
+            .SetDerivedDataCache(derived_data_cache_.get())
             .Build();
     if (!sysdic.ok()) {
       return std::move(sysdic).status();
@@ -132,7 +157,8 @@ absl::Status Modules::Init(std::unique_ptr<const DataManager> data_manager) {
     RETURN_IF_NULL(suffix_dictionary_);
   }
 
-  auto status_or_connector = Connector::CreateFromDataManager(*data_manager_);
+  auto status_or_connector = Connector::CreateFromDataManager(
+      *data_manager_, derived_data_cache_.get());
   if (!status_or_connector.ok()) {
     return std::move(status_or_connector).status();
   }
@@ -173,6 +199,15 @@ absl::Status Modules::Init(std::unique_ptr<const DataManager> data_manager) {
   zero_query_number_dict_.Init(zero_query_number_token_array_data,
                                zero_query_number_string_array_data);
 
+  if (derived_data_cache_ && derived_data_cache_->has_built_sections()) {
+    // This process uses the sections built on its heap, and the following
+    // processes map them from the file.
+    if (absl::Status s = derived_data_cache_->Save(derived_data_cache_path);
+        !s.ok()) {
+      LOG(WARNING) << "Cannot save the derived data cache: " << s;
+    }
+  }
+
   initialized_ = true;
   return absl::Status();
 #undef RETURN_IF_NULL
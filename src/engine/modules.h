@@ -46,6 +46,7 @@
 #include "prediction/single_kanji_prediction_aggregator.h"
 #include "prediction/suggestion_filter.h"
 #include "prediction/zero_query_dict.h"
+#include "storage/derived_data_cache.h"
 
 namespace mozc {
 namespace engine {
@@ -129,6 +130,8 @@ class Modules {
  private:
   bool initialized_ = false;
   std::unique_ptr<const DataManager> data_manager_;
+  // Declared before the modules referring to the derived structures in it.
+  std::unique_ptr<storage::DerivedDataCache> derived_data_cache_;
   std::unique_ptr<const dictionary::PosMatcher> pos_matcher_;
   std::unique_ptr<dictionary::SuppressionDictionary> suppression_dictionary_;
   Connector connector_;
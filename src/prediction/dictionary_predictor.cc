@@ -51,6 +51,7 @@
 #include "absl/types/span.h"
 #include "base/strings/assign.h"
 #include "base/strings/japanese.h"
+#include "base/trace.h"
 #include "base/util.h"
 #include "base/vlog.h"
 #include "composer/composer.h"
@@ -290,6 +291,7 @@ void DictionaryPredictor::MaybeRecordUsageStats(
 
 bool DictionaryPredictor::PredictForRequest(const ConversionRequest &request,
                                             Segments *segments) const {
+  ScopedTraceSpan span("DictionaryPredictor::PredictForRequest");
   if (segments == nullptr) {
     return false;
   }
@@ -45,6 +45,7 @@
         'result.cc',
         'single_kanji_prediction_aggregator.cc',
         'user_history_predictor.cc',
+        'user_history_store.cc',
       ],
       'dependencies': [
         '<(mozc_oss_src_dir)/base/absl.gyp:absl_strings',
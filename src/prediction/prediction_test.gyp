@@ -41,6 +41,7 @@
         'dictionary_prediction_aggregator_test.cc',
         'number_decoder_test.cc',
         'user_history_predictor_test.cc',
+        'user_history_store_test.cc',
         'predictor_test.cc',
         'single_kanji_prediction_aggregator_test.cc',
         'zero_query_dict_test.cc',
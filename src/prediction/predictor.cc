@@ -31,6 +31,7 @@
 
 #include <algorithm>
 #include <cstddef>
+#include <cstdint>
 #include <memory>
 #include <optional>
 #include <string>
@@ -41,6 +42,7 @@
 #include "absl/log/log.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
+#include "base/trace.h"
 #include "base/util.h"
 #include "converter/converter_interface.h"
 #include "converter/segments.h"
@@ -144,6 +146,16 @@ void BasePredictor::Revert(Segments *segments) {
   user_history_predictor_->Revert(segments);
 }
 
+void BasePredictor::AddPendingLearning(uint64_t id,
+                                       const ConversionRequest &request,
+                                       const Segments &segments) {
+  user_history_predictor_->AddPendingLearning(id, request, segments);
+}
+
+void BasePredictor::RemovePendingLearning(uint64_t id) {
+  user_history_predictor_->RemovePendingLearning(id);
+}
+
 bool BasePredictor::ClearAllHistory() {
   return user_history_predictor_->ClearAllHistory();
 }
@@ -222,6 +234,7 @@ DefaultPredictor::~DefaultPredictor() = default;
 
 bool DefaultPredictor::PredictForRequest(const ConversionRequest &request,
                                          Segments *segments) const {
+  ScopedTraceSpan span("DefaultPredictor::PredictForRequest");
   DCHECK(request.request_type() == ConversionRequest::PREDICTION ||
          request.request_type() == ConversionRequest::SUGGESTION ||
          request.request_type() == ConversionRequest::PARTIAL_PREDICTION ||
@@ -357,6 +370,7 @@ void MaybeFillFallbackPos(Segments *segments) {
 
 bool MobilePredictor::PredictForRequest(const ConversionRequest &request,
                                         Segments *segments) const {
+  ScopedTraceSpan span("MobilePredictor::PredictForRequest");
   DCHECK(request.request_type() == ConversionRequest::PREDICTION ||
          request.request_type() == ConversionRequest::SUGGESTION ||
          request.request_type() == ConversionRequest::PARTIAL_PREDICTION ||
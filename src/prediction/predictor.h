@@ -30,6 +30,7 @@
 #ifndef MOZC_PREDICTION_PREDICTOR_H_
 #define MOZC_PREDICTION_PREDICTOR_H_
 
+#include <cstdint>
 #include <memory>
 #include <string>
 
@@ -55,6 +56,11 @@ class BasePredictor : public PredictorInterface {
   // Reverts the last Finish operation.
   void Revert(Segments *segments) override;
 
+  // Forwards the pending learning to UserHistoryPredictor.
+  void AddPendingLearning(uint64_t id, const ConversionRequest &request,
+                          const Segments &segments) override;
+  void RemovePendingLearning(uint64_t id) override;
+
   // Clears all history data of UserHistoryPredictor.
   bool ClearAllHistory() override;
 
@@ -30,6 +30,7 @@
 #ifndef MOZC_PREDICTION_PREDICTOR_INTERFACE_H_
 #define MOZC_PREDICTION_PREDICTOR_INTERFACE_H_
 
+#include <cstdint>
 #include <string>
 
 #include "absl/base/attributes.h"
@@ -58,6 +59,16 @@ class PredictorInterface {
   // Reverts the last Finish operation.
   virtual void Revert(Segments *segments) {}
 
+  // Called when the Finish operation for the committed `segments` is deferred,
+  // e.g., to a background thread. Until RemovePendingLearning() is called with
+  // the same `id`, the predictions should reflect the commit as if it had been
+  // learned, without modifying the learned data.
+  virtual void AddPendingLearning(uint64_t id, const ConversionRequest &request,
+                                  const Segments &segments) {}
+
+  // Called after the deferred Finish operation of `id` is done.
+  virtual void RemovePendingLearning(uint64_t id) {}
+
   // Clears all history data of UserHistoryPredictor.
   virtual bool ClearAllHistory() { return true; }
 
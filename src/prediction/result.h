@@ -128,7 +128,7 @@ struct Result {
   // If the candidate key and value are
   // "わたしの|なまえは|なかのです", " 私の|名前は|中野です",
   // |inner_segment_boundary| have [(4,2), (4, 3), (5, 4)].
-  std::vector<uint32_t> inner_segment_boundary;
+  Segment::Candidate::InnerSegmentBoundary inner_segment_boundary;
   // Segment::Candidate::SourceInfo.
   // Will be used for usage stats.
   uint32_t source_info = 0;
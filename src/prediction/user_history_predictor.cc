@@ -52,6 +52,7 @@
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_join.h"
 #include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
 #include "absl/time/time.h"
 #include "absl/types/span.h"
 #include "base/bits.h"
@@ -61,6 +62,7 @@
 #include "base/container/trie.h"
 #include "base/hash.h"
 #include "base/japanese_util.h"
+#include "base/trace.h"
 #include "base/util.h"
 #include "base/vlog.h"
 #include "composer/composer.h"
@@ -74,7 +76,6 @@
 #include "request/conversion_request.h"
 #include "rewriter/variants_rewriter.h"
 #include "storage/encrypted_string_storage.h"
-#include "storage/lru_cache.h"
 #include "usage_stats/usage_stats.h"
 
 namespace mozc::prediction {
@@ -112,10 +113,16 @@ const uint16_t kRevertId = 1;
 // File name for the history
 #ifdef _WIN32
 constexpr char kFileName[] = "user://history.db";
+constexpr char kJournalFileName[] = "user://history.db.journal";
 #else   // _WIN32
 constexpr char kFileName[] = "user://.history.db";
+constexpr char kJournalFileName[] = "user://.history.db.journal";
 #endif  // _WIN32
 
+// The journal is compacted into the history file when the records in the
+// journal get larger than this size.
+constexpr size_t kMaxJournalSize = 512 * 1024;
+
 // Uses '\t' as a key/value delimiter
 constexpr absl::string_view kDelimiter = "\t";
 constexpr absl::string_view kEmojiDescription = "絵文字";
@@ -125,9 +132,8 @@ constexpr absl::Duration k62Days = absl::Hours(62 * 24);
 // TODO(peria, hidehiko): Unify this checker and IsEmojiCandidate in
 //     EmojiRewriter.  If you make similar functions before the merging in
 //     case, put a similar note to avoid twisted dependency.
-bool IsEmojiEntry(const UserHistoryPredictor::Entry &entry) {
-  return (entry.has_description() &&
-          absl::StrContains(entry.description(), kEmojiDescription));
+bool IsEmojiEntry(UserHistoryPredictor::EntryRef entry) {
+  return absl::StrContains(entry.description(), kEmojiDescription);
 }
 
 // http://unicode.org/~scherer/emoji4unicode/snapshot/full.html
@@ -347,7 +353,7 @@ UserHistoryPredictor::UserHistoryPredictor(const engine::Modules &modules,
       predictor_name_("UserHistoryPredictor"),
       content_word_learning_enabled_(enable_content_word_learning),
       updated_(false),
-      dic_(new DicCache(UserHistoryPredictor::cache_size())),
+      dic_(new UserHistoryStore(UserHistoryPredictor::cache_size())),
       modules_(modules) {
   AsyncLoad();  // non-blocking
   // Load()  blocking version can be used if any
@@ -363,6 +369,10 @@ std::string UserHistoryPredictor::GetUserHistoryFileName() {
   return ConfigFileStream::GetFileName(kFileName);
 }
 
+std::string UserHistoryPredictor::GetUserHistoryJournalFileName() {
+  return ConfigFileStream::GetFileName(kJournalFileName);
+}
+
 // Returns revert id
 // static
 uint16_t UserHistoryPredictor::revert_id() { return kRevertId; }
@@ -379,7 +389,11 @@ bool UserHistoryPredictor::Wait() {
   return true;
 }
 
-bool UserHistoryPredictor::CheckSyncerAndDelete() const {
+bool UserHistoryPredictor::IsSyncerReady() const {
+  return !sync_.has_value() || sync_->Ready();
+}
+
+bool UserHistoryPredictor::CheckSyncerAndDelete() {
   if (sync_.has_value()) {
     if (!sync_->Ready()) {
       return false;
@@ -405,6 +419,8 @@ bool UserHistoryPredictor::AsyncLoad() {
     return true;
   }
 
+  dirty_fps_.clear();
+  dic_cleared_ = false;
   sync_.emplace([this] {
     MOZC_VLOG(1) << "Executing Reload method";
     Load();
@@ -422,9 +438,17 @@ bool UserHistoryPredictor::AsyncSave() {
     return true;
   }
 
-  sync_.emplace([this] {
+  // The changes are collected here so that the syncer doesn't touch
+  // |dirty_fps_|.
+  const bool compact = ShouldCompactJournal();
+  user_history_predictor::UserHistoryJournalRecord record;
+  if (!MakeJournalRecord(&record) && !compact) {
+    return true;
+  }
+
+  sync_.emplace([this, record = std::move(record), compact]() mutable {
     MOZC_VLOG(1) << "Executing Sync method";
-    Save();
+    WriteJournal(std::move(record), compact);
   });
 
   return true;
@@ -434,11 +458,50 @@ bool UserHistoryPredictor::Load() {
   const std::string filename = GetUserHistoryFileName();
 
   UserHistoryStorage history(filename);
-  if (!history.Load()) {
+  const bool history_loaded = history.Load();
+
+  // Replays the journal even if the history file is not available, as the
+  // history may exist only in the journal before the first compaction.
+  std::vector<std::string> records;
+  storage::EncryptedJournalStorage journal(GetUserHistoryJournalFileName());
+  bool journal_loaded = journal.Load(&records);
+  if (!history_loaded && records.empty()) {
     LOG(ERROR) << "UserHistoryStorage::Load() failed";
     return false;
   }
-  return Load(history);
+  if (!history_loaded) {
+    history.GetProto().Clear();
+  }
+
+  Load(history);
+  journal_sequence_ = history.GetProto().journal_sequence();
+  journal_size_ = 0;
+  for (const std::string &data : records) {
+    user_history_predictor::UserHistoryJournalRecord record;
+    if (!record.ParseFromString(data)) {
+      LOG(ERROR) << "ParseFromString failed. journal looks broken";
+      journal_loaded = false;
+      break;
+    }
+    journal_size_ += data.size();
+    // Skips the records already merged into the history file, which remain
+    // when the process exits after the compaction but before removing the
+    // journal.
+    if (record.sequence() <= journal_sequence_) {
+      continue;
+    }
+    ReplayJournalRecord(record);
+    journal_sequence_ = record.sequence();
+  }
+
+  // Records appended after a broken record can never be read, so rewrites
+  // the history file and starts a new journal on the next save.
+  if (!journal_loaded) {
+    compaction_requested_ = true;
+  }
+
+  MOZC_VLOG(1) << "Replayed " << records.size() << " journal records";
+  return true;
 }
 
 bool UserHistoryPredictor::Load(const UserHistoryStorage &history) {
@@ -467,17 +530,115 @@ bool UserHistoryPredictor::Save() {
   // Do not check incognito_mode or use_history_suggest in Config here.
   // The input data should not have been inserted when those flags are on.
 
-  const DicElement *tail = dic_->Tail();
-  if (tail == nullptr) {
+  const bool compact = ShouldCompactJournal();
+  user_history_predictor::UserHistoryJournalRecord record;
+  if (!MakeJournalRecord(&record) && !compact) {
+    return true;
+  }
+  return WriteJournal(std::move(record), compact);
+}
+
+bool UserHistoryPredictor::MakeJournalRecord(
+    user_history_predictor::UserHistoryJournalRecord *record) {
+  DCHECK(record);
+  updated_ = false;
+
+  // Erases the entries untouched for 62 days as UserHistoryStorage does on
+  // save, so that they are not loaded again.
+  const absl::Time now = Clock::GetAbslTime();
+  const uint64_t timestamp =
+      absl::ToUnixSeconds(std::max(now - k62Days, absl::UnixEpoch()));
+  std::vector<uint32_t> expired_fps;
+  for (EntryRef entry : *dic_) {
+    if (entry.entry_type() == Entry::DEFAULT_ENTRY &&
+        entry.last_access_time() < timestamp) {
+      expired_fps.push_back(entry.fp());
+    }
+  }
+  for (const uint32_t fp : expired_fps) {
+    dic_->Erase(fp);
+    MarkDirty(fp);
+  }
+
+  if (dirty_fps_.empty() && !dic_cleared_) {
+    return false;
+  }
+
+  record->set_clear(dic_cleared_);
+  // Adds the entries in the LRU order so that the replay reproduces the order.
+  for (EntryRef entry = dic_->Tail(); entry; entry = entry.prev()) {
+    if (dirty_fps_.erase(entry.fp())) {
+      entry.CopyTo(record->add_entries());
+    }
+  }
+  // The remaining ones are not in |dic_| any more.
+  for (const uint32_t fp : dirty_fps_) {
+    record->add_erased_fps(fp);
+  }
+
+  dirty_fps_.clear();
+  dic_cleared_ = false;
+  return true;
+}
+
+bool UserHistoryPredictor::WriteJournal(
+    user_history_predictor::UserHistoryJournalRecord record, bool compact) {
+  if (record.clear() || record.erased_fps_size() > 0 ||
+      record.entries_size() > 0) {
+    record.set_sequence(journal_sequence_ + 1);
+    const std::string data = record.SerializeAsString();
+    storage::EncryptedJournalStorage journal(GetUserHistoryJournalFileName());
+    if (journal.Append(data)) {
+      journal_sequence_ = record.sequence();
+      journal_size_ += data.size();
+    } else {
+      // The changes are saved by writing the entire history instead.
+      LOG(ERROR) << "EncryptedJournalStorage::Append() failed";
+      compact = true;
+    }
+  }
+
+  if (!compact) {
+    return true;
+  }
+  return SaveSnapshot();
+}
+
+void UserHistoryPredictor::ReplayJournalRecord(
+    const user_history_predictor::UserHistoryJournalRecord &record) {
+  if (record.clear()) {
+    dic_->Clear();
+  }
+  for (const uint32_t fp : record.erased_fps()) {
+    dic_->Erase(fp);
+  }
+  for (const Entry &entry : record.entries()) {
+    // Same as Load(history). See the comment there.
+    if (!Util::IsValidUtf8(entry.value())) {
+      LOG(ERROR) << "Invalid UTF8 found in user history: " << entry;
+      continue;
+    }
+    dic_->Insert(EntryFingerprint(entry), entry);
+  }
+}
+
+bool UserHistoryPredictor::ShouldCompactJournal() const {
+  return compaction_requested_ || journal_size_ >= kMaxJournalSize;
+}
+
+bool UserHistoryPredictor::SaveSnapshot() {
+  const EntryRef tail = dic_->Tail();
+  if (!tail) {
     return true;
   }
 
   const std::string filename = GetUserHistoryFileName();
 
   UserHistoryStorage history(filename);
-  for (const DicElement *elm = tail; elm != nullptr; elm = elm->prev) {
-    *history.GetProto().add_entries() = elm->value;
+  for (EntryRef entry = tail; entry; entry = entry.prev()) {
+    entry.CopyTo(history.GetProto().add_entries());
   }
+  history.GetProto().set_journal_sequence(journal_sequence_);
 
   // Updates usage stats here.
   UsageStats::SetInteger("UserHistoryPredictorEntrySize",
@@ -487,6 +648,13 @@ bool UserHistoryPredictor::Save() {
     LOG(ERROR) << "UserHistoryStorage::Save() failed";
     return false;
   }
+  // The records in the journal are skipped on load even if this fails, as
+  // the history file has their sequence numbers.
+  storage::EncryptedJournalStorage journal(GetUserHistoryJournalFileName());
+  if (journal.Remove()) {
+    journal_size_ = 0;
+    compaction_requested_ = false;
+  }
   Load(history);
 
   updated_ = false;
@@ -499,9 +667,13 @@ bool UserHistoryPredictor::ClearAllHistory() {
   WaitForSyncer();
 
   MOZC_VLOG(1) << "Clearing user prediction";
-  // Renews DicCache as LruCache tries to reuse the internal value by
-  // using FreeList
-  dic_ = std::make_unique<DicCache>(UserHistoryPredictor::cache_size());
+  // Releases the memory of the entries as well.
+  dic_->Clear();
+  dirty_fps_.clear();
+  dic_cleared_ = true;
+  // Rewrites the history file so that the cleared entries don't remain on the
+  // storage.
+  compaction_requested_ = true;
 
   // insert a dummy event entry.
   InsertEvent(Entry::CLEAN_ALL_EVENT);
@@ -524,10 +696,10 @@ bool UserHistoryPredictor::ClearUnusedHistory() {
   }
 
   std::vector<uint32_t> keys;
-  for (const DicElement &elm : *dic_) {
-    MOZC_VLOG(3) << elm.key << " " << elm.value.suggestion_freq();
-    if (elm.value.suggestion_freq() == 0) {
-      keys.push_back(elm.key);
+  for (EntryRef entry : *dic_) {
+    MOZC_VLOG(3) << entry.fp() << " " << entry.suggestion_freq();
+    if (entry.suggestion_freq() == 0) {
+      keys.push_back(entry.fp());
     }
   }
 
@@ -536,6 +708,7 @@ bool UserHistoryPredictor::ClearUnusedHistory() {
     if (!dic_->Erase(key)) {
       LOG(ERROR) << "cannot erase " << key;
     }
+    MarkDirty(key);
   }
 
   // Inserts a dummy event entry.
@@ -551,19 +724,9 @@ bool UserHistoryPredictor::ClearUnusedHistory() {
 }
 
 // Erases all the next_entries whose entry_fp field equals |fp|.
-void UserHistoryPredictor::EraseNextEntries(uint32_t fp, Entry *entry) {
-  const size_t orig_size = entry->next_entries_size();
-  size_t new_size = orig_size;
-  for (size_t pos = 0; pos < new_size;) {
-    if (entry->next_entries(pos).entry_fp() == fp) {
-      entry->mutable_next_entries()->SwapElements(pos, --new_size);
-    } else {
-      ++pos;
-    }
-  }
-  for (size_t i = 0; i < orig_size - new_size; ++i) {
-    entry->mutable_next_entries()->RemoveLast();
-  }
+void UserHistoryPredictor::EraseNextEntries(uint32_t fp,
+                                            MutableEntryRef entry) {
+  entry.EraseNextEntryFps(fp);
 }
 
 // Recursively finds the Ngram history that produces |target_key| and
@@ -579,7 +742,7 @@ void UserHistoryPredictor::EraseNextEntries(uint32_t fp, Entry *entry) {
 UserHistoryPredictor::RemoveNgramChainResult
 UserHistoryPredictor::RemoveNgramChain(
     const absl::string_view target_key, const absl::string_view target_value,
-    Entry *entry, std::vector<absl::string_view> *key_ngrams,
+    MutableEntryRef entry, std::vector<absl::string_view> *key_ngrams,
     size_t key_ngrams_len, std::vector<absl::string_view> *value_ngrams,
     size_t value_ngrams_len) {
   DCHECK(entry);
@@ -587,20 +750,20 @@ UserHistoryPredictor::RemoveNgramChain(
   DCHECK(value_ngrams);
 
   // Updates the lengths with the current entry node.
-  key_ngrams_len += entry->key().size();
-  value_ngrams_len += entry->value().size();
+  key_ngrams_len += entry.key().size();
+  value_ngrams_len += entry.value().size();
 
   // This is the case where ngram key and value are shorter than the target key
   // and value, respectively. In this case, we need to find further entries to
   // concatenate in order to make |target_key| and |target_value|.
   if (key_ngrams_len < target_key.size() &&
       value_ngrams_len < target_value.size()) {
-    key_ngrams->push_back(entry->key());
-    value_ngrams->push_back(entry->value());
-    for (size_t i = 0; i < entry->next_entries().size(); ++i) {
-      const uint32_t fp = entry->next_entries(i).entry_fp();
-      Entry *e = dic_->MutableLookupWithoutInsert(fp);
-      if (e == nullptr) {
+    key_ngrams->push_back(entry.key());
+    value_ngrams->push_back(entry.value());
+    for (size_t i = 0; i < entry.next_entries_size(); ++i) {
+      const uint32_t fp = entry.next_entry_fps()[i];
+      MutableEntryRef e = dic_->MutableLookupWithoutInsert(fp);
+      if (!e) {
         continue;
       }
       const RemoveNgramChainResult r =
@@ -613,6 +776,7 @@ UserHistoryPredictor::RemoveNgramChain(
           // |entry| is the second-to-the-last node. So cut the link to the
           // child entry.
           EraseNextEntries(fp, entry);
+          MarkDirty(entry.fp());
           return DONE;
         default:
           break;
@@ -628,8 +792,8 @@ UserHistoryPredictor::RemoveNgramChain(
   // lengths as those of |target_key| and |target_value|, respectively.
   if (key_ngrams_len == target_key.size() &&
       value_ngrams_len == target_value.size()) {
-    key_ngrams->push_back(entry->key());
-    value_ngrams->push_back(entry->value());
+    key_ngrams->push_back(entry.key());
+    value_ngrams->push_back(entry.value());
     const std::string ngram_key = absl::StrJoin(*key_ngrams, "");
     const std::string ngram_value = absl::StrJoin(*value_ngrams, "");
     if (ngram_key == target_key && ngram_value == target_value) {
@@ -651,12 +815,14 @@ bool UserHistoryPredictor::ClearHistoryEntry(const absl::string_view key,
   {
     // Finds the history entry that has the exactly same key and value and has
     // not been removed yet. If exists, remove it.
-    Entry *entry = dic_->MutableLookupWithoutInsert(Fingerprint(key, value));
-    if (entry != nullptr && !entry->removed()) {
-      entry->set_suggestion_freq(0);
-      entry->set_conversion_freq(0);
-      entry->set_shown_freq(0);
-      entry->set_removed(true);
+    const uint32_t fp = Fingerprint(key, value);
+    MutableEntryRef entry = dic_->MutableLookupWithoutInsert(fp);
+    if (entry && !entry.removed()) {
+      entry.set_suggestion_freq(0);
+      entry.set_conversion_freq(0);
+      entry.set_shown_freq(0);
+      entry.set_removed(true);
+      MarkDirty(fp);
       // We don't clear entry->next_entries() so that we can generate prediction
       // by chaining.
       deleted = true;
@@ -666,10 +832,9 @@ bool UserHistoryPredictor::ClearHistoryEntry(const absl::string_view key,
     // Finds a chain of history entries that produces key and value. If exists,
     // remove the link so that N-gram history prediction never generates this
     // key value pair..
-    for (DicElement &elm : *dic_) {
-      Entry *entry = &elm.value;
-      if (!absl::StartsWith(key, entry->key()) ||
-          !absl::StartsWith(value, entry->value())) {
+    for (MutableEntryRef entry : *dic_) {
+      if (!absl::StartsWith(key, entry.key()) ||
+          !absl::StartsWith(value, entry.value())) {
         continue;
       }
       std::vector<absl::string_view> key_ngrams, value_ngrams;
@@ -687,15 +852,9 @@ bool UserHistoryPredictor::ClearHistoryEntry(const absl::string_view key,
 
 // Returns true if prev_entry has a next_fp link to entry
 // static
-bool UserHistoryPredictor::HasBigramEntry(const Entry &entry,
-                                          const Entry &prev_entry) {
-  const uint32_t fp = EntryFingerprint(entry);
-  for (int i = 0; i < prev_entry.next_entries_size(); ++i) {
-    if (fp == prev_entry.next_entries(i).entry_fp()) {
-      return true;
-    }
-  }
-  return false;
+bool UserHistoryPredictor::HasBigramEntry(EntryRef entry,
+                                          EntryRef prev_entry) {
+  return absl::c_linear_search(prev_entry.next_entry_fps(), entry.fp());
 }
 
 // static
@@ -817,8 +976,8 @@ bool UserHistoryPredictor::RomanFuzzyPrefixMatch(
 }
 
 bool UserHistoryPredictor::ZeroQueryLookupEntry(
-    RequestType request_type, absl::string_view input_key, const Entry *entry,
-    const Entry *prev_entry, EntryPriorityQueue *results) const {
+    RequestType request_type, absl::string_view input_key, EntryRef entry,
+    EntryRef prev_entry, EntryPriorityQueue *results) const {
   DCHECK(entry);
   DCHECK(results);
 
@@ -831,13 +990,13 @@ bool UserHistoryPredictor::ZeroQueryLookupEntry(
   // the history segment is in the LRU cache.
   if (prev_entry && aggressive_bigram_enabled_ &&
       request_type == ZERO_QUERY_SUGGESTION && input_key.empty() &&
-      entry->key().size() > prev_entry->key().size() &&
-      entry->value().size() > prev_entry->value().size() &&
-      absl::StartsWith(entry->key(), prev_entry->key()) &&
-      absl::StartsWith(entry->value(), prev_entry->value())) {
+      entry.key().size() > prev_entry.key().size() &&
+      entry.value().size() > prev_entry.value().size() &&
+      absl::StartsWith(entry.key(), prev_entry.key()) &&
+      absl::StartsWith(entry.value(), prev_entry.value())) {
     // suffix must starts with Japanese characters.
-    std::string key = entry->key().substr(prev_entry->key().size());
-    std::string value = entry->value().substr(prev_entry->value().size());
+    std::string key(entry.key().substr(prev_entry.key().size()));
+    std::string value(entry.value().substr(prev_entry.value().size()));
     const auto type = Util::GetFirstScriptType(value);
     if (type != Util::KANJI && type != Util::HIRAGANA &&
         type != Util::KATAKANA) {
@@ -846,7 +1005,7 @@ bool UserHistoryPredictor::ZeroQueryLookupEntry(
     Entry *result = results->NewEntry();
     DCHECK(result);
     // Copy timestamp from `entry`
-    *result = *entry;
+    entry.CopyTo(result);
     result->set_key(std::move(key));
     result->set_value(std::move(value));
     result->set_bigram_boost(true);
@@ -858,7 +1017,7 @@ bool UserHistoryPredictor::ZeroQueryLookupEntry(
 }
 
 bool UserHistoryPredictor::RomanFuzzyLookupEntry(
-    const absl::string_view roman_input_key, const Entry *entry,
+    const absl::string_view roman_input_key, EntryRef entry,
     EntryPriorityQueue *results) const {
   if (roman_input_key.empty()) {
     return false;
@@ -867,13 +1026,13 @@ bool UserHistoryPredictor::RomanFuzzyLookupEntry(
   DCHECK(entry);
   DCHECK(results);
 
-  if (!RomanFuzzyPrefixMatch(ToRoman(entry->key()), roman_input_key)) {
+  if (!RomanFuzzyPrefixMatch(ToRoman(entry.key()), roman_input_key)) {
     return false;
   }
 
   Entry *result = results->NewEntry();
   DCHECK(result);
-  *result = *entry;
+  entry.CopyTo(result);
   result->set_spelling_correction(true);
   results->Push(result);
 
@@ -881,18 +1040,18 @@ bool UserHistoryPredictor::RomanFuzzyLookupEntry(
 }
 
 UserHistoryPredictor::Entry *UserHistoryPredictor::AddEntry(
-    const Entry &entry, EntryPriorityQueue *results) const {
+    EntryRef entry, EntryPriorityQueue *results) const {
   // We add an entry even if it was marked as removed so that it can be used to
   // generate prediction by entry chaining. The deleted entry itself is never
   // shown in the final prediction result as it is filtered finally.
   Entry *new_entry = results->NewEntry();
-  *new_entry = entry;
+  entry.CopyTo(new_entry);
   return new_entry;
 }
 
 UserHistoryPredictor::Entry *UserHistoryPredictor::AddEntryWithNewKeyValue(
     std::string key, std::string value, Entry entry,
-    EntryPriorityQueue *results) const {
+    const UserHistoryStore *pending, EntryPriorityQueue *results) const {
   // We add an entry even if it was marked as removed so that it can be used to
   // generate prediction by entry chaining. The deleted entry itself is never
   // shown in the final prediction result as it is filtered finally.
@@ -902,47 +1061,46 @@ UserHistoryPredictor::Entry *UserHistoryPredictor::AddEntryWithNewKeyValue(
   new_entry->set_value(std::move(value));
 
   // Sets removed field true if the new key and value were removed.
-  const Entry *e = dic_->LookupWithoutInsert(
-      Fingerprint(new_entry->key(), new_entry->value()));
-  new_entry->set_removed(e != nullptr && e->removed());
+  EntryRef e = LookupWithPending(
+      pending, Fingerprint(new_entry->key(), new_entry->value()));
+  new_entry->set_removed(e && e.removed());
 
   return new_entry;
 }
 
 bool UserHistoryPredictor::GetKeyValueForExactAndRightPrefixMatch(
-    const absl::string_view input_key, const Entry *entry,
-    const Entry **result_last_entry, uint64_t *left_last_access_time,
-    uint64_t *left_most_last_access_time, std::string *result_key,
-    std::string *result_value) const {
-  std::string key = entry->key();
-  std::string value = entry->value();
-  const Entry *current_entry = entry;
+    const absl::string_view input_key, EntryRef entry,
+    const UserHistoryStore *pending, EntryRef *result_last_entry,
+    uint64_t *left_last_access_time, uint64_t *left_most_last_access_time,
+    std::string *result_key, std::string *result_value) const {
+  std::string key(entry.key());
+  std::string value(entry.value());
+  EntryRef current_entry = entry;
   absl::flat_hash_set<std::pair<absl::string_view, absl::string_view>> seen;
-  seen.emplace(current_entry->key(), current_entry->value());
+  seen.emplace(current_entry.key(), current_entry.value());
   // Until target entry gets longer than input_key.
   while (key.size() <= input_key.size()) {
-    const Entry *latest_entry = nullptr;
-    const Entry *left_same_timestamp_entry = nullptr;
-    const Entry *left_most_same_timestamp_entry = nullptr;
-    for (size_t i = 0; i < current_entry->next_entries_size(); ++i) {
-      const Entry *tmp_next_entry =
-          dic_->LookupWithoutInsert(current_entry->next_entries(i).entry_fp());
-      if (tmp_next_entry == nullptr || tmp_next_entry->key().empty()) {
+    EntryRef latest_entry;
+    EntryRef left_same_timestamp_entry;
+    EntryRef left_most_same_timestamp_entry;
+    for (const uint32_t next_fp : current_entry.next_entry_fps()) {
+      EntryRef tmp_next_entry = LookupWithPending(pending, next_fp);
+      if (!tmp_next_entry || tmp_next_entry.key().empty()) {
         continue;
       }
       const MatchType mtype_joined =
-          GetMatchType(absl::StrCat(key, tmp_next_entry->key()), input_key);
+          GetMatchType(absl::StrCat(key, tmp_next_entry.key()), input_key);
       if (mtype_joined == NO_MATCH || mtype_joined == LEFT_EMPTY_MATCH) {
         continue;
       }
-      if (latest_entry == nullptr || latest_entry->last_access_time() <
-                                         tmp_next_entry->last_access_time()) {
+      if (!latest_entry || latest_entry.last_access_time() <
+                               tmp_next_entry.last_access_time()) {
         latest_entry = tmp_next_entry;
       }
-      if (tmp_next_entry->last_access_time() == *left_last_access_time) {
+      if (tmp_next_entry.last_access_time() == *left_last_access_time) {
         left_same_timestamp_entry = tmp_next_entry;
       }
-      if (tmp_next_entry->last_access_time() == *left_most_last_access_time) {
+      if (tmp_next_entry.last_access_time() == *left_most_last_access_time) {
         left_most_same_timestamp_entry = tmp_next_entry;
       }
     }
@@ -956,15 +1114,15 @@ bool UserHistoryPredictor::GetKeyValueForExactAndRightPrefixMatch(
     // (2). The current entry's time stamp is equal to that of
     //      left closest content word
     // (3). The current entry is the latest
-    const Entry *next_entry = left_most_same_timestamp_entry;
-    if (next_entry == nullptr) {
+    EntryRef next_entry = left_most_same_timestamp_entry;
+    if (!next_entry) {
       next_entry = left_same_timestamp_entry;
     }
-    if (next_entry == nullptr) {
+    if (!next_entry) {
       next_entry = latest_entry;
     }
 
-    if (next_entry == nullptr || next_entry->key().empty()) {
+    if (!next_entry || next_entry.key().empty()) {
       break;
     }
 
@@ -972,12 +1130,12 @@ bool UserHistoryPredictor::GetKeyValueForExactAndRightPrefixMatch(
     // This is because an entry only has one timestamp.
     // we cannot trust the timestamp if there are duplicate values
     // in one input.
-    if (!seen.emplace(next_entry->key(), next_entry->value()).second) {
+    if (!seen.emplace(next_entry.key(), next_entry.value()).second) {
       break;
     }
 
-    key += next_entry->key();
-    value += next_entry->value();
+    absl::StrAppend(&key, next_entry.key());
+    absl::StrAppend(&value, next_entry.value());
     current_entry = next_entry;
     *result_last_entry = next_entry;
 
@@ -986,16 +1144,16 @@ bool UserHistoryPredictor::GetKeyValueForExactAndRightPrefixMatch(
     // The time-stamp of non-content-word will be updated frequently.
     // The time-stamp of the previous candidate is more trustful.
     // It partially fixes the bug http://b/2843371.
-    const bool is_content_word = IsContentWord(current_entry->value());
+    const bool is_content_word = IsContentWord(current_entry.value());
 
     if (is_content_word) {
-      *left_last_access_time = current_entry->last_access_time();
+      *left_last_access_time = current_entry.last_access_time();
     }
 
     // If left_most entry is a functional word (symbols/punctuations),
     // we don't take it as a canonical candidate.
     if (*left_most_last_access_time == 0 && is_content_word) {
-      *left_most_last_access_time = current_entry->last_access_time();
+      *left_most_last_access_time = current_entry.last_access_time();
     }
   }
 
@@ -1013,15 +1171,15 @@ bool UserHistoryPredictor::LookupEntry(RequestType request_type,
                                        const absl::string_view input_key,
                                        const absl::string_view key_base,
                                        const Trie<std::string> *key_expanded,
-                                       const Entry *entry,
-                                       const Entry *prev_entry,
+                                       EntryRef entry, EntryRef prev_entry,
+                                       const UserHistoryStore *pending,
                                        EntryPriorityQueue *results) const {
   CHECK(entry);
   CHECK(results);
 
   Entry *result = nullptr;
 
-  const Entry *last_entry = nullptr;
+  EntryRef last_entry;
 
   // last_access_time of the left-closest content word.
   uint64_t left_last_access_time = 0;
@@ -1036,64 +1194,66 @@ bool UserHistoryPredictor::LookupEntry(RequestType request_type,
   // left_most_last_access_time:   timestamp of B
 
   // |input_key| is a query user is now typing.
-  // |entry->key()| is a target value saved in the database.
+  // |entry.key()| is a target value saved in the database.
   //  const string input_key = key_base;
 
   const MatchType mtype =
-      GetMatchTypeFromInput(input_key, key_base, key_expanded, entry->key());
+      GetMatchTypeFromInput(input_key, key_base, key_expanded, entry.key());
   if (mtype == NO_MATCH) {
     return false;
   } else if (mtype == LEFT_EMPTY_MATCH) {  // zero-query-suggestion
     // if |input_key| is empty, the |prev_entry| and |entry| must
     // have bigram relation.
-    if (prev_entry != nullptr && HasBigramEntry(*entry, *prev_entry)) {
-      result = AddEntry(*entry, results);
+    if (prev_entry && HasBigramEntry(entry, prev_entry)) {
+      result = AddEntry(entry, results);
       if (result) {
         last_entry = entry;
-        left_last_access_time = entry->last_access_time();
+        left_last_access_time = entry.last_access_time();
         left_most_last_access_time =
-            IsContentWord(entry->value()) ? left_last_access_time : 0;
+            IsContentWord(entry.value()) ? left_last_access_time : 0;
       }
     } else {
       return false;
     }
   } else if (mtype == LEFT_PREFIX_MATCH) {
-    // |input_key| is shorter than |entry->key()|
+    // |input_key| is shorter than |entry.key()|
     // This scenario is a simple prefix match.
-    // e.g., |input_key|="foo", |entry->key()|="foobar"
-    result = AddEntry(*entry, results);
+    // e.g., |input_key|="foo", |entry.key()|="foobar"
+    result = AddEntry(entry, results);
     if (result) {
       last_entry = entry;
-      left_last_access_time = entry->last_access_time();
+      left_last_access_time = entry.last_access_time();
       left_most_last_access_time =
-          IsContentWord(entry->value()) ? left_last_access_time : 0;
+          IsContentWord(entry.value()) ? left_last_access_time : 0;
     }
   } else if (mtype == RIGHT_PREFIX_MATCH || mtype == EXACT_MATCH) {
-    // |input_key| is longer than or the same as |entry->key()|.
+    // |input_key| is longer than or the same as |entry.key()|.
     // In this case, recursively traverse "next_entries" until
     // target entry gets longer than input_key.
-    // e.g., |input_key|="foobar", |entry->key()|="foo"
+    // e.g., |input_key|="foobar", |entry.key()|="foo"
     if (request_type == ZERO_QUERY_SUGGESTION && mtype == EXACT_MATCH) {
       // For mobile, we don't generate joined result.
-      result = AddEntry(*entry, results);
+      result = AddEntry(entry, results);
       if (result) {
         last_entry = entry;
-        left_last_access_time = entry->last_access_time();
+        left_last_access_time = entry.last_access_time();
         left_most_last_access_time =
-            IsContentWord(entry->value()) ? left_last_access_time : 0;
+            IsContentWord(entry.value()) ? left_last_access_time : 0;
       }
     } else {
       std::string key, value;
-      left_last_access_time = entry->last_access_time();
+      left_last_access_time = entry.last_access_time();
       left_most_last_access_time =
-          IsContentWord(entry->value()) ? left_last_access_time : 0;
+          IsContentWord(entry.value()) ? left_last_access_time : 0;
       if (!GetKeyValueForExactAndRightPrefixMatch(
-              input_key, entry, &last_entry, &left_last_access_time,
+              input_key, entry, pending, &last_entry, &left_last_access_time,
               &left_most_last_access_time, &key, &value)) {
         return false;
       }
-      result = AddEntryWithNewKeyValue(std::move(key), std::move(value), *entry,
-                                       results);
+      Entry base_entry;
+      entry.CopyTo(&base_entry);
+      result = AddEntryWithNewKeyValue(std::move(key), std::move(value),
+                                       std::move(base_entry), pending, results);
     }
   } else {
     LOG(ERROR) << "Unknown match mode: " << mtype;
@@ -1108,7 +1268,7 @@ bool UserHistoryPredictor::LookupEntry(RequestType request_type,
   // from |prev_entry| to |entry|.
   result->set_bigram_boost(false);
 
-  if (prev_entry != nullptr && HasBigramEntry(*entry, *prev_entry)) {
+  if (prev_entry && HasBigramEntry(entry, prev_entry)) {
     // Sets bigram_boost flag so that this entry is boosted
     // against LRU policy.
     result->set_bigram_boost(true);
@@ -1124,46 +1284,46 @@ bool UserHistoryPredictor::LookupEntry(RequestType request_type,
   }
 
   // Generates joined result using |last_entry|.
-  if (last_entry != nullptr && Util::CharsLen(result->key()) >= 1 &&
+  if (last_entry && Util::CharsLen(result->key()) >= 1 &&
       2 * Util::CharsLen(input_key) >= Util::CharsLen(result->key())) {
-    const Entry *latest_entry = nullptr;
-    const Entry *left_same_timestamp_entry = nullptr;
-    const Entry *left_most_same_timestamp_entry = nullptr;
-    for (int i = 0; i < last_entry->next_entries_size(); ++i) {
-      const Entry *tmp_entry =
-          dic_->LookupWithoutInsert(last_entry->next_entries(i).entry_fp());
-      if (tmp_entry == nullptr || tmp_entry->key().empty()) {
+    EntryRef latest_entry;
+    EntryRef left_same_timestamp_entry;
+    EntryRef left_most_same_timestamp_entry;
+    for (const uint32_t next_fp : last_entry.next_entry_fps()) {
+      EntryRef tmp_entry = LookupWithPending(pending, next_fp);
+      if (!tmp_entry || tmp_entry.key().empty()) {
         continue;
       }
-      if (latest_entry == nullptr ||
-          latest_entry->last_access_time() < tmp_entry->last_access_time()) {
+      if (!latest_entry ||
+          latest_entry.last_access_time() < tmp_entry.last_access_time()) {
         latest_entry = tmp_entry;
       }
-      if (tmp_entry->last_access_time() == left_last_access_time) {
+      if (tmp_entry.last_access_time() == left_last_access_time) {
         left_same_timestamp_entry = tmp_entry;
       }
-      if (tmp_entry->last_access_time() == left_most_last_access_time) {
+      if (tmp_entry.last_access_time() == left_most_last_access_time) {
         left_most_same_timestamp_entry = tmp_entry;
       }
     }
 
-    const Entry *next_entry = left_most_same_timestamp_entry;
-    if (next_entry == nullptr) {
+    EntryRef next_entry = left_most_same_timestamp_entry;
+    if (!next_entry) {
       next_entry = left_same_timestamp_entry;
     }
-    if (next_entry == nullptr) {
+    if (!next_entry) {
       next_entry = latest_entry;
     }
 
     // The new entry was input within 10 seconds.
     // TODO(taku): This is a simple heuristics.
-    if (next_entry != nullptr && !next_entry->key().empty() &&
-        abs(static_cast<int32_t>(next_entry->last_access_time() -
-                                 last_entry->last_access_time())) <= 10 &&
-        IsContentWord(next_entry->value())) {
+    if (next_entry && !next_entry.key().empty() &&
+        abs(static_cast<int32_t>(next_entry.last_access_time() -
+                                 last_entry.last_access_time())) <= 10 &&
+        IsContentWord(next_entry.value())) {
       Entry *result2 = AddEntryWithNewKeyValue(
-          absl::StrCat(result->key(), next_entry->key()),
-          absl::StrCat(result->value(), next_entry->value()), *result, results);
+          absl::StrCat(result->key(), next_entry.key()),
+          absl::StrCat(result->value(), next_entry.value()), *result, pending,
+          results);
       if (!result2->removed()) {
         results->Push(result2);
       }
@@ -1183,17 +1343,20 @@ bool UserHistoryPredictor::Predict(Segments *segments) const {
 
 bool UserHistoryPredictor::PredictForRequest(const ConversionRequest &request,
                                              Segments *segments) const {
+  ScopedTraceSpan span("UserHistoryPredictor::PredictForRequest");
   const RequestType request_type = request.request().zero_query_suggestion()
                                        ? ZERO_QUERY_SUGGESTION
                                        : DEFAULT;
-  if (!ShouldPredict(request_type, request, *segments)) {
+  // The entries updated by the commits which are not learned yet.
+  const std::unique_ptr<UserHistoryStore> pending = BuildPendingStore();
+  if (!ShouldPredict(request_type, request, *segments, pending.get())) {
     return false;
   }
 
   const size_t input_key_len =
       Util::CharsLen(segments->conversion_segment(0).key());
-  const Entry *prev_entry = LookupPrevEntry(*segments);
-  if (input_key_len == 0 && prev_entry == nullptr) {
+  const EntryRef prev_entry = LookupPrevEntry(*segments, pending.get());
+  if (input_key_len == 0 && !prev_entry) {
     MOZC_VLOG(1) << "If input_key_len is 0, prev_entry must be set";
     return false;
   }
@@ -1221,7 +1384,8 @@ bool UserHistoryPredictor::PredictForRequest(const ConversionRequest &request,
 
   EntryPriorityQueue results;
   GetResultsFromHistoryDictionary(request_type, request, *segments, prev_entry,
-                                  max_prediction_size * 5, &results);
+                                  pending.get(), max_prediction_size * 5,
+                                  &results);
   if (results.size() == 0) {
     MOZC_VLOG(2) << "no prefix match candidate is found.";
     return false;
@@ -1231,10 +1395,10 @@ bool UserHistoryPredictor::PredictForRequest(const ConversionRequest &request,
                           max_prediction_char_coverage, segments, &results);
 }
 
-bool UserHistoryPredictor::ShouldPredict(RequestType request_type,
-                                         const ConversionRequest &request,
-                                         const Segments &segments) const {
-  if (!CheckSyncerAndDelete()) {
+bool UserHistoryPredictor::ShouldPredict(
+    RequestType request_type, const ConversionRequest &request,
+    const Segments &segments, const UserHistoryStore *pending) const {
+  if (!IsSyncerReady()) {
     LOG(WARNING) << "Syncer is running";
     return false;
   }
@@ -1265,7 +1429,7 @@ bool UserHistoryPredictor::ShouldPredict(RequestType request_type,
     return false;
   }
 
-  if (dic_->empty()) {
+  if (dic_->empty() && pending == nullptr) {
     MOZC_VLOG(2) << "dic is empty";
     return false;
   }
@@ -1285,15 +1449,15 @@ bool UserHistoryPredictor::ShouldPredict(RequestType request_type,
   return true;
 }
 
-const UserHistoryPredictor::Entry *UserHistoryPredictor::LookupPrevEntry(
-    const Segments &segments) const {
+UserHistoryPredictor::EntryRef UserHistoryPredictor::LookupPrevEntry(
+    const Segments &segments, const UserHistoryStore *pending) const {
   const Segments::const_range history_segments = segments.history_segments();
-  const Entry *prev_entry = nullptr;
+  EntryRef prev_entry;
   // When there are non-zero history segments, lookup an entry
   // from the LRU dictionary, which is corresponding to the last
   // history segment.
   if (history_segments.empty()) {
-    return nullptr;
+    return EntryRef();
   }
 
   const Segment &history_segment = history_segments.back();
@@ -1317,45 +1481,45 @@ const UserHistoryPredictor::Entry *UserHistoryPredictor::LookupPrevEntry(
     for (const auto &segment : history_segments) {
       if (suffix_key.empty() || suffix_value.empty()) break;
       prev_entry =
-          dic_->LookupWithoutInsert(Fingerprint(suffix_key, suffix_value));
+          LookupWithPending(pending, Fingerprint(suffix_key, suffix_value));
       if (prev_entry) break;
       suffix_value.remove_prefix(segment.candidate(0).value.size());
       suffix_key.remove_prefix(segment.candidate(0).key.size());
     }
   } else {
-    prev_entry = dic_->LookupWithoutInsert(SegmentFingerprint(history_segment));
+    prev_entry =
+        LookupWithPending(pending, SegmentFingerprint(history_segment));
   }
 
   // Check the timestamp of prev_entry.
   const absl::Time now = Clock::GetAbslTime();
-  if (prev_entry != nullptr &&
-      absl::FromUnixSeconds(prev_entry->last_access_time()) + k62Days < now) {
+  if (prev_entry &&
+      absl::FromUnixSeconds(prev_entry.last_access_time()) + k62Days < now) {
     updated_ = true;  // We found an entry to be deleted at next save.
-    return nullptr;
+    return EntryRef();
   }
 
   // When |prev_entry| is nullptr or |prev_entry| has no valid next_entries,
   // do linear-search over the LRU.
-  if ((prev_entry == nullptr && history_segment.candidates_size() > 0) ||
-      (prev_entry != nullptr && prev_entry->next_entries_size() == 0)) {
-    const std::string &prev_value = prev_entry == nullptr
-                                        ? history_segment.candidate(0).value
-                                        : prev_entry->value();
+  if ((!prev_entry && history_segment.candidates_size() > 0) ||
+      (prev_entry && prev_entry.next_entries_size() == 0)) {
+    const absl::string_view prev_value =
+        !prev_entry ? absl::string_view(history_segment.candidate(0).value)
+                    : prev_entry.value();
     int trial = 0;
-    for (const DicElement &elm : *dic_) {
+    for (EntryRef entry : *dic_) {
       if (++trial > kMaxPrevValueTrial) {
         break;
       }
-      const Entry *entry = &(elm.value);
-      // entry->value() equals to the prev_value or
-      // entry->value() is a SUFFIX of prev_value.
-      // length of entry->value() must be >= 2, as single-length
+      // entry.value() equals to the prev_value or
+      // entry.value() is a SUFFIX of prev_value.
+      // length of entry.value() must be >= 2, as single-length
       // match would be noisy.
-      if (IsValidEntry(*entry) && entry != prev_entry &&
-          entry->next_entries_size() > 0 &&
-          Util::CharsLen(entry->value()) >= 2 &&
-          (entry->value() == prev_value ||
-           absl::EndsWith(prev_value, entry->value()))) {
+      if (IsValidEntry(entry) && entry != prev_entry &&
+          entry.next_entries_size() > 0 &&
+          Util::CharsLen(entry.value()) >= 2 &&
+          (entry.value() == prev_value ||
+           absl::EndsWith(prev_value, entry.value()))) {
         prev_entry = entry;
         break;
       }
@@ -1366,7 +1530,8 @@ const UserHistoryPredictor::Entry *UserHistoryPredictor::LookupPrevEntry(
 
 void UserHistoryPredictor::GetResultsFromHistoryDictionary(
     RequestType request_type, const ConversionRequest &request,
-    const Segments &segments, const Entry *prev_entry, size_t max_results_size,
+    const Segments &segments, EntryRef prev_entry,
+    const UserHistoryStore *pending, size_t max_results_size,
     EntryPriorityQueue *results) const {
   DCHECK(results);
   // Gets romanized input key if the given preedit looks misspelled.
@@ -1399,33 +1564,34 @@ void UserHistoryPredictor::GetResultsFromHistoryDictionary(
 
   const absl::Time now = Clock::GetAbslTime();
   int trial = 0;
-  for (const DicElement &elm : *dic_) {
+  // Looks up `entry` and returns false if the lookup should stop.
+  auto lookup = [&](EntryRef entry) {
     // already found enough results.
     if (results->size() >= max_results_size) {
-      break;
+      return false;
     }
 
-    if (!IsValidEntryIgnoringRemovedField(elm.value)) {
-      continue;
+    if (!IsValidEntryIgnoringRemovedField(entry)) {
+      return true;
     }
-    if (absl::FromUnixSeconds(elm.value.last_access_time()) + k62Days < now) {
+    if (absl::FromUnixSeconds(entry.last_access_time()) + k62Days < now) {
       updated_ = true;  // We found an entry to be deleted at next save.
-      continue;
+      return true;
     }
     if (request.request_type() == ConversionRequest::SUGGESTION &&
         trial++ >= kMaxSuggestionTrial) {
       MOZC_VLOG(2) << "too many trials";
-      break;
+      return false;
     }
 
-    // Lookup key from elm_value and prev_entry.
+    // Lookup key from entry and prev_entry.
     // If a new entry is found, the entry is pushed to the results.
-    if (LookupEntry(request_type, input_key, base_key, expanded.get(),
-                    &(elm.value), prev_entry, results) ||
-        RomanFuzzyLookupEntry(roman_input_key, &(elm.value), results) ||
-        ZeroQueryLookupEntry(request_type, input_key, &(elm.value), prev_entry,
+    if (LookupEntry(request_type, input_key, base_key, expanded.get(), entry,
+                    prev_entry, pending, results) ||
+        RomanFuzzyLookupEntry(roman_input_key, entry, results) ||
+        ZeroQueryLookupEntry(request_type, input_key, entry, prev_entry,
                              results)) {
-      continue;
+      return true;
     }
 
     // Lookup typing corrected keys when the original `input_key` doesn't match.
@@ -1435,11 +1601,30 @@ void UserHistoryPredictor::GetResultsFromHistoryDictionary(
       // Only apply when score > 0. When score < 0, we trigger literal-on-top
       // in dictionary predictor.
       if (c.score > 0.0 &&
-          LookupEntry(request_type, c.correction, c.correction, nullptr,
-                      &(elm.value), prev_entry, results)) {
+          LookupEntry(request_type, c.correction, c.correction, nullptr, entry,
+                      prev_entry, pending, results)) {
         break;
       }
     }
+    return true;
+  };
+
+  // The pending entries are the most recently used ones, and shadow the old
+  // versions in dic_.
+  if (pending != nullptr) {
+    for (EntryRef entry : *pending) {
+      if (!lookup(entry)) {
+        return;
+      }
+    }
+  }
+  for (EntryRef entry : *dic_) {
+    if (pending != nullptr && pending->HasKey(entry.fp())) {
+      continue;
+    }
+    if (!lookup(entry)) {
+      return;
+    }
   }
 }
 
@@ -1661,52 +1846,52 @@ bool UserHistoryPredictor::InsertCandidates(RequestType request_type,
   return !entries.empty();
 }
 
-void UserHistoryPredictor::InsertNextEntry(const NextEntry &next_entry,
-                                           Entry *entry) const {
-  if (next_entry.entry_fp() == 0 || entry == nullptr) {
+void UserHistoryPredictor::InsertNextEntry(uint32_t next_fp,
+                                           MutableEntryRef entry) const {
+  if (next_fp == 0 || !entry) {
     return;
   }
 
-  NextEntry *target_next_entry = nullptr;
-
   // If next_entries_size is less than kMaxNextEntriesSize,
   // we simply allocate a new entry.
-  if (entry->next_entries_size() < max_next_entries_size()) {
-    target_next_entry = entry->add_next_entries();
-  } else {
-    // Otherwise, find the oldest next_entry.
-    uint64_t last_access_time = std::numeric_limits<uint64_t>::max();
-    for (int i = 0; i < entry->next_entries_size(); ++i) {
-      // Already has the same id
-      if (next_entry.entry_fp() == entry->next_entries(i).entry_fp()) {
-        target_next_entry = entry->mutable_next_entries(i);
-        break;
-      }
-      const Entry *found_entry =
-          dic_->LookupWithoutInsert(entry->next_entries(i).entry_fp());
-      // Reuses the entry if it is already removed from the LRU.
-      if (found_entry == nullptr) {
-        target_next_entry = entry->mutable_next_entries(i);
-        break;
-      }
-      // Preserves the oldest entry
-      if (target_next_entry == nullptr ||
-          last_access_time > found_entry->last_access_time()) {
-        target_next_entry = entry->mutable_next_entries(i);
-        last_access_time = found_entry->last_access_time();
-      }
+  if (entry.next_entries_size() < max_next_entries_size()) {
+    entry.add_next_entry_fp(next_fp);
+    return;
+  }
+
+  // Otherwise, find the oldest next_entry.
+  const absl::Span<const uint32_t> next_fps = entry.next_entry_fps();
+  std::optional<size_t> target_index;
+  uint64_t last_access_time = std::numeric_limits<uint64_t>::max();
+  for (size_t i = 0; i < next_fps.size(); ++i) {
+    // Already has the same id
+    if (next_fp == next_fps[i]) {
+      target_index = i;
+      break;
+    }
+    const EntryRef found_entry = dic_->LookupWithoutInsert(next_fps[i]);
+    // Reuses the entry if it is already removed from the LRU.
+    if (!found_entry) {
+      target_index = i;
+      break;
+    }
+    // Preserves the oldest entry
+    if (!target_index.has_value() ||
+        last_access_time > found_entry.last_access_time()) {
+      target_index = i;
+      last_access_time = found_entry.last_access_time();
     }
   }
 
-  if (target_next_entry == nullptr) {
+  if (!target_index.has_value()) {
     LOG(ERROR) << "cannot find a room for inserting next fp";
     return;
   }
 
-  *target_next_entry = next_entry;
+  entry.set_next_entry_fp(*target_index, next_fp);
 }
 
-bool UserHistoryPredictor::IsValidEntry(const Entry &entry) const {
+bool UserHistoryPredictor::IsValidEntry(EntryRef entry) const {
   if (entry.removed() || !IsValidEntryIgnoringRemovedField(entry)) {
     return false;
   }
@@ -1714,7 +1899,7 @@ bool UserHistoryPredictor::IsValidEntry(const Entry &entry) const {
 }
 
 bool UserHistoryPredictor::IsValidEntryIgnoringRemovedField(
-    const Entry &entry) const {
+    EntryRef entry) const {
   if (entry.entry_type() != Entry::DEFAULT_ENTRY ||
       suppression_dictionary_->SuppressEntry(entry.key(), entry.value())) {
     return false;
@@ -1741,17 +1926,11 @@ void UserHistoryPredictor::InsertEvent(EntryType type) {
   const uint32_t dic_key = Fingerprint("", "", type);
 
   CHECK(dic_.get());
-  DicElement *e = dic_->Insert(dic_key);
-  if (e == nullptr) {
-    MOZC_VLOG(2) << "insert failed";
-    return;
-  }
-
-  Entry *entry = &(e->value);
-  DCHECK(entry);
-  entry->Clear();
-  entry->set_entry_type(type);
-  entry->set_last_access_time(last_access_time);
+  MutableEntryRef entry = dic_->Insert(dic_key);
+  entry.Clear();
+  entry.set_entry_type(type);
+  entry.set_last_access_time(last_access_time);
+  MarkDirty(dic_key);
 }
 
 bool UserHistoryPredictor::ShouldInsert(
@@ -1808,43 +1987,28 @@ void UserHistoryPredictor::Insert(std::string key, std::string value,
     // add a treatment for UPDATE_ENTRY mode
   }
 
-  DicElement *e = dic_->Insert(dic_key);
-  if (e == nullptr) {
-    MOZC_VLOG(2) << "insert failed";
-    return;
-  }
-
-  Entry *entry = &(e->value);
-  DCHECK(entry);
-
-  entry->set_key(std::move(key));
-  entry->set_value(std::move(value));
-  entry->set_removed(false);
+  MutableEntryRef entry = dic_->Insert(dic_key);
+  entry.set_key(key);
+  entry.set_value(value);
+  entry.set_removed(false);
+  entry.set_description(description);
 
-  if (description.empty()) {
-    entry->clear_description();
-  } else {
-    entry->set_description(std::move(description));
-  }
-
-  entry->set_last_access_time(last_access_time);
+  entry.set_last_access_time(last_access_time);
   if (is_suggestion_selected) {
-    entry->set_suggestion_freq(entry->suggestion_freq() + 1);
+    entry.set_suggestion_freq(entry.suggestion_freq() + 1);
   } else {
-    entry->set_conversion_freq(entry->conversion_freq() + 1);
+    entry.set_conversion_freq(entry.conversion_freq() + 1);
   }
 
   // Inserts next_fp to the entry
   for (const auto next_fp : next_fps) {
-    NextEntry next_entry;
-    next_entry.set_entry_fp(next_fp);
-    InsertNextEntry(next_entry, entry);
+    InsertNextEntry(next_fp, entry);
   }
 
-  MOZC_VLOG(2) << entry->key() << " " << entry->value()
-               << " has been inserted: " << *entry;
+  MOZC_VLOG(2) << entry.key() << " " << entry.value() << " has been inserted";
 
   // New entry is inserted to the cache
+  MarkDirty(dic_key);
   updated_ = true;
 }
 
@@ -1886,23 +2050,24 @@ void UserHistoryPredictor::MaybeRemoveUnselectedHistory(
   for (size_t i = 0; i < std::min(segment.candidates_size(), kMaxHistorySize);
        ++i) {
     const Segment::Candidate &candidate = segment.candidate(i);
-    Entry *entry = dic_->MutableLookupWithoutInsert(
-        Fingerprint(candidate.key, candidate.value));
-    if (entry == nullptr) {
+    const uint32_t fp = Fingerprint(candidate.key, candidate.value);
+    MutableEntryRef entry = dic_->MutableLookupWithoutInsert(fp);
+    if (!entry) {
       continue;
     }
+    MarkDirty(fp);
     // Note(b/339742825): For now shown freq is only used here and it's OK to
     // increment the value here.
-    entry->set_shown_freq(entry->shown_freq() + 1);
+    entry.set_shown_freq(entry.shown_freq() + 1);
 
     const float selected_ratio =
-        1.0 * std::max(entry->suggestion_freq(), entry->conversion_freq()) /
-        entry->shown_freq();
+        1.0 * std::max(entry.suggestion_freq(), entry.conversion_freq()) /
+        entry.shown_freq();
     if (selected_ratio < kMinSelectedRatio) {
-      entry->set_suggestion_freq(0);
-      entry->set_conversion_freq(0);
-      entry->set_shown_freq(0);
-      entry->set_removed(true);
+      entry.set_suggestion_freq(0);
+      entry.set_conversion_freq(0);
+      entry.set_shown_freq(0);
+      entry.set_removed(true);
       continue;
     }
   }
@@ -1910,25 +2075,7 @@ void UserHistoryPredictor::MaybeRemoveUnselectedHistory(
 
 void UserHistoryPredictor::Finish(const ConversionRequest &request,
                                   Segments *segments) {
-  if (request.request_type() == ConversionRequest::REVERSE_CONVERSION) {
-    // Do nothing for REVERSE_CONVERSION.
-    return;
-  }
-
-  if (request.config().incognito_mode()) {
-    MOZC_VLOG(2) << "incognito mode";
-    return;
-  }
-
-  if (request.config().history_learning_level() !=
-      config::Config::DEFAULT_HISTORY) {
-    MOZC_VLOG(2) << "history learning level is not DEFAULT_HISTORY: "
-                 << request.config().history_learning_level();
-    return;
-  }
-
-  if (!request.config().use_history_suggest()) {
-    MOZC_VLOG(2) << "no history suggest";
+  if (!IsLearningEnabled(request)) {
     return;
   }
 
@@ -1958,7 +2105,7 @@ void UserHistoryPredictor::Finish(const ConversionRequest &request,
   //
   // Note: We don't make such candidates for mobile.
   if (request_type != ZERO_QUERY_SUGGESTION && !dic_->empty() &&
-      dic_->Head()->value.last_access_time() + 5 > last_access_time &&
+      dic_->Head().last_access_time() + 5 > last_access_time &&
       // Check if the current value is a punctuation.
       segments->conversion_segments_size() == 1 &&
       segments->conversion_segment(0).candidates_size() > 0 &&
@@ -1968,49 +2115,82 @@ void UserHistoryPredictor::Finish(const ConversionRequest &request,
       segments->history_segments().back().candidates_size() > 0 &&
       IsSentenceLikeCandidate(
           segments->history_segments().back().candidate(0))) {
-    const Entry *entry = &(dic_->Head()->value);
+    const EntryRef entry = dic_->Head();
     DCHECK(entry);
     const std::string &last_value =
         segments->history_segments().back().candidate(0).value;
     // Check if the head value in LRU ends with the candidate value in history
     // segments.
-    if (absl::EndsWith(entry->value(), last_value)) {
+    if (absl::EndsWith(entry.value(), last_value)) {
       const Segment::Candidate &candidate =
           segments->conversion_segment(0).candidate(0);
       // Uses the same last_access_time stored in the top element
       // so that this item can be grouped together.
       TryInsert(
-          std::move(request_type), absl::StrCat(entry->key(), candidate.key),
-          absl::StrCat(entry->value(), candidate.value), entry->description(),
-          is_suggestion, {}, entry->last_access_time(), segments);
+          std::move(request_type), absl::StrCat(entry.key(), candidate.key),
+          absl::StrCat(entry.value(), candidate.value), entry.description(),
+          is_suggestion, {}, entry.last_access_time(), segments);
     }
   }
 
+  if (!IsLearnableSegments(*segments)) {
+    return;
+  }
+
+  InsertHistory(request_type, is_suggestion, last_access_time, segments);
+
+  MaybeRemoveUnselectedHistory(*segments);
+}
+
+bool UserHistoryPredictor::IsLearningEnabled(
+    const ConversionRequest &request) const {
+  if (request.request_type() == ConversionRequest::REVERSE_CONVERSION) {
+    // Do nothing for REVERSE_CONVERSION.
+    return false;
+  }
+
+  if (request.config().incognito_mode()) {
+    MOZC_VLOG(2) << "incognito mode";
+    return false;
+  }
+
+  if (request.config().history_learning_level() !=
+      config::Config::DEFAULT_HISTORY) {
+    MOZC_VLOG(2) << "history learning level is not DEFAULT_HISTORY: "
+                 << request.config().history_learning_level();
+    return false;
+  }
+
+  if (!request.config().use_history_suggest()) {
+    MOZC_VLOG(2) << "no history suggest";
+    return false;
+  }
+  return true;
+}
+
+bool UserHistoryPredictor::IsLearnableSegments(const Segments &segments) const {
   // Checks every segment is valid.
-  for (const Segment &segment : segments->conversion_segments()) {
+  for (const Segment &segment : segments.conversion_segments()) {
     if (segment.candidates_size() < 1) {
       MOZC_VLOG(2) << "candidates size < 1";
-      return;
+      return false;
     }
     if (segment.segment_type() != Segment::FIXED_VALUE) {
       MOZC_VLOG(2) << "segment is not FIXED_VALUE";
-      return;
+      return false;
     }
     const Segment::Candidate &candidate = segment.candidate(0);
     if (candidate.attributes & Segment::Candidate::NO_SUGGEST_LEARNING) {
       MOZC_VLOG(2) << "NO_SUGGEST_LEARNING";
-      return;
+      return false;
     }
   }
 
-  if (IsPrivacySensitive(segments)) {
+  if (IsPrivacySensitive(&segments)) {
     MOZC_VLOG(2) << "do not remember privacy sensitive input";
-    return;
+    return false;
   }
-
-  InsertHistory(request_type, is_suggestion, last_access_time, segments);
-
-  MaybeRemoveUnselectedHistory(*segments);
+  return true;
 }
 
 UserHistoryPredictor::SegmentsForLearning
@@ -2057,79 +2237,39 @@ void UserHistoryPredictor::InsertHistory(RequestType request_type,
                                          Segments *segments) {
   const SegmentsForLearning learning_segments = MakeLearningSegments(*segments);
 
-  InsertHistoryForConversionSegments(request_type, is_suggestion_selected,
-                                     last_access_time, learning_segments,
-                                     segments);
-
-  const std::string &all_key = learning_segments.conversion_segments_key;
-  const std::string &all_value = learning_segments.conversion_segments_value;
-
-  // Inserts all_key/all_value.
-  // We don't insert it for mobile.
-  if (request_type != ZERO_QUERY_SUGGESTION &&
-      learning_segments.conversion_segments.size() > 1 && !all_key.empty() &&
-      !all_value.empty()) {
-    TryInsert(request_type, all_key, all_value, "", is_suggestion_selected, {},
-              last_access_time, segments);
-  }
+  ForEachHistoryInsertion(
+      request_type, learning_segments,
+      [&](absl::string_view key, absl::string_view value,
+          absl::string_view description, absl::Span<const uint32_t> next_fps) {
+        TryInsert(request_type, key, value, description,
+                  is_suggestion_selected, next_fps, last_access_time,
+                  segments);
+      });
 
   // Makes a link from the last history_segment to the first conversion segment
   // or to the entire user input.
-  if (!learning_segments.history_segments.empty() &&
-      !learning_segments.conversion_segments.empty()) {
-    const SegmentForLearning &history_segment =
-        learning_segments
-            .history_segments[segments->history_segments_size() - 1];
-    const SegmentForLearning &conversion_segment =
-        learning_segments.conversion_segments[0];
-    const std::string &history_value = history_segment.value;
-    if (history_value.empty() || conversion_segment.value.empty()) {
-      return;
-    }
-    // 1) Don't learn a link from a history which ends with punctuation.
-    if (IsPunctuation(Util::Utf8SubString(
-            history_value, Util::CharsLen(history_value) - 1, 1))) {
-      return;
-    }
-    // 2) Don't learn a link to a punctuation.
-    // Exception: For zero query suggestion, we learn a link to a single
-    //            punctuation segment.
-    // Example: "よろしく|。" -> OK
-    //          "よろしく|。でも" -> NG
-    //          "よろしく|。。" -> NG
-    // Note that another piece of code handles learning for
-    // (sentence + punctuation) form; see Finish().
-    if (IsPunctuation(Util::Utf8SubString(conversion_segment.value, 0, 1)) &&
-        (request_type != ZERO_QUERY_SUGGESTION ||
-         Util::CharsLen(conversion_segment.value) > 1)) {
-      return;
-    }
-    Entry *history_entry = dic_->MutableLookupWithoutInsert(
-        LearningSegmentFingerprint(history_segment));
-    if (history_entry) {
-      NextEntry next_entry;
-      if (!is_suggestion_selected) {
-        for (const auto next_fp :
-             LearningSegmentFingerprints(conversion_segment)) {
-          next_entry.set_entry_fp(next_fp);
-          InsertNextEntry(next_entry, history_entry);
-        }
-      }
-
-      // Entire user input or SUGGESTION
-      if (is_suggestion_selected ||
-          learning_segments.conversion_segments.size() > 1) {
-        next_entry.set_entry_fp(Fingerprint(all_key, all_value));
-        InsertNextEntry(next_entry, history_entry);
-      }
+  const std::vector<uint32_t> link_fps = GetHistoryLinkFingerprints(
+      request_type, is_suggestion_selected, learning_segments);
+  if (link_fps.empty()) {
+    return;
+  }
+  const uint32_t history_fp =
+      LearningSegmentFingerprint(learning_segments.history_segments.back());
+  MutableEntryRef history_entry = dic_->MutableLookupWithoutInsert(history_fp);
+  if (history_entry) {
+    MarkDirty(history_fp);
+    for (const uint32_t next_fp : link_fps) {
+      InsertNextEntry(next_fp, history_entry);
     }
   }
 }
 
-void UserHistoryPredictor::InsertHistoryForConversionSegments(
-    RequestType request_type, bool is_suggestion_selected,
-    uint64_t last_access_time, const SegmentsForLearning &learning_segments,
-    Segments *segments) {
+void UserHistoryPredictor::ForEachHistoryInsertion(
+    RequestType request_type, const SegmentsForLearning &learning_segments,
+    absl::FunctionRef<void(absl::string_view key, absl::string_view value,
+                           absl::string_view description,
+                           absl::Span<const uint32_t> next_fps)>
+        insert) const {
   absl::flat_hash_set<std::vector<uint32_t>> seen;
   bool this_was_seen = false;
 
@@ -2160,16 +2300,71 @@ void UserHistoryPredictor::InsertHistoryForConversionSegments(
     } else {
       this_was_seen = false;
     }
-    TryInsert(request_type, segment.key, segment.value, segment.description,
-              is_suggestion_selected, next_fps_to_set, last_access_time,
-              segments);
+    insert(segment.key, segment.value, segment.description, next_fps_to_set);
     if (content_word_learning_enabled_ && segment.content_key != segment.key &&
         segment.content_value != segment.value) {
-      TryInsert(request_type, segment.content_key, segment.content_value,
-                segment.description, is_suggestion_selected, {},
-                last_access_time, segments);
+      insert(segment.content_key, segment.content_value, segment.description,
+             {});
     }
   }
+
+  const std::string &all_key = learning_segments.conversion_segments_key;
+  const std::string &all_value = learning_segments.conversion_segments_value;
+
+  // Inserts all_key/all_value.
+  // We don't insert it for mobile.
+  if (request_type != ZERO_QUERY_SUGGESTION &&
+      learning_segments.conversion_segments.size() > 1 && !all_key.empty() &&
+      !all_value.empty()) {
+    insert(all_key, all_value, "", {});
+  }
+}
+
+std::vector<uint32_t> UserHistoryPredictor::GetHistoryLinkFingerprints(
+    RequestType request_type, bool is_suggestion_selected,
+    const SegmentsForLearning &learning_segments) const {
+  if (learning_segments.history_segments.empty() ||
+      learning_segments.conversion_segments.empty()) {
+    return {};
+  }
+  const SegmentForLearning &history_segment =
+      learning_segments.history_segments.back();
+  const SegmentForLearning &conversion_segment =
+      learning_segments.conversion_segments[0];
+  const std::string &history_value = history_segment.value;
+  if (history_value.empty() || conversion_segment.value.empty()) {
+    return {};
+  }
+  // 1) Don't learn a link from a history which ends with punctuation.
+  if (IsPunctuation(Util::Utf8SubString(
+          history_value, Util::CharsLen(history_value) - 1, 1))) {
+    return {};
+  }
+  // 2) Don't learn a link to a punctuation.
+  // Exception: For zero query suggestion, we learn a link to a single
+  //            punctuation segment.
+  // Example: "よろしく|。" -> OK
+  //          "よろしく|。でも" -> NG
+  //          "よろしく|。。" -> NG
+  // Note that another piece of code handles learning for
+  // (sentence + punctuation) form; see Finish().
+  if (IsPunctuation(Util::Utf8SubString(conversion_segment.value, 0, 1)) &&
+      (request_type != ZERO_QUERY_SUGGESTION ||
+       Util::CharsLen(conversion_segment.value) > 1)) {
+    return {};
+  }
+
+  std::vector<uint32_t> fps;
+  if (!is_suggestion_selected) {
+    fps = LearningSegmentFingerprints(conversion_segment);
+  }
+  // Entire user input or SUGGESTION
+  if (is_suggestion_selected ||
+      learning_segments.conversion_segments.size() > 1) {
+    fps.push_back(Fingerprint(learning_segments.conversion_segments_key,
+                              learning_segments.conversion_segments_value));
+  }
+  return fps;
 }
 
 void UserHistoryPredictor::Revert(Segments *segments) {
@@ -2185,8 +2380,141 @@ void UserHistoryPredictor::Revert(Segments *segments) {
       const uint32_t key = LoadUnaligned<uint32_t>(revert_entry.key.data());
       MOZC_VLOG(2) << "Erasing the key: " << key;
       dic_->Erase(key);
+      MarkDirty(key);
+    }
+  }
+}
+
+void UserHistoryPredictor::AddPendingLearning(uint64_t id,
+                                              const ConversionRequest &request,
+                                              const Segments &segments) {
+  // The same conditions as Finish(), except for the ones which depend on the
+  // learned data.
+  if (!IsLearningEnabled(request) || !IsLearnableSegments(segments)) {
+    return;
+  }
+
+  aggressive_bigram_enabled_ = request.request()
+                                   .decoder_experiment_params()
+                                   .user_history_prediction_aggressive_bigram();
+  const RequestType request_type = request.request().zero_query_suggestion()
+                                       ? ZERO_QUERY_SUGGESTION
+                                       : DEFAULT;
+  const bool is_suggestion =
+      request.request_type() != ConversionRequest::CONVERSION;
+  const uint64_t last_access_time = absl::ToUnixSeconds(Clock::GetAbslTime());
+  const SegmentsForLearning learning_segments = MakeLearningSegments(segments);
+
+  // The same updates as InsertHistory().
+  std::vector<PendingUpdate> updates;
+  ForEachHistoryInsertion(
+      request_type, learning_segments,
+      [&](absl::string_view key, absl::string_view value,
+          absl::string_view description, absl::Span<const uint32_t> next_fps) {
+        // The same preprocess as TryInsert().
+        key = absl::StripTrailingAsciiWhitespace(key);
+        value = absl::StripTrailingAsciiWhitespace(value);
+        if (!ShouldInsert(request_type, key, value, description)) {
+          return;
+        }
+        updates.push_back(
+            {.key = std::string(key),
+             .value = std::string(value),
+             .description = std::string(description),
+             .is_suggestion_selected = is_suggestion,
+             .next_fps = std::vector<uint32_t>(next_fps.begin(),
+                                               next_fps.end()),
+             .last_access_time = last_access_time});
+      });
+
+  // The link from the last history segment, which is added only if the entry
+  // of the history segment exists.
+  std::vector<uint32_t> link_fps = GetHistoryLinkFingerprints(
+      request_type, is_suggestion, learning_segments);
+  if (!link_fps.empty()) {
+    const SegmentForLearning &history_segment =
+        learning_segments.history_segments.back();
+    updates.push_back({.key = history_segment.key,
+                       .value = history_segment.value,
+                       .insert = false,
+                       .next_fps = std::move(link_fps)});
+  }
+
+  if (updates.empty()) {
+    return;
+  }
+  absl::MutexLock l(&pending_mutex_);
+  pending_.emplace_back(id, std::move(updates));
+}
+
+void UserHistoryPredictor::RemovePendingLearning(uint64_t id) {
+  absl::MutexLock l(&pending_mutex_);
+  std::erase_if(pending_, [id](const auto &pending) {
+    return pending.first == id;
+  });
+}
+
+std::unique_ptr<UserHistoryStore> UserHistoryPredictor::BuildPendingStore()
+    const {
+  absl::MutexLock l(&pending_mutex_);
+  size_t size = 0;
+  for (const auto &[id, updates] : pending_) {
+    size += updates.size();
+  }
+  if (size == 0) {
+    return nullptr;
+  }
+
+  // Applies the updates to the copies of the entries in dic_ in the same way
+  // as Insert() and InsertHistory().
+  auto pending = std::make_unique<UserHistoryStore>(size);
+  for (const auto &[id, updates] : pending_) {
+    for (const PendingUpdate &update : updates) {
+      const uint32_t fp = Fingerprint(update.key, update.value);
+      MutableEntryRef entry = pending->MutableLookupWithoutInsert(fp);
+      if (!entry) {
+        const EntryRef learned = dic_->LookupWithoutInsert(fp);
+        if (!learned && !update.insert) {
+          continue;
+        }
+        entry = pending->Insert(fp);
+        if (learned) {
+          Entry learned_entry;
+          learned.CopyTo(&learned_entry);
+          entry.CopyFrom(learned_entry);
+        }
+      } else if (update.insert) {
+        // Moves the entry to the head.
+        entry = pending->Insert(fp);
+      }
+      if (update.insert) {
+        entry.set_key(update.key);
+        entry.set_value(update.value);
+        entry.set_removed(false);
+        entry.set_description(update.description);
+        entry.set_last_access_time(update.last_access_time);
+        if (update.is_suggestion_selected) {
+          entry.set_suggestion_freq(entry.suggestion_freq() + 1);
+        } else {
+          entry.set_conversion_freq(entry.conversion_freq() + 1);
+        }
+      }
+      for (const uint32_t next_fp : update.next_fps) {
+        InsertNextEntry(next_fp, entry);
+      }
+    }
+  }
+  return pending;
+}
+
+UserHistoryPredictor::EntryRef UserHistoryPredictor::LookupWithPending(
+    const UserHistoryStore *pending, uint32_t fp) const {
+  if (pending != nullptr) {
+    if (const EntryRef entry = pending->LookupWithoutInsert(fp); entry) {
+      return entry;
     }
   }
+  return dic_->LookupWithoutInsert(fp);
 }
 
 // static
@@ -40,8 +40,12 @@
 #include <utility>
 #include <vector>
 
+#include "absl/base/thread_annotations.h"
 #include "absl/container/flat_hash_set.h"
+#include "absl/functional/function_ref.h"
 #include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/types/span.h"
 #include "base/container/freelist.h"
 #include "base/container/trie.h"
 #include "base/thread.h"
@@ -53,9 +57,9 @@
 #include "engine/modules.h"
 #include "prediction/predictor_interface.h"
 #include "prediction/user_history_predictor.pb.h"
+#include "prediction/user_history_store.h"
 #include "request/conversion_request.h"
 #include "storage/encrypted_string_storage.h"
-#include "storage/lru_cache.h"
 #include "testing/friend_test.h"  // IWYU pragma: keep
 
 namespace mozc::prediction {
@@ -115,6 +119,13 @@ class UserHistoryPredictor : public PredictorInterface {
   // Revert last Finish operation.
   void Revert(Segments *segments) override;
 
+  // Records the entries that Finish() would update for `segments`. They are
+  // looked up before the LRU data by the predictions until
+  // RemovePendingLearning(id) is called.
+  void AddPendingLearning(uint64_t id, const ConversionRequest &request,
+                          const Segments &segments) override;
+  void RemovePendingLearning(uint64_t id) override;
+
   // Sync user history data to local file.
   // You can call either Save() or AsyncSave().
   bool Sync() override;
@@ -139,6 +150,9 @@ class UserHistoryPredictor : public PredictorInterface {
   // Gets user history filename.
   static std::string GetUserHistoryFileName();
 
+  // Gets user history journal filename.
+  static std::string GetUserHistoryJournalFileName();
+
   const std::string &GetPredictorName() const override {
     return predictor_name_;
   }
@@ -147,6 +161,8 @@ class UserHistoryPredictor : public PredictorInterface {
   using Entry = user_history_predictor::UserHistory::Entry;
   using NextEntry = user_history_predictor::UserHistory::NextEntry;
   using EntryType = user_history_predictor::UserHistory::Entry::EntryType;
+  using EntryRef = UserHistoryStore::EntryRef;
+  using MutableEntryRef = UserHistoryStore::MutableEntryRef;
 
   // Returns fingerprints from various object.
   static uint32_t Fingerprint(absl::string_view key, absl::string_view value);
@@ -185,9 +201,22 @@ class UserHistoryPredictor : public PredictorInterface {
     std::vector<SegmentForLearning> conversion_segments;
   };
 
+  // Update of an entry by a commit whose Finish() is deferred.
+  struct PendingUpdate {
+    std::string key;
+    std::string value;
+    std::string description;
+    // False if the update only adds the next entries to an existing entry.
+    bool insert = true;
+    bool is_suggestion_selected = false;
+    std::vector<uint32_t> next_fps;
+    uint64_t last_access_time = 0;
+  };
+
   friend class UserHistoryPredictorTest;
 
   FRIEND_TEST(UserHistoryPredictorTest, UserHistoryPredictorTestSuggestion);
+  FRIEND_TEST(UserHistoryPredictorTest, PendingLearningIsPredicted);
   FRIEND_TEST(UserHistoryPredictorTest, GetMatchTypeTest);
   FRIEND_TEST(UserHistoryPredictorTest, Uint32ToStringTest);
   FRIEND_TEST(UserHistoryPredictorTest, GetScore);
@@ -225,6 +254,7 @@ class UserHistoryPredictor : public PredictorInterface {
   FRIEND_TEST(UserHistoryPredictorTest,
               ClearHistoryEntryTrigramDeleteSecondBigram);
   FRIEND_TEST(UserHistoryPredictorTest, 62DayOldEntriesAreDeletedAtSync);
+  FRIEND_TEST(UserHistoryPredictorTest, JournalIsReplayedOnLoad);
 
   enum MatchType {
     NO_MATCH,            // no match
@@ -255,17 +285,45 @@ class UserHistoryPredictor : public PredictorInterface {
   };
 
   // Returns true if this predictor should return results for the input.
+  // |pending| is the overlay built by BuildPendingStore().
   bool ShouldPredict(RequestType request_type, const ConversionRequest &request,
-                     const Segments &segments) const;
+                     const Segments &segments,
+                     const UserHistoryStore *pending) const;
 
-  // Loads user history data to an on-memory LRU from the local file.
+  // Loads user history data to an on-memory LRU from the local file, and
+  // replays the journal on top of it.
   bool Load();
   // Loads user history data to an on-memory LRU.
   bool Load(const UserHistoryStorage &history);
 
-  // Saves user history data in LRU to local file
+  // Saves the changes of user history data in LRU to the journal. The journal
+  // is compacted into the local file when it gets large.
   bool Save();
 
+  // Moves the changes since the last save to |record|. Returns false if there
+  // is no change to save.
+  bool MakeJournalRecord(
+      user_history_predictor::UserHistoryJournalRecord *record);
+
+  // Appends |record| to the journal and compacts the journal if |compact| is
+  // true or appending fails. Called by the syncer.
+  bool WriteJournal(user_history_predictor::UserHistoryJournalRecord record,
+                    bool compact);
+
+  // Applies the changes of |record| to the on-memory LRU.
+  void ReplayJournalRecord(
+      const user_history_predictor::UserHistoryJournalRecord &record);
+
+  // Returns true if the journal should be compacted on the next save.
+  bool ShouldCompactJournal() const;
+
+  // Saves all the user history data in LRU to the local file and removes the
+  // journal.
+  bool SaveSnapshot();
+
+  // Records that the entry of |fp| in |dic_| is inserted, updated or erased.
+  void MarkDirty(uint32_t fp) { dirty_fps_.insert(fp); }
+
   // non-blocking version of Load
   // This makes a new thread and call Load()
   bool AsyncSave();
@@ -293,7 +351,7 @@ class UserHistoryPredictor : public PredictorInterface {
   static std::string Uint32ToString(uint32_t fp);
 
   // Returns true if prev_entry has a next_fp link to entry
-  static bool HasBigramEntry(const Entry &entry, const Entry &prev_entry);
+  static bool HasBigramEntry(EntryRef entry, EntryRef prev_entry);
 
   // Returns true |result_entry| can be handled as
   // a valid result if the length of user input is |prefix_len|.
@@ -312,9 +370,9 @@ class UserHistoryPredictor : public PredictorInterface {
 
   // Returns true if entry is DEFAULT_ENTRY, satisfies certain conditions, and
   // doesn't have removed flag.
-  bool IsValidEntry(const Entry &entry) const;
+  bool IsValidEntry(EntryRef entry) const;
   // The same as IsValidEntry except that removed field is ignored.
-  bool IsValidEntryIgnoringRemovedField(const Entry &entry) const;
+  bool IsValidEntryIgnoringRemovedField(EntryRef entry) const;
 
   // Returns "tweaked" score of result_entry.
   // the score is basically determined by "last_access_time", (a.k.a,
@@ -347,21 +405,33 @@ class UserHistoryPredictor : public PredictorInterface {
     absl::flat_hash_set<size_t> seen_;
   };
 
-  using DicCache = mozc::storage::LruCache<uint32_t, Entry>;
-  using DicElement = DicCache::Element;
+  // Returns true if the syncer is not running. Unlike CheckSyncerAndDelete(),
+  // this doesn't release the finished syncer, so it can be called from the
+  // concurrent predictions.
+  // Returns the entries of |dic_| updated by the pending learning, or nullptr
+  // if there is no pending learning. The returned store is a snapshot for one
+  // prediction, and its entries are looked up before the ones in |dic_|.
+  std::unique_ptr<UserHistoryStore> BuildPendingStore() const;
+
+  // Returns the entry of |fp| in |pending| if found, or the one in |dic_|.
+  EntryRef LookupWithPending(const UserHistoryStore *pending,
+                             uint32_t fp) const;
 
-  bool CheckSyncerAndDelete() const;
+  bool IsSyncerReady() const;
+  bool CheckSyncerAndDelete();
 
   // If |entry| is the target of prediction,
   // create a new result and insert it to |results|.
   // Can set |prev_entry| if there is a history segment just before |input_key|.
   // |prev_entry| is an optional field. If set nullptr, this field is just
-  // ignored. This method adds a new result entry with score,
-  // pair<score, entry>, to |results|.
+  // ignored. |pending| is the overlay of |dic_| and can be nullptr. This
+  // method adds a new result entry with score, pair<score, entry>, to
+  // |results|.
   bool LookupEntry(RequestType request_type, absl::string_view input_key,
                    absl::string_view key_base,
-                   const Trie<std::string> *key_expanded, const Entry *entry,
-                   const Entry *prev_entry, EntryPriorityQueue *results) const;
+                   const Trie<std::string> *key_expanded, EntryRef entry,
+                   EntryRef prev_entry, const UserHistoryStore *pending,
+                   EntryPriorityQueue *results) const;
 
   // For the EXACT and RIGHT_PREFIX match, we will generate joined
   // candidates by looking up the history link.
@@ -372,27 +442,27 @@ class UserHistoryPredictor : public PredictorInterface {
   // |left_last_access_time| and |left_most_last_access_time| will be updated
   // according to the entry lookup.
   bool GetKeyValueForExactAndRightPrefixMatch(
-      absl::string_view input_key, const Entry *entry,
-      const Entry **result_last_entry, uint64_t *left_last_access_time,
-      uint64_t *left_most_last_access_time, std::string *result_key,
-      std::string *result_value) const;
+      absl::string_view input_key, EntryRef entry,
+      const UserHistoryStore *pending, EntryRef *result_last_entry,
+      uint64_t *left_last_access_time, uint64_t *left_most_last_access_time,
+      std::string *result_key, std::string *result_value) const;
 
-  const Entry *LookupPrevEntry(const Segments &segments) const;
+  EntryRef LookupPrevEntry(const Segments &segments,
+                           const UserHistoryStore *pending) const;
 
   // Adds an entry to a priority queue.
-  Entry *AddEntry(const Entry &entry, EntryPriorityQueue *results) const;
+  Entry *AddEntry(EntryRef entry, EntryPriorityQueue *results) const;
 
   // Adds the entry whose key and value are modified to a priority queue.
   Entry *AddEntryWithNewKeyValue(std::string key, std::string value,
-                                 Entry entry,
+                                 Entry entry, const UserHistoryStore *pending,
                                  EntryPriorityQueue *results) const;
 
-  void GetResultsFromHistoryDictionary(RequestType request_type,
-                                       const ConversionRequest &request,
-                                       const Segments &segments,
-                                       const Entry *prev_entry,
-                                       size_t max_results_size,
-                                       EntryPriorityQueue *results) const;
+  void GetResultsFromHistoryDictionary(
+      RequestType request_type, const ConversionRequest &request,
+      const Segments &segments, EntryRef prev_entry,
+      const UserHistoryStore *pending, size_t max_results_size,
+      EntryPriorityQueue *results) const;
 
   // Gets input data from segments.
   // These input data include ambiguities.
@@ -439,23 +509,42 @@ class UserHistoryPredictor : public PredictorInterface {
   // This method adds a new result entry with score, pair<score, entry>, to
   // |results|.
   bool RomanFuzzyLookupEntry(absl::string_view roman_input_key,
-                             const Entry *entry,
+                             EntryRef entry,
                              EntryPriorityQueue *results) const;
 
   // if `prev_entry` is the prefix of `entry`, add the suffix part as
   // zero-query suggestion.
   bool ZeroQueryLookupEntry(RequestType request_type,
-                            absl::string_view input_key, const Entry *entry,
-                            const Entry *prev_entry,
+                            absl::string_view input_key, EntryRef entry,
+                            EntryRef prev_entry,
                             EntryPriorityQueue *results) const;
 
+  // Returns false if the request disables the learning. Shared by Finish()
+  // and AddPendingLearning().
+  bool IsLearningEnabled(const ConversionRequest &request) const;
+
+  // Returns false if the committed segments must not be learned.
+  bool IsLearnableSegments(const Segments &segments) const;
+
   void InsertHistory(RequestType request_type, bool is_suggestion_selected,
                      uint64_t last_access_time, Segments *segments);
 
-  void InsertHistoryForConversionSegments(
+  // Calls `insert` for each entry which InsertHistory() inserts, with the
+  // fingerprints of its next entries. Shared by InsertHistory() and
+  // AddPendingLearning() so that the pending learning predicts the same
+  // entries as the learning.
+  void ForEachHistoryInsertion(
+      RequestType request_type, const SegmentsForLearning &learning_segments,
+      absl::FunctionRef<void(absl::string_view key, absl::string_view value,
+                             absl::string_view description,
+                             absl::Span<const uint32_t> next_fps)>
+          insert) const;
+
+  // Returns the fingerprints of the next entries added to the last history
+  // segment, or an empty vector if the link is not learned.
+  std::vector<uint32_t> GetHistoryLinkFingerprints(
       RequestType request_type, bool is_suggestion_selected,
-      uint64_t last_access_time, const SegmentsForLearning &learning_segments,
-      Segments *segments);
+      const SegmentsForLearning &learning_segments) const;
 
   // Inserts |key,value,description| to the internal dictionary database.
   // |is_suggestion_selected|: key/value is suggestion or conversion.
@@ -481,17 +570,17 @@ class UserHistoryPredictor : public PredictorInterface {
   // Inserts event entry (CLEAN_ALL_EVENT|CLEAN_UNUSED_EVENT).
   void InsertEvent(EntryType type);
 
-  // Inserts a new |next_entry| into |entry|.
+  // Inserts a new next entry of |next_fp| into |entry|.
   // it makes a bigram connection from entry to next_entry.
-  void InsertNextEntry(const NextEntry &next_entry, Entry *entry) const;
+  void InsertNextEntry(uint32_t next_fp, MutableEntryRef entry) const;
 
-  static void EraseNextEntries(uint32_t fp, Entry *entry);
+  static void EraseNextEntries(uint32_t fp, MutableEntryRef entry);
 
   // Recursively removes a chain of Entries in |dic_|. See the comment in
   // implementation for details.
   RemoveNgramChainResult RemoveNgramChain(
       absl::string_view target_key, absl::string_view target_value,
-      Entry *entry, std::vector<absl::string_view> *key_ngrams,
+      MutableEntryRef entry, std::vector<absl::string_view> *key_ngrams,
       size_t key_ngrams_len, std::vector<absl::string_view> *value_ngrams,
       size_t value_ngrams_len);
 
@@ -513,11 +602,26 @@ class UserHistoryPredictor : public PredictorInterface {
 
   bool content_word_learning_enabled_;
   mutable std::atomic<bool> updated_;
-  std::unique_ptr<DicCache> dic_;
-  mutable std::optional<BackgroundFuture<void>> sync_;
+  std::unique_ptr<UserHistoryStore> dic_;
+  // Fingerprints of the entries changed since the last save, and whether
+  // |dic_| was cleared since then. They are written to the journal on save.
+  absl::flat_hash_set<uint32_t> dirty_fps_;
+  bool dic_cleared_ = false;
+  // Sequence number of the last journal record and the total size of the
+  // records in the journal.
+  std::atomic<uint64_t> journal_sequence_ = 0;
+  std::atomic<size_t> journal_size_ = 0;
+  std::atomic<bool> compaction_requested_ = false;
+  std::optional<BackgroundFuture<void>> sync_;
   const engine::Modules &modules_;
 
   mutable std::atomic<bool> aggressive_bigram_enabled_ = false;
+
+  // Updates recorded by AddPendingLearning() with their ids, in the commit
+  // order.
+  mutable absl::Mutex pending_mutex_;
+  std::vector<std::pair<uint64_t, std::vector<PendingUpdate>>> pending_
+      ABSL_GUARDED_BY(pending_mutex_);
 };
 
 }  // namespace mozc::prediction
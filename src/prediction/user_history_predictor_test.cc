@@ -43,6 +43,7 @@
 
 #include "absl/log/check.h"
 #include "absl/random/random.h"
+#include "absl/status/statusor.h"
 #include "absl/strings/match.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_format.h"
@@ -70,12 +71,12 @@
 #include "engine/supplemental_model_interface.h"
 #include "engine/supplemental_model_mock.h"
 #include "prediction/user_history_predictor.pb.h"
+#include "prediction/user_history_store.h"
 #include "protocol/commands.pb.h"
 #include "protocol/config.pb.h"
 #include "request/conversion_request.h"
 #include "request/request_test_util.h"
 #include "storage/encrypted_string_storage.h"
-#include "storage/lru_cache.h"
 #include "testing/gmock.h"
 #include "testing/gunit.h"
 #include "testing/mozctest.h"
@@ -186,27 +187,29 @@ class UserHistoryPredictorTest : public testing::TestWithTempUserProfile {
            IsPredicted(predictor, key, value);
   }
 
-  static UserHistoryPredictor::Entry *InsertEntry(
+  static UserHistoryPredictor::MutableEntryRef InsertEntry(
       UserHistoryPredictor *predictor, const absl::string_view key,
       const absl::string_view value) {
-    UserHistoryPredictor::Entry *e =
-        &predictor->dic_->Insert(predictor->Fingerprint(key, value))->value;
-    e->set_key(std::string(key));
-    e->set_value(std::string(value));
-    e->set_removed(false);
+    UserHistoryPredictor::MutableEntryRef e =
+        predictor->dic_->Insert(predictor->Fingerprint(key, value));
+    e.set_key(key);
+    e.set_value(value);
+    e.set_removed(false);
     return e;
   }
 
-  static UserHistoryPredictor::Entry *AppendEntry(
+  static UserHistoryPredictor::MutableEntryRef AppendEntry(
       UserHistoryPredictor *predictor, const absl::string_view key,
-      const absl::string_view value, UserHistoryPredictor::Entry *prev) {
-    prev->add_next_entries()->set_entry_fp(predictor->Fingerprint(key, value));
-    UserHistoryPredictor::Entry *e = InsertEntry(predictor, key, value);
+      const absl::string_view value,
+      UserHistoryPredictor::MutableEntryRef prev) {
+    prev.add_next_entry_fp(predictor->Fingerprint(key, value));
+    UserHistoryPredictor::MutableEntryRef e =
+        InsertEntry(predictor, key, value);
     return e;
   }
 
   static size_t EntrySize(const UserHistoryPredictor &predictor) {
-    return predictor.dic_->Size();
+    return predictor.dic_->size();
   }
 
   static bool LoadStorage(UserHistoryPredictor *predictor,
@@ -214,12 +217,12 @@ class UserHistoryPredictorTest : public testing::TestWithTempUserProfile {
     return predictor->Load(history);
   }
 
-  static bool IsConnected(const UserHistoryPredictor::Entry &prev,
-                          const UserHistoryPredictor::Entry &next) {
+  static bool IsConnected(UserHistoryPredictor::EntryRef prev,
+                          UserHistoryPredictor::EntryRef next) {
     const uint32_t fp =
         UserHistoryPredictor::Fingerprint(next.key(), next.value());
-    for (size_t i = 0; i < prev.next_entries_size(); ++i) {
-      if (prev.next_entries(i).entry_fp() == fp) {
+    for (const uint32_t next_fp : prev.next_entry_fps()) {
+      if (next_fp == fp) {
         return true;
       }
     }
@@ -228,9 +231,9 @@ class UserHistoryPredictorTest : public testing::TestWithTempUserProfile {
 
   // Helper function to create a test case for bigram history deletion.
   void InitHistory_JapaneseInput(UserHistoryPredictor *predictor,
-                                 UserHistoryPredictor::Entry **japaneseinput,
-                                 UserHistoryPredictor::Entry **japanese,
-                                 UserHistoryPredictor::Entry **input) {
+                                 UserHistoryPredictor::MutableEntryRef *japaneseinput,
+                                 UserHistoryPredictor::MutableEntryRef *japanese,
+                                 UserHistoryPredictor::MutableEntryRef *input) {
     // Make the history for ("japaneseinput", "JapaneseInput"). It's assumed
     // that this sentence consists of two segments, "japanese" and "input". So,
     // the following history entries are constructed:
@@ -239,9 +242,9 @@ class UserHistoryPredictorTest : public testing::TestWithTempUserProfile {
     *japaneseinput = InsertEntry(predictor, "japaneseinput", "JapaneseInput");
     *japanese = InsertEntry(predictor, "japanese", "Japanese");
     *input = AppendEntry(predictor, "input", "Input", *japanese);
-    (*japaneseinput)->set_last_access_time(1);
-    (*japanese)->set_last_access_time(1);
-    (*input)->set_last_access_time(1);
+    japaneseinput->set_last_access_time(1);
+    japanese->set_last_access_time(1);
+    input->set_last_access_time(1);
 
     // Check the predictor functionality for the above history structure.
     EXPECT_TRUE(IsSuggestedAndPredicted(predictor, "japan", "Japanese"));
@@ -252,10 +255,10 @@ class UserHistoryPredictorTest : public testing::TestWithTempUserProfile {
   // Helper function to create a test case for trigram history deletion.
   void InitHistory_JapaneseInputMethod(
       UserHistoryPredictor *predictor,
-      UserHistoryPredictor::Entry **japaneseinputmethod,
-      UserHistoryPredictor::Entry **japanese,
-      UserHistoryPredictor::Entry **input,
-      UserHistoryPredictor::Entry **method) {
+      UserHistoryPredictor::MutableEntryRef *japaneseinputmethod,
+      UserHistoryPredictor::MutableEntryRef *japanese,
+      UserHistoryPredictor::MutableEntryRef *input,
+      UserHistoryPredictor::MutableEntryRef *method) {
     // Make the history for ("japaneseinputmethod", "JapaneseInputMethod"). It's
     // assumed that this sentence consists of three segments, "japanese",
     // "input" and "method". So, the following history entries are constructed:
@@ -266,10 +269,10 @@ class UserHistoryPredictorTest : public testing::TestWithTempUserProfile {
     *japanese = InsertEntry(predictor, "japanese", "Japanese");
     *input = AppendEntry(predictor, "input", "Input", *japanese);
     *method = AppendEntry(predictor, "method", "Method", *input);
-    (*japaneseinputmethod)->set_last_access_time(1);
-    (*japanese)->set_last_access_time(1);
-    (*input)->set_last_access_time(1);
-    (*method)->set_last_access_time(1);
+    japaneseinputmethod->set_last_access_time(1);
+    japanese->set_last_access_time(1);
+    input->set_last_access_time(1);
+    method->set_last_access_time(1);
 
     // Check the predictor functionality for the above history structure.
     EXPECT_TRUE(IsSuggestedAndPredicted(predictor, "japan", "Japanese"));
@@ -783,14 +786,12 @@ TEST_F(UserHistoryPredictorTest, UserHistoryPredictorTestSuggestion) {
     predictor->Finish(convreq, &segments);
 
     // All added items must be suggestion entries.
-    for (const UserHistoryPredictor::DicCache::Element &element :
-         *predictor->dic_) {
-      if (!element.next) {
+    for (UserHistoryPredictor::EntryRef entry : *predictor->dic_) {
+      if (!entry.next()) {
         break;  // Except the last one.
       }
-      const user_history_predictor::UserHistory::Entry &entry = element.value;
-      EXPECT_TRUE(entry.has_suggestion_freq() && entry.suggestion_freq() == 1);
-      EXPECT_TRUE(!entry.has_conversion_freq() && entry.conversion_freq() == 0);
+      EXPECT_EQ(entry.suggestion_freq(), 1);
+      EXPECT_EQ(entry.conversion_freq(), 0);
     }
   }
 
@@ -812,6 +813,38 @@ TEST_F(UserHistoryPredictorTest, UserHistoryPredictorTestSuggestion) {
   }
 }
 
+TEST_F(UserHistoryPredictorTest, PendingLearningIsPredicted) {
+  UserHistoryPredictor *predictor = GetUserHistoryPredictorWithClearedHistory();
+
+  // Register the commit as a pending learning only.
+  {
+    Segments segments;
+    const ConversionRequest convreq =
+        SetUpInputForSuggestion("かまた", &composer_, &segments);
+    AddCandidate(0, "火魔汰", &segments);
+    predictor->AddPendingLearning(1, convreq, segments);
+    EXPECT_TRUE(predictor->dic_->empty());
+  }
+
+  // The pending commit is visible to the prediction.
+  {
+    Segments segments;
+    const ConversionRequest convreq =
+        SetUpInputForSuggestion("かま", &composer_, &segments);
+    EXPECT_TRUE(predictor->PredictForRequest(convreq, &segments));
+    EXPECT_TRUE(FindCandidateByValue("火魔汰", segments));
+  }
+
+  // Once removed, the pending commit is not predicted any more.
+  predictor->RemovePendingLearning(1);
+  {
+    Segments segments;
+    const ConversionRequest convreq =
+        SetUpInputForSuggestion("かま", &composer_, &segments);
+    EXPECT_FALSE(predictor->PredictForRequest(convreq, &segments));
+  }
+}
+
 TEST_F(UserHistoryPredictorTest, UserHistoryPredictorPreprocessInput) {
   UserHistoryPredictor *predictor = GetUserHistoryPredictorWithClearedHistory();
 
@@ -2075,7 +2108,8 @@ TEST_F(UserHistoryPredictorTest, GetScore) {
 TEST_F(UserHistoryPredictorTest, IsValidEntry) {
   UserHistoryPredictor *predictor = GetUserHistoryPredictor();
 
-  UserHistoryPredictor::Entry entry;
+  UserHistoryStore store(1);
+  UserHistoryPredictor::MutableEntryRef entry = store.Insert(1);
 
   EXPECT_TRUE(predictor->IsValidEntry(entry));
 
@@ -2117,7 +2151,7 @@ TEST_F(UserHistoryPredictorTest, IsValidEntry) {
   EXPECT_TRUE(predictor->IsValidEntryIgnoringRemovedField(entry));
 
   // An android pua emoji. It is obsolete and should return false.
-  *entry.mutable_value() = Util::CodepointToUtf8(0xFE000);
+  entry.set_value(Util::CodepointToUtf8(0xFE000));
   EXPECT_FALSE(predictor->IsValidEntry(entry));
   EXPECT_FALSE(predictor->IsValidEntryIgnoringRemovedField(entry));
 
@@ -2677,23 +2711,24 @@ TEST_F(UserHistoryPredictorTest, GetRomanMisspelledKey) {
 
 TEST_F(UserHistoryPredictorTest, RomanFuzzyLookupEntry) {
   UserHistoryPredictor *predictor = GetUserHistoryPredictor();
-  UserHistoryPredictor::Entry entry;
+  UserHistoryStore store(1);
+  UserHistoryPredictor::MutableEntryRef entry = store.Insert(1);
   UserHistoryPredictor::EntryPriorityQueue results;
 
   entry.set_key("");
-  EXPECT_FALSE(predictor->RomanFuzzyLookupEntry("", &entry, &results));
+  EXPECT_FALSE(predictor->RomanFuzzyLookupEntry("", entry, &results));
 
   entry.set_key("よろしく");
-  EXPECT_TRUE(predictor->RomanFuzzyLookupEntry("yorosku", &entry, &results));
-  EXPECT_TRUE(predictor->RomanFuzzyLookupEntry("yrosiku", &entry, &results));
-  EXPECT_TRUE(predictor->RomanFuzzyLookupEntry("yorsiku", &entry, &results));
-  EXPECT_FALSE(predictor->RomanFuzzyLookupEntry("yrsk", &entry, &results));
-  EXPECT_FALSE(predictor->RomanFuzzyLookupEntry("yorosiku", &entry, &results));
+  EXPECT_TRUE(predictor->RomanFuzzyLookupEntry("yorosku", entry, &results));
+  EXPECT_TRUE(predictor->RomanFuzzyLookupEntry("yrosiku", entry, &results));
+  EXPECT_TRUE(predictor->RomanFuzzyLookupEntry("yorsiku", entry, &results));
+  EXPECT_FALSE(predictor->RomanFuzzyLookupEntry("yrsk", entry, &results));
+  EXPECT_FALSE(predictor->RomanFuzzyLookupEntry("yorosiku", entry, &results));
 
   entry.set_key("ぐーぐる");
-  EXPECT_TRUE(predictor->RomanFuzzyLookupEntry("gu=guru", &entry, &results));
-  EXPECT_FALSE(predictor->RomanFuzzyLookupEntry("gu-guru", &entry, &results));
-  EXPECT_FALSE(predictor->RomanFuzzyLookupEntry("g=guru", &entry, &results));
+  EXPECT_TRUE(predictor->RomanFuzzyLookupEntry("gu=guru", entry, &results));
+  EXPECT_FALSE(predictor->RomanFuzzyLookupEntry("gu-guru", entry, &results));
+  EXPECT_FALSE(predictor->RomanFuzzyLookupEntry("g=guru", entry, &results));
 }
 
 namespace {
@@ -2705,7 +2740,8 @@ struct LookupTestData {
 
 TEST_F(UserHistoryPredictorTest, ExpandedLookupRoman) {
   UserHistoryPredictor *predictor = GetUserHistoryPredictor();
-  UserHistoryPredictor::Entry entry;
+  UserHistoryStore store(1);
+  UserHistoryPredictor::MutableEntryRef entry = store.Insert(1);
   UserHistoryPredictor::EntryPriorityQueue results;
 
   // Roman
@@ -2729,10 +2765,11 @@ TEST_F(UserHistoryPredictorTest, ExpandedLookupRoman) {
   // with expanded
   for (size_t i = 0; i < std::size(kTests1); ++i) {
     entry.set_key(kTests1[i].entry_key);
-    EXPECT_EQ(
-        predictor->LookupEntry(UserHistoryPredictor::DEFAULT, "あｋ", "あ",
-                               expanded.get(), &entry, nullptr, &results),
-        kTests1[i].expect_result)
+    EXPECT_EQ(predictor->LookupEntry(UserHistoryPredictor::DEFAULT, "あｋ", "あ",
+                                     expanded.get(), entry,
+                                     UserHistoryPredictor::EntryRef(), nullptr,
+                                     &results),
+              kTests1[i].expect_result)
         << kTests1[i].entry_key;
   }
 
@@ -2750,7 +2787,9 @@ TEST_F(UserHistoryPredictorTest, ExpandedLookupRoman) {
   for (size_t i = 0; i < std::size(kTests2); ++i) {
     entry.set_key(kTests2[i].entry_key);
     EXPECT_EQ(predictor->LookupEntry(UserHistoryPredictor::DEFAULT, "", "",
-                                     expanded.get(), &entry, nullptr, &results),
+                                     expanded.get(), entry,
+                                     UserHistoryPredictor::EntryRef(), nullptr,
+                                     &results),
               kTests2[i].expect_result)
         << kTests2[i].entry_key;
   }
@@ -2758,7 +2797,8 @@ TEST_F(UserHistoryPredictorTest, ExpandedLookupRoman) {
 
 TEST_F(UserHistoryPredictorTest, ExpandedLookupKana) {
   UserHistoryPredictor *predictor = GetUserHistoryPredictor();
-  UserHistoryPredictor::Entry entry;
+  UserHistoryStore store(1);
+  UserHistoryPredictor::MutableEntryRef entry = store.Insert(1);
   UserHistoryPredictor::EntryPriorityQueue results;
 
   // Kana
@@ -2781,10 +2821,11 @@ TEST_F(UserHistoryPredictorTest, ExpandedLookupKana) {
   // with expanded
   for (size_t i = 0; i < std::size(kTests1); ++i) {
     entry.set_key(kTests1[i].entry_key);
-    EXPECT_EQ(
-        predictor->LookupEntry(UserHistoryPredictor::DEFAULT, "あし", "あ",
-                               expanded.get(), &entry, nullptr, &results),
-        kTests1[i].expect_result)
+    EXPECT_EQ(predictor->LookupEntry(UserHistoryPredictor::DEFAULT, "あし", "あ",
+                                     expanded.get(), entry,
+                                     UserHistoryPredictor::EntryRef(), nullptr,
+                                     &results),
+              kTests1[i].expect_result)
         << kTests1[i].entry_key;
   }
 
@@ -2801,7 +2842,9 @@ TEST_F(UserHistoryPredictorTest, ExpandedLookupKana) {
   for (size_t i = 0; i < std::size(kTests2); ++i) {
     entry.set_key(kTests2[i].entry_key);
     EXPECT_EQ(predictor->LookupEntry(UserHistoryPredictor::DEFAULT, "し", "",
-                                     expanded.get(), &entry, nullptr, &results),
+                                     expanded.get(), entry,
+                                     UserHistoryPredictor::EntryRef(), nullptr,
+                                     &results),
               kTests2[i].expect_result)
         << kTests2[i].entry_key;
   }
@@ -3241,29 +3284,30 @@ TEST_F(UserHistoryPredictorTest, LongCandidateForMobile) {
 }
 
 TEST_F(UserHistoryPredictorTest, EraseNextEntries) {
-  UserHistoryPredictor::Entry e;
-  e.add_next_entries()->set_entry_fp(100);
-  e.add_next_entries()->set_entry_fp(10);
-  e.add_next_entries()->set_entry_fp(30);
-  e.add_next_entries()->set_entry_fp(10);
-  e.add_next_entries()->set_entry_fp(100);
-
-  UserHistoryPredictor::EraseNextEntries(1234, &e);
+  UserHistoryStore store(1);
+  UserHistoryPredictor::MutableEntryRef e = store.Insert(1);
+  e.add_next_entry_fp(100);
+  e.add_next_entry_fp(10);
+  e.add_next_entry_fp(30);
+  e.add_next_entry_fp(10);
+  e.add_next_entry_fp(100);
+
+  UserHistoryPredictor::EraseNextEntries(1234, e);
   EXPECT_EQ(e.next_entries_size(), 5);
 
-  UserHistoryPredictor::EraseNextEntries(30, &e);
+  UserHistoryPredictor::EraseNextEntries(30, e);
   ASSERT_EQ(e.next_entries_size(), 4);
   for (size_t i = 0; i < 4; ++i) {
-    EXPECT_NE(e.next_entries(i).entry_fp(), 30);
+    EXPECT_NE(e.next_entry_fps()[i], 30);
   }
 
-  UserHistoryPredictor::EraseNextEntries(10, &e);
+  UserHistoryPredictor::EraseNextEntries(10, e);
   ASSERT_EQ(e.next_entries_size(), 2);
   for (size_t i = 0; i < 2; ++i) {
-    EXPECT_NE(e.next_entries(i).entry_fp(), 10);
+    EXPECT_NE(e.next_entry_fps()[i], 10);
   }
 
-  UserHistoryPredictor::EraseNextEntries(100, &e);
+  UserHistoryPredictor::EraseNextEntries(100, e);
   EXPECT_EQ(e.next_entries_size(), 0);
 }
 
@@ -3273,12 +3317,12 @@ TEST_F(UserHistoryPredictorTest, RemoveNgramChain) {
   // Set up the following chain of next entries:
   // ("abc", "ABC")
   // (  "a",   "A") --- ("b", "B") --- ("c", "C")
-  UserHistoryPredictor::Entry *abc = InsertEntry(predictor, "abc", "ABC");
-  UserHistoryPredictor::Entry *a = InsertEntry(predictor, "a", "A");
-  UserHistoryPredictor::Entry *b = AppendEntry(predictor, "b", "B", a);
-  UserHistoryPredictor::Entry *c = AppendEntry(predictor, "c", "C", b);
+  UserHistoryPredictor::MutableEntryRef abc = InsertEntry(predictor, "abc", "ABC");
+  UserHistoryPredictor::MutableEntryRef a = InsertEntry(predictor, "a", "A");
+  UserHistoryPredictor::MutableEntryRef b = AppendEntry(predictor, "b", "B", a);
+  UserHistoryPredictor::MutableEntryRef c = AppendEntry(predictor, "c", "C", b);
 
-  std::vector<UserHistoryPredictor::Entry *> entries;
+  std::vector<UserHistoryPredictor::MutableEntryRef> entries;
   entries.push_back(abc);
   entries.push_back(a);
   entries.push_back(b);
@@ -3293,10 +3337,10 @@ TEST_F(UserHistoryPredictorTest, RemoveNgramChain) {
   }
   // Moreover, all nodes and links should be kept.
   for (size_t i = 0; i < entries.size(); ++i) {
-    EXPECT_FALSE(entries[i]->removed());
+    EXPECT_FALSE(entries[i].removed());
   }
-  EXPECT_TRUE(IsConnected(*a, *b));
-  EXPECT_TRUE(IsConnected(*b, *c));
+  EXPECT_TRUE(IsConnected(a, b));
+  EXPECT_TRUE(IsConnected(b, c));
 
   {
     // Try deleting the chain for "abc". Only the link from "b" to "c" should be
@@ -3306,10 +3350,10 @@ TEST_F(UserHistoryPredictorTest, RemoveNgramChain) {
         predictor->RemoveNgramChain("abc", "ABC", a, &dummy1, 0, &dummy2, 0),
         UserHistoryPredictor::DONE);
     for (size_t i = 0; i < entries.size(); ++i) {
-      EXPECT_FALSE(entries[i]->removed());
+      EXPECT_FALSE(entries[i].removed());
     }
-    EXPECT_TRUE(IsConnected(*a, *b));
-    EXPECT_FALSE(IsConnected(*b, *c));
+    EXPECT_TRUE(IsConnected(a, b));
+    EXPECT_FALSE(IsConnected(b, c));
   }
   {
     // Try deleting the chain for "a". Since this is the head of the chain, the
@@ -3318,10 +3362,10 @@ TEST_F(UserHistoryPredictorTest, RemoveNgramChain) {
     EXPECT_EQ(predictor->RemoveNgramChain("a", "A", a, &dummy1, 0, &dummy2, 0),
               UserHistoryPredictor::TAIL);
     for (size_t i = 0; i < entries.size(); ++i) {
-      EXPECT_FALSE(entries[i]->removed());
+      EXPECT_FALSE(entries[i].removed());
     }
-    EXPECT_TRUE(IsConnected(*a, *b));
-    EXPECT_FALSE(IsConnected(*b, *c));
+    EXPECT_TRUE(IsConnected(a, b));
+    EXPECT_FALSE(IsConnected(b, c));
   }
   {
     // Further delete the chain for "ab".  Now all the links should be removed.
@@ -3330,10 +3374,10 @@ TEST_F(UserHistoryPredictorTest, RemoveNgramChain) {
         predictor->RemoveNgramChain("ab", "AB", a, &dummy1, 0, &dummy2, 0),
         UserHistoryPredictor::DONE);
     for (size_t i = 0; i < entries.size(); ++i) {
-      EXPECT_FALSE(entries[i]->removed());
+      EXPECT_FALSE(entries[i].removed());
     }
-    EXPECT_FALSE(IsConnected(*a, *b));
-    EXPECT_FALSE(IsConnected(*b, *c));
+    EXPECT_FALSE(IsConnected(a, b));
+    EXPECT_FALSE(IsConnected(b, c));
   }
 }
 
@@ -3344,9 +3388,9 @@ TEST_F(UserHistoryPredictorTest, ClearHistoryEntryUnigram) {
   UserHistoryPredictor *predictor = GetUserHistoryPredictorWithClearedHistory();
 
   // Add a unigram history ("japanese", "Japanese").
-  UserHistoryPredictor::Entry *e =
+  UserHistoryPredictor::MutableEntryRef e =
       InsertEntry(predictor, "japanese", "Japanese");
-  e->set_last_access_time(1);
+  e.set_last_access_time(1);
 
   // "Japanese" should be suggested and predicted from "japan".
   EXPECT_TRUE(IsSuggestedAndPredicted(predictor, "japan", "Japanese"));
@@ -3354,7 +3398,7 @@ TEST_F(UserHistoryPredictorTest, ClearHistoryEntryUnigram) {
   // Delete the history.
   EXPECT_TRUE(predictor->ClearHistoryEntry("japanese", "Japanese"));
 
-  EXPECT_TRUE(e->removed());
+  EXPECT_TRUE(e.removed());
 
   // "Japanese" should be never be suggested nor predicted.
   constexpr absl::string_view kKey = "japanese";
@@ -3377,9 +3421,9 @@ TEST_F(UserHistoryPredictorTest, ClearHistoryEntryBigramDeleteWhole) {
   // following history entries are constructed:
   //   ("japaneseinput", "JapaneseInput")  // Unigram
   //   ("japanese", "Japanese") --- ("input", "Input")  // Bigram chain
-  UserHistoryPredictor::Entry *japaneseinput;
-  UserHistoryPredictor::Entry *japanese;
-  UserHistoryPredictor::Entry *input;
+  UserHistoryPredictor::MutableEntryRef japaneseinput;
+  UserHistoryPredictor::MutableEntryRef japanese;
+  UserHistoryPredictor::MutableEntryRef input;
   InitHistory_JapaneseInput(predictor, &japaneseinput, &japanese, &input);
 
   // Check the predictor functionality for the above history structure.
@@ -3390,10 +3434,10 @@ TEST_F(UserHistoryPredictorTest, ClearHistoryEntryBigramDeleteWhole) {
   // Delete the unigram ("japaneseinput", "JapaneseInput").
   EXPECT_TRUE(predictor->ClearHistoryEntry("japaneseinput", "JapaneseInput"));
 
-  EXPECT_TRUE(japaneseinput->removed());
-  EXPECT_FALSE(japanese->removed());
-  EXPECT_FALSE(input->removed());
-  EXPECT_FALSE(IsConnected(*japanese, *input));
+  EXPECT_TRUE(japaneseinput.removed());
+  EXPECT_FALSE(japanese.removed());
+  EXPECT_FALSE(input.removed());
+  EXPECT_FALSE(IsConnected(japanese, input));
 
   // Now "JapaneseInput" should never be suggested nor predicted.
   constexpr absl::string_view kKey = "japaneseinput";
@@ -3417,9 +3461,9 @@ TEST_F(UserHistoryPredictorTest, ClearHistoryEntryBigramDeleteFirst) {
 
   // Make the history for ("japaneseinput", "JapaneseInput"), i.e., the same
   // history structure as ClearHistoryEntry_Bigram_DeleteWhole is constructed.
-  UserHistoryPredictor::Entry *japaneseinput;
-  UserHistoryPredictor::Entry *japanese;
-  UserHistoryPredictor::Entry *input;
+  UserHistoryPredictor::MutableEntryRef japaneseinput;
+  UserHistoryPredictor::MutableEntryRef japanese;
+  UserHistoryPredictor::MutableEntryRef input;
   InitHistory_JapaneseInput(predictor, &japaneseinput, &japanese, &input);
 
   EXPECT_TRUE(IsSuggestedAndPredicted(predictor, "japan", "Japanese"));
@@ -3431,10 +3475,10 @@ TEST_F(UserHistoryPredictorTest, ClearHistoryEntryBigramDeleteFirst) {
 
   // Note that the first node was removed but the connection to the second node
   // is still valid.
-  EXPECT_FALSE(japaneseinput->removed());
-  EXPECT_TRUE(japanese->removed());
-  EXPECT_FALSE(input->removed());
-  EXPECT_TRUE(IsConnected(*japanese, *input));
+  EXPECT_FALSE(japaneseinput.removed());
+  EXPECT_TRUE(japanese.removed());
+  EXPECT_FALSE(input.removed());
+  EXPECT_TRUE(IsConnected(japanese, input));
 
   // Now "Japanese" should never be suggested nor predicted.
   constexpr absl::string_view kKey = "japaneseinput";
@@ -3458,9 +3502,9 @@ TEST_F(UserHistoryPredictorTest, ClearHistoryEntryBigramDeleteSecond) {
 
   // Make the history for ("japaneseinput", "JapaneseInput"), i.e., the same
   // history structure as ClearHistoryEntry_Bigram_DeleteWhole is constructed.
-  UserHistoryPredictor::Entry *japaneseinput;
-  UserHistoryPredictor::Entry *japanese;
-  UserHistoryPredictor::Entry *input;
+  UserHistoryPredictor::MutableEntryRef japaneseinput;
+  UserHistoryPredictor::MutableEntryRef japanese;
+  UserHistoryPredictor::MutableEntryRef input;
   InitHistory_JapaneseInput(predictor, &japaneseinput, &japanese, &input);
 
   EXPECT_TRUE(IsSuggestedAndPredicted(predictor, "japan", "Japanese"));
@@ -3470,10 +3514,10 @@ TEST_F(UserHistoryPredictorTest, ClearHistoryEntryBigramDeleteSecond) {
   // Delete the second bigram node ("input", "Input").
   EXPECT_TRUE(predictor->ClearHistoryEntry("input", "Input"));
 
-  EXPECT_FALSE(japaneseinput->removed());
-  EXPECT_FALSE(japanese->removed());
-  EXPECT_TRUE(input->removed());
-  EXPECT_TRUE(IsConnected(*japanese, *input));
+  EXPECT_FALSE(japaneseinput.removed());
+  EXPECT_FALSE(japanese.removed());
+  EXPECT_TRUE(input.removed());
+  EXPECT_TRUE(IsConnected(japanese, input));
 
   // Now "Input" should never be suggested nor predicted.
   constexpr absl::string_view kKey = "input";
@@ -3500,10 +3544,10 @@ TEST_F(UserHistoryPredictorTest, ClearHistoryEntryTrigramDeleteWhole) {
   // and "method". So, the following history entries are constructed:
   //   ("japaneseinputmethod", "JapaneseInputMethod")  // Unigram
   //   ("japanese", "Japanese") -- ("input", "Input") -- ("method", "Method")
-  UserHistoryPredictor::Entry *japaneseinputmethod;
-  UserHistoryPredictor::Entry *japanese;
-  UserHistoryPredictor::Entry *input;
-  UserHistoryPredictor::Entry *method;
+  UserHistoryPredictor::MutableEntryRef japaneseinputmethod;
+  UserHistoryPredictor::MutableEntryRef japanese;
+  UserHistoryPredictor::MutableEntryRef input;
+  UserHistoryPredictor::MutableEntryRef method;
   InitHistory_JapaneseInputMethod(predictor, &japaneseinputmethod, &japanese,
                                   &input, &method);
 
@@ -3512,12 +3556,12 @@ TEST_F(UserHistoryPredictorTest, ClearHistoryEntryTrigramDeleteWhole) {
                                            "JapaneseInputMethod"));
 
   // Note that only the link from "input" to "method" was removed.
-  EXPECT_TRUE(japaneseinputmethod->removed());
-  EXPECT_FALSE(japanese->removed());
-  EXPECT_FALSE(input->removed());
-  EXPECT_FALSE(method->removed());
-  EXPECT_TRUE(IsConnected(*japanese, *input));
-  EXPECT_FALSE(IsConnected(*input, *method));
+  EXPECT_TRUE(japaneseinputmethod.removed());
+  EXPECT_FALSE(japanese.removed());
+  EXPECT_FALSE(input.removed());
+  EXPECT_FALSE(method.removed());
+  EXPECT_TRUE(IsConnected(japanese, input));
+  EXPECT_FALSE(IsConnected(input, method));
 
   {
     // Now "JapaneseInputMethod" should never be suggested nor predicted.
@@ -3557,10 +3601,10 @@ TEST_F(UserHistoryPredictorTest, ClearHistoryEntryTrigramDeleteFirst) {
   UserHistoryPredictor *predictor = GetUserHistoryPredictorWithClearedHistory();
 
   // Make the same history structure as ClearHistoryEntry_Trigram_DeleteWhole.
-  UserHistoryPredictor::Entry *japaneseinputmethod;
-  UserHistoryPredictor::Entry *japanese;
-  UserHistoryPredictor::Entry *input;
-  UserHistoryPredictor::Entry *method;
+  UserHistoryPredictor::MutableEntryRef japaneseinputmethod;
+  UserHistoryPredictor::MutableEntryRef japanese;
+  UserHistoryPredictor::MutableEntryRef input;
+  UserHistoryPredictor::MutableEntryRef method;
   InitHistory_JapaneseInputMethod(predictor, &japaneseinputmethod, &japanese,
                                   &input, &method);
 
@@ -3576,12 +3620,12 @@ TEST_F(UserHistoryPredictorTest, ClearHistoryEntryTrigramDeleteFirst) {
   EXPECT_TRUE(predictor->ClearHistoryEntry("japanese", "Japanese"));
 
   // Note that the two links are still alive.
-  EXPECT_FALSE(japaneseinputmethod->removed());
-  EXPECT_TRUE(japanese->removed());
-  EXPECT_FALSE(input->removed());
-  EXPECT_FALSE(method->removed());
-  EXPECT_TRUE(IsConnected(*japanese, *input));
-  EXPECT_TRUE(IsConnected(*input, *method));
+  EXPECT_FALSE(japaneseinputmethod.removed());
+  EXPECT_TRUE(japanese.removed());
+  EXPECT_FALSE(input.removed());
+  EXPECT_FALSE(method.removed());
+  EXPECT_TRUE(IsConnected(japanese, input));
+  EXPECT_TRUE(IsConnected(input, method));
 
   {
     // Now "Japanese" should never be suggested nor predicted.
@@ -3610,10 +3654,10 @@ TEST_F(UserHistoryPredictorTest, ClearHistoryEntryTrigramDeleteSecond) {
   UserHistoryPredictor *predictor = GetUserHistoryPredictorWithClearedHistory();
 
   // Make the same history structure as ClearHistoryEntry_Trigram_DeleteWhole.
-  UserHistoryPredictor::Entry *japaneseinputmethod;
-  UserHistoryPredictor::Entry *japanese;
-  UserHistoryPredictor::Entry *input;
-  UserHistoryPredictor::Entry *method;
+  UserHistoryPredictor::MutableEntryRef japaneseinputmethod;
+  UserHistoryPredictor::MutableEntryRef japanese;
+  UserHistoryPredictor::MutableEntryRef input;
+  UserHistoryPredictor::MutableEntryRef method;
   InitHistory_JapaneseInputMethod(predictor, &japaneseinputmethod, &japanese,
                                   &input, &method);
 
@@ -3629,12 +3673,12 @@ TEST_F(UserHistoryPredictorTest, ClearHistoryEntryTrigramDeleteSecond) {
   EXPECT_TRUE(predictor->ClearHistoryEntry("input", "Input"));
 
   // Note that the two links are still alive.
-  EXPECT_FALSE(japaneseinputmethod->removed());
-  EXPECT_FALSE(japanese->removed());
-  EXPECT_TRUE(input->removed());
-  EXPECT_FALSE(method->removed());
-  EXPECT_TRUE(IsConnected(*japanese, *input));
-  EXPECT_TRUE(IsConnected(*input, *method));
+  EXPECT_FALSE(japaneseinputmethod.removed());
+  EXPECT_FALSE(japanese.removed());
+  EXPECT_TRUE(input.removed());
+  EXPECT_FALSE(method.removed());
+  EXPECT_TRUE(IsConnected(japanese, input));
+  EXPECT_TRUE(IsConnected(input, method));
 
   {
     // Now "Input" should never be suggested nor predicted.
@@ -3663,10 +3707,10 @@ TEST_F(UserHistoryPredictorTest, ClearHistoryEntryTrigramDeleteThird) {
   UserHistoryPredictor *predictor = GetUserHistoryPredictorWithClearedHistory();
 
   // Make the same history structure as ClearHistoryEntry_Trigram_DeleteWhole.
-  UserHistoryPredictor::Entry *japaneseinputmethod;
-  UserHistoryPredictor::Entry *japanese;
-  UserHistoryPredictor::Entry *input;
-  UserHistoryPredictor::Entry *method;
+  UserHistoryPredictor::MutableEntryRef japaneseinputmethod;
+  UserHistoryPredictor::MutableEntryRef japanese;
+  UserHistoryPredictor::MutableEntryRef input;
+  UserHistoryPredictor::MutableEntryRef method;
   InitHistory_JapaneseInputMethod(predictor, &japaneseinputmethod, &japanese,
                                   &input, &method);
 
@@ -3682,12 +3726,12 @@ TEST_F(UserHistoryPredictorTest, ClearHistoryEntryTrigramDeleteThird) {
   EXPECT_TRUE(predictor->ClearHistoryEntry("method", "Method"));
 
   // Note that the two links are still alive.
-  EXPECT_FALSE(japaneseinputmethod->removed());
-  EXPECT_FALSE(japanese->removed());
-  EXPECT_FALSE(input->removed());
-  EXPECT_TRUE(method->removed());
-  EXPECT_TRUE(IsConnected(*japanese, *input));
-  EXPECT_TRUE(IsConnected(*input, *method));
+  EXPECT_FALSE(japaneseinputmethod.removed());
+  EXPECT_FALSE(japanese.removed());
+  EXPECT_FALSE(input.removed());
+  EXPECT_TRUE(method.removed());
+  EXPECT_TRUE(IsConnected(japanese, input));
+  EXPECT_TRUE(IsConnected(input, method));
 
   {
     // Now "Method" should never be suggested nor predicted.
@@ -3716,10 +3760,10 @@ TEST_F(UserHistoryPredictorTest, ClearHistoryEntryTrigramDeleteFirstBigram) {
   UserHistoryPredictor *predictor = GetUserHistoryPredictorWithClearedHistory();
 
   // Make the same history structure as ClearHistoryEntry_Trigram_DeleteWhole.
-  UserHistoryPredictor::Entry *japaneseinputmethod;
-  UserHistoryPredictor::Entry *japanese;
-  UserHistoryPredictor::Entry *input;
-  UserHistoryPredictor::Entry *method;
+  UserHistoryPredictor::MutableEntryRef japaneseinputmethod;
+  UserHistoryPredictor::MutableEntryRef japanese;
+  UserHistoryPredictor::MutableEntryRef input;
+  UserHistoryPredictor::MutableEntryRef method;
   InitHistory_JapaneseInputMethod(predictor, &japaneseinputmethod, &japanese,
                                   &input, &method);
 
@@ -3736,12 +3780,12 @@ TEST_F(UserHistoryPredictorTest, ClearHistoryEntryTrigramDeleteFirstBigram) {
 
   // Note that the node "japaneseinput" and the link from "japanese" to "input"
   // were removed.
-  EXPECT_FALSE(japaneseinputmethod->removed());
-  EXPECT_FALSE(japanese->removed());
-  EXPECT_FALSE(input->removed());
-  EXPECT_FALSE(method->removed());
-  EXPECT_FALSE(IsConnected(*japanese, *input));
-  EXPECT_TRUE(IsConnected(*input, *method));
+  EXPECT_FALSE(japaneseinputmethod.removed());
+  EXPECT_FALSE(japanese.removed());
+  EXPECT_FALSE(input.removed());
+  EXPECT_FALSE(method.removed());
+  EXPECT_FALSE(IsConnected(japanese, input));
+  EXPECT_TRUE(IsConnected(input, method));
 
   {
     // Now "JapaneseInput" should never be suggested nor predicted.
@@ -3771,10 +3815,10 @@ TEST_F(UserHistoryPredictorTest, ClearHistoryEntryTrigramDeleteSecondBigram) {
   UserHistoryPredictor *predictor = GetUserHistoryPredictorWithClearedHistory();
 
   // Make the same history structure as ClearHistoryEntry_Trigram_DeleteWhole.
-  UserHistoryPredictor::Entry *japaneseinputmethod;
-  UserHistoryPredictor::Entry *japanese;
-  UserHistoryPredictor::Entry *input;
-  UserHistoryPredictor::Entry *method;
+  UserHistoryPredictor::MutableEntryRef japaneseinputmethod;
+  UserHistoryPredictor::MutableEntryRef japanese;
+  UserHistoryPredictor::MutableEntryRef input;
+  UserHistoryPredictor::MutableEntryRef method;
   InitHistory_JapaneseInputMethod(predictor, &japaneseinputmethod, &japanese,
                                   &input, &method);
 
@@ -3790,12 +3834,12 @@ TEST_F(UserHistoryPredictorTest, ClearHistoryEntryTrigramDeleteSecondBigram) {
   EXPECT_TRUE(predictor->ClearHistoryEntry("inputmethod", "InputMethod"));
 
   // Note that only link from "input" to "method" was removed.
-  EXPECT_FALSE(japaneseinputmethod->removed());
-  EXPECT_FALSE(japanese->removed());
-  EXPECT_FALSE(input->removed());
-  EXPECT_FALSE(method->removed());
-  EXPECT_TRUE(IsConnected(*japanese, *input));
-  EXPECT_FALSE(IsConnected(*input, *method));
+  EXPECT_FALSE(japaneseinputmethod.removed());
+  EXPECT_FALSE(japanese.removed());
+  EXPECT_FALSE(input.removed());
+  EXPECT_FALSE(method.removed());
+  EXPECT_TRUE(IsConnected(japanese, input));
+  EXPECT_FALSE(IsConnected(input, method));
 
   {
     // Now "InputMethod" should never be suggested.
@@ -4381,15 +4425,71 @@ TEST_F(UserHistoryPredictorTest, 62DayOldEntriesAreDeletedAtSync) {
 
   // Verify also that on-memory data structure doesn't contain node for 中野.
   bool found_takahashi = false;
-  for (const auto &elem : *predictor->dic_) {
-    EXPECT_EQ(elem.value.value().find("中野"), std::string::npos);
-    if (elem.value.value().find("高橋")) {
+  for (UserHistoryPredictor::EntryRef entry : *predictor->dic_) {
+    EXPECT_EQ(entry.value().find("中野"), absl::string_view::npos);
+    if (entry.value().find("高橋")) {
       found_takahashi = true;
     }
   }
   EXPECT_TRUE(found_takahashi);
 }
 
+TEST_F(UserHistoryPredictorTest, JournalIsReplayedOnLoad) {
+  UserHistoryPredictor *predictor = GetUserHistoryPredictorWithClearedHistory();
+  const std::string filename = predictor->GetUserHistoryFileName();
+  const std::string journal_filename =
+      predictor->GetUserHistoryJournalFileName();
+
+  // Clearing the history rewrites the history file and removes the journal.
+  EXPECT_OK(FileUtil::FileExists(filename));
+  EXPECT_FALSE(FileUtil::FileExists(journal_filename).ok());
+  absl::StatusOr<std::string> history_contents =
+      FileUtil::GetContents(filename);
+  ASSERT_OK(history_contents);
+
+  // Let the predictor learn "私の名前は中野です" and "私の名前は高橋です".
+  Segments segments;
+  const ConversionRequest convreq1 = SetUpInputForConversion(
+      "わたしのなまえはなかのです", &composer_, &segments);
+  AddCandidate("私の名前は中野です", &segments);
+  predictor->Finish(convreq1, &segments);
+  ASSERT_TRUE(predictor->Sync());
+  WaitForSyncer(predictor);
+
+  segments.Clear();
+  const ConversionRequest convreq2 = SetUpInputForConversion(
+      "わたしのなまえはたかはしです", &composer_, &segments);
+  AddCandidate("私の名前は高橋です", &segments);
+  predictor->Finish(convreq2, &segments);
+  ASSERT_TRUE(predictor->Sync());
+  WaitForSyncer(predictor);
+
+  ASSERT_TRUE(predictor->ClearHistoryEntry("わたしのなまえはなかのです",
+                                           "私の名前は中野です"));
+  ASSERT_TRUE(predictor->Sync());
+  WaitForSyncer(predictor);
+
+  // The changes are only appended to the journal.
+  EXPECT_OK(FileUtil::FileExists(journal_filename));
+  EXPECT_EQ(FileUtil::GetContents(filename).value_or(""), *history_contents);
+
+  // Reloading replays the journal on top of the history file.
+  predictor->dic_->Clear();
+  ASSERT_TRUE(predictor->Load());
+  EXPECT_TRUE(IsPredicted(predictor, "わたしの", "私の名前は高橋です"));
+  EXPECT_FALSE(IsPredicted(predictor, "わたしの", "私の名前は中野です"));
+
+  // Compaction merges the journal into the history file.
+  ASSERT_TRUE(predictor->SaveSnapshot());
+  EXPECT_FALSE(FileUtil::FileExists(journal_filename).ok());
+  EXPECT_NE(FileUtil::GetContents(filename).value_or(""), *history_contents);
+
+  predictor->dic_->Clear();
+  ASSERT_TRUE(predictor->Load());
+  EXPECT_TRUE(IsPredicted(predictor, "わたしの", "私の名前は高橋です"));
+  EXPECT_FALSE(IsPredicted(predictor, "わたしの", "私の名前は中野です"));
+}
+
 TEST_F(UserHistoryPredictorTest, FutureTimestamp) {
   // Test the case where history has "future" timestamps.
   ScopedClockMock clock(absl::FromUnixSeconds(10000));
@@ -0,0 +1,481 @@
+// Copyright 2010-2021, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "prediction/user_history_store.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/hash/hash.h"
+#include "absl/log/check.h"
+#include "absl/strings/string_view.h"
+#include "prediction/user_history_predictor.pb.h"
+
+namespace mozc::prediction {
+namespace {
+
+// The string arena and the pool of the next entries are compacted when the
+// unused part exceeds both this size and the used part.
+constexpr size_t kMinGarbageSizeToCompact = 4096;
+
+// The capacity of the next entries allocated first for an entry.
+constexpr size_t kInitialNextEntriesCapacity = 4;
+
+bool ShouldCompact(size_t garbage_size, size_t total_size) {
+  return garbage_size >= kMinGarbageSizeToCompact &&
+         garbage_size * 2 >= total_size;
+}
+
+template <typename T>
+size_t VectorMemoryUsage(const std::vector<T> &v) {
+  return v.capacity() * sizeof(T);
+}
+
+// Releases the memory of `v`, which clear() doesn't.
+template <typename T>
+void ReleaseVector(std::vector<T> *v) {
+  std::vector<T>().swap(*v);
+}
+
+}  // namespace
+
+void UserHistoryStore::EntryRef::CopyTo(Entry *entry) const {
+  DCHECK(entry);
+  entry->Clear();
+  if (!key().empty()) {
+    entry->set_key(std::string(key()));
+  }
+  if (!value().empty()) {
+    entry->set_value(std::string(value()));
+  }
+  if (!description().empty()) {
+    entry->set_description(std::string(description()));
+  }
+  if (suggestion_freq() != 0) {
+    entry->set_suggestion_freq(suggestion_freq());
+  }
+  if (conversion_freq() != 0) {
+    entry->set_conversion_freq(conversion_freq());
+  }
+  if (shown_freq() != 0) {
+    entry->set_shown_freq(shown_freq());
+  }
+  if (last_access_time() != 0) {
+    entry->set_last_access_time(last_access_time());
+  }
+  for (const uint32_t fp : next_entry_fps()) {
+    entry->add_next_entries()->set_entry_fp(fp);
+  }
+  if (bigram_boost()) {
+    entry->set_bigram_boost(true);
+  }
+  if (spelling_correction()) {
+    entry->set_spelling_correction(true);
+  }
+  if (removed()) {
+    entry->set_removed(true);
+  }
+  if (entry_type() != Entry::DEFAULT_ENTRY) {
+    entry->set_entry_type(entry_type());
+  }
+}
+
+void UserHistoryStore::MutableEntryRef::set_entry_type(EntryType type) {
+  uint8_t &flags = store_->flags_[slot_];
+  flags = (flags & ((1 << kEntryTypeShift) - 1)) |
+          (static_cast<uint8_t>(type) << kEntryTypeShift);
+}
+
+void UserHistoryStore::MutableEntryRef::SetFlag(uint8_t flag, bool value) {
+  if (value) {
+    store_->flags_[slot_] |= flag;
+  } else {
+    store_->flags_[slot_] &= ~flag;
+  }
+}
+
+void UserHistoryStore::MutableEntryRef::add_next_entry_fp(uint32_t fp) {
+  if (next_entries_size() >= kMaxNextEntriesSize) {
+    return;
+  }
+  store_->ReserveNextEntry(slot_);
+  const uint8_t size = store_->next_sizes_[slot_]++;
+  store_->next_fps_[store_->next_begins_[slot_] + size] = fp;
+}
+
+void UserHistoryStore::MutableEntryRef::set_next_entry_fp(size_t i,
+                                                          uint32_t fp) {
+  DCHECK_LT(i, next_entries_size());
+  store_->next_fps_[store_->next_begins_[slot_] + i] = fp;
+}
+
+void UserHistoryStore::MutableEntryRef::EraseNextEntryFps(uint32_t fp) {
+  uint32_t *fps = store_->next_fps_.data() + store_->next_begins_[slot_];
+  size_t size = next_entries_size();
+  for (size_t pos = 0; pos < size;) {
+    if (fps[pos] == fp) {
+      std::swap(fps[pos], fps[--size]);
+    } else {
+      ++pos;
+    }
+  }
+  store_->next_sizes_[slot_] = size;
+}
+
+void UserHistoryStore::MutableEntryRef::Clear() { store_->ResetSlot(slot_); }
+
+void UserHistoryStore::MutableEntryRef::CopyFrom(const Entry &entry) {
+  set_key(entry.key());
+  set_value(entry.value());
+  set_description(entry.description());
+  set_suggestion_freq(entry.suggestion_freq());
+  set_conversion_freq(entry.conversion_freq());
+  set_shown_freq(entry.shown_freq());
+  set_last_access_time(entry.last_access_time());
+  set_bigram_boost(entry.bigram_boost());
+  set_spelling_correction(entry.spelling_correction());
+  set_removed(entry.removed());
+  set_entry_type(entry.entry_type());
+  clear_next_entries();
+  for (const auto &next_entry : entry.next_entries()) {
+    add_next_entry_fp(next_entry.entry_fp());
+  }
+}
+
+UserHistoryStore::StringPool::StringPool()
+    : pieces_(1), index_(0, Hash{this}, Eq{this}) {}
+
+size_t UserHistoryStore::StringPool::Hash::operator()(uint32_t id) const {
+  return absl::Hash<absl::string_view>()(pool->Get(id));
+}
+
+size_t UserHistoryStore::StringPool::Hash::operator()(
+    absl::string_view str) const {
+  return absl::Hash<absl::string_view>()(str);
+}
+
+uint32_t UserHistoryStore::StringPool::Intern(absl::string_view str) {
+  if (str.empty()) {
+    return 0;
+  }
+  if (const auto it = index_.find(str); it != index_.end()) {
+    ++pieces_[*it].refs;
+    return *it;
+  }
+
+  uint32_t id = 0;
+  if (free_ids_.empty()) {
+    id = pieces_.size();
+    pieces_.emplace_back();
+  } else {
+    id = free_ids_.back();
+    free_ids_.pop_back();
+  }
+  Piece &piece = pieces_[id];
+  piece.offset = data_.size();
+  piece.size = str.size();
+  piece.refs = 1;
+  data_.append(str.data(), str.size());
+  index_.insert(id);
+  return id;
+}
+
+void UserHistoryStore::StringPool::Release(uint32_t id) {
+  if (id == 0) {
+    return;
+  }
+  Piece &piece = pieces_[id];
+  DCHECK_GT(piece.refs, 0);
+  if (--piece.refs > 0) {
+    return;
+  }
+  // Erases before resetting the piece, as the hash is computed from it.
+  index_.erase(id);
+  garbage_size_ += piece.size;
+  piece = Piece();
+  free_ids_.push_back(id);
+  if (ShouldCompact(garbage_size_, data_.size())) {
+    Compact();
+  }
+}
+
+void UserHistoryStore::StringPool::Compact() {
+  std::string data;
+  data.reserve(data_.size() - garbage_size_);
+  for (Piece &piece : pieces_) {
+    if (piece.refs == 0) {
+      continue;
+    }
+    const uint32_t offset = data.size();
+    data.append(data_, piece.offset, piece.size);
+    piece.offset = offset;
+  }
+  data_ = std::move(data);
+  garbage_size_ = 0;
+}
+
+void UserHistoryStore::StringPool::Clear() {
+  std::string().swap(data_);
+  pieces_.assign(1, Piece());
+  pieces_.shrink_to_fit();
+  ReleaseVector(&free_ids_);
+  index_ = absl::flat_hash_set<uint32_t, Hash, Eq>(0, Hash{this}, Eq{this});
+  garbage_size_ = 0;
+}
+
+size_t UserHistoryStore::StringPool::MemoryUsage() const {
+  return data_.capacity() + VectorMemoryUsage(pieces_) +
+         VectorMemoryUsage(free_ids_) +
+         index_.capacity() * (sizeof(uint32_t) + 1);
+}
+
+UserHistoryStore::UserHistoryStore(size_t max_size) : max_size_(max_size) {
+  DCHECK_GT(max_size_, 0);
+}
+
+UserHistoryStore::MutableEntryRef UserHistoryStore::Insert(uint32_t fp) {
+  if (const auto it = index_.find(fp); it != index_.end()) {
+    PushLruHead(it->second);
+    return MakeRef<MutableEntryRef>(it->second);
+  }
+  if (index_.size() >= max_size_) {
+    Erase(fps_[lru_tail_]);
+  }
+  const uint32_t slot = AllocateSlot();
+  fps_[slot] = fp;
+  index_.emplace(fp, slot);
+  PushLruHead(slot);
+  return MakeRef<MutableEntryRef>(slot);
+}
+
+UserHistoryStore::MutableEntryRef UserHistoryStore::Insert(
+    uint32_t fp, const Entry &entry) {
+  MutableEntryRef ref = Insert(fp);
+  ref.CopyFrom(entry);
+  return ref;
+}
+
+UserHistoryStore::EntryRef UserHistoryStore::LookupWithoutInsert(
+    uint32_t fp) const {
+  const auto it = index_.find(fp);
+  return it == index_.end() ? EntryRef() : MakeRef(it->second);
+}
+
+UserHistoryStore::MutableEntryRef UserHistoryStore::MutableLookupWithoutInsert(
+    uint32_t fp) {
+  const auto it = index_.find(fp);
+  return it == index_.end() ? MutableEntryRef()
+                            : MakeRef<MutableEntryRef>(it->second);
+}
+
+bool UserHistoryStore::Erase(uint32_t fp) {
+  const auto it = index_.find(fp);
+  if (it == index_.end()) {
+    return false;
+  }
+  const uint32_t slot = it->second;
+  index_.erase(it);
+  RemoveFromLru(slot);
+  FreeSlot(slot);
+  return true;
+}
+
+void UserHistoryStore::Clear() {
+  ReleaseVector(&fps_);
+  ReleaseVector(&keys_);
+  ReleaseVector(&values_);
+  ReleaseVector(&descriptions_);
+  ReleaseVector(&suggestion_freqs_);
+  ReleaseVector(&conversion_freqs_);
+  ReleaseVector(&shown_freqs_);
+  ReleaseVector(&last_access_times_);
+  ReleaseVector(&flags_);
+  ReleaseVector(&next_begins_);
+  ReleaseVector(&next_sizes_);
+  ReleaseVector(&next_capacities_);
+  ReleaseVector(&lru_prevs_);
+  ReleaseVector(&lru_nexts_);
+  ReleaseVector(&next_fps_);
+  next_fps_garbage_size_ = 0;
+  strings_.Clear();
+  index_ = absl::flat_hash_map<uint32_t, uint32_t>();
+  ReleaseVector(&free_slots_);
+  lru_head_ = kNoSlot;
+  lru_tail_ = kNoSlot;
+}
+
+size_t UserHistoryStore::MemoryUsage() const {
+  return VectorMemoryUsage(fps_) + VectorMemoryUsage(keys_) +
+         VectorMemoryUsage(values_) + VectorMemoryUsage(descriptions_) +
+         VectorMemoryUsage(suggestion_freqs_) +
+         VectorMemoryUsage(conversion_freqs_) +
+         VectorMemoryUsage(shown_freqs_) +
+         VectorMemoryUsage(last_access_times_) + VectorMemoryUsage(flags_) +
+         VectorMemoryUsage(next_begins_) + VectorMemoryUsage(next_sizes_) +
+         VectorMemoryUsage(next_capacities_) + VectorMemoryUsage(lru_prevs_) +
+         VectorMemoryUsage(lru_nexts_) + VectorMemoryUsage(next_fps_) +
+         strings_.MemoryUsage() +
+         index_.capacity() * (sizeof(std::pair<uint32_t, uint32_t>) + 1) +
+         VectorMemoryUsage(free_slots_);
+}
+
+void UserHistoryStore::SetString(absl::string_view str, uint32_t *id) {
+  // Interns first, as `str` may refer to the string to be released.
+  const uint32_t new_id = strings_.Intern(str);
+  strings_.Release(*id);
+  *id = new_id;
+}
+
+uint32_t UserHistoryStore::AllocateSlot() {
+  if (!free_slots_.empty()) {
+    const uint32_t slot = free_slots_.back();
+    free_slots_.pop_back();
+    return slot;
+  }
+  const uint32_t slot = fps_.size();
+  fps_.push_back(0);
+  keys_.push_back(0);
+  values_.push_back(0);
+  descriptions_.push_back(0);
+  suggestion_freqs_.push_back(0);
+  conversion_freqs_.push_back(0);
+  shown_freqs_.push_back(0);
+  last_access_times_.push_back(0);
+  flags_.push_back(0);
+  next_begins_.push_back(0);
+  next_sizes_.push_back(0);
+  next_capacities_.push_back(0);
+  lru_prevs_.push_back(kNoSlot);
+  lru_nexts_.push_back(kNoSlot);
+  return slot;
+}
+
+void UserHistoryStore::FreeSlot(uint32_t slot) {
+  ResetSlot(slot);
+  fps_[slot] = 0;
+  next_fps_garbage_size_ += next_capacities_[slot];
+  next_begins_[slot] = 0;
+  next_capacities_[slot] = 0;
+  free_slots_.push_back(slot);
+  if (ShouldCompact(next_fps_garbage_size_, next_fps_.size())) {
+    CompactNextEntries();
+  }
+}
+
+void UserHistoryStore::ResetSlot(uint32_t slot) {
+  strings_.Release(keys_[slot]);
+  strings_.Release(values_[slot]);
+  strings_.Release(descriptions_[slot]);
+  keys_[slot] = 0;
+  values_[slot] = 0;
+  descriptions_[slot] = 0;
+  suggestion_freqs_[slot] = 0;
+  conversion_freqs_[slot] = 0;
+  shown_freqs_[slot] = 0;
+  last_access_times_[slot] = 0;
+  flags_[slot] = 0;
+  next_sizes_[slot] = 0;
+}
+
+void UserHistoryStore::RemoveFromLru(uint32_t slot) {
+  const uint32_t prev = lru_prevs_[slot];
+  const uint32_t next = lru_nexts_[slot];
+  if (prev == kNoSlot) {
+    lru_head_ = next;
+  } else {
+    lru_nexts_[prev] = next;
+  }
+  if (next == kNoSlot) {
+    lru_tail_ = prev;
+  } else {
+    lru_prevs_[next] = prev;
+  }
+  lru_prevs_[slot] = kNoSlot;
+  lru_nexts_[slot] = kNoSlot;
+}
+
+void UserHistoryStore::PushLruHead(uint32_t slot) {
+  if (lru_head_ == slot) {
+    return;
+  }
+  // A new slot is not linked yet. Otherwise it has the previous one as it is
+  // not the head.
+  if (lru_prevs_[slot] != kNoSlot) {
+    RemoveFromLru(slot);
+  }
+  lru_nexts_[slot] = lru_head_;
+  if (lru_head_ != kNoSlot) {
+    lru_prevs_[lru_head_] = slot;
+  }
+  lru_head_ = slot;
+  if (lru_tail_ == kNoSlot) {
+    lru_tail_ = slot;
+  }
+}
+
+void UserHistoryStore::ReserveNextEntry(uint32_t slot) {
+  const size_t size = next_sizes_[slot];
+  const size_t capacity = next_capacities_[slot];
+  if (size < capacity) {
+    return;
+  }
+  const size_t new_capacity =
+      std::min(kMaxNextEntriesSize,
+               std::max(kInitialNextEntriesCapacity, capacity * 2));
+  // Moves the block to the end of the pool. The old block is reclaimed by the
+  // compaction.
+  const uint32_t begin = next_fps_.size();
+  next_fps_.resize(begin + new_capacity);
+  std::copy_n(next_fps_.begin() + next_begins_[slot], size,
+              next_fps_.begin() + begin);
+  next_fps_garbage_size_ += capacity;
+  next_begins_[slot] = begin;
+  next_capacities_[slot] = new_capacity;
+  if (ShouldCompact(next_fps_garbage_size_, next_fps_.size())) {
+    CompactNextEntries();
+  }
+}
+
+void UserHistoryStore::CompactNextEntries() {
+  std::vector<uint32_t> next_fps;
+  next_fps.reserve(next_fps_.size() - next_fps_garbage_size_);
+  for (uint32_t slot = 0; slot < next_begins_.size(); ++slot) {
+    const auto begin = next_fps_.begin() + next_begins_[slot];
+    next_begins_[slot] = next_fps.size();
+    next_fps.insert(next_fps.end(), begin, begin + next_capacities_[slot]);
+  }
+  next_fps_ = std::move(next_fps);
+  next_fps_garbage_size_ = 0;
+}
+
+}  // namespace mozc::prediction
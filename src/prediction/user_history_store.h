@@ -0,0 +1,411 @@
+// Copyright 2010-2021, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef MOZC_PREDICTION_USER_HISTORY_STORE_H_
+#define MOZC_PREDICTION_USER_HISTORY_STORE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
+#include "prediction/user_history_predictor.pb.h"
+
+namespace mozc::prediction {
+
+// Compact in-memory storage of the user history entries, which replaces
+// storage::LruCache<uint32_t, UserHistory::Entry> in UserHistoryPredictor.
+//
+// The entries are kept in a structure-of-arrays layout indexed by slot:
+// key/value/description are interned in a shared string arena, the
+// frequencies, the timestamp and the flags are fixed-size fields, and the
+// fingerprints of the next entries are kept in a shared pool. The slots are
+// linked in the LRU order, and the least recently used entry is evicted when
+// the store is full. This saves the per-entry allocations of the protobuf
+// messages and makes the full scans touch only the fields they read.
+// UserHistory::Entry is used only to load and save the entries.
+//
+// Entries are accessed through EntryRef and MutableEntryRef, which are
+// lightweight handles like pointers to the elements of LruCache. A handle is
+// valid until its entry is erased or evicted, and the string_views returned by
+// it are valid until the store is modified.
+class UserHistoryStore {
+ public:
+  using Entry = user_history_predictor::UserHistory::Entry;
+  using EntryType = Entry::EntryType;
+
+  // Read-only handle of an entry. A default-constructed handle is null.
+  class EntryRef {
+   public:
+    EntryRef() = default;
+
+    explicit operator bool() const { return store_ != nullptr; }
+    friend bool operator==(const EntryRef &lhs, const EntryRef &rhs) {
+      return lhs.store_ == rhs.store_ && lhs.slot_ == rhs.slot_;
+    }
+    friend bool operator!=(const EntryRef &lhs, const EntryRef &rhs) {
+      return !(lhs == rhs);
+    }
+
+    // The fingerprint with which the entry is inserted.
+    uint32_t fp() const { return store_->fps_[slot_]; }
+
+    absl::string_view key() const {
+      return store_->strings_.Get(store_->keys_[slot_]);
+    }
+    absl::string_view value() const {
+      return store_->strings_.Get(store_->values_[slot_]);
+    }
+    absl::string_view description() const {
+      return store_->strings_.Get(store_->descriptions_[slot_]);
+    }
+    uint32_t suggestion_freq() const {
+      return store_->suggestion_freqs_[slot_];
+    }
+    uint32_t conversion_freq() const {
+      return store_->conversion_freqs_[slot_];
+    }
+    uint32_t shown_freq() const { return store_->shown_freqs_[slot_]; }
+    uint64_t last_access_time() const {
+      return store_->last_access_times_[slot_];
+    }
+    bool bigram_boost() const { return HasFlag(kBigramBoost); }
+    bool spelling_correction() const { return HasFlag(kSpellingCorrection); }
+    bool removed() const { return HasFlag(kRemoved); }
+    EntryType entry_type() const {
+      return static_cast<EntryType>(store_->flags_[slot_] >> kEntryTypeShift);
+    }
+
+    // Fingerprints of the next entries.
+    absl::Span<const uint32_t> next_entry_fps() const {
+      return absl::MakeConstSpan(
+          store_->next_fps_.data() + store_->next_begins_[slot_],
+          store_->next_sizes_[slot_]);
+    }
+    size_t next_entries_size() const { return store_->next_sizes_[slot_]; }
+
+    // The neighbors in the LRU list; prev() is the more recently used one.
+    // Returns a null handle at the ends.
+    EntryRef prev() const {
+      return store_->MakeRef(store_->lru_prevs_[slot_]);
+    }
+    EntryRef next() const {
+      return store_->MakeRef(store_->lru_nexts_[slot_]);
+    }
+
+    // Copies the entry to `entry` for serialization. The fields with the
+    // default values are left unset.
+    void CopyTo(Entry *entry) const;
+
+   protected:
+    friend class UserHistoryStore;
+
+    EntryRef(UserHistoryStore *store, uint32_t slot)
+        : store_(store), slot_(slot) {}
+
+    bool HasFlag(uint8_t flag) const {
+      return (store_->flags_[slot_] & flag) != 0;
+    }
+
+    UserHistoryStore *store_ = nullptr;
+    uint32_t slot_ = 0;
+  };
+
+  class MutableEntryRef : public EntryRef {
+   public:
+    MutableEntryRef() = default;
+
+    void set_key(absl::string_view key) {
+      store_->SetString(key, &store_->keys_[slot_]);
+    }
+    void set_value(absl::string_view value) {
+      store_->SetString(value, &store_->values_[slot_]);
+    }
+    void set_description(absl::string_view description) {
+      store_->SetString(description, &store_->descriptions_[slot_]);
+    }
+    void set_suggestion_freq(uint32_t freq) {
+      store_->suggestion_freqs_[slot_] = freq;
+    }
+    void set_conversion_freq(uint32_t freq) {
+      store_->conversion_freqs_[slot_] = freq;
+    }
+    void set_shown_freq(uint32_t freq) { store_->shown_freqs_[slot_] = freq; }
+    void set_last_access_time(uint64_t time) {
+      store_->last_access_times_[slot_] = time;
+    }
+    void set_bigram_boost(bool value) { SetFlag(kBigramBoost, value); }
+    void set_spelling_correction(bool value) {
+      SetFlag(kSpellingCorrection, value);
+    }
+    void set_removed(bool value) { SetFlag(kRemoved, value); }
+    void set_entry_type(EntryType type);
+
+    // Appends `fp` to the next entries. The number of the next entries is
+    // limited to kMaxNextEntriesSize.
+    void add_next_entry_fp(uint32_t fp);
+    void set_next_entry_fp(size_t i, uint32_t fp);
+    // Erases all the next entries equal to `fp`.
+    void EraseNextEntryFps(uint32_t fp);
+    void clear_next_entries() { store_->next_sizes_[slot_] = 0; }
+
+    // Resets all the fields to the default values.
+    void Clear();
+
+    // Copies all the fields from `entry`.
+    void CopyFrom(const Entry &entry);
+
+   private:
+    friend class UserHistoryStore;
+
+    MutableEntryRef(UserHistoryStore *store, uint32_t slot)
+        : EntryRef(store, slot) {}
+
+    void SetFlag(uint8_t flag, bool value);
+  };
+
+  // Iterates the entries from the most recently used one. The next entry is
+  // captured before the current one is returned, so the current entry can be
+  // erased during the iteration like LruCache.
+  template <typename Ref>
+  class Iterator {
+   public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = Ref;
+    using difference_type = ptrdiff_t;
+    using pointer = const Ref *;
+    using reference = const Ref &;
+
+    explicit Iterator(Ref current) : current_(current) { CaptureNext(); }
+
+    reference operator*() const { return current_; }
+    pointer operator->() const { return &current_; }
+
+    Iterator &operator++() {
+      current_ = next_;
+      CaptureNext();
+      return *this;
+    }
+
+    bool operator==(const Iterator &other) const {
+      return current_ == other.current_;
+    }
+    bool operator!=(const Iterator &other) const {
+      return current_ != other.current_;
+    }
+
+   private:
+    void CaptureNext() {
+      next_ = current_ ? current_.store_->template MakeRef<Ref>(
+                             current_.store_->lru_nexts_[current_.slot_])
+                       : Ref();
+    }
+
+    Ref current_;
+    Ref next_;
+  };
+  using iterator = Iterator<MutableEntryRef>;
+  using const_iterator = Iterator<EntryRef>;
+
+  // The maximum number of the next entries kept by an entry.
+  static constexpr size_t kMaxNextEntriesSize =
+      std::numeric_limits<uint8_t>::max();
+
+  // Constructs a store that can hold at most `max_size` entries.
+  explicit UserHistoryStore(size_t max_size);
+
+  UserHistoryStore(const UserHistoryStore &) = delete;
+  UserHistoryStore &operator=(const UserHistoryStore &) = delete;
+
+  iterator begin() { return iterator(MakeRef<MutableEntryRef>(lru_head_)); }
+  iterator end() { return iterator(MutableEntryRef()); }
+  const_iterator begin() const { return const_iterator(MakeRef(lru_head_)); }
+  const_iterator end() const { return const_iterator(EntryRef()); }
+
+  // Returns the entry of `fp` moved to the head of the LRU list. A new entry
+  // with the default values is added if `fp` is not in the store, evicting the
+  // least recently used entry if the store is full.
+  MutableEntryRef Insert(uint32_t fp);
+
+  // Same as above, but also copies all the fields from `entry`.
+  MutableEntryRef Insert(uint32_t fp, const Entry &entry);
+
+  // Returns the entry of `fp` without changing the LRU order, or a null
+  // handle if not found.
+  EntryRef LookupWithoutInsert(uint32_t fp) const;
+  MutableEntryRef MutableLookupWithoutInsert(uint32_t fp);
+
+  bool HasKey(uint32_t fp) const { return index_.contains(fp); }
+
+  // Removes the entry of `fp`. Returns false if not found.
+  bool Erase(uint32_t fp);
+
+  // Removes all the entries and releases the memory.
+  void Clear();
+
+  size_t size() const { return index_.size(); }
+  bool empty() const { return index_.empty(); }
+  size_t max_size() const { return max_size_; }
+
+  // Returns the most and the least recently used entries.
+  EntryRef Head() const { return MakeRef(lru_head_); }
+  EntryRef Tail() const { return MakeRef(lru_tail_); }
+
+  // Returns the number of bytes used by the entries, excluding the fixed
+  // overhead of the containers.
+  size_t MemoryUsage() const;
+
+ private:
+  // Interned strings with reference counts. Id 0 is the empty string.
+  class StringPool {
+   public:
+    StringPool();
+    StringPool(const StringPool &) = delete;
+    StringPool &operator=(const StringPool &) = delete;
+
+    absl::string_view Get(uint32_t id) const {
+      const Piece &piece = pieces_[id];
+      return absl::string_view(data_.data() + piece.offset, piece.size);
+    }
+
+    // Returns the id of `str` and increments its reference count.
+    uint32_t Intern(absl::string_view str);
+    // Decrements the reference count of `id`.
+    void Release(uint32_t id);
+    void Clear();
+
+    size_t MemoryUsage() const;
+
+   private:
+    struct Piece {
+      uint32_t offset = 0;
+      uint32_t size = 0;
+      uint32_t refs = 0;
+    };
+
+    // Hash and equality of the ids by their contents, which also accept
+    // string_view for the lookup.
+    struct Hash {
+      using is_transparent = void;
+      size_t operator()(uint32_t id) const;
+      size_t operator()(absl::string_view str) const;
+      const StringPool *pool;
+    };
+    struct Eq {
+      using is_transparent = void;
+      bool operator()(uint32_t lhs, uint32_t rhs) const { return lhs == rhs; }
+      bool operator()(uint32_t lhs, absl::string_view rhs) const {
+        return pool->Get(lhs) == rhs;
+      }
+      bool operator()(absl::string_view lhs, uint32_t rhs) const {
+        return lhs == pool->Get(rhs);
+      }
+      const StringPool *pool;
+    };
+
+    // Drops the bytes of the released strings from `data_`.
+    void Compact();
+
+    std::string data_;
+    std::vector<Piece> pieces_;
+    std::vector<uint32_t> free_ids_;
+    absl::flat_hash_set<uint32_t, Hash, Eq> index_;
+    size_t garbage_size_ = 0;
+  };
+
+  static constexpr uint32_t kNoSlot = std::numeric_limits<uint32_t>::max();
+
+  static constexpr uint8_t kRemoved = 1 << 0;
+  static constexpr uint8_t kBigramBoost = 1 << 1;
+  static constexpr uint8_t kSpellingCorrection = 1 << 2;
+  static constexpr int kEntryTypeShift = 4;
+
+  // The handles keep a non-const pointer so that MutableEntryRef can share the
+  // accessors. Only the non-const methods return MutableEntryRef.
+  template <typename R = EntryRef>
+  R MakeRef(uint32_t slot) const {
+    return slot == kNoSlot ? R()
+                           : R(const_cast<UserHistoryStore *>(this), slot);
+  }
+
+  void SetString(absl::string_view str, uint32_t *id);
+
+  // Returns a slot reset to the default values.
+  uint32_t AllocateSlot();
+  void FreeSlot(uint32_t slot);
+  void ResetSlot(uint32_t slot);
+
+  void RemoveFromLru(uint32_t slot);
+  void PushLruHead(uint32_t slot);
+
+  // Makes room for one more next entry of `slot`.
+  void ReserveNextEntry(uint32_t slot);
+  // Drops the unused blocks from `next_fps_`.
+  void CompactNextEntries();
+
+  const size_t max_size_;
+
+  // Fields of the entries indexed by slot.
+  std::vector<uint32_t> fps_;
+  std::vector<uint32_t> keys_;
+  std::vector<uint32_t> values_;
+  std::vector<uint32_t> descriptions_;
+  std::vector<uint32_t> suggestion_freqs_;
+  std::vector<uint32_t> conversion_freqs_;
+  std::vector<uint32_t> shown_freqs_;
+  std::vector<uint64_t> last_access_times_;
+  std::vector<uint8_t> flags_;
+  // The block of each slot in `next_fps_`.
+  std::vector<uint32_t> next_begins_;
+  std::vector<uint8_t> next_sizes_;
+  std::vector<uint8_t> next_capacities_;
+  // Doubly linked LRU list.
+  std::vector<uint32_t> lru_prevs_;
+  std::vector<uint32_t> lru_nexts_;
+
+  // Shared pool of the fingerprints of the next entries.
+  std::vector<uint32_t> next_fps_;
+  size_t next_fps_garbage_size_ = 0;
+
+  StringPool strings_;
+  absl::flat_hash_map<uint32_t, uint32_t> index_;  // fp -> slot
+  std::vector<uint32_t> free_slots_;
+  uint32_t lru_head_ = kNoSlot;
+  uint32_t lru_tail_ = kNoSlot;
+};
+
+}  // namespace mozc::prediction
+
+#endif  // MOZC_PREDICTION_USER_HISTORY_STORE_H_
@@ -0,0 +1,402 @@
+// Copyright 2010-2021, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "prediction/user_history_store.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "prediction/user_history_predictor.pb.h"
+#include "testing/gmock.h"
+#include "testing/gunit.h"
+#include "testing/testing_util.h"
+
+namespace mozc::prediction {
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::IsEmpty;
+
+using Entry = UserHistoryStore::Entry;
+using EntryRef = UserHistoryStore::EntryRef;
+using MutableEntryRef = UserHistoryStore::MutableEntryRef;
+
+std::vector<uint32_t> GetOrderedFps(const UserHistoryStore &store) {
+  std::vector<uint32_t> fps;
+  for (EntryRef entry : store) {
+    fps.push_back(entry.fp());
+  }
+  return fps;
+}
+
+std::vector<uint32_t> GetNextEntryFps(EntryRef entry) {
+  return std::vector<uint32_t>(entry.next_entry_fps().begin(),
+                               entry.next_entry_fps().end());
+}
+
+TEST(UserHistoryStoreTest, InsertAndEvict) {
+  UserHistoryStore store(3);
+  EXPECT_TRUE(store.empty());
+  EXPECT_FALSE(store.Head());
+  EXPECT_FALSE(store.Tail());
+
+  store.Insert(0);
+  EXPECT_THAT(GetOrderedFps(store), ElementsAre(0));
+  store.Insert(1);
+  store.Insert(2);
+  EXPECT_THAT(GetOrderedFps(store), ElementsAre(2, 1, 0));
+  store.Insert(3);
+  EXPECT_THAT(GetOrderedFps(store), ElementsAre(3, 2, 1));
+  EXPECT_EQ(store.size(), 3);
+  EXPECT_FALSE(store.HasKey(0));
+
+  // Inserting an existing entry moves it to the head.
+  store.Insert(1);
+  EXPECT_THAT(GetOrderedFps(store), ElementsAre(1, 3, 2));
+  store.Insert(2);
+  EXPECT_THAT(GetOrderedFps(store), ElementsAre(2, 1, 3));
+  store.Insert(2);
+  EXPECT_THAT(GetOrderedFps(store), ElementsAre(2, 1, 3));
+  EXPECT_EQ(store.Head().fp(), 2);
+  EXPECT_EQ(store.Tail().fp(), 3);
+  EXPECT_EQ(store.Tail().prev().fp(), 1);
+  EXPECT_FALSE(store.Tail().next());
+  EXPECT_FALSE(store.Head().prev());
+}
+
+TEST(UserHistoryStoreTest, InsertKeepsFields) {
+  UserHistoryStore store(2);
+  MutableEntryRef entry = store.Insert(10);
+  entry.set_key("key");
+  entry.set_conversion_freq(3);
+  store.Insert(20);
+
+  entry = store.Insert(10);
+  EXPECT_EQ(entry.key(), "key");
+  EXPECT_EQ(entry.conversion_freq(), 3);
+}
+
+TEST(UserHistoryStoreTest, NewEntryHasDefaultValues) {
+  UserHistoryStore store(1);
+  MutableEntryRef entry = store.Insert(1);
+  entry.set_key("key");
+  entry.set_value("value");
+  entry.set_suggestion_freq(1);
+  entry.set_last_access_time(100);
+  entry.set_removed(true);
+  entry.set_entry_type(Entry::CLEAN_ALL_EVENT);
+  entry.add_next_entry_fp(5);
+
+  // Evicts the entry of 1 and reuses its slot.
+  entry = store.Insert(2);
+  EXPECT_EQ(entry.fp(), 2);
+  EXPECT_THAT(entry.key(), IsEmpty());
+  EXPECT_THAT(entry.value(), IsEmpty());
+  EXPECT_EQ(entry.suggestion_freq(), 0);
+  EXPECT_EQ(entry.last_access_time(), 0);
+  EXPECT_FALSE(entry.removed());
+  EXPECT_EQ(entry.entry_type(), Entry::DEFAULT_ENTRY);
+  EXPECT_EQ(entry.next_entries_size(), 0);
+}
+
+TEST(UserHistoryStoreTest, Lookup) {
+  UserHistoryStore store(3);
+  store.Insert(1).set_key("one");
+  store.Insert(2).set_key("two");
+
+  EntryRef entry = store.LookupWithoutInsert(1);
+  ASSERT_TRUE(entry);
+  EXPECT_EQ(entry.key(), "one");
+  // Lookup doesn't change the order.
+  EXPECT_THAT(GetOrderedFps(store), ElementsAre(2, 1));
+  EXPECT_FALSE(store.LookupWithoutInsert(3));
+
+  MutableEntryRef mutable_entry = store.MutableLookupWithoutInsert(2);
+  ASSERT_TRUE(mutable_entry);
+  mutable_entry.set_key("TWO");
+  EXPECT_EQ(store.LookupWithoutInsert(2).key(), "TWO");
+  EXPECT_FALSE(store.MutableLookupWithoutInsert(3));
+}
+
+TEST(UserHistoryStoreTest, Erase) {
+  UserHistoryStore store(5);
+  for (uint32_t fp = 0; fp < 5; ++fp) {
+    store.Insert(fp);
+  }
+  EXPECT_TRUE(store.Erase(2));
+  EXPECT_FALSE(store.Erase(2));
+  EXPECT_THAT(GetOrderedFps(store), ElementsAre(4, 3, 1, 0));
+  EXPECT_TRUE(store.Erase(4));
+  EXPECT_TRUE(store.Erase(0));
+  EXPECT_THAT(GetOrderedFps(store), ElementsAre(3, 1));
+  EXPECT_EQ(store.Head().fp(), 3);
+  EXPECT_EQ(store.Tail().fp(), 1);
+
+  store.Insert(5);
+  store.Insert(6);
+  EXPECT_THAT(GetOrderedFps(store), ElementsAre(6, 5, 3, 1));
+}
+
+TEST(UserHistoryStoreTest, EraseWhileIterating) {
+  UserHistoryStore store(10);
+  for (uint32_t fp = 0; fp < 10; ++fp) {
+    store.Insert(fp);
+  }
+  for (EntryRef entry : store) {
+    if (entry.fp() % 2 == 0) {
+      store.Erase(entry.fp());
+    }
+  }
+  EXPECT_THAT(GetOrderedFps(store), ElementsAre(9, 7, 5, 3, 1));
+}
+
+TEST(UserHistoryStoreTest, MutableIteration) {
+  UserHistoryStore store(3);
+  for (uint32_t fp = 0; fp < 3; ++fp) {
+    store.Insert(fp);
+  }
+  for (MutableEntryRef entry : store) {
+    entry.set_shown_freq(entry.fp() + 1);
+  }
+  EXPECT_EQ(store.LookupWithoutInsert(0).shown_freq(), 1);
+  EXPECT_EQ(store.LookupWithoutInsert(2).shown_freq(), 3);
+}
+
+TEST(UserHistoryStoreTest, Strings) {
+  UserHistoryStore store(3);
+  MutableEntryRef entry1 = store.Insert(1);
+  entry1.set_key("key");
+  entry1.set_value("value");
+  entry1.set_description("desc");
+  MutableEntryRef entry2 = store.Insert(2);
+  entry2.set_key("key");
+  entry2.set_value("key");
+
+  EXPECT_EQ(entry1.key(), "key");
+  EXPECT_EQ(entry1.value(), "value");
+  EXPECT_EQ(entry1.description(), "desc");
+  EXPECT_EQ(entry2.key(), "key");
+  EXPECT_EQ(entry2.value(), "key");
+  EXPECT_THAT(entry2.description(), IsEmpty());
+
+  // Strings shared by other entries are kept.
+  store.Erase(1);
+  EXPECT_EQ(entry2.key(), "key");
+  entry2.set_key("");
+  EXPECT_THAT(entry2.key(), IsEmpty());
+  EXPECT_EQ(entry2.value(), "key");
+
+  // Setting a string of the same entry.
+  entry2.set_key(entry2.value());
+  entry2.set_value("other");
+  EXPECT_EQ(entry2.key(), "key");
+  EXPECT_EQ(entry2.value(), "other");
+}
+
+TEST(UserHistoryStoreTest, StringsAfterChurn) {
+  constexpr int kSize = 100;
+  UserHistoryStore store(kSize);
+  // Replaces the strings many times to trigger the compaction of the arena.
+  for (int i = 0; i < 100; ++i) {
+    for (uint32_t fp = 0; fp < kSize; ++fp) {
+      MutableEntryRef entry = store.Insert(fp);
+      entry.set_key(absl::StrCat("key", fp, "_", i));
+      entry.set_value(absl::StrCat("value", fp % 10));
+    }
+    // Evicts a part of the entries.
+    for (uint32_t fp = kSize * (i + 1); fp < kSize * (i + 1) + 10; ++fp) {
+      store.Insert(fp).set_key(absl::StrCat("evictor", fp));
+    }
+  }
+  for (EntryRef entry : store) {
+    if (entry.fp() < kSize) {
+      EXPECT_EQ(entry.key(), absl::StrCat("key", entry.fp(), "_", 99));
+      EXPECT_EQ(entry.value(), absl::StrCat("value", entry.fp() % 10));
+    } else {
+      EXPECT_EQ(entry.key(), absl::StrCat("evictor", entry.fp()));
+    }
+  }
+  // The garbage is bounded by the compaction.
+  EXPECT_LT(store.MemoryUsage(), 64 * 1024);
+}
+
+TEST(UserHistoryStoreTest, NextEntries) {
+  UserHistoryStore store(3);
+  MutableEntryRef entry1 = store.Insert(1);
+  MutableEntryRef entry2 = store.Insert(2);
+  for (uint32_t fp = 0; fp < 10; ++fp) {
+    entry1.add_next_entry_fp(fp);
+    entry2.add_next_entry_fp(fp * 2);
+  }
+  EXPECT_THAT(GetNextEntryFps(entry1),
+              ElementsAre(0, 1, 2, 3, 4, 5, 6, 7, 8, 9));
+  EXPECT_THAT(GetNextEntryFps(entry2),
+              ElementsAre(0, 2, 4, 6, 8, 10, 12, 14, 16, 18));
+
+  entry1.set_next_entry_fp(0, 100);
+  entry1.add_next_entry_fp(3);
+  entry1.EraseNextEntryFps(3);
+  EXPECT_THAT(GetNextEntryFps(entry1),
+              ElementsAre(100, 1, 2, 9, 4, 5, 6, 7, 8));
+  entry1.EraseNextEntryFps(1000);
+  EXPECT_EQ(entry1.next_entries_size(), 9);
+
+  entry1.clear_next_entries();
+  EXPECT_EQ(entry1.next_entries_size(), 0);
+  EXPECT_EQ(entry2.next_entries_size(), 10);
+}
+
+TEST(UserHistoryStoreTest, NextEntriesLimit) {
+  UserHistoryStore store(1);
+  MutableEntryRef entry = store.Insert(1);
+  for (uint32_t fp = 0; fp < UserHistoryStore::kMaxNextEntriesSize + 10;
+       ++fp) {
+    entry.add_next_entry_fp(fp);
+  }
+  EXPECT_EQ(entry.next_entries_size(), UserHistoryStore::kMaxNextEntriesSize);
+  EXPECT_EQ(entry.next_entry_fps().back(),
+            UserHistoryStore::kMaxNextEntriesSize - 1);
+}
+
+TEST(UserHistoryStoreTest, NextEntriesAfterChurn) {
+  constexpr int kSize = 100;
+  UserHistoryStore store(kSize);
+  // Grows and frees the blocks many times to trigger the compaction.
+  for (uint32_t i = 0; i < 100; ++i) {
+    for (uint32_t fp = i * kSize; fp < (i + 1) * kSize; ++fp) {
+      MutableEntryRef entry = store.Insert(fp);
+      for (int j = 0; j < 5; ++j) {
+        entry.add_next_entry_fp(fp);
+      }
+    }
+  }
+  for (EntryRef entry : store) {
+    const std::vector<uint32_t> fps = GetNextEntryFps(entry);
+    ASSERT_EQ(fps.size(), 5);
+    for (const uint32_t fp : fps) {
+      EXPECT_EQ(fp, entry.fp());
+    }
+  }
+  EXPECT_LT(store.MemoryUsage(), 64 * 1024);
+}
+
+TEST(UserHistoryStoreTest, CopyToAndCopyFrom) {
+  Entry entry;
+  entry.set_key("key");
+  entry.set_value("value");
+  entry.set_description("description");
+  entry.set_suggestion_freq(1);
+  entry.set_conversion_freq(2);
+  entry.set_shown_freq(3);
+  entry.set_last_access_time(1234567890);
+  entry.add_next_entries()->set_entry_fp(10);
+  entry.add_next_entries()->set_entry_fp(20);
+  entry.set_bigram_boost(true);
+  entry.set_spelling_correction(true);
+  entry.set_removed(true);
+  entry.set_entry_type(Entry::CLEAN_UNUSED_EVENT);
+
+  UserHistoryStore store(2);
+  EntryRef ref = store.Insert(1, entry);
+  Entry copied;
+  ref.CopyTo(&copied);
+  EXPECT_PROTO_EQ(entry, copied);
+
+  // The default values are left unset.
+  Entry empty;
+  empty.set_key("key");
+  store.Insert(2, empty).CopyTo(&copied);
+  EXPECT_PROTO_EQ(empty, copied);
+  EXPECT_FALSE(copied.has_suggestion_freq());
+  EXPECT_FALSE(copied.has_description());
+  EXPECT_FALSE(copied.has_entry_type());
+
+  // Overwrites all the fields.
+  store.Insert(1, empty).CopyTo(&copied);
+  EXPECT_PROTO_EQ(empty, copied);
+}
+
+TEST(UserHistoryStoreTest, ClearEntry) {
+  UserHistoryStore store(2);
+  Entry entry;
+  entry.set_key("key");
+  entry.set_conversion_freq(2);
+  entry.add_next_entries()->set_entry_fp(10);
+  MutableEntryRef ref = store.Insert(1, entry);
+  ref.Clear();
+  EXPECT_EQ(ref.fp(), 1);
+  EXPECT_TRUE(store.HasKey(1));
+  Entry copied;
+  ref.CopyTo(&copied);
+  EXPECT_PROTO_EQ(Entry(), copied);
+}
+
+TEST(UserHistoryStoreTest, Clear) {
+  UserHistoryStore store(10);
+  for (uint32_t fp = 0; fp < 10; ++fp) {
+    MutableEntryRef entry = store.Insert(fp);
+    entry.set_key(absl::StrCat("key", fp));
+    entry.add_next_entry_fp(fp);
+  }
+  const size_t memory_usage = store.MemoryUsage();
+  store.Clear();
+  EXPECT_TRUE(store.empty());
+  EXPECT_THAT(GetOrderedFps(store), IsEmpty());
+  EXPECT_FALSE(store.Head());
+  EXPECT_FALSE(store.Tail());
+  EXPECT_LT(store.MemoryUsage(), memory_usage / 10);
+
+  MutableEntryRef entry = store.Insert(1);
+  entry.set_key("key");
+  EXPECT_EQ(store.LookupWithoutInsert(1).key(), "key");
+  EXPECT_THAT(GetOrderedFps(store), ElementsAre(1));
+}
+
+TEST(UserHistoryStoreTest, MemoryUsage) {
+  constexpr int kSize = 1000;
+  UserHistoryStore store(kSize);
+  size_t proto_size = 0;
+  for (uint32_t fp = 0; fp < kSize; ++fp) {
+    Entry entry;
+    entry.set_key(absl::StrCat("key", fp % 100));
+    entry.set_value(absl::StrCat("value", fp));
+    entry.set_suggestion_freq(1);
+    entry.set_last_access_time(fp);
+    entry.add_next_entries()->set_entry_fp(fp + 1);
+    proto_size += entry.SpaceUsedLong();
+    store.Insert(fp, entry);
+  }
+  EXPECT_LT(store.MemoryUsage(), proto_size);
+}
+
+}  // namespace
+}  // namespace mozc::prediction
@@ -31,6 +31,7 @@
 #define MOZC_REQUEST_CONVERSION_REQUEST_H_
 
 #include <cstddef>
+#include <cstdint>
 #include <string>
 #include <utility>
 
@@ -120,6 +121,11 @@ class ConversionRequest {
     // If true, use conversion_segment(0).key() instead of ComposerData.
     // TODO(b/365909808): Create a new string field to store the key.
     bool use_already_typing_corrected_key = false;
+
+    // Fingerprint of the request and the config, which is computed by the
+    // caller when they change rather than for each conversion. The converter
+    // caches the results only when this is non-zero.
+    uint64_t settings_fingerprint = 0;
   };
 
   ConversionRequest()
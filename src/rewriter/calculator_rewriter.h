@@ -51,6 +51,8 @@ class CalculatorRewriter : public RewriterInterface {
 
   int capability(const ConversionRequest &request) const override;
 
+  Trigger trigger() const override { return {.single_segment_only = true}; }
+
   std::optional<ResizeSegmentsRequest> CheckResizeSegmentsRequest(
       const ConversionRequest &request,
       const Segments &segments) const override;
@@ -31,6 +31,7 @@
 
 #include <algorithm>
 #include <cstddef>
+#include <iterator>
 #include <string>
 #include <vector>
 
@@ -41,6 +42,7 @@
 #include "converter/segments.h"
 #include "protocol/config.pb.h"
 #include "request/conversion_request.h"
+#include "rewriter/rewriter_interface.h"
 
 namespace mozc {
 namespace {
@@ -165,6 +167,12 @@ bool CommandRewriter::RewriteSegment(const config::Config &config,
   return false;
 }
 
+RewriterInterface::Trigger CommandRewriter::trigger() const {
+  return {.single_segment_only = true,
+          .keys = std::vector<std::string>(std::begin(kTriggerKeys),
+                                           std::end(kTriggerKeys))};
+}
+
 bool CommandRewriter::Rewrite(const ConversionRequest &request,
                               Segments *segments) const {
   if (segments == nullptr || segments->conversion_segments_size() != 1) {
@@ -47,6 +47,8 @@ class CommandRewriter : public RewriterInterface {
   CommandRewriter() = default;
   ~CommandRewriter() override = default;
 
+  Trigger trigger() const override;
+
   bool Rewrite(const ConversionRequest &request,
                Segments *segments) const override;
 
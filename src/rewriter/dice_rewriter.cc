@@ -36,12 +36,16 @@
 #include "absl/log/log.h"
 #include "absl/random/random.h"
 #include "absl/strings/str_format.h"
+#include "absl/strings/string_view.h"
 #include "converter/segments.h"
 #include "request/conversion_request.h"
+#include "rewriter/rewriter_interface.h"
 
 namespace mozc {
 namespace {
 
+constexpr absl::string_view kTriggerKey = "さいころ";
+
 // We use dice with 6 faces.
 constexpr int kDiceFaces = 6;
 
@@ -86,6 +90,10 @@ DiceRewriter::DiceRewriter() = default;
 
 DiceRewriter::~DiceRewriter() = default;
 
+RewriterInterface::Trigger DiceRewriter::trigger() const {
+  return {.single_segment_only = true, .keys = {std::string(kTriggerKey)}};
+}
+
 bool DiceRewriter::Rewrite(const ConversionRequest &request,
                            Segments *segments) const {
   if (segments->conversion_segments_size() != 1) {
@@ -99,7 +107,7 @@ bool DiceRewriter::Rewrite(const ConversionRequest &request,
     return false;
   }
 
-  if (key != "さいころ") {
+  if (key != kTriggerKey) {
     return false;
   }
 
@@ -109,9 +117,16 @@ bool DiceRewriter::Rewrite(const ConversionRequest &request,
 
   // Get a random number whose range is [1, kDiceFaces]
   // Insert the number at |insert_pos|
+  absl::BitGen bitgen;
   return InsertCandidate(
-      absl::Uniform(absl::IntervalClosed, bitgen_, 1, kDiceFaces), insert_pos,
+      absl::Uniform(absl::IntervalClosed, bitgen, 1, kDiceFaces), insert_pos,
       segments->mutable_conversion_segment(0));
 }
 
+bool DiceRewriter::IsDeterministic(const ConversionRequest &request,
+                                   const Segments &segments) const {
+  return segments.conversion_segments_size() != 1 ||
+         segments.conversion_segment(0).key() != kTriggerKey;
+}
+
 }  // namespace mozc
@@ -30,7 +30,6 @@
 #ifndef MOZC_REWRITER_DICE_REWRITER_H_
 #define MOZC_REWRITER_DICE_REWRITER_H_
 
-#include "absl/random/random.h"
 #include "rewriter/rewriter_interface.h"
 
 namespace mozc {
@@ -43,11 +42,14 @@ class DiceRewriter : public RewriterInterface {
   DiceRewriter();
   ~DiceRewriter() override;
 
+  Trigger trigger() const override;
+
   bool Rewrite(const ConversionRequest &request,
                Segments *segments) const override;
 
- private:
-  mutable absl::BitGen bitgen_;
+  // The dice number is random.
+  bool IsDeterministic(const ConversionRequest &request,
+                       const Segments &segments) const override;
 };
 
 }  // namespace mozc
@@ -31,8 +31,10 @@
 
 #include <algorithm>
 #include <cstddef>
+#include <cstdint>
 #include <cstring>
 #include <memory>
+#include <optional>
 #include <string>
 #include <utility>
 #include <vector>
@@ -41,6 +43,7 @@
 #include "absl/strings/match.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
+#include "base/container/serialized_key_index.h"
 #include "base/container/serialized_string_array.h"
 #include "base/japanese_util.h"
 #include "base/strings/assign.h"
@@ -113,8 +116,23 @@ void GatherAllEmojiData(EmojiDataIterator begin, EmojiDataIterator end,
   std::sort(utf8_emoji_list->begin(), utf8_emoji_list->end());
 }
 
-std::vector<std::unique_ptr<Segment::Candidate>> CreateAllEmojiData(
-    absl::string_view key, const int cost, EmojiEntryList utf8_emoji_list) {
+void GatherEmojiData(EmojiRewriter::IteratorRange range,
+                     const SerializedStringArray &string_array,
+                     EmojiEntryList *utf8_emoji_list) {
+  utf8_emoji_list->reserve(range.second - range.first);
+  for (auto iter = range.first; iter != range.second; ++iter) {
+    absl::string_view utf8_emoji = string_array[iter.emoji_index()];
+    if (utf8_emoji.empty()) {
+      continue;
+    }
+    utf8_emoji_list->emplace_back(utf8_emoji,
+                                  string_array[iter.description_utf8_index()]);
+  }
+}
+
+std::vector<std::unique_ptr<Segment::Candidate>> CreateEmojiData(
+    absl::string_view key, const int cost,
+    const EmojiEntryList &utf8_emoji_list) {
   std::vector<std::unique_ptr<Segment::Candidate>> candidates;
   candidates.reserve(utf8_emoji_list.size());
   for (const auto &emoji_entry : utf8_emoji_list) {
@@ -124,21 +142,16 @@ std::vector<std::unique_ptr<Segment::Candidate>> CreateAllEmojiData(
   return candidates;
 }
 
-std::vector<std::unique_ptr<Segment::Candidate>> CreateEmojiData(
-    absl::string_view key, const int cost, EmojiRewriter::IteratorRange range,
-    const SerializedStringArray &string_array) {
-  std::vector<std::unique_ptr<Segment::Candidate>> candidates;
-  candidates.reserve(range.second - range.first);
-  for (auto iter = range.first; iter != range.second; ++iter) {
-    absl::string_view utf8_emoji = string_array[iter.emoji_index()];
-    if (utf8_emoji.empty()) {
-      continue;
-    }
-    candidates.push_back(CreateCandidate(
-        key, utf8_emoji, string_array[iter.description_utf8_index()], cost));
-  }
-  return candidates;
-}
+// Emoji entries looked up for each conversion segment.
+class PreparedEmoji : public RewriterInterface::PreparedRewrite {
+ public:
+  struct SegmentEntries {
+    std::string reading;
+    EmojiEntryList utf8_emoji_list;
+  };
+  std::vector<SegmentEntries> segments;
+};
+
 }  // namespace
 
 EmojiRewriter::EmojiRewriter(const DataManager &data_manager) {
@@ -146,6 +159,13 @@ EmojiRewriter::EmojiRewriter(const DataManager &data_manager) {
   data_manager.GetEmojiRewriterData(&token_array_data_, &string_array_data);
   DCHECK(SerializedStringArray::VerifyData(string_array_data));
   string_array_.Set(string_array_data);
+  const absl::string_view key_index_data =
+      data_manager.GetEmojiRewriterKeyIndexData();
+  if (!key_index_data.empty()) {
+    DCHECK(SerializedKeyIndex::VerifyData(
+        key_index_data, token_array_data_.size() / kEmojiDataByteLength));
+    key_index_.Set(key_index_data);
+  }
 }
 
 int EmojiRewriter::capability(const ConversionRequest &request) const {
@@ -158,13 +178,76 @@ int EmojiRewriter::capability(const ConversionRequest &request) const {
 
 bool EmojiRewriter::Rewrite(const ConversionRequest &request,
                             Segments *segments) const {
+  CHECK(segments != nullptr);
+  const std::unique_ptr<PreparedRewrite> prepared =
+      PrepareRewrite(request, *segments);
+  if (prepared == nullptr) {
+    return false;
+  }
+  return ApplyRewrite(request, *prepared, segments);
+}
+
+std::unique_ptr<RewriterInterface::PreparedRewrite>
+EmojiRewriter::PrepareRewrite(const ConversionRequest &request,
+                              const Segments &segments) const {
   if (!request.config().use_emoji_conversion()) {
     MOZC_VLOG(2) << "no use_emoji_conversion";
-    return false;
+    return nullptr;
   }
 
-  CHECK(segments != nullptr);
-  return RewriteCandidates(segments);
+  auto prepared = std::make_unique<PreparedEmoji>();
+  prepared->segments.reserve(segments.conversion_segments_size());
+  for (const Segment &segment : segments.conversion_segments()) {
+    PreparedEmoji::SegmentEntries &entries =
+        prepared->segments.emplace_back();
+    entries.reading =
+        japanese_util::FullWidthAsciiToHalfWidthAscii(segment.key());
+    if (entries.reading.empty()) {
+      continue;
+    }
+
+    if (entries.reading == kEmojiKey) {
+      // When key is "えもじ", we expect to expand all Emoji characters.
+      GatherAllEmojiData(begin(), end(), string_array_,
+                         &entries.utf8_emoji_list);
+      continue;
+    }
+
+    const auto range = LookUpToken(entries.reading);
+    if (range.first == range.second) {
+      MOZC_VLOG(2) << "Token not found: " << entries.reading;
+      continue;
+    }
+    GatherEmojiData(range, string_array_, &entries.utf8_emoji_list);
+  }
+  return prepared;
+}
+
+bool EmojiRewriter::ApplyRewrite(const ConversionRequest &request,
+                                 const PreparedRewrite &prepared,
+                                 Segments *segments) const {
+  const PreparedEmoji &emoji = static_cast<const PreparedEmoji &>(prepared);
+  DCHECK_EQ(emoji.segments.size(), segments->conversion_segments_size());
+
+  bool modified = false;
+  for (size_t i = 0; i < emoji.segments.size(); ++i) {
+    const PreparedEmoji::SegmentEntries &entries = emoji.segments[i];
+    if (entries.utf8_emoji_list.empty()) {
+      continue;
+    }
+    Segment *segment = segments->mutable_conversion_segment(i);
+    std::vector<std::unique_ptr<Segment::Candidate>> candidates =
+        CreateEmojiData(entries.reading, GetEmojiCost(*segment),
+                        entries.utf8_emoji_list);
+    if (candidates.empty()) {
+      continue;
+    }
+    const size_t insert_position =
+        RewriterUtil::CalculateInsertPosition(*segment, kDefaultInsertPos);
+    segment->insert_candidates(insert_position, std::move(candidates));
+    modified = true;
+  }
+  return modified;
 }
 
 void EmojiRewriter::Finish(const ConversionRequest &request,
@@ -195,6 +278,15 @@ bool EmojiRewriter::IsEmojiCandidate(const Segment::Candidate &candidate) {
 
 std::pair<EmojiDataIterator, EmojiDataIterator> EmojiRewriter::LookUpToken(
     absl::string_view key) const {
+  if (!key_index_.empty()) {
+    const std::optional<SerializedKeyIndex::Range> range = key_index_.Find(
+        key, [this](uint32_t i) { return string_array_[*(begin() + i)]; });
+    if (!range.has_value()) {
+      return std::pair<EmojiDataIterator, EmojiDataIterator>(end(), end());
+    }
+    return std::pair<EmojiDataIterator, EmojiDataIterator>(
+        begin() + range->first, begin() + range->second);
+  }
   // Search string array for key.
   auto iter = std::lower_bound(string_array_.begin(), string_array_.end(), key);
   if (iter == string_array_.end() || *iter != key) {
@@ -204,55 +296,4 @@ std::pair<EmojiDataIterator, EmojiDataIterator> EmojiRewriter::LookUpToken(
   return std::equal_range(begin(), end(), iter.index());
 }
 
-bool EmojiRewriter::RewriteCandidates(Segments *segments) const {
-  bool modified = false;
-  std::string reading;
-
-  auto insert_candidates =
-      [](std::vector<std::unique_ptr<Segment::Candidate>> &&cands,
-         Segment *segment) -> bool {
-    if (cands.empty()) {
-      return false;
-    }
-    const size_t insert_position =
-        RewriterUtil::CalculateInsertPosition(*segment, kDefaultInsertPos);
-    segment->insert_candidates(insert_position, std::move(cands));
-    return true;
-  };
-
-  for (Segment &segment : segments->conversion_segments()) {
-    reading = japanese_util::FullWidthAsciiToHalfWidthAscii(segment.key());
-    if (reading.empty()) {
-      continue;
-    }
-
-    if (reading == kEmojiKey) {
-      // When key is "えもじ", we expect to expand all Emoji characters.
-      EmojiEntryList utf8_emoji_list;
-      GatherAllEmojiData(begin(), end(), string_array_, &utf8_emoji_list);
-      if (utf8_emoji_list.empty()) {
-        continue;
-      }
-
-      const int cost = GetEmojiCost(segment);
-      std::vector<std::unique_ptr<Segment::Candidate>> candidates =
-          CreateAllEmojiData(reading, cost, utf8_emoji_list);
-      modified |= insert_candidates(std::move(candidates), &segment);
-      continue;
-    }
-
-    const auto range = LookUpToken(reading);
-    if (range.first == range.second) {
-      MOZC_VLOG(2) << "Token not found: " << reading;
-      continue;
-    }
-
-    const int cost = GetEmojiCost(segment);
-    std::vector<std::unique_ptr<Segment::Candidate>> candidates =
-        CreateEmojiData(reading, cost, range, string_array_);
-    modified |= insert_candidates(std::move(candidates), &segment);
-  }
-  return modified;
-}
-
 }  // namespace mozc
@@ -31,9 +31,11 @@
 #define MOZC_REWRITER_EMOJI_REWRITER_H_
 
 #include <cstddef>
+#include <memory>
 #include <utility>
 
 #include "absl/strings/string_view.h"
+#include "base/container/serialized_key_index.h"
 #include "base/container/serialized_string_array.h"
 #include "converter/segments.h"
 #include "data_manager/data_manager.h"
@@ -79,12 +81,21 @@ class EmojiRewriter : public RewriterInterface {
 
   // Returns true if emoji candidates are added.  When user settings are set
   // not to use EmojiRewriter, does nothing other than returning false.
-  // Otherwise, main process are done in ReriteCandidates().
-  // A reference to a ConversionRequest instance is not used, but it is required
-  // because of the interface.
+  // Otherwise, adds emoji candidates on each segment whose key is a reading of
+  // emoji in the dictionary.  If a segment's key is "えもじ", adds all emoji
+  // candidates.
   bool Rewrite(const ConversionRequest &request,
                Segments *segments) const override;
 
+  // Emoji lookups only depend on the segment keys.
+  bool SupportsPrepareRewrite() const override { return true; }
+  std::unique_ptr<PreparedRewrite> PrepareRewrite(
+      const ConversionRequest &request,
+      const Segments &segments) const override;
+  bool ApplyRewrite(const ConversionRequest &request,
+                    const PreparedRewrite &prepared,
+                    Segments *segments) const override;
+
   // Counts the number of segments in which emoji candidates are selected,
   // and stores the result as usage stats.
   // NOTE: This method is expected to be called after the segments are processed
@@ -108,16 +119,13 @@ class EmojiRewriter : public RewriterInterface {
                              token_array_data_.size());
   }
 
-  // Adds emoji candidates on each segment of given segments, if it has a
-  // specific string as a key based on a dictionary.  If a segment's value is
-  // "えもじ", adds all emoji candidates.
-  // Returns true if emoji candidates are added in any segment.
-  bool RewriteCandidates(Segments *segments) const;
-
   IteratorRange LookUpToken(absl::string_view key) const;
 
   absl::string_view token_array_data_;
   SerializedStringArray string_array_;
+  // Optional index from reading to token range.  If empty, tokens are looked
+  // up by binary search.
+  SerializedKeyIndex key_index_;
 };
 
 }  // namespace mozc
@@ -30,6 +30,7 @@
 #include "rewriter/emoticon_rewriter.h"
 
 #include <algorithm>
+#include <cstddef>
 #include <cstring>
 #include <iterator>
 #include <memory>
@@ -40,6 +41,7 @@
 #include "absl/log/log.h"
 #include "absl/random/random.h"
 #include "absl/strings/string_view.h"
+#include "absl/types/span.h"
 #include "base/vlog.h"
 #include "converter/segments.h"
 #include "data_manager/data_manager.h"
@@ -69,21 +71,9 @@ class IsEqualValue {
   }
 };
 
-// Insert Emoticon into the |segment|
-// Top |initial_insert_size| candidates are inserted from |initial_insert_pos|.
-// Remained candidates are added to the buttom.
-void InsertCandidates(SerializedDictionary::const_iterator begin,
-                      SerializedDictionary::const_iterator end,
-                      size_t initial_insert_pos, size_t initial_insert_size,
-                      bool is_no_learning, Segment *segment) {
-  if (segment->candidates_size() == 0) {
-    LOG(WARNING) << "candidates_size is 0";
-    return;
-  }
-
-  const Segment::Candidate &base_candidate = segment->candidate(0);
-  size_t offset = std::min(initial_insert_pos, segment->candidates_size());
-
+std::vector<SerializedDictionary::const_iterator> SortValues(
+    SerializedDictionary::const_iterator begin,
+    SerializedDictionary::const_iterator end) {
   // Sort values by cost just in case
   std::vector<SerializedDictionary::const_iterator> sorted_value;
   for (auto iter = begin; iter != end; ++iter) {
@@ -98,6 +88,23 @@ void InsertCandidates(SerializedDictionary::const_iterator begin,
   sorted_value.erase(
       std::unique(sorted_value.begin(), sorted_value.end(), IsEqualValue()),
       sorted_value.end());
+  return sorted_value;
+}
+
+// Insert Emoticon into the |segment|
+// Top |initial_insert_size| candidates are inserted from |initial_insert_pos|.
+// Remained candidates are added to the buttom.
+void InsertCandidates(
+    absl::Span<const SerializedDictionary::const_iterator> sorted_value,
+    size_t initial_insert_pos, size_t initial_insert_size,
+    bool is_no_learning, Segment *segment) {
+  if (segment->candidates_size() == 0) {
+    LOG(WARNING) << "candidates_size is 0";
+    return;
+  }
+
+  const Segment::Candidate &base_candidate = segment->candidate(0);
+  size_t offset = std::min(initial_insert_pos, segment->candidates_size());
 
   for (size_t i = 0; i < sorted_value.size(); ++i) {
     Segment::Candidate *c = nullptr;
@@ -146,21 +153,44 @@ void InsertCandidates(SerializedDictionary::const_iterator begin,
   }
 }
 
+// A random emoticon is suggested for this key.
+constexpr absl::string_view kRandomEmoticonKey = "ふくわらい";
+
+// Emoticons looked up for each conversion segment.
+class PreparedEmoticon : public RewriterInterface::PreparedRewrite {
+ public:
+  struct SegmentEntries {
+    std::vector<SerializedDictionary::const_iterator> sorted_value;
+    // Passed to RewriterUtil::CalculateInsertPosition().
+    int default_insert_pos = 0;
+    size_t initial_insert_size = 0;
+    bool is_no_learning = false;
+  };
+  std::vector<SegmentEntries> segments;
+};
+
 }  // namespace
 
-bool EmoticonRewriter::RewriteCandidate(Segments *segments) const {
-  bool modified = false;
-  for (Segment &segment : segments->conversion_segments()) {
+std::unique_ptr<RewriterInterface::PreparedRewrite>
+EmoticonRewriter::PrepareRewrite(const ConversionRequest &request,
+                                 const Segments &segments) const {
+  if (!request.config().use_emoticon_conversion()) {
+    MOZC_VLOG(2) << "no use_emoticon_conversion";
+    return nullptr;
+  }
+
+  auto prepared = std::make_unique<PreparedEmoticon>();
+  prepared->segments.reserve(segments.conversion_segments_size());
+  for (const Segment &segment : segments.conversion_segments()) {
+    PreparedEmoticon::SegmentEntries &entries =
+        prepared->segments.emplace_back();
     const std::string &key = segment.key();
     if (key.empty()) {
       // This case happens for zero query suggestion.
       continue;
     }
-    bool is_no_learning = false;
     SerializedDictionary::const_iterator begin;
     SerializedDictionary::const_iterator end = dic_.end();
-    size_t initial_insert_size = 0;
-    size_t initial_insert_pos = 0;
 
     // TODO(taku): Emoticon dictionary does not always include "facemark".
     // Displaying non-facemarks with "かおもじ" is not always correct.
@@ -173,46 +203,68 @@ bool EmoticonRewriter::RewriteCandidate(Segments *segments) const {
       CHECK(begin != dic_.end());
       end = dic_.end();
       // set large value(100) so that all candidates are pushed to the bottom
-      initial_insert_pos = RewriterUtil::CalculateInsertPosition(segment, 100);
-      initial_insert_size = dic_.size();
+      entries.default_insert_pos = 100;
+      entries.initial_insert_size = dic_.size();
     } else if (key == "かお") {
       // When key is "かお", expand all candidates in conservative way.
       begin = dic_.begin();
       CHECK(begin != dic_.end());
       // first 6 candidates are inserted at 4 th position.
       // Other candidates are pushed to the buttom.
-      initial_insert_pos = RewriterUtil::CalculateInsertPosition(segment, 4);
-      initial_insert_size = 6;
-    } else if (key == "ふくわらい") {
+      entries.default_insert_pos = 4;
+      entries.initial_insert_size = 6;
+    } else if (key == kRandomEmoticonKey) {
       // Choose one emoticon randomly from the dictionary.
       // TODO(taku): want to make it "generate" more funny emoticon.
       begin = dic_.begin();
       CHECK(begin != dic_.end());
       // use secure random not to predict the next emoticon.
-      begin += absl::Uniform(bitgen_, 0u, dic_.size());
+      // PrepareRewrite() may run concurrently, so the generator is local.
+      absl::BitGen bitgen;
+      begin += absl::Uniform(bitgen, 0u, dic_.size());
       end = begin + 1;
-      initial_insert_pos = RewriterUtil::CalculateInsertPosition(segment, 4);
-      initial_insert_size = 1;
-      is_no_learning = true;  // do not learn this candidate.
+      entries.default_insert_pos = 4;
+      entries.initial_insert_size = 1;
+      entries.is_no_learning = true;  // do not learn this candidate.
     } else {
       const auto range = dic_.equal_range(key);
       begin = range.first;
       end = range.second;
       if (begin != end) {
-        initial_insert_pos = RewriterUtil::CalculateInsertPosition(segment, 6);
-        initial_insert_size = std::distance(begin, end);
+        entries.default_insert_pos = 6;
+        entries.initial_insert_size = std::distance(begin, end);
       }
     }
 
     if (begin == end) {
       continue;
     }
+    entries.sorted_value = SortValues(begin, end);
+  }
+  return prepared;
+}
+
+bool EmoticonRewriter::ApplyRewrite(const ConversionRequest &request,
+                                    const PreparedRewrite &prepared,
+                                    Segments *segments) const {
+  const PreparedEmoticon &emoticon =
+      static_cast<const PreparedEmoticon &>(prepared);
+  DCHECK_EQ(emoticon.segments.size(), segments->conversion_segments_size());
 
-    InsertCandidates(begin, end, initial_insert_pos, initial_insert_size,
-                     is_no_learning, &segment);
+  bool modified = false;
+  for (size_t i = 0; i < emoticon.segments.size(); ++i) {
+    const PreparedEmoticon::SegmentEntries &entries = emoticon.segments[i];
+    if (entries.sorted_value.empty()) {
+      continue;
+    }
+    Segment *segment = segments->mutable_conversion_segment(i);
+    const size_t initial_insert_pos = RewriterUtil::CalculateInsertPosition(
+        *segment, entries.default_insert_pos);
+    InsertCandidates(entries.sorted_value, initial_insert_pos,
+                     entries.initial_insert_size, entries.is_no_learning,
+                     segment);
     modified = true;
   }
-
   return modified;
 }
 
@@ -220,13 +272,15 @@ std::unique_ptr<EmoticonRewriter> EmoticonRewriter::CreateFromDataManager(
     const DataManager &data_manager) {
   absl::string_view token_array_data, string_array_data;
   data_manager.GetEmoticonRewriterData(&token_array_data, &string_array_data);
-  return std::make_unique<EmoticonRewriter>(token_array_data,
-                                            string_array_data);
+  return std::make_unique<EmoticonRewriter>(
+      token_array_data, string_array_data,
+      data_manager.GetEmoticonRewriterKeyIndexData());
 }
 
 EmoticonRewriter::EmoticonRewriter(absl::string_view token_array_data,
-                                   absl::string_view string_array_data)
-    : dic_(token_array_data, string_array_data) {}
+                                   absl::string_view string_array_data,
+                                   absl::string_view key_index_data)
+    : dic_(token_array_data, string_array_data, key_index_data) {}
 
 int EmoticonRewriter::capability(const ConversionRequest &request) const {
   if (request.request().mixed_conversion()) {
@@ -237,10 +291,21 @@ int EmoticonRewriter::capability(const ConversionRequest &request) const {
 
 bool EmoticonRewriter::Rewrite(const ConversionRequest &request,
                                Segments *segments) const {
-  if (!request.config().use_emoticon_conversion()) {
-    MOZC_VLOG(2) << "no use_emoticon_conversion";
+  const std::unique_ptr<PreparedRewrite> prepared =
+      PrepareRewrite(request, *segments);
+  if (prepared == nullptr) {
     return false;
   }
-  return RewriteCandidate(segments);
+  return ApplyRewrite(request, *prepared, segments);
+}
+
+bool EmoticonRewriter::IsDeterministic(const ConversionRequest &request,
+                                       const Segments &segments) const {
+  for (const Segment &segment : segments.conversion_segments()) {
+    if (segment.key() == kRandomEmoticonKey) {
+      return false;
+    }
+  }
+  return true;
 }
 }  // namespace mozc
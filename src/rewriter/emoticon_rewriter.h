@@ -32,7 +32,6 @@
 
 #include <memory>
 
-#include "absl/random/random.h"
 #include "absl/strings/string_view.h"
 #include "converter/segments.h"
 #include "data_manager/data_manager.h"
@@ -47,19 +46,32 @@ class EmoticonRewriter : public RewriterInterface {
   static std::unique_ptr<EmoticonRewriter> CreateFromDataManager(
       const DataManager &data_manager);
 
+  // `key_index_data` is the optional key index of the dictionary.  See
+  // SerializedDictionary.
   EmoticonRewriter(absl::string_view token_array_data,
-                   absl::string_view string_array_data);
+                   absl::string_view string_array_data,
+                   absl::string_view key_index_data = "");
 
   int capability(const ConversionRequest &request) const override;
 
   bool Rewrite(const ConversionRequest &request,
                Segments *segments) const override;
 
- private:
-  bool RewriteCandidate(Segments *segments) const;
+  // The emoticon for "ふくわらい" is chosen randomly.
+  bool IsDeterministic(const ConversionRequest &request,
+                       const Segments &segments) const override;
+
+  // Emoticon lookups only depend on the segment keys.
+  bool SupportsPrepareRewrite() const override { return true; }
+  std::unique_ptr<PreparedRewrite> PrepareRewrite(
+      const ConversionRequest &request,
+      const Segments &segments) const override;
+  bool ApplyRewrite(const ConversionRequest &request,
+                    const PreparedRewrite &prepared,
+                    Segments *segments) const override;
 
+ private:
   SerializedDictionary dic_;
-  mutable absl::BitGen bitgen_;
 };
 
 }  // namespace mozc
@@ -164,6 +164,11 @@ class TestDataManager : public testing::MockDataManager {
     *string_array_data = string_array_data_;
   }
 
+  // The test data has no key index.
+  absl::string_view GetEmojiRewriterKeyIndexData() const override {
+    return "";
+  }
+
  private:
   std::vector<uint32_t> token_array_;
   absl::string_view string_array_data_;
@@ -34,19 +34,25 @@
 #include <iterator>
 #include <string>
 
+#include "absl/base/thread_annotations.h"
 #include "absl/log/check.h"
 #include "absl/log/log.h"
 #include "absl/random/random.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
 #include "absl/time/civil_time.h"
 #include "absl/time/time.h"
 #include "base/clock.h"
 #include "base/singleton.h"
 #include "converter/segments.h"
 #include "request/conversion_request.h"
+#include "rewriter/rewriter_interface.h"
 
 namespace mozc {
 namespace {
 
+constexpr absl::string_view kTriggerKey = "おみくじ";
+
 enum FortuneType {
   FORTUNE_TYPE_EXCELLENT_LUCK = 0,
   FORTUNE_TYPE_LUCK = 1,
@@ -67,13 +73,24 @@ bool IsValidFortuneType(FortuneType fortune_type) {
   return (fortune_type < NUM_FORTUNE_TYPES);
 }
 
+// The fortune of the day. Rewrite() runs concurrently for different
+// sessions, so the fortune is updated under the mutex.
 class FortuneData {
  public:
-  FortuneData() : fortune_type_(FORTUNE_TYPE_EXCELLENT_LUCK) {
+  FortuneData() {
+    absl::MutexLock l(&mutex_);
     ChangeFortune();
   }
 
-  void ChangeFortune() {
+  // Returns the fortune of today, which is changed once per day.
+  FortuneType GetFortune() {
+    absl::MutexLock l(&mutex_);
+    ChangeFortune();
+    return fortune_type_;
+  }
+
+ private:
+  void ChangeFortune() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
     const int *levels = kNormalLevels;
 
     const absl::Time at = Clock::GetAbslTime();
@@ -107,12 +124,11 @@ class FortuneData {
     DCHECK(IsValidFortuneType(fortune_type_));
   }
 
-  FortuneType fortune_type() const { return fortune_type_; }
-
- private:
-  FortuneType fortune_type_;
-  absl::CivilDay last_updated_day_;
-  absl::BitGen gen_;
+  absl::Mutex mutex_;
+  FortuneType fortune_type_ ABSL_GUARDED_BY(mutex_) =
+      FORTUNE_TYPE_EXCELLENT_LUCK;
+  absl::CivilDay last_updated_day_ ABSL_GUARDED_BY(mutex_);
+  absl::BitGen gen_ ABSL_GUARDED_BY(mutex_);
 };
 
 // Insert Fortune message into the |segment|
@@ -178,6 +194,10 @@ FortuneRewriter::FortuneRewriter() = default;
 
 FortuneRewriter::~FortuneRewriter() = default;
 
+RewriterInterface::Trigger FortuneRewriter::trigger() const {
+  return {.single_segment_only = true, .keys = {std::string(kTriggerKey)}};
+}
+
 bool FortuneRewriter::Rewrite(const ConversionRequest &request,
                               Segments *segments) const {
   if (segments->conversion_segments_size() != 1) {
@@ -191,13 +211,11 @@ bool FortuneRewriter::Rewrite(const ConversionRequest &request,
     return false;
   }
 
-  if (key != "おみくじ") {
+  if (key != kTriggerKey) {
     return false;
   }
-  FortuneData *fortune_data = Singleton<FortuneData>::get();
-  fortune_data->ChangeFortune();
   // Insert a fortune candidate into the last of all candidates.
-  return InsertCandidate(fortune_data->fortune_type(),
+  return InsertCandidate(Singleton<FortuneData>::get()->GetFortune(),
                          segment.candidates_size(),
                          segments->mutable_conversion_segment(0));
 }
@@ -42,6 +42,8 @@ class FortuneRewriter : public RewriterInterface {
   FortuneRewriter();
   ~FortuneRewriter() override;
 
+  Trigger trigger() const override;
+
   bool Rewrite(const ConversionRequest &request,
                Segments *segments) const override;
 };
@@ -31,9 +31,13 @@
 
 #include <cstddef>
 #include <string>
+#include <vector>
 
 #include "absl/log/check.h"
 #include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+#include "base/clock_mock.h"
+#include "base/thread.h"
 #include "converter/segments.h"
 #include "request/conversion_request.h"
 #include "testing/gunit.h"
@@ -85,5 +89,34 @@ TEST_F(FortuneRewriterTest, BasicTest) {
   EXPECT_TRUE(HasFortune(segments));
 }
 
+TEST_F(FortuneRewriterTest, ConcurrentRewrite) {
+  ScopedClockMock clock(absl::FromUnixSeconds(1700000000));
+  const FortuneRewriter fortune_rewriter;
+  const ConversionRequest request;
+
+  // The sessions rewrite in parallel, and see the same fortune of the day.
+  constexpr int kNumThreads = 4;
+  std::vector<std::string> fortunes(kNumThreads);
+  std::vector<Thread> threads;
+  for (int i = 0; i < kNumThreads; ++i) {
+    threads.emplace_back([&fortune_rewriter, &request,
+                          &fortune = fortunes[i]] {
+      for (int j = 0; j < 100; ++j) {
+        Segments segments;
+        AddSegment("おみくじ", "test", &segments);
+        ASSERT_TRUE(fortune_rewriter.Rewrite(request, &segments));
+        const Segment &segment = segments.segment(0);
+        fortune = segment.candidate(segment.candidates_size() - 1).value;
+      }
+    });
+  }
+  for (Thread &thread : threads) {
+    thread.Join();
+  }
+  for (const std::string &fortune : fortunes) {
+    EXPECT_EQ(fortune, fortunes[0]);
+  }
+}
+
 }  // namespace
 }  // namespace mozc
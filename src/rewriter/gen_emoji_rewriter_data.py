@@ -58,6 +58,7 @@ import struct
 import sys
 
 from build_tools import code_generator_util
+from build_tools import serialized_key_index_builder
 from build_tools import serialized_string_array_builder
 
 
@@ -127,8 +128,8 @@ def ReadEmojiTsv(stream):
 
 
 def OutputData(emoji_data_list, token_dict,
-               token_array_file, string_array_file):
-  """Output token and string arrays to files."""
+               token_array_file, string_array_file, key_index_file=None):
+  """Output token and string arrays, and optionally key index, to files."""
   sorted_token_dict = sorted(token_dict.items())
 
   strings = {}
@@ -162,6 +163,15 @@ def OutputData(emoji_data_list, token_dict,
   serialized_string_array_builder.SerializeToFile(sorted_strings,
                                                   string_array_file)
 
+  if key_index_file:
+    # Maps each reading to its range of tokens in the token array above.
+    entries = []
+    begin = 0
+    for reading, value_list in sorted_token_dict:
+      entries.append((reading, begin, begin + len(value_list)))
+      begin += len(value_list)
+    serialized_key_index_builder.SerializeToFile(entries, key_index_file)
+
 
 def ParseOptions() -> argparse.Namespace:
   """Parse given options.
@@ -179,6 +189,10 @@ def ParseOptions() -> argparse.Namespace:
       '--output_string_array',
       dest='output_string_array',
       help='output string array file')
+  parser.add_argument(
+      '--output_key_index',
+      dest='output_key_index',
+      help='output key index file')
   return parser.parse_args()
 
 
@@ -188,7 +202,8 @@ def main():
     (emoji_data_list, token_dict) = ReadEmojiTsv(input_stream)
 
   OutputData(emoji_data_list, token_dict,
-             options.output_token_array, options.output_string_array)
+             options.output_token_array, options.output_string_array,
+             options.output_key_index)
 
 
 if __name__ == '__main__':
@@ -0,0 +1,371 @@
+// Copyright 2010-2021, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "rewriter/merger_rewriter.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/functional/function_ref.h"
+#include "absl/log/check.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "base/stopwatch.h"
+#include "base/thread.h"
+#include "base/trace.h"
+#include "converter/segments.h"
+#include "protocol/commands.pb.h"
+#include "protocol/config.pb.h"
+#include "request/conversion_request.h"
+#include "rewriter/rewriter_interface.h"
+
+namespace mozc {
+namespace {
+
+RewriterInterface::CapabilityType GetCapabilityType(
+    const ConversionRequest &request) {
+  switch (request.request_type()) {
+    case ConversionRequest::CONVERSION:
+      return RewriterInterface::CONVERSION;
+    case ConversionRequest::PREDICTION:
+    case ConversionRequest::PARTIAL_PREDICTION:
+      return RewriterInterface::PREDICTION;
+    case ConversionRequest::SUGGESTION:
+    case ConversionRequest::PARTIAL_SUGGESTION:
+      return RewriterInterface::SUGGESTION;
+    case ConversionRequest::REVERSE_CONVERSION:
+    default:
+      return RewriterInterface::NOT_AVAILABLE;
+  }
+}
+
+std::vector<std::string> GetConversionKeys(const Segments &segments) {
+  std::vector<std::string> keys;
+  keys.reserve(segments.conversion_segments_size());
+  for (const Segment &segment : segments.conversion_segments()) {
+    keys.push_back(segment.key());
+  }
+  return keys;
+}
+
+// Returns true if the keys of the conversion segments are `keys`.
+bool HasConversionKeys(const Segments &segments,
+                       const std::vector<std::string> &keys) {
+  if (segments.conversion_segments_size() != keys.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < keys.size(); ++i) {
+    if (segments.conversion_segment(i).key() != keys[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+// Small fixed-size thread pool for PrepareRewrite(). The calling thread takes
+// part in running the tasks, so a batch completes even when all the workers
+// are busy with batches of other sessions.
+class MergerRewriter::PrepareThreadPool {
+ public:
+  explicit PrepareThreadPool(int num_threads) {
+    threads_.reserve(num_threads);
+    for (int i = 0; i < num_threads; ++i) {
+      threads_.emplace_back([this] { WorkerLoop(); });
+    }
+  }
+
+  PrepareThreadPool(const PrepareThreadPool &) = delete;
+  PrepareThreadPool &operator=(const PrepareThreadPool &) = delete;
+
+  ~PrepareThreadPool() {
+    {
+      absl::MutexLock lock(&mutex_);
+      terminating_ = true;
+    }
+    for (Thread &thread : threads_) {
+      thread.Join();
+    }
+  }
+
+  // Calls task(0), ..., task(size - 1) and returns when all of them are done.
+  void ParallelFor(size_t size, absl::FunctionRef<void(size_t)> task) {
+    auto batch = std::make_shared<Batch>(size, task);
+    {
+      absl::MutexLock lock(&mutex_);
+      const size_t num_helpers = std::min(size - 1, threads_.size());
+      for (size_t i = 0; i < num_helpers; ++i) {
+        pending_.push_back(batch);
+      }
+    }
+    batch->Work();
+
+    Batch &b = *batch;
+    const auto done = [&b]() ABSL_EXCLUSIVE_LOCKS_REQUIRED(b.mutex) {
+      return b.num_done == b.size;
+    };
+    absl::MutexLock lock(&b.mutex);
+    b.mutex.Await(absl::Condition(&done));
+  }
+
+ private:
+  struct Batch {
+    Batch(size_t size, absl::FunctionRef<void(size_t)> task)
+        : size(size), task(task) {}
+
+    // Runs the tasks not started yet. `task` is not called once all the tasks
+    // are started, so stale batches left in the queue are harmless.
+    void Work() {
+      for (size_t i = next.fetch_add(1); i < size; i = next.fetch_add(1)) {
+        task(i);
+        absl::MutexLock lock(&mutex);
+        ++num_done;
+      }
+    }
+
+    const size_t size;
+    const absl::FunctionRef<void(size_t)> task;
+    std::atomic<size_t> next = 0;
+    absl::Mutex mutex;
+    size_t num_done ABSL_GUARDED_BY(mutex) = 0;
+  };
+
+  void WorkerLoop() {
+    const auto has_task = [this]() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
+      return terminating_ || !pending_.empty();
+    };
+    while (true) {
+      std::shared_ptr<Batch> batch;
+      {
+        absl::MutexLock lock(&mutex_);
+        mutex_.Await(absl::Condition(&has_task));
+        if (terminating_) {
+          return;
+        }
+        batch = std::move(pending_.front());
+        pending_.pop_front();
+      }
+      batch->Work();
+    }
+  }
+
+  std::vector<Thread> threads_;
+  absl::Mutex mutex_;
+  std::deque<std::shared_ptr<Batch>> pending_ ABSL_GUARDED_BY(mutex_);
+  bool terminating_ ABSL_GUARDED_BY(mutex_) = false;
+};
+
+MergerRewriter::MergerRewriter() = default;
+
+MergerRewriter::MergerRewriter(int num_prepare_threads) {
+  if (num_prepare_threads > 0) {
+    prepare_pool_ = std::make_unique<PrepareThreadPool>(num_prepare_threads);
+  }
+}
+
+MergerRewriter::~MergerRewriter() = default;
+
+void MergerRewriter::AddRewriter(std::unique_ptr<RewriterInterface> rewriter,
+                                 absl::string_view name) {
+  DCHECK(rewriter);
+  const RewriterInterface::Trigger trigger = rewriter->trigger();
+  const size_t index = rewriters_.size();
+  auto dispatch = std::make_unique<Dispatch>();
+  dispatch->name = std::string(name);
+  dispatch->single_segment_only = trigger.single_segment_only;
+  dispatch->has_key_trigger = !trigger.keys.empty();
+  dispatch->supports_prepare = rewriter->SupportsPrepareRewrite();
+  for (const std::string &key : trigger.keys) {
+    key_triggers_[key].push_back(index);
+  }
+  rewriters_.push_back(std::move(rewriter));
+  dispatches_.push_back(std::move(dispatch));
+}
+
+std::vector<bool> MergerRewriter::GetKeyTriggeredRewriters(
+    const Segments &segments) const {
+  std::vector<bool> triggered(rewriters_.size(), false);
+  if (key_triggers_.empty()) {
+    return triggered;
+  }
+  // A single lookup per segment covers the triggers of all the rewriters.
+  for (const Segment &segment : segments.conversion_segments()) {
+    const auto it = key_triggers_.find(segment.key());
+    if (it == key_triggers_.end()) {
+      continue;
+    }
+    for (const size_t index : it->second) {
+      triggered[index] = true;
+    }
+  }
+  return triggered;
+}
+
+std::vector<std::unique_ptr<RewriterInterface::PreparedRewrite>>
+MergerRewriter::PrepareRewriters(const ConversionRequest &request,
+                                 const Segments &segments,
+                                 const std::vector<bool> &runnable) const {
+  std::vector<std::unique_ptr<PreparedRewrite>> prepared;
+  if (prepare_pool_ == nullptr) {
+    return prepared;
+  }
+  std::vector<size_t> indices;
+  for (size_t i = 0; i < rewriters_.size(); ++i) {
+    if (runnable[i] && dispatches_[i]->supports_prepare) {
+      indices.push_back(i);
+    }
+  }
+  // A single lookup gains nothing from the thread pool.
+  if (indices.size() < 2) {
+    return prepared;
+  }
+
+  prepared.resize(rewriters_.size());
+  prepare_pool_->ParallelFor(indices.size(), [&](size_t task) {
+    const size_t index = indices[task];
+    const Stopwatch stopwatch = Stopwatch::StartNew();
+    prepared[index] = rewriters_[index]->PrepareRewrite(request, segments);
+    dispatches_[index]->total_time_ns.fetch_add(
+        absl::ToInt64Nanoseconds(stopwatch.GetElapsed()),
+        std::memory_order_relaxed);
+  });
+  return prepared;
+}
+
+bool MergerRewriter::Rewrite(const ConversionRequest &request,
+                             Segments *segments) const {
+  ScopedTraceSpan span("MergerRewriter::Rewrite");
+  if (segments == nullptr) {
+    return false;
+  }
+
+  const CapabilityType capability_type = GetCapabilityType(request);
+  std::vector<bool> capable(rewriters_.size(), false);
+  for (size_t i = 0; i < rewriters_.size(); ++i) {
+    capable[i] = rewriters_[i]->capability(request) & capability_type;
+  }
+
+  // The triggers are evaluated against `keys`, the keys of the conversion
+  // segments. Some rewriters reset the key of a segment or change the number
+  // of the segments, in which case the triggers are evaluated again for the
+  // following rewriters.
+  std::vector<std::string> keys = GetConversionKeys(*segments);
+  std::vector<bool> key_triggered = GetKeyTriggeredRewriters(*segments);
+  const auto is_triggered = [&](size_t i) {
+    const Dispatch &dispatch = *dispatches_[i];
+    return !(dispatch.single_segment_only && keys.size() != 1) &&
+           !(dispatch.has_key_trigger && !key_triggered[i]);
+  };
+
+  std::vector<bool> runnable(rewriters_.size(), false);
+  for (size_t i = 0; i < rewriters_.size(); ++i) {
+    runnable[i] = capable[i] && is_triggered(i);
+  }
+  // The prepared buffers are valid only while the keys stay the same.
+  std::vector<std::unique_ptr<PreparedRewrite>> prepared =
+      PrepareRewriters(request, *segments, runnable);
+  bool keys_changed = false;
+
+  bool is_updated = false;
+  for (size_t i = 0; i < rewriters_.size(); ++i) {
+    if (!capable[i]) {
+      continue;
+    }
+    if (!HasConversionKeys(*segments, keys)) {
+      keys = GetConversionKeys(*segments);
+      key_triggered = GetKeyTriggeredRewriters(*segments);
+      keys_changed = true;
+    }
+    Dispatch &dispatch = *dispatches_[i];
+    if (!is_triggered(i)) {
+      dispatch.num_skipped.fetch_add(1, std::memory_order_relaxed);
+      continue;
+    }
+    const RewriterInterface &rewriter = *rewriters_[i];
+    const Stopwatch stopwatch = Stopwatch::StartNew();
+    if (!keys_changed && !prepared.empty() && prepared[i] != nullptr) {
+      is_updated |= rewriter.ApplyRewrite(request, *prepared[i], segments);
+    } else {
+      is_updated |= rewriter.Rewrite(request, segments);
+    }
+    dispatch.num_calls.fetch_add(1, std::memory_order_relaxed);
+    dispatch.total_time_ns.fetch_add(
+        absl::ToInt64Nanoseconds(stopwatch.GetElapsed()),
+        std::memory_order_relaxed);
+  }
+
+  if (request.request_type() == ConversionRequest::SUGGESTION &&
+      segments->conversion_segments_size() == 1 &&
+      !request.request().mixed_conversion()) {
+    const size_t max_suggestions = request.config().suggestions_size();
+    Segment *segment = segments->mutable_conversion_segment(0);
+    const size_t candidate_size = segment->candidates_size();
+    if (candidate_size > max_suggestions) {
+      segment->erase_candidates(max_suggestions,
+                                candidate_size - max_suggestions);
+    }
+  }
+  return is_updated;
+}
+
+std::vector<MergerRewriter::RewriterStats> MergerRewriter::GetRewriterStats()
+    const {
+  std::vector<RewriterStats> stats;
+  stats.reserve(dispatches_.size());
+  for (const std::unique_ptr<Dispatch> &dispatch : dispatches_) {
+    stats.push_back({
+        .name = dispatch->name,
+        .num_calls = dispatch->num_calls.load(std::memory_order_relaxed),
+        .num_skipped = dispatch->num_skipped.load(std::memory_order_relaxed),
+        .total_time = absl::Nanoseconds(
+            dispatch->total_time_ns.load(std::memory_order_relaxed)),
+    });
+  }
+  return stats;
+}
+
+void MergerRewriter::ResetRewriterStats() {
+  for (const std::unique_ptr<Dispatch> &dispatch : dispatches_) {
+    dispatch->num_calls = 0;
+    dispatch->num_skipped = 0;
+    dispatch->total_time_ns = 0;
+  }
+}
+
+}  // namespace mozc
@@ -30,16 +30,18 @@
 #ifndef MOZC_REWRITER_MERGER_REWRITER_H_
 #define MOZC_REWRITER_MERGER_REWRITER_H_
 
+#include <atomic>
 #include <cstddef>
+#include <cstdint>
 #include <memory>
 #include <optional>
-#include <utility>
+#include <string>
 #include <vector>
 
-#include "absl/log/check.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
 #include "converter/segments.h"
-#include "protocol/commands.pb.h"
-#include "protocol/config.pb.h"
 #include "request/conversion_request.h"
 #include "rewriter/rewriter_interface.h"
 
@@ -47,16 +49,36 @@ namespace mozc {
 
 class MergerRewriter : public RewriterInterface {
  public:
-  MergerRewriter() = default;
-  ~MergerRewriter() override = default;
+  MergerRewriter();
+  // If `num_prepare_threads` > 0, PrepareRewrite() of the sub rewriters
+  // supporting it runs concurrently on that many background threads, before
+  // the rewriters are applied in order. See RewriterInterface for details.
+  explicit MergerRewriter(int num_prepare_threads);
+  ~MergerRewriter() override;
 
   MergerRewriter(const MergerRewriter &) = delete;
   MergerRewriter &operator=(const MergerRewriter &) = delete;
 
-  void AddRewriter(std::unique_ptr<RewriterInterface> rewriter) {
-    DCHECK(rewriter);
-    rewriters_.push_back(std::move(rewriter));
-  }
+  // Cumulative statistics of a sub rewriter.
+  struct RewriterStats {
+    // The name given to AddRewriter().
+    std::string name;
+    // Number of Rewrite() or ApplyRewrite() calls.
+    uint64_t num_calls = 0;
+    // Number of requests skipped by the trigger of the rewriter.
+    uint64_t num_skipped = 0;
+    // Total time spent in Rewrite(), PrepareRewrite() and ApplyRewrite().
+    absl::Duration total_time = absl::ZeroDuration();
+  };
+
+  // Adds `rewriter` to the end of the rewriters. `name` is used only for
+  // GetRewriterStats().
+  void AddRewriter(std::unique_ptr<RewriterInterface> rewriter,
+                   absl::string_view name = "");
+
+  // Returns the statistics of the rewriters in the order of AddRewriter().
+  std::vector<RewriterStats> GetRewriterStats() const;
+  void ResetRewriterStats();
 
   std::optional<ResizeSegmentsRequest> CheckResizeSegmentsRequest(
       const ConversionRequest &request, const Segments &segments) const {
@@ -75,46 +97,16 @@ class MergerRewriter : public RewriterInterface {
   }
 
   bool Rewrite(const ConversionRequest &request,
-               Segments *segments) const override {
-    if (segments == nullptr) {
-      return false;
-    }
-
-    const CapabilityType capability_type = [&request]() {
-      switch (request.request_type()) {
-        case ConversionRequest::CONVERSION:
-          return RewriterInterface::CONVERSION;
-        case ConversionRequest::PREDICTION:
-        case ConversionRequest::PARTIAL_PREDICTION:
-          return RewriterInterface::PREDICTION;
-        case ConversionRequest::SUGGESTION:
-        case ConversionRequest::PARTIAL_SUGGESTION:
-          return RewriterInterface::SUGGESTION;
-        case ConversionRequest::REVERSE_CONVERSION:
-        default:
-          return RewriterInterface::NOT_AVAILABLE;
-      }
-    }();
+               Segments *segments) const override;
 
-    bool is_updated = false;
+  bool IsDeterministic(const ConversionRequest &request,
+                       const Segments &segments) const override {
     for (const std::unique_ptr<RewriterInterface> &rewriter : rewriters_) {
-      if (rewriter->capability(request) & capability_type) {
-        is_updated |= rewriter->Rewrite(request, segments);
+      if (!rewriter->IsDeterministic(request, segments)) {
+        return false;
       }
     }
-
-    if (request.request_type() == ConversionRequest::SUGGESTION &&
-        segments->conversion_segments_size() == 1 &&
-        !request.request().mixed_conversion()) {
-      const size_t max_suggestions = request.config().suggestions_size();
-      Segment *segment = segments->mutable_conversion_segment(0);
-      const size_t candidate_size = segment->candidates_size();
-      if (candidate_size > max_suggestions) {
-        segment->erase_candidates(max_suggestions,
-                                  candidate_size - max_suggestions);
-      }
-    }
-    return is_updated;
+    return true;
   }
 
   // This method is mainly called when user puts SPACE key
@@ -180,7 +172,36 @@ class MergerRewriter : public RewriterInterface {
   }
 
  private:
+  // Dispatch information of a sub rewriter, computed from its trigger.
+  struct Dispatch {
+    std::string name;
+    bool single_segment_only = false;
+    bool has_key_trigger = false;
+    bool supports_prepare = false;
+    // Counters for RewriterStats. Atomic as Rewrite() is a const method.
+    std::atomic<uint64_t> num_calls = 0;
+    std::atomic<uint64_t> num_skipped = 0;
+    std::atomic<int64_t> total_time_ns = 0;
+  };
+
+  class PrepareThreadPool;
+
+  // Returns the mask of the rewriters triggered by the keys of `segments`.
+  std::vector<bool> GetKeyTriggeredRewriters(const Segments &segments) const;
+
+  // Runs PrepareRewrite() of the `runnable` rewriters supporting it on the
+  // thread pool. Returns the buffers indexed by rewriter, or an empty vector if
+  // there are fewer than two such rewriters.
+  std::vector<std::unique_ptr<PreparedRewrite>> PrepareRewriters(
+      const ConversionRequest &request, const Segments &segments,
+      const std::vector<bool> &runnable) const;
+
   std::vector<std::unique_ptr<RewriterInterface>> rewriters_;
+  // dispatches_[i] is for rewriters_[i].
+  std::vector<std::unique_ptr<Dispatch>> dispatches_;
+  // Map from a trigger key to the indices of the rewriters triggered by it.
+  absl::flat_hash_map<std::string, std::vector<size_t>> key_triggers_;
+  std::unique_ptr<PrepareThreadPool> prepare_pool_;
 };
 
 }  // namespace mozc
@@ -29,15 +29,24 @@
 
 #include "rewriter/merger_rewriter.h"
 
+#include <atomic>
 #include <cstddef>
 #include <memory>
 #include <string>
+#include <utility>
+#include <vector>
 
+#include "absl/memory/memory.h"
 #include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+#include "config/config_handler.h"
 #include "converter/segments.h"
+#include "data_manager/testing/mock_data_manager.h"
 #include "protocol/commands.pb.h"
 #include "protocol/config.pb.h"
 #include "request/conversion_request.h"
+#include "rewriter/emoji_rewriter.h"
+#include "rewriter/emoticon_rewriter.h"
 #include "rewriter/rewriter_interface.h"
 #include "testing/gunit.h"
 #include "testing/mozctest.h"
@@ -75,6 +84,10 @@ class TestRewriter : public RewriterInterface {
     return capability_;
   }
 
+  void set_trigger(Trigger trigger) { trigger_ = std::move(trigger); }
+
+  Trigger trigger() const override { return trigger_; }
+
   bool Focus(Segments *segments, size_t segment_index,
              int candidate_index) const override {
     buffer_->append(name_ + ".Focus();");
@@ -101,11 +114,98 @@ class TestRewriter : public RewriterInterface {
 
   void Clear() override { buffer_->append(name_ + ".Clear();"); }
 
- private:
+ protected:
   std::string *buffer_;
   const std::string name_;
   const bool return_value_;
+
+ private:
   int capability_;
+  Trigger trigger_;
+};
+
+// TestRewriter supporting PrepareRewrite(). PrepareRewrite() may run on a
+// background thread, so it only counts the calls.
+class PrepareTestRewriter : public TestRewriter {
+ public:
+  using TestRewriter::TestRewriter;
+
+  bool SupportsPrepareRewrite() const override { return true; }
+
+  std::unique_ptr<PreparedRewrite> PrepareRewrite(
+      const ConversionRequest &request,
+      const Segments &segments) const override {
+    ++num_prepared_;
+    return std::make_unique<PreparedRewrite>();
+  }
+
+  bool ApplyRewrite(const ConversionRequest &request,
+                    const PreparedRewrite &prepared,
+                    Segments *segments) const override {
+    buffer_->append(name_ + ".ApplyRewrite();");
+    return return_value_;
+  }
+
+  int num_prepared() const { return num_prepared_; }
+
+ private:
+  mutable std::atomic<int> num_prepared_ = 0;
+};
+
+// Resets the key of the first conversion segment, like UnicodeRewriter.
+class KeyResetRewriter : public TestRewriter {
+ public:
+  KeyResetRewriter(std::string *buffer, const absl::string_view name,
+                   const absl::string_view key)
+      : TestRewriter(buffer, name, true), key_(key) {}
+
+  bool Rewrite(const ConversionRequest &request,
+               Segments *segments) const override {
+    segments->mutable_conversion_segment(0)->set_key(key_);
+    return TestRewriter::Rewrite(request, segments);
+  }
+
+ private:
+  const std::string key_;
+};
+
+// Merges all the conversion segments into the first one.
+class MergeSegmentsRewriter : public TestRewriter {
+ public:
+  MergeSegmentsRewriter(std::string *buffer, const absl::string_view name)
+      : TestRewriter(buffer, name, true) {}
+
+  bool Rewrite(const ConversionRequest &request,
+               Segments *segments) const override {
+    std::string key;
+    for (const Segment &segment : segments->conversion_segments()) {
+      key.append(segment.key());
+    }
+    segments->erase_segments(1, segments->conversion_segments_size() - 1);
+    segments->mutable_conversion_segment(0)->set_key(key);
+    return TestRewriter::Rewrite(request, segments);
+  }
+};
+
+// Adds a candidate to the top of each conversion segment, so that the
+// candidates differ from those seen by PrepareRewrite().
+class AddCandidateRewriter : public TestRewriter {
+ public:
+  AddCandidateRewriter(std::string *buffer, const absl::string_view name)
+      : TestRewriter(buffer, name, true) {}
+
+  bool Rewrite(const ConversionRequest &request,
+               Segments *segments) const override {
+    for (Segment &segment : segments->conversion_segments()) {
+      Segment::Candidate *candidate = segment.push_front_candidate();
+      candidate->key = segment.key();
+      candidate->content_key = segment.key();
+      candidate->value = name_;
+      candidate->content_value = name_;
+      candidate->cost = 100;
+    }
+    return TestRewriter::Rewrite(request, segments);
+  }
 };
 
 class MergerRewriterTest : public testing::TestWithTempUserProfile {};
@@ -264,6 +364,243 @@ TEST_F(MergerRewriterTest, RewriteCheckTest) {
   call_result.clear();
 }
 
+TEST_F(MergerRewriterTest, RewriteWithTrigger) {
+  std::string call_result;
+  MergerRewriter merger;
+  merger.AddRewriter(std::make_unique<TestRewriter>(&call_result, "a", false));
+  auto single = std::make_unique<TestRewriter>(&call_result, "b", false);
+  single->set_trigger({.single_segment_only = true});
+  merger.AddRewriter(std::move(single));
+  auto keyed = std::make_unique<TestRewriter>(&call_result, "c", false);
+  keyed->set_trigger({.keys = {"さいころ", "おみくじ"}});
+  merger.AddRewriter(std::move(keyed));
+  auto single_keyed = std::make_unique<TestRewriter>(&call_result, "d", false);
+  single_keyed->set_trigger({.single_segment_only = true, .keys = {"さいころ"}});
+  merger.AddRewriter(std::move(single_keyed));
+
+  const ConversionRequest request;
+  Segments segments;
+  segments.add_segment()->set_key("きょう");
+  EXPECT_FALSE(merger.Rewrite(request, &segments));
+  EXPECT_EQ(call_result,
+            "a.Rewrite();"
+            "b.Rewrite();");
+  call_result.clear();
+
+  segments.mutable_segment(0)->set_key("さいころ");
+  EXPECT_FALSE(merger.Rewrite(request, &segments));
+  EXPECT_EQ(call_result,
+            "a.Rewrite();"
+            "b.Rewrite();"
+            "c.Rewrite();"
+            "d.Rewrite();");
+  call_result.clear();
+
+  // The key trigger matches any of the conversion segments.
+  segments.add_segment()->set_key("おみくじ");
+  segments.mutable_segment(0)->set_key("きょう");
+  EXPECT_FALSE(merger.Rewrite(request, &segments));
+  EXPECT_EQ(call_result,
+            "a.Rewrite();"
+            "c.Rewrite();");
+}
+
+TEST_F(MergerRewriterTest, RewriteWithTriggerAfterSegmentsChange) {
+  std::string call_result;
+  MergerRewriter merger;
+  auto keyed = std::make_unique<TestRewriter>(&call_result, "a", false);
+  keyed->set_trigger({.keys = {"さいころ"}});
+  merger.AddRewriter(std::move(keyed));
+  merger.AddRewriter(
+      std::make_unique<MergeSegmentsRewriter>(&call_result, "b"));
+  auto single = std::make_unique<TestRewriter>(&call_result, "c", false);
+  single->set_trigger({.single_segment_only = true});
+  merger.AddRewriter(std::move(single));
+  merger.AddRewriter(
+      std::make_unique<KeyResetRewriter>(&call_result, "d", "おみくじ"));
+  keyed = std::make_unique<TestRewriter>(&call_result, "e", false);
+  keyed->set_trigger({.keys = {"おみくじ"}});
+  merger.AddRewriter(std::move(keyed));
+
+  const ConversionRequest request;
+  Segments segments;
+  segments.add_segment()->set_key("さい");
+  segments.add_segment()->set_key("ころ");
+  EXPECT_TRUE(merger.Rewrite(request, &segments));
+  // "c" and "e" are triggered by the segments rewritten by "b" and "d".
+  EXPECT_EQ(call_result,
+            "b.Rewrite();"
+            "c.Rewrite();"
+            "d.Rewrite();"
+            "e.Rewrite();");
+  ASSERT_EQ(segments.conversion_segments_size(), 1);
+  EXPECT_EQ(segments.conversion_segment(0).key(), "おみくじ");
+}
+
+TEST_F(MergerRewriterTest, RewriterStats) {
+  std::string call_result;
+  MergerRewriter merger;
+  merger.AddRewriter(std::make_unique<TestRewriter>(&call_result, "a", false),
+                     "RewriterA");
+  auto keyed = std::make_unique<TestRewriter>(&call_result, "b", false);
+  keyed->set_trigger({.keys = {"さいころ"}});
+  merger.AddRewriter(std::move(keyed), "RewriterB");
+  merger.AddRewriter(std::make_unique<TestRewriter>(
+      &call_result, "c", false, RewriterInterface::SUGGESTION));
+
+  const ConversionRequest request;
+  Segments segments;
+  segments.add_segment()->set_key("きょう");
+  EXPECT_FALSE(merger.Rewrite(request, &segments));
+  EXPECT_FALSE(merger.Rewrite(request, &segments));
+
+  std::vector<MergerRewriter::RewriterStats> stats = merger.GetRewriterStats();
+  ASSERT_EQ(stats.size(), 3);
+  EXPECT_EQ(stats[0].name, "RewriterA");
+  EXPECT_EQ(stats[0].num_calls, 2);
+  EXPECT_EQ(stats[0].num_skipped, 0);
+  EXPECT_GE(stats[0].total_time, absl::ZeroDuration());
+  EXPECT_EQ(stats[1].name, "RewriterB");
+  EXPECT_EQ(stats[1].num_calls, 0);
+  EXPECT_EQ(stats[1].num_skipped, 2);
+  EXPECT_EQ(stats[1].total_time, absl::ZeroDuration());
+  // Not counted as the capability doesn't match.
+  EXPECT_EQ(stats[2].name, "");
+  EXPECT_EQ(stats[2].num_calls, 0);
+  EXPECT_EQ(stats[2].num_skipped, 0);
+
+  merger.ResetRewriterStats();
+  stats = merger.GetRewriterStats();
+  EXPECT_EQ(stats[0].num_calls, 0);
+  EXPECT_EQ(stats[1].num_skipped, 0);
+}
+
+TEST_F(MergerRewriterTest, RewriteWithPrepare) {
+  std::string call_result;
+  MergerRewriter merger(2);
+  auto *a = new PrepareTestRewriter(&call_result, "a", false);
+  auto *c = new PrepareTestRewriter(&call_result, "c", true);
+  auto *d = new PrepareTestRewriter(&call_result, "d", false);
+  merger.AddRewriter(absl::WrapUnique(a));
+  merger.AddRewriter(std::make_unique<TestRewriter>(&call_result, "b", false));
+  merger.AddRewriter(absl::WrapUnique(c));
+  merger.AddRewriter(absl::WrapUnique(d));
+
+  const ConversionRequest request;
+  Segments segments;
+  segments.add_segment()->set_key("きょう");
+  EXPECT_TRUE(merger.Rewrite(request, &segments));
+  // The rewriters are applied in the order of AddRewriter().
+  EXPECT_EQ(call_result,
+            "a.ApplyRewrite();"
+            "b.Rewrite();"
+            "c.ApplyRewrite();"
+            "d.ApplyRewrite();");
+  EXPECT_EQ(a->num_prepared(), 1);
+  EXPECT_EQ(c->num_prepared(), 1);
+  EXPECT_EQ(d->num_prepared(), 1);
+}
+
+TEST_F(MergerRewriterTest, RewriteWithPrepareWithoutThreads) {
+  std::string call_result;
+  MergerRewriter merger;
+  auto *a = new PrepareTestRewriter(&call_result, "a", false);
+  auto *b = new PrepareTestRewriter(&call_result, "b", false);
+  merger.AddRewriter(absl::WrapUnique(a));
+  merger.AddRewriter(absl::WrapUnique(b));
+
+  const ConversionRequest request;
+  Segments segments;
+  segments.add_segment()->set_key("きょう");
+  EXPECT_FALSE(merger.Rewrite(request, &segments));
+  EXPECT_EQ(call_result,
+            "a.Rewrite();"
+            "b.Rewrite();");
+  EXPECT_EQ(a->num_prepared(), 0);
+  EXPECT_EQ(b->num_prepared(), 0);
+}
+
+TEST_F(MergerRewriterTest, RewriteWithPrepareAfterKeyChange) {
+  std::string call_result;
+  MergerRewriter merger(2);
+  merger.AddRewriter(
+      std::make_unique<PrepareTestRewriter>(&call_result, "a", false));
+  merger.AddRewriter(
+      std::make_unique<KeyResetRewriter>(&call_result, "b", "きょう"));
+  merger.AddRewriter(
+      std::make_unique<KeyResetRewriter>(&call_result, "c", "あした"));
+  merger.AddRewriter(
+      std::make_unique<PrepareTestRewriter>(&call_result, "d", false));
+
+  const ConversionRequest request;
+  Segments segments;
+  segments.add_segment()->set_key("きょう");
+  EXPECT_TRUE(merger.Rewrite(request, &segments));
+  // The buffer of "d" is prepared for the old key, so Rewrite() is called.
+  EXPECT_EQ(call_result,
+            "a.ApplyRewrite();"
+            "b.Rewrite();"
+            "c.Rewrite();"
+            "d.Rewrite();");
+}
+
+TEST_F(MergerRewriterTest, RewriteWithPrepareMatchesRewrite) {
+  const testing::MockDataManager data_manager;
+  const auto rewrite = [&data_manager](int num_prepare_threads) {
+    std::string call_result;
+    MergerRewriter merger(num_prepare_threads);
+    merger.AddRewriter(
+        std::make_unique<AddCandidateRewriter>(&call_result, "a"));
+    merger.AddRewriter(std::make_unique<EmojiRewriter>(data_manager));
+    merger.AddRewriter(EmoticonRewriter::CreateFromDataManager(data_manager));
+
+    config::Config config;
+    config::ConfigHandler::GetDefaultConfig(&config);
+    config.set_use_emoji_conversion(true);
+    config.set_use_emoticon_conversion(true);
+    commands::Request request;
+    request.set_emoji_rewriter_capability(commands::Request::ALL);
+    const ConversionRequest conversion_request =
+        ConversionRequestBuilder().SetConfig(config).SetRequest(request).Build();
+
+    Segments segments;
+    for (const absl::string_view key : {"えもじ", "かお"}) {
+      Segment *segment = segments.add_segment();
+      segment->set_key(key);
+      Segment::Candidate *candidate = segment->add_candidate();
+      candidate->key = std::string(key);
+      candidate->content_key = std::string(key);
+      candidate->value = std::string(key);
+      candidate->content_value = std::string(key);
+    }
+    EXPECT_TRUE(merger.Rewrite(conversion_request, &segments));
+    return segments;
+  };
+
+  // The merged candidates are the same with and without PrepareRewrite(),
+  // even though "a" changes the candidates after the preparation.
+  const Segments expected = rewrite(0);
+  const Segments actual = rewrite(2);
+  ASSERT_EQ(actual.conversion_segments_size(),
+            expected.conversion_segments_size());
+  for (size_t i = 0; i < expected.conversion_segments_size(); ++i) {
+    const Segment &expected_segment = expected.conversion_segment(i);
+    const Segment &actual_segment = actual.conversion_segment(i);
+    ASSERT_EQ(actual_segment.candidates_size(),
+              expected_segment.candidates_size());
+    EXPECT_GT(actual_segment.candidates_size(), 2);
+    for (size_t j = 0; j < expected_segment.candidates_size(); ++j) {
+      const Segment::Candidate &expected_candidate =
+          expected_segment.candidate(j);
+      const Segment::Candidate &actual_candidate = actual_segment.candidate(j);
+      EXPECT_EQ(actual_candidate.value, expected_candidate.value);
+      EXPECT_EQ(actual_candidate.cost, expected_candidate.cost);
+      EXPECT_EQ(actual_candidate.attributes, expected_candidate.attributes);
+      EXPECT_EQ(actual_candidate.description, expected_candidate.description);
+    }
+  }
+}
+
 TEST_F(MergerRewriterTest, Focus) {
   std::string call_result;
   MergerRewriter merger;
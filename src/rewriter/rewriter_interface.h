@@ -33,7 +33,10 @@
 #include <array>
 #include <cstddef>  // for size_t
 #include <cstdint>
+#include <memory>
 #include <optional>
+#include <string>
+#include <vector>
 
 #include "converter/segments.h"
 #include "request/conversion_request.h"
@@ -78,6 +81,59 @@ class RewriterInterface {
   virtual bool Rewrite(const ConversionRequest &request,
                        Segments *segments) const = 0;
 
+  // Returns false if Rewrite() may add different candidates to the same
+  // segments, e.g., random numbers. The converter doesn't cache such results.
+  virtual bool IsDeterministic(const ConversionRequest &request,
+                               const Segments &segments) const {
+    return true;
+  }
+
+  // Cheap key-based condition for Rewrite(). MergerRewriter evaluates the
+  // triggers of all the rewriters once per conversion segment and skips
+  // Rewrite() of the rewriters that are not triggered. The triggers are
+  // evaluated again when a rewriter changes the keys or the number of the
+  // conversion segments. Hence a rewriter may declare a trigger only if its
+  // Rewrite() never modifies segments that don't satisfy it. The trigger is
+  // read once when the rewriter is added.
+  struct Trigger {
+    // If true, Rewrite() is called only when there is exactly one conversion
+    // segment.
+    bool single_segment_only = false;
+    // If not empty, Rewrite() is called only when the key of a conversion
+    // segment is one of these keys.
+    std::vector<std::string> keys;
+  };
+  virtual Trigger trigger() const { return {}; }
+
+  // Optional split of Rewrite() into two phases for rewriters that add
+  // candidates looked up from static data, so that MergerRewriter can run the
+  // lookups of several rewriters concurrently:
+  //
+  //  * PrepareRewrite() computes the new candidates into a private buffer. It
+  //    may only depend on the request and on the keys of the conversion
+  //    segments, and must be thread-safe.
+  //  * ApplyRewrite() is called at the rewriter's usual position in the
+  //    sequence with the buffer, and inserts the candidates. The result must be
+  //    identical to that of Rewrite() for the same segments.
+  //
+  // PrepareRewrite() may return nullptr, in which case Rewrite() is called
+  // instead. Rewriters supporting this return true from
+  // SupportsPrepareRewrite(), which is read once when the rewriter is added.
+  class PreparedRewrite {
+   public:
+    virtual ~PreparedRewrite() = default;
+  };
+  virtual bool SupportsPrepareRewrite() const { return false; }
+  virtual std::unique_ptr<PreparedRewrite> PrepareRewrite(
+      const ConversionRequest &request, const Segments &segments) const {
+    return nullptr;
+  }
+  virtual bool ApplyRewrite(const ConversionRequest &request,
+                            const PreparedRewrite &prepared,
+                            Segments *segments) const {
+    return Rewrite(request, segments);
+  }
+
   // This method is mainly called when user puts SPACE key
   // and changes the focused candidate.
   // In this method, Converter will find bracketing matching.
@@ -97,6 +97,13 @@ void InsertNounPrefix(const PosMatcher &pos_matcher, Segment *segment,
   }
 }
 
+// Single kanji entries looked up for each conversion segment.
+class PreparedSingleKanji : public RewriterInterface::PreparedRewrite {
+ public:
+  // Empty if the key has no entry.
+  std::vector<std::vector<std::string>> kanji_lists;
+};
+
 }  // namespace
 
 SingleKanjiRewriter::SingleKanjiRewriter(
@@ -116,36 +123,65 @@ int SingleKanjiRewriter::capability(const ConversionRequest &request) const {
 
 bool SingleKanjiRewriter::Rewrite(const ConversionRequest &request,
                                   Segments *segments) const {
+  const std::unique_ptr<PreparedRewrite> prepared =
+      PrepareRewrite(request, *segments);
+  if (prepared == nullptr) {
+    return false;
+  }
+  return ApplyRewrite(request, *prepared, segments);
+}
+
+std::unique_ptr<RewriterInterface::PreparedRewrite>
+SingleKanjiRewriter::PrepareRewrite(const ConversionRequest &request,
+                                    const Segments &segments) const {
   if (!request.config().use_single_kanji_conversion()) {
     MOZC_VLOG(2) << "no use_single_kanji_conversion";
-    return false;
+    return nullptr;
   }
   if (request.request().mixed_conversion() &&
       request.request_type() != ConversionRequest::CONVERSION) {
     MOZC_VLOG(2) << "single kanji prediction is enabled";
-    return false;
+    return nullptr;
   }
 
-  bool modified = false;
-  const Segments::range conversion_segments = segments->conversion_segments();
-  const size_t segments_size = conversion_segments.size();
-  const bool is_single_segment = (segments_size == 1);
   const bool use_svs = (request.request()
                             .decoder_experiment_params()
                             .variation_character_types() &
                         commands::DecoderExperimentParams::SVS_JAPANESE);
-  for (Segment &segment : conversion_segments) {
+  auto prepared = std::make_unique<PreparedSingleKanji>();
+  prepared->kanji_lists.reserve(segments.conversion_segments_size());
+  for (const Segment &segment : segments.conversion_segments()) {
+    std::vector<std::string> &kanji_list =
+        prepared->kanji_lists.emplace_back();
+    if (!single_kanji_dictionary_->LookupKanjiEntries(segment.key(), use_svs,
+                                                      &kanji_list)) {
+      kanji_list.clear();
+    }
+  }
+  return prepared;
+}
+
+bool SingleKanjiRewriter::ApplyRewrite(const ConversionRequest &request,
+                                       const PreparedRewrite &prepared,
+                                       Segments *segments) const {
+  const std::vector<std::vector<std::string>> &kanji_lists =
+      static_cast<const PreparedSingleKanji &>(prepared).kanji_lists;
+  DCHECK_EQ(kanji_lists.size(), segments->conversion_segments_size());
+
+  bool modified = false;
+  const Segments::range conversion_segments = segments->conversion_segments();
+  const size_t segments_size = conversion_segments.size();
+  const bool is_single_segment = (segments_size == 1);
+  for (size_t i = 0; i < segments_size; ++i) {
+    Segment &segment = conversion_segments[i];
     AddDescriptionForExistingCandidates(&segment);
 
-    const std::string &key = segment.key();
-    std::vector<std::string> kanji_list;
-    if (!single_kanji_dictionary_->LookupKanjiEntries(key, use_svs,
-                                                      &kanji_list)) {
+    if (kanji_lists[i].empty()) {
       continue;
     }
     modified |=
         InsertCandidate(is_single_segment, pos_matcher_.GetGeneralSymbolId(),
-                        kanji_list, &segment);
+                        kanji_lists[i], &segment);
   }
 
   // Tweak for noun prefix.
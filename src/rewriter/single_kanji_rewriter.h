@@ -55,6 +55,16 @@ class SingleKanjiRewriter : public RewriterInterface {
   bool Rewrite(const ConversionRequest &request,
                Segments *segments) const override;
 
+  // Single kanji lookups only depend on the segment keys. The noun prefix
+  // tweak depends on the candidates, so it is done in ApplyRewrite().
+  bool SupportsPrepareRewrite() const override { return true; }
+  std::unique_ptr<PreparedRewrite> PrepareRewrite(
+      const ConversionRequest &request,
+      const Segments &segments) const override;
+  bool ApplyRewrite(const ConversionRequest &request,
+                    const PreparedRewrite &prepared,
+                    Segments *segments) const override;
+
  private:
   void AddDescriptionForExistingCandidates(Segment *segment) const;
   bool InsertCandidate(bool is_single_segment, uint16_t single_kanji_id,
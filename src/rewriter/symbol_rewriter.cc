@@ -372,9 +372,12 @@ SymbolRewriter::CheckResizeSegmentsRequest(const ConversionRequest &request,
 SymbolRewriter::SymbolRewriter(const DataManager *data_manager) {
   absl::string_view token_array_data, string_array_data;
   data_manager->GetSymbolRewriterData(&token_array_data, &string_array_data);
-  DCHECK(SerializedDictionary::VerifyData(token_array_data, string_array_data));
-  dictionary_ = std::make_unique<SerializedDictionary>(token_array_data,
-                                                       string_array_data);
+  const absl::string_view key_index_data =
+      data_manager->GetSymbolRewriterKeyIndexData();
+  DCHECK(SerializedDictionary::VerifyData(token_array_data, string_array_data,
+                                          key_index_data));
+  dictionary_ = std::make_unique<SerializedDictionary>(
+      token_array_data, string_array_data, key_index_data);
 }
 
 int SymbolRewriter::capability(const ConversionRequest &request) const {
@@ -39,6 +39,8 @@ namespace mozc {
 
 class UnicodeRewriter : public RewriterInterface {
  public:
+  Trigger trigger() const override { return {.single_segment_only = true}; }
+
   std::optional<RewriterInterface::ResizeSegmentsRequest>
   CheckResizeSegmentsRequest(const ConversionRequest &request,
                              const Segments &segments) const override;
@@ -32,6 +32,7 @@
 #ifndef NO_USAGE_REWRITER
 #include <cstddef>
 #include <cstdint>
+#include <memory>
 #include <string>
 #include <utility>
 
@@ -39,6 +40,7 @@
 #include "absl/strings/match.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
 #include "base/container/serialized_string_array.h"
 #include "base/util.h"
 #include "base/vlog.h"
@@ -184,6 +186,24 @@ UsageRewriter::UsageDictItemIterator UsageRewriter::LookupUsage(
   return LookupUnmatchedUsageHeuristically(candidate);
 }
 
+std::shared_ptr<const Segment::Candidate::Usage> UsageRewriter::GetUsage(
+    UsageDictItemIterator iter) const {
+  absl::MutexLock l(&usages_mutex_);
+  std::shared_ptr<const Segment::Candidate::Usage> &usage =
+      usages_[iter.usage_id()];
+  if (usage == nullptr) {
+    const absl::string_view value_suffix =
+        string_array_[base_conjugation_suffix_[2 * iter.conjugation_id()]];
+    usage = std::make_shared<const Segment::Candidate::Usage>(
+        Segment::Candidate::Usage{
+            .title = absl::StrCat(string_array_[iter.value_index()],
+                                  value_suffix),
+            .description =
+                std::string(string_array_[iter.meaning_index()])});
+  }
+  return usage;
+}
+
 bool UsageRewriter::Rewrite(const ConversionRequest &request,
                             Segments *segments) const {
   MOZC_VLOG(2) << segments->DebugString();
@@ -220,8 +240,10 @@ bool UsageRewriter::Rewrite(const ConversionRequest &request,
                                        request, &comment)) {
           Segment::Candidate *candidate = segment->mutable_candidate(j);
           candidate->usage_id = usage_id_for_user_comment;
-          candidate->usage_title = segment->candidate(j).content_value;
-          candidate->usage_description = std::move(comment);
+          candidate->usage = std::make_shared<const Segment::Candidate::Usage>(
+              Segment::Candidate::Usage{
+                  .title = segment->candidate(j).content_value,
+                  .description = std::move(comment)});
           comment.clear();
           modified = true;
           continue;
@@ -235,16 +257,7 @@ bool UsageRewriter::Rewrite(const ConversionRequest &request,
         Segment::Candidate *candidate = segment->mutable_candidate(j);
         DCHECK(candidate);
         candidate->usage_id = iter.usage_id();
-
-        const absl::string_view value_suffix =
-            string_array_[base_conjugation_suffix_[2 * iter.conjugation_id()]];
-        candidate->usage_title.assign(string_array_[iter.value_index()].data(),
-                                      string_array_[iter.value_index()].size());
-        candidate->usage_title.append(value_suffix.data(), value_suffix.size());
-
-        candidate->usage_description.assign(
-            string_array_[iter.meaning_index()].data(),
-            string_array_[iter.meaning_index()].size());
+        candidate->usage = GetUsage(iter);
 
         MOZC_VLOG(2) << i << ":" << j << ":" << candidate->content_key << ":"
                      << candidate->content_value << ":"
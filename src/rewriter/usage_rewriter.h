@@ -34,12 +34,15 @@
 #include <cstddef>
 #include <cstdint>
 #include <iterator>
+#include <memory>
 #include <new>
 #include <string>
 #include <utility>
 
+#include "absl/base/thread_annotations.h"
 #include "absl/container/flat_hash_map.h"
 #include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
 #include "base/container/serialized_string_array.h"
 #include "converter/segments.h"
 #include "data_manager/data_manager.h"
@@ -110,11 +113,22 @@ class UsageRewriter : public RewriterInterface {
       const Segment::Candidate &candidate) const;
   UsageDictItemIterator LookupUsage(const Segment::Candidate &candidate) const;
 
+  // Returns the usage of `iter`. The usage is built on the first call and
+  // shared by all the candidates of the same entry afterwards.
+  std::shared_ptr<const Segment::Candidate::Usage> GetUsage(
+      UsageDictItemIterator iter) const;
+
   absl::flat_hash_map<StrPair, UsageDictItemIterator> key_value_usageitem_map_;
   const dictionary::PosMatcher pos_matcher_;
   const dictionary::DictionaryInterface *dictionary_;
   const uint32_t *base_conjugation_suffix_;
   SerializedStringArray string_array_;
+  // Interned usages keyed by the usage ID. The number of the entries is
+  // bounded by the size of the usage dictionary.
+  mutable absl::Mutex usages_mutex_;
+  mutable absl::flat_hash_map<size_t,
+                              std::shared_ptr<const Segment::Candidate::Usage>>
+      usages_ ABSL_GUARDED_BY(usages_mutex_);
 
  private:
   friend class UsageRewriterPeer;
@@ -178,10 +178,10 @@ TEST_F(UsageRewriterTest, ConjugationTest) {
   AddCandidate("うたえば", "唱えば", "うたえ", "唄え", seg);
   const ConversionRequest convreq = ConvReq(config_, request_);
   EXPECT_TRUE(rewriter->Rewrite(convreq, &segments));
-  EXPECT_EQ(segments.conversion_segment(0).candidate(0).usage_title, "歌う");
-  EXPECT_NE(segments.conversion_segment(0).candidate(0).usage_description, "");
-  EXPECT_EQ(segments.conversion_segment(0).candidate(1).usage_title, "唄う");
-  EXPECT_NE(segments.conversion_segment(0).candidate(1).usage_description, "");
+  EXPECT_EQ(segments.conversion_segment(0).candidate(0).usage_title(), "歌う");
+  EXPECT_NE(segments.conversion_segment(0).candidate(0).usage_description(), "");
+  EXPECT_EQ(segments.conversion_segment(0).candidate(1).usage_title(), "唄う");
+  EXPECT_NE(segments.conversion_segment(0).candidate(1).usage_description(), "");
 }
 
 TEST_F(UsageRewriterTest, SingleSegmentSingleCandidateTest) {
@@ -195,16 +195,16 @@ TEST_F(UsageRewriterTest, SingleSegmentSingleCandidateTest) {
   seg->set_key("あおい");
   AddCandidate("あおい", "青い", "あおい", "青い", seg);
   EXPECT_TRUE(rewriter->Rewrite(convreq, &segments));
-  EXPECT_EQ(segments.conversion_segment(0).candidate(0).usage_title, "青い");
-  EXPECT_NE(segments.conversion_segment(0).candidate(0).usage_description, "");
+  EXPECT_EQ(segments.conversion_segment(0).candidate(0).usage_title(), "青い");
+  EXPECT_NE(segments.conversion_segment(0).candidate(0).usage_description(), "");
 
   segments.Clear();
   seg = segments.push_back_segment();
   seg->set_key("あおい");
   AddCandidate("あおい", "あああ", "あおい", "あああ", seg);
   EXPECT_FALSE(rewriter->Rewrite(convreq, &segments));
-  EXPECT_EQ(segments.conversion_segment(0).candidate(0).usage_title, "");
-  EXPECT_EQ(segments.conversion_segment(0).candidate(0).usage_description, "");
+  EXPECT_EQ(segments.conversion_segment(0).candidate(0).usage_title(), "");
+  EXPECT_EQ(segments.conversion_segment(0).candidate(0).usage_description(), "");
 }
 
 TEST_F(UsageRewriterTest, ConfigTest) {
@@ -259,10 +259,10 @@ TEST_F(UsageRewriterTest, SingleSegmentMultiCandidatesTest) {
   AddCandidate("あおい", "青い", "あおい", "青い", seg);
   AddCandidate("あおい", "蒼い", "あおい", "蒼い", seg);
   EXPECT_TRUE(rewriter->Rewrite(convreq, &segments));
-  EXPECT_EQ(segments.conversion_segment(0).candidate(0).usage_title, "青い");
-  EXPECT_NE(segments.conversion_segment(0).candidate(0).usage_description, "");
-  EXPECT_EQ(segments.conversion_segment(0).candidate(1).usage_title, "蒼い");
-  EXPECT_NE(segments.conversion_segment(0).candidate(1).usage_description, "");
+  EXPECT_EQ(segments.conversion_segment(0).candidate(0).usage_title(), "青い");
+  EXPECT_NE(segments.conversion_segment(0).candidate(0).usage_description(), "");
+  EXPECT_EQ(segments.conversion_segment(0).candidate(1).usage_title(), "蒼い");
+  EXPECT_NE(segments.conversion_segment(0).candidate(1).usage_description(), "");
 
   segments.Clear();
   seg = segments.push_back_segment();
@@ -270,10 +270,10 @@ TEST_F(UsageRewriterTest, SingleSegmentMultiCandidatesTest) {
   AddCandidate("あおい", "青い", "あおい", "青い", seg);
   AddCandidate("あおい", "あああ", "あおい", "あああ", seg);
   EXPECT_TRUE(rewriter->Rewrite(convreq, &segments));
-  EXPECT_EQ(segments.conversion_segment(0).candidate(0).usage_title, "青い");
-  EXPECT_NE(segments.conversion_segment(0).candidate(0).usage_description, "");
-  EXPECT_EQ(segments.conversion_segment(0).candidate(1).usage_title, "");
-  EXPECT_EQ(segments.conversion_segment(0).candidate(1).usage_description, "");
+  EXPECT_EQ(segments.conversion_segment(0).candidate(0).usage_title(), "青い");
+  EXPECT_NE(segments.conversion_segment(0).candidate(0).usage_description(), "");
+  EXPECT_EQ(segments.conversion_segment(0).candidate(1).usage_title(), "");
+  EXPECT_EQ(segments.conversion_segment(0).candidate(1).usage_description(), "");
 
   segments.Clear();
   seg = segments.push_back_segment();
@@ -281,10 +281,10 @@ TEST_F(UsageRewriterTest, SingleSegmentMultiCandidatesTest) {
   AddCandidate("あおい", "あああ", "あおい", "あああ", seg);
   AddCandidate("あおい", "青い", "あおい", "青い", seg);
   EXPECT_TRUE(rewriter->Rewrite(convreq, &segments));
-  EXPECT_EQ(segments.conversion_segment(0).candidate(0).usage_title, "");
-  EXPECT_EQ(segments.conversion_segment(0).candidate(0).usage_description, "");
-  EXPECT_EQ(segments.conversion_segment(0).candidate(1).usage_title, "青い");
-  EXPECT_NE(segments.conversion_segment(0).candidate(1).usage_description, "");
+  EXPECT_EQ(segments.conversion_segment(0).candidate(0).usage_title(), "");
+  EXPECT_EQ(segments.conversion_segment(0).candidate(0).usage_description(), "");
+  EXPECT_EQ(segments.conversion_segment(0).candidate(1).usage_title(), "青い");
+  EXPECT_NE(segments.conversion_segment(0).candidate(1).usage_description(), "");
 
   segments.Clear();
   seg = segments.push_back_segment();
@@ -292,10 +292,10 @@ TEST_F(UsageRewriterTest, SingleSegmentMultiCandidatesTest) {
   AddCandidate("あおい", "あああ", "あおい", "あああ", seg);
   AddCandidate("あおい", "いいい", "あおい", "いいい", seg);
   EXPECT_FALSE(rewriter->Rewrite(convreq, &segments));
-  EXPECT_EQ(segments.conversion_segment(0).candidate(0).usage_title, "");
-  EXPECT_EQ(segments.conversion_segment(0).candidate(0).usage_description, "");
-  EXPECT_EQ(segments.conversion_segment(0).candidate(1).usage_title, "");
-  EXPECT_EQ(segments.conversion_segment(0).candidate(1).usage_description, "");
+  EXPECT_EQ(segments.conversion_segment(0).candidate(0).usage_title(), "");
+  EXPECT_EQ(segments.conversion_segment(0).candidate(0).usage_description(), "");
+  EXPECT_EQ(segments.conversion_segment(0).candidate(1).usage_title(), "");
+  EXPECT_EQ(segments.conversion_segment(0).candidate(1).usage_description(), "");
 }
 
 TEST_F(UsageRewriterTest, MultiSegmentsTest) {
@@ -315,16 +315,16 @@ TEST_F(UsageRewriterTest, MultiSegmentsTest) {
   AddCandidate("うたえば", "歌えば", "うたえ", "歌え", seg);
   AddCandidate("うたえば", "唱えば", "うたえ", "唄え", seg);
   EXPECT_TRUE(rewriter->Rewrite(convreq, &segments));
-  EXPECT_EQ(segments.conversion_segment(0).candidate(0).usage_title, "青い");
-  EXPECT_NE(segments.conversion_segment(0).candidate(0).usage_description, "");
-  EXPECT_EQ(segments.conversion_segment(0).candidate(1).usage_title, "蒼い");
-  EXPECT_NE(segments.conversion_segment(0).candidate(1).usage_description, "");
-  EXPECT_EQ(segments.conversion_segment(0).candidate(2).usage_title, "");
-  EXPECT_EQ(segments.conversion_segment(0).candidate(2).usage_description, "");
-  EXPECT_EQ(segments.conversion_segment(1).candidate(0).usage_title, "歌う");
-  EXPECT_NE(segments.conversion_segment(1).candidate(0).usage_description, "");
-  EXPECT_EQ(segments.conversion_segment(1).candidate(1).usage_title, "唄う");
-  EXPECT_NE(segments.conversion_segment(1).candidate(1).usage_description, "");
+  EXPECT_EQ(segments.conversion_segment(0).candidate(0).usage_title(), "青い");
+  EXPECT_NE(segments.conversion_segment(0).candidate(0).usage_description(), "");
+  EXPECT_EQ(segments.conversion_segment(0).candidate(1).usage_title(), "蒼い");
+  EXPECT_NE(segments.conversion_segment(0).candidate(1).usage_description(), "");
+  EXPECT_EQ(segments.conversion_segment(0).candidate(2).usage_title(), "");
+  EXPECT_EQ(segments.conversion_segment(0).candidate(2).usage_description(), "");
+  EXPECT_EQ(segments.conversion_segment(1).candidate(0).usage_title(), "歌う");
+  EXPECT_NE(segments.conversion_segment(1).candidate(0).usage_description(), "");
+  EXPECT_EQ(segments.conversion_segment(1).candidate(1).usage_title(), "唄う");
+  EXPECT_NE(segments.conversion_segment(1).candidate(1).usage_description(), "");
 }
 
 TEST_F(UsageRewriterTest, SameUsageTest) {
@@ -339,12 +339,12 @@ TEST_F(UsageRewriterTest, SameUsageTest) {
   AddCandidate("うたえば", "唱えば", "うたえ", "唄え", seg);
   AddCandidate("うたえば", "唱エバ", "うたえ", "唄え", seg);
   EXPECT_TRUE(rewriter->Rewrite(convreq, &segments));
-  EXPECT_EQ(segments.conversion_segment(0).candidate(0).usage_title, "歌う");
-  EXPECT_NE(segments.conversion_segment(0).candidate(0).usage_description, "");
-  EXPECT_EQ(segments.conversion_segment(0).candidate(1).usage_title, "唄う");
-  EXPECT_NE(segments.conversion_segment(0).candidate(1).usage_description, "");
-  EXPECT_EQ(segments.conversion_segment(0).candidate(2).usage_title, "唄う");
-  EXPECT_NE(segments.conversion_segment(0).candidate(2).usage_description, "");
+  EXPECT_EQ(segments.conversion_segment(0).candidate(0).usage_title(), "歌う");
+  EXPECT_NE(segments.conversion_segment(0).candidate(0).usage_description(), "");
+  EXPECT_EQ(segments.conversion_segment(0).candidate(1).usage_title(), "唄う");
+  EXPECT_NE(segments.conversion_segment(0).candidate(1).usage_description(), "");
+  EXPECT_EQ(segments.conversion_segment(0).candidate(2).usage_title(), "唄う");
+  EXPECT_NE(segments.conversion_segment(0).candidate(2).usage_description(), "");
   EXPECT_NE(segments.conversion_segment(0).candidate(0).usage_id,
             segments.conversion_segment(0).candidate(1).usage_id);
   EXPECT_EQ(segments.conversion_segment(0).candidate(1).usage_id,
@@ -394,13 +394,13 @@ TEST_F(UsageRewriterTest, CommentFromUserDictionary) {
 
   // Result of ("うま", "Horse"). No comment is expected.
   const Segment::Candidate &cand0 = segments.conversion_segment(0).candidate(0);
-  EXPECT_TRUE(cand0.usage_title.empty());
-  EXPECT_TRUE(cand0.usage_description.empty());
+  EXPECT_TRUE(cand0.usage_title().empty());
+  EXPECT_TRUE(cand0.usage_description().empty());
 
   // Result of ("うま", "アルパカ"). Comment from user dictionary is expected.
   const Segment::Candidate &cand1 = segments.conversion_segment(0).candidate(1);
-  EXPECT_EQ(cand1.usage_title, "アルパカ");
-  EXPECT_EQ(cand1.usage_description, "アルパカコメント");
+  EXPECT_EQ(cand1.usage_title(), "アルパカ");
+  EXPECT_EQ(cand1.usage_description(), "アルパカコメント");
 }
 
 }  // namespace mozc
@@ -32,7 +32,6 @@
 
 #include <cstdint>
 #include <string>
-#include <vector>
 
 #include "absl/strings/string_view.h"
 #include "converter/segments.h"
@@ -116,8 +115,9 @@ class VariantsRewriter : public RewriterInterface {
       const Segment::Candidate &original, std::string *default_value,
       std::string *alternative_value, std::string *default_content_value,
       std::string *alternative_content_value,
-      std::vector<uint32_t> *default_inner_segment_boundary,
-      std::vector<uint32_t> *alternative_inner_segment_boundary) const;
+      Segment::Candidate::InnerSegmentBoundary *default_inner_segment_boundary,
+      Segment::Candidate::InnerSegmentBoundary
+          *alternative_inner_segment_boundary) const;
 
   const dictionary::PosMatcher pos_matcher_;
 };
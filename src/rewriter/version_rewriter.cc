@@ -40,6 +40,7 @@
 #include "base/version.h"
 #include "converter/segments.h"
 #include "request/conversion_request.h"
+#include "rewriter/rewriter_interface.h"
 
 namespace mozc {
 namespace {
@@ -78,6 +79,14 @@ VersionRewriter::VersionRewriter(absl::string_view data_version) {
   }
 }
 
+RewriterInterface::Trigger VersionRewriter::trigger() const {
+  Trigger trigger;
+  for (const auto &[key, entry] : entries_) {
+    trigger.keys.push_back(key);
+  }
+  return trigger;
+}
+
 bool VersionRewriter::Rewrite(const ConversionRequest &request,
                               Segments *segments) const {
   bool result = false;
@@ -54,6 +54,8 @@ class VersionRewriter : public RewriterInterface {
     return RewriterInterface::CONVERSION;
   }
 
+  Trigger trigger() const override;
+
   bool Rewrite(const ConversionRequest &request,
                Segments *segments) const override;
 
@@ -45,6 +45,8 @@ class ZipcodeRewriter : public RewriterInterface {
   explicit ZipcodeRewriter(const dictionary::PosMatcher pos_matcher)
       : pos_matcher_(pos_matcher) {}
 
+  Trigger trigger() const override { return {.single_segment_only = true}; }
+
   bool Rewrite(const ConversionRequest &request,
                Segments *segments) const override;
 
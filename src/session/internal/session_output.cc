@@ -186,7 +186,7 @@ void SessionOutput::FillCandidate(
     *candidate_proto->mutable_annotation() = annotation;
   }
 
-  if (!candidate_value.usage_title.empty()) {
+  if (!candidate_value.usage_title().empty()) {
     candidate_proto->set_information_id(candidate_value.usage_id);
   }
 }
@@ -266,7 +266,7 @@ bool SessionOutput::ShouldShowUsages(const Segment &segment,
     if (candidate_ptr.HasSubcandidateList()) {
       continue;
     }
-    if (!segment.candidate(candidate_ptr.id()).usage_title.empty()) {
+    if (!segment.candidate(candidate_ptr.id()).usage_title().empty()) {
       return true;
     }
   }
@@ -291,7 +291,7 @@ void SessionOutput::FillUsages(
       continue;
     }
     const Segment::Candidate &candidate = segment.candidate(candidate_ptr.id());
-    if (candidate.usage_title.empty()) {
+    if (candidate.usage_title().empty()) {
       continue;
     }
 
@@ -303,8 +303,8 @@ void SessionOutput::FillUsages(
       index = usages->information_size();
       info = usages->add_information();
       info->set_id(candidate.usage_id);
-      info->set_title(candidate.usage_title);
-      info->set_description(candidate.usage_description);
+      info->set_title(candidate.usage->title);
+      info->set_description(candidate.usage->description);
       info->add_candidate_id(candidate_ptr.id());
       usageid_information_map.emplace(candidate.usage_id,
                                       std::make_pair(index, info));
@@ -32,6 +32,7 @@
 #include <cstddef>
 #include <cstdint>
 #include <iterator>
+#include <memory>
 #include <string>
 
 #include "absl/strings/string_view.h"
@@ -60,8 +61,10 @@ void FillDummySegment(const DummySegment *dummy_segments, const size_t num,
     candidate_list->AddCandidate(i, dummy_segments[i].value);
     cand->value = dummy_segments[i].value;
     cand->usage_id = dummy_segments[i].usage_id;
-    cand->usage_title = dummy_segments[i].usage_title;
-    cand->usage_description = dummy_segments[i].usage_description;
+    cand->usage = std::make_shared<const Segment::Candidate::Usage>(
+        Segment::Candidate::Usage{
+            .title = dummy_segments[i].usage_title,
+            .description = dummy_segments[i].usage_description});
   }
 }
 
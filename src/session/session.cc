@@ -45,6 +45,7 @@
 #include "absl/strings/string_view.h"
 #include "absl/time/time.h"
 #include "base/clock.h"
+#include "base/trace.h"
 #include "base/util.h"
 #include "composer/composer.h"
 #include "composer/key_event_util.h"
@@ -283,6 +284,7 @@ void Session::EnsureIMEIsOn() {
 }
 
 bool Session::SendCommand(commands::Command *command) {
+  ScopedTraceSpan span("Session::SendCommand");
   UpdateTime();
   UpdatePreferences(command);
   if (!command->input().has_command()) {
@@ -502,6 +504,7 @@ bool Session::TestSendKey(commands::Command *command) {
 }
 
 bool Session::SendKey(commands::Command *command) {
+  ScopedTraceSpan span("Session::SendKey");
   UpdateTime();
   UpdatePreferences(command);
   TransformInput(command->mutable_input());
@@ -1477,6 +1480,10 @@ absl::Time Session::create_session_time() const {
   return context_->create_time();
 }
 
+void Session::ResetCreateSessionTime() {
+  context_->set_create_time(Clock::GetAbslTime());
+}
+
 absl::Time Session::last_command_time() const {
   return context_->last_command_time();
 }
@@ -254,6 +254,10 @@ class Session : public SessionInterface {
   // Return the time when this instance was created.
   absl::Time create_session_time() const override;
 
+  // Resets the creation time to the current time. Used when a pre-constructed
+  // session is handed out to a client.
+  void ResetCreateSessionTime();
+
   // return 0 (default value) if no command is executed in this session.
   absl::Time last_command_time() const override;
 
@@ -44,7 +44,9 @@
 #include "absl/strings/match.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
+#include "base/hash.h"
 #include "base/text_normalizer.h"
+#include "base/trace.h"
 #include "base/util.h"
 #include "base/vlog.h"
 #include "composer/composer.h"
@@ -157,6 +159,7 @@ bool SessionConverter::Convert(const composer::Composer &composer) {
 bool SessionConverter::ConvertWithPreferences(
     const composer::Composer &composer,
     const ConversionPreferences &preferences) {
+  ScopedTraceSpan span("SessionConverter::Convert");
   DCHECK(CheckState(COMPOSITION | SUGGESTION | CONVERSION));
 
   const commands::Context context;
@@ -432,6 +435,7 @@ bool SessionConverter::Suggest(const composer::Composer &composer,
 bool SessionConverter::SuggestWithPreferences(
     const composer::Composer &composer, const commands::Context &context,
     const ConversionPreferences &preferences) {
+  ScopedTraceSpan span("SessionConverter::Suggest");
   DCHECK(CheckState(COMPOSITION | SUGGESTION));
   candidate_list_visible_ = false;
 
@@ -502,6 +506,8 @@ bool SessionConverter::SuggestWithPreferences(
     const Config incognito_config = CreateIncognitoConfig();
     ConversionRequest::Options incognito_options = conversion_request.options();
     incognito_options.enable_user_history_for_conversion = false;
+    // The fingerprint is of the non-incognito config.
+    incognito_options.settings_fingerprint = 0;
     incognito_options.request_type = use_partial_composition
                                          ? ConversionRequest::PARTIAL_SUGGESTION
                                          : ConversionRequest::SUGGESTION;
@@ -552,6 +558,7 @@ bool SessionConverter::IsEmptySegment(const Segment &segment) const {
 bool SessionConverter::PredictWithPreferences(
     const composer::Composer &composer,
     const ConversionPreferences &preferences) {
+  ScopedTraceSpan span("SessionConverter::Predict");
   // TODO(komatsu): DCHECK should be
   // DCHECK(CheckState(COMPOSITION | SUGGESTION | PREDICTION));
   DCHECK(CheckState(COMPOSITION | SUGGESTION | CONVERSION | PREDICTION));
@@ -1115,7 +1122,7 @@ void MaybeFillConfig(Segment::Candidate::Command command,
       output->mutable_config()->set_presentation_mode(false);
       break;
     default:
-      LOG(WARNING) << "Unknown command: " << command;
+      LOG(WARNING) << "Unknown command: " << static_cast<int>(command);
       break;
   }
 }
@@ -1123,6 +1130,7 @@ void MaybeFillConfig(Segment::Candidate::Command command,
 
 void SessionConverter::FillOutput(const composer::Composer &composer,
                                   commands::Output *output) const {
+  ScopedTraceSpan span("SessionConverter::FillOutput");
   if (!output) {
     LOG(ERROR) << "output is nullptr.";
     return;
@@ -1365,7 +1373,8 @@ bool SessionConverter::MaybePerformCommandCandidate(const size_t index,
           updated_command_ = candidate.command;
           break;
         default:
-          LOG(WARNING) << "Unknown command: " << candidate.command;
+          LOG(WARNING) << "Unknown command: "
+                       << static_cast<int>(candidate.command);
           break;
       }
       return true;
@@ -1670,6 +1679,7 @@ void SessionConverter::FillIncognitoCandidateWords(
 void SessionConverter::SetRequest(const commands::Request *request) {
   request_ = request;
   candidate_list_.set_page_size(request->candidate_page_size());
+  UpdateSettingsFingerprint();
 }
 
 void SessionConverter::SetConfig(const config::Config *config) {
@@ -1677,6 +1687,13 @@ void SessionConverter::SetConfig(const config::Config *config) {
   updated_command_ = Segment::Candidate::DEFAULT_COMMAND;
   selection_shortcut_ = config->selection_shortcut();
   use_cascading_window_ = config->use_cascading_window();
+  UpdateSettingsFingerprint();
+}
+
+void SessionConverter::UpdateSettingsFingerprint() {
+  const std::string request = request_->SerializeAsString();
+  settings_fingerprint_ = Fingerprint(absl::StrCat(
+      request.size(), ":", request, config_->SerializeAsString()));
 }
 
 void SessionConverter::OnStartComposition(const commands::Context &context) {
@@ -1851,6 +1868,7 @@ void SessionConverter::SetRequestType(
     ConversionRequest::Options &options) {
   request_type_ = request_type;
   options.request_type = request_type;
+  options.settings_fingerprint = settings_fingerprint_;
 }
 
 Config SessionConverter::CreateIncognitoConfig() {
@@ -354,6 +354,9 @@ class SessionConverter : public SessionConverterInterface {
   void SetRequestType(ConversionRequest::RequestType request_type,
                       ConversionRequest::Options &options);
 
+  // Updates settings_fingerprint_ for the current request_ and config_.
+  void UpdateSettingsFingerprint();
+
   // Creates a config for incognito mode from the current config.
   config::Config CreateIncognitoConfig();
 
@@ -379,6 +382,9 @@ class SessionConverter : public SessionConverterInterface {
 
   const commands::Request *request_;
   const config::Config *config_;
+  // Passed to the converter as ConversionRequest::Options::settings_fingerprint
+  // so that it doesn't fingerprint request_ and config_ for each conversion.
+  uint64_t settings_fingerprint_ = 0;
 
   SessionConverterInterface::State state_;
 
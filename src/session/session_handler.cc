@@ -37,15 +37,24 @@
 #include <cstdint>
 #include <limits>
 #include <memory>
+#include <optional>
+#include <string>
 #include <utility>
 #include <vector>
 
+#include "absl/algorithm/container.h"
 #include "absl/flags/flag.h"
+#include "absl/functional/function_ref.h"
 #include "absl/log/log.h"
 #include "absl/random/random.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
 #include "absl/time/time.h"
+#include "absl/types/span.h"
 #include "base/clock.h"
 #include "base/stopwatch.h"
+#include "base/system_util.h"
+#include "base/trace.h"
 #include "base/version.h"
 #include "base/vlog.h"
 #include "composer/table.h"
@@ -61,6 +70,7 @@
 #include "session/session.h"
 #include "session/session_observer_handler.h"
 #include "session/session_observer_interface.h"
+#include "usage_stats/metrics_registry.h"
 #include "usage_stats/usage_stats.h"
 
 #ifndef MOZC_DISABLE_SESSION_WATCHDOG
@@ -98,13 +108,82 @@ ABSL_FLAG(int32_t, last_create_session_timeout, 300,
           "\"last_create_session_timeout\" sec "
           "after create session command");
 
+ABSL_FLAG(int32_t, session_pool_size, 2,
+          "number of pre-constructed sessions kept for CreateSession. "
+          "0 disables the pool.");
+
 ABSL_FLAG(bool, restricted, false, "Launch server with restricted setting");
 
+ABSL_FLAG(bool, record_stage_latencies, false,
+          "record the latencies of the conversion stages for "
+          "GET_SERVER_STATS.");
+
 namespace mozc {
 namespace {
 
 using mozc::usage_stats::UsageStats;
 
+// Names of the spans whose latencies are reported by GET_SERVER_STATS.
+constexpr absl::string_view kTraceStageNames[] = {
+    "SessionHandler::EvalCommand",
+    "Session::SendKey",
+    "Session::SendCommand",
+    "SessionConverter::Convert",
+    "SessionConverter::Suggest",
+    "SessionConverter::Predict",
+    "SessionConverter::FillOutput",
+    "Converter::StartConversion",
+    "Converter::StartPrediction",
+    "ImmutableConverter::ConvertForRequest",
+    "MergerRewriter::Rewrite",
+    "DefaultPredictor::PredictForRequest",
+    "MobilePredictor::PredictForRequest",
+    "UserHistoryPredictor::PredictForRequest",
+    "DictionaryPredictor::PredictForRequest",
+};
+
+uint32_t ToUsec(absl::Duration duration) {
+  return static_cast<uint32_t>(std::clamp<int64_t>(
+      absl::ToInt64Microseconds(duration), 0,
+      std::numeric_limits<uint32_t>::max()));
+}
+
+void FillTrace(absl::Span<const TraceBuffer::Span> spans,
+               commands::Trace *trace) {
+  for (const TraceBuffer::Span &span : spans) {
+    commands::Trace::Span *output = trace->add_spans();
+    output->set_name(span.name);
+    output->set_start_usec(
+        absl::ToInt64Microseconds(span.start - spans.front().start));
+    output->set_duration_usec(absl::ToInt64Microseconds(span.duration));
+    output->set_depth(span.depth);
+  }
+}
+
+void FillLatency(absl::string_view name,
+                 const usage_stats::MetricsSnapshot::Timing &timing,
+                 commands::ServerStats::Latency *latency) {
+  latency->set_name(name);
+  latency->set_num(timing.num);
+  latency->set_p50_usec(timing.GetPercentile(50));
+  latency->set_p90_usec(timing.GetPercentile(90));
+  latency->set_p99_usec(timing.GetPercentile(99));
+  latency->set_max_usec(timing.max);
+}
+
+void AddCache(absl::string_view name, const usage_stats::MetricsSnapshot &stats,
+              const std::string &hit_name, const std::string &miss_name,
+              commands::ServerStats *server_stats) {
+  commands::ServerStats::Cache *cache = server_stats->add_caches();
+  cache->set_name(name);
+  if (const auto it = stats.counts.find(hit_name); it != stats.counts.end()) {
+    cache->set_hits(it->second);
+  }
+  if (const auto it = stats.counts.find(miss_name); it != stats.counts.end()) {
+    cache->set_misses(it->second);
+  }
+}
+
 bool IsApplicationAlive(const session::Session *session) {
 #ifndef MOZC_DISABLE_SESSION_WATCHDOG
   const commands::ApplicationInfo &info = session->application_info();
@@ -130,7 +209,7 @@ bool IsApplicationAlive(const session::Session *session) {
 }  // namespace
 
 SessionHandler::SessionHandler(std::unique_ptr<EngineInterface> engine)
-    : engine_(std::move(engine)) {
+    : engine_(std::move(engine)), stage_latencies_(kTraceStageNames) {
   is_available_ = false;
   max_session_size_ = 0;
   last_session_empty_time_ = Clock::GetAbslTime();
@@ -154,11 +233,15 @@ SessionHandler::SessionHandler(std::unique_ptr<EngineInterface> engine)
     absl::SetFlag(&FLAGS_watch_dog_interval, 15);
     absl::SetFlag(&FLAGS_last_create_session_timeout, 60);
     absl::SetFlag(&FLAGS_last_command_timeout, 60);
+    absl::SetFlag(&FLAGS_session_pool_size, 0);
   }
 
   // Allow [2..128] sessions.
   max_session_size_ = std::clamp(absl::GetFlag(FLAGS_max_session_size), 2, 128);
-  session_map_ = std::make_unique<SessionMap>(max_session_size_);
+  session_map_.reserve(max_session_size_);
+  // Allow [0..8] pooled sessions.
+  session_pool_size_ = std::clamp(absl::GetFlag(FLAGS_session_pool_size), 0, 8);
+  record_stage_latencies_ = absl::GetFlag(FLAGS_record_stage_latencies);
 
   if (!engine_) {
     return;
@@ -168,10 +251,21 @@ SessionHandler::SessionHandler(std::unique_ptr<EngineInterface> engine)
   is_available_ = true;
 }
 
+SessionHandler::~SessionHandler() {
+  {
+    absl::MutexLock l(&mutex_);
+    terminating_ = true;
+  }
+  if (session_pool_replenisher_.has_value()) {
+    session_pool_replenisher_->Join();
+  }
+}
+
 bool SessionHandler::IsAvailable() const { return is_available_; }
 
 void SessionHandler::StartWatchDog() {
 #ifndef MOZC_DISABLE_SESSION_WATCHDOG
+  absl::MutexLock l(&mutex_);
   if (!session_watch_dog_.has_value()) {
     session_watch_dog_.emplace(
         absl::Seconds(absl::GetFlag(FLAGS_watch_dog_interval)));
@@ -199,22 +293,32 @@ void SessionHandler::UpdateSessions(const config::Config &config,
     key_map_manager_ = std::make_unique<keymap::KeyMapManager>(*config_);
   }
 
-  for (SessionElement &element : *session_map_) {
-    std::unique_ptr<session::Session> &session = element.value;
-    if (!session) {
+  for (const auto &[id, entry] : session_map_) {
+    // Waits for the command in progress, which may refer to the previous
+    // config, request and key map.
+    absl::MutexLock l(&entry->mutex);
+    if (!entry->session) {
       continue;
     }
-    session->SetConfig(config_.get());
-    session->SetKeyMapManager(key_map_manager_.get());
-    session->SetRequest(request_.get());
-    if (table != nullptr) {
-      session->SetTable(table);
-    }
+    ConfigureSession(entry->session.get(), table);
+  }
+  for (std::unique_ptr<session::Session> &session : session_pool_) {
+    ConfigureSession(session.get(), table);
   }
   config::CharacterFormManager::GetCharacterFormManager()->ReloadConfig(
       *config_);
 }
 
+void SessionHandler::ConfigureSession(session::Session *session,
+                                      const composer::Table *table) {
+  session->SetConfig(config_.get());
+  session->SetKeyMapManager(key_map_manager_.get());
+  session->SetRequest(request_.get());
+  if (table != nullptr) {
+    session->SetTable(table);
+  }
+}
+
 bool SessionHandler::SyncData(commands::Command *command) {
   MOZC_VLOG(1) << "Syncing user data";
   engine_->Sync();
@@ -299,6 +403,48 @@ bool SessionHandler::SetRequest(commands::Command *command) {
 }
 
 bool SessionHandler::EvalCommand(commands::Command *command) {
+  ++pending_command_count_;
+
+  // The spans are recorded into the buffer of the caller if any, e.g. of
+  // session_handler_main.
+  TraceBuffer *buffer = TraceBuffer::GetCurrent();
+  if (buffer == nullptr && !record_stage_latencies_ &&
+      !command->input().enable_trace()) {
+    // Nobody reads the spans, so ScopedTraceSpan records nothing.
+    const bool result = EvalCommandInternal(command);
+    --pending_command_count_;
+    return result;
+  }
+  std::optional<TraceBuffer> local_buffer;
+  std::optional<ScopedTraceBuffer> scoped_buffer;
+  if (buffer == nullptr) {
+    buffer = &local_buffer.emplace();
+    scoped_buffer.emplace(buffer);
+  }
+  const size_t first_span = buffer->spans().size();
+
+  const bool result = EvalCommandInternal(command);
+
+  const absl::Span<const TraceBuffer::Span> spans =
+      absl::MakeConstSpan(buffer->spans()).subspan(first_span);
+  if (record_stage_latencies_) {
+    for (const TraceBuffer::Span &span : spans) {
+      if (const std::optional<size_t> id = stage_latencies_.GetId(span.name);
+          id.has_value()) {
+        stage_latencies_.UpdateTiming(*id, ToUsec(span.duration));
+      }
+    }
+  }
+  if (command->input().enable_trace()) {
+    FillTrace(spans, command->mutable_output()->mutable_trace());
+  }
+
+  --pending_command_count_;
+  return result;
+}
+
+bool SessionHandler::EvalCommandInternal(commands::Command *command) {
+  ScopedTraceSpan span("SessionHandler::EvalCommand");
   if (!is_available_) {
     LOG(ERROR) << "SessionHandler is not available.";
     return false;
@@ -308,13 +454,8 @@ bool SessionHandler::EvalCommand(commands::Command *command) {
   Stopwatch stopwatch;
   stopwatch.Start();
 
+  // The session commands and the command lists take the locks by themselves.
   switch (command->input().type()) {
-    case commands::Input::CREATE_SESSION:
-      eval_succeeded = CreateSession(command);
-      break;
-    case commands::Input::DELETE_SESSION:
-      eval_succeeded = DeleteSession(command);
-      break;
     case commands::Input::SEND_KEY:
       eval_succeeded = SendKey(command);
       break;
@@ -324,56 +465,14 @@ bool SessionHandler::EvalCommand(commands::Command *command) {
     case commands::Input::SEND_COMMAND:
       eval_succeeded = SendCommand(command);
       break;
-    case commands::Input::SYNC_DATA:
-      eval_succeeded = SyncData(command);
-      break;
-    case commands::Input::CLEAR_USER_HISTORY:
-      eval_succeeded = ClearUserHistory(command);
-      break;
-    case commands::Input::CLEAR_USER_PREDICTION:
-      eval_succeeded = ClearUserPrediction(command);
-      break;
-    case commands::Input::CLEAR_UNUSED_USER_PREDICTION:
-      eval_succeeded = ClearUnusedUserPrediction(command);
-      break;
-    case commands::Input::GET_CONFIG:
-      eval_succeeded = GetConfig(command);
-      break;
-    case commands::Input::SET_CONFIG:
-      eval_succeeded = SetConfig(command);
-      break;
-    case commands::Input::SET_REQUEST:
-      eval_succeeded = SetRequest(command);
-      break;
-    case commands::Input::SHUTDOWN:
-      eval_succeeded = Shutdown(command);
-      break;
-    case commands::Input::RELOAD:
-      eval_succeeded = Reload(command);
+    case commands::Input::SEND_COMMAND_LIST:
+      eval_succeeded = SendCommandList(command);
       break;
-    case commands::Input::RELOAD_AND_WAIT:
-      eval_succeeded = ReloadAndWait(command);
-      break;
-    case commands::Input::CLEANUP:
-      eval_succeeded = Cleanup(command);
-      break;
-    case commands::Input::SEND_USER_DICTIONARY_COMMAND:
-      eval_succeeded = SendUserDictionaryCommand(command);
+    default: {
+      absl::MutexLock l(&mutex_);
+      eval_succeeded = EvalHandlerCommand(command);
       break;
-    case commands::Input::SEND_ENGINE_RELOAD_REQUEST:
-      eval_succeeded = SendEngineReloadRequest(command);
-      break;
-    case commands::Input::NO_OPERATION:
-      eval_succeeded = NoOperation(command);
-      break;
-    case commands::Input::RELOAD_SPELL_CHECKER:
-      eval_succeeded = ReloadSupplementalModel(command);
-      break;
-    case commands::Input::GET_SERVER_VERSION:
-      eval_succeeded = GetServerVersion(command);
-      break;
-    default:
-      eval_succeeded = false;
+    }
   }
 
   if (eval_succeeded) {
@@ -389,8 +488,13 @@ bool SessionHandler::EvalCommand(commands::Command *command) {
         commands::Output::SESSION_FAILURE);
   }
 
+  if (command->input().has_request_id()) {
+    command->mutable_output()->set_request_id(command->input().request_id());
+  }
+
   if (eval_succeeded) {
     // TODO(komatsu): Make sure if checking eval_succeeded is necessary or not.
+    absl::MutexLock l(&observer_mutex_);
     observer_handler_->EvalCommandHandler(*command);
   }
 
@@ -402,12 +506,58 @@ bool SessionHandler::EvalCommand(commands::Command *command) {
   return is_available_;
 }
 
+bool SessionHandler::EvalHandlerCommand(commands::Command *command) {
+  switch (command->input().type()) {
+    case commands::Input::CREATE_SESSION:
+      return CreateSession(command);
+    case commands::Input::DELETE_SESSION:
+      return DeleteSession(command);
+    case commands::Input::SYNC_DATA:
+      return SyncData(command);
+    case commands::Input::CLEAR_USER_HISTORY:
+      return ClearUserHistory(command);
+    case commands::Input::CLEAR_USER_PREDICTION:
+      return ClearUserPrediction(command);
+    case commands::Input::CLEAR_UNUSED_USER_PREDICTION:
+      return ClearUnusedUserPrediction(command);
+    case commands::Input::GET_CONFIG:
+      return GetConfig(command);
+    case commands::Input::SET_CONFIG:
+      return SetConfig(command);
+    case commands::Input::SET_REQUEST:
+      return SetRequest(command);
+    case commands::Input::SHUTDOWN:
+      return Shutdown(command);
+    case commands::Input::RELOAD:
+      return Reload(command);
+    case commands::Input::RELOAD_AND_WAIT:
+      return ReloadAndWait(command);
+    case commands::Input::CLEANUP:
+      return Cleanup(command);
+    case commands::Input::SEND_USER_DICTIONARY_COMMAND:
+      return SendUserDictionaryCommand(command);
+    case commands::Input::SEND_ENGINE_RELOAD_REQUEST:
+      return SendEngineReloadRequest(command);
+    case commands::Input::NO_OPERATION:
+      return NoOperation(command);
+    case commands::Input::RELOAD_SPELL_CHECKER:
+      return ReloadSupplementalModel(command);
+    case commands::Input::GET_SERVER_VERSION:
+      return GetServerVersion(command);
+    case commands::Input::GET_SERVER_STATS:
+      return GetServerStats(command);
+    default:
+      return false;
+  }
+}
+
 std::unique_ptr<session::Session> SessionHandler::NewSession() {
   // Session doesn't take the ownership of engine.
   return std::make_unique<session::Session>(engine_.get());
 }
 
 void SessionHandler::AddObserver(session::SessionObserverInterface *observer) {
+  absl::MutexLock l(&observer_mutex_);
   observer_handler_->AddObserver(observer);
 }
 
@@ -420,46 +570,80 @@ void SessionHandler::MaybeUpdateConfig(commands::Command *command) {
   Reload(command);
 }
 
-bool SessionHandler::SendKey(commands::Command *command) {
+std::shared_ptr<SessionHandler::SessionEntry> SessionHandler::LookupSession(
+    SessionID id) {
+  absl::ReaderMutexLock l(&mutex_);
+  const auto it = session_map_.find(id);
+  if (it == session_map_.end()) {
+    return nullptr;
+  }
+  it->second->last_access = ++access_counter_;
+  return it->second;
+}
+
+bool SessionHandler::EvalSessionCommand(
+    commands::Command *command,
+    absl::FunctionRef<void(session::Session *)> eval) {
   const SessionID id = command->input().id();
-  std::unique_ptr<session::Session> *session = session_map_->MutableLookup(id);
-  if (session == nullptr || !*session) {
+  const std::shared_ptr<SessionEntry> entry = LookupSession(id);
+  if (entry == nullptr) {
     LOG(WARNING) << "SessionID " << id << " is not available";
     return false;
   }
-  (*session)->SendKey(command);
-  MaybeUpdateConfig(command);
+  absl::MutexLock l(&entry->mutex);
+  if (!entry->session) {
+    // Deleted after the lookup.
+    LOG(WARNING) << "SessionID " << id << " is not available";
+    return false;
+  }
+  eval(entry->session.get());
   return true;
 }
 
-bool SessionHandler::TestSendKey(commands::Command *command) {
-  const SessionID id = command->input().id();
-  std::unique_ptr<session::Session> *session = session_map_->MutableLookup(id);
-  if (session == nullptr || !*session) {
-    LOG(WARNING) << "SessionID " << id << " is not available";
+bool SessionHandler::SendKey(commands::Command *command) {
+  if (!EvalSessionCommand(command, [command](session::Session *session) {
+        session->SendKey(command);
+      })) {
     return false;
   }
-  (*session)->TestSendKey(command);
+  if (command->output().has_config()) {
+    absl::MutexLock l(&mutex_);
+    MaybeUpdateConfig(command);
+  }
   return true;
 }
 
+bool SessionHandler::TestSendKey(commands::Command *command) {
+  return EvalSessionCommand(command, [command](session::Session *session) {
+    session->TestSendKey(command);
+  });
+}
+
 bool SessionHandler::SendCommand(commands::Command *command) {
-  const SessionID id = command->input().id();
-  std::unique_ptr<session::Session> *session = session_map_->MutableLookup(id);
-  if (session == nullptr || !*session) {
-    LOG(WARNING) << "SessionID " << id << " is not available";
+  if (!EvalSessionCommand(command, [command](session::Session *session) {
+        session->SendCommand(command);
+      })) {
     return false;
   }
-  (*session)->SendCommand(command);
-  MaybeUpdateConfig(command);
+  if (command->output().has_config()) {
+    absl::MutexLock l(&mutex_);
+    MaybeUpdateConfig(command);
+  }
   return true;
 }
 
 void SessionHandler::MaybeReloadEngine(commands::Command *command) {
-  if (session_map_->Size() > 0) {
-    // Some sessions still use the current engine_.
+  if (!session_map_.empty()) {
+    // Some sessions still use the current converter. It is not swapped while
+    // they are alive, as the previous and the new converters would otherwise
+    // update the same user data.
     return;
   }
+  // The session under construction reads the current converter.
+  const auto pool_idle = [this]() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
+    return !session_pool_constructing_;
+  };
+  mutex_.Await(absl::Condition(&pool_idle));
 
   EngineReloadResponse engine_reload_response;
   if (!engine_->MaybeReloadEngine(&engine_reload_response)) {
@@ -470,9 +654,67 @@ void SessionHandler::MaybeReloadEngine(commands::Command *command) {
   LOG(INFO) << "Engine reloaded";
   *command->mutable_output()->mutable_engine_reload_response() =
       engine_reload_response;
+  // The pooled sessions refer to the previous converter and tables.
+  session_pool_.clear();
+  ++session_pool_generation_;
   table_manager_->ClearCaches();
 }
 
+std::unique_ptr<session::Session> SessionHandler::TakePooledSession() {
+  if (session_pool_.empty()) {
+    UsageStats::IncrementCount("SessionPoolMiss");
+    return NewSession();
+  }
+  UsageStats::IncrementCount("SessionPoolHit");
+  std::unique_ptr<session::Session> session = std::move(session_pool_.back());
+  session_pool_.pop_back();
+  session->ResetCreateSessionTime();
+  return session;
+}
+
+void SessionHandler::MaybeStartSessionPoolReplenisher() {
+  if (session_pool_size_ == 0 || session_pool_replenisher_.has_value()) {
+    return;
+  }
+  session_pool_replenisher_.emplace([this] { ReplenishSessionPool(); });
+}
+
+void SessionHandler::ReplenishSessionPool() {
+  const auto needs_session = [this]() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
+    return terminating_ ||
+           (is_available_ && session_pool_.size() < session_pool_size_);
+  };
+  while (true) {
+    uint64_t generation = 0;
+    {
+      absl::MutexLock l(&mutex_);
+      mutex_.Await(absl::Condition(&needs_session));
+      if (terminating_) {
+        return;
+      }
+      generation = session_pool_generation_;
+      session_pool_constructing_ = true;
+    }
+
+    // The session is constructed without the lock so that EvalCommand is not
+    // blocked by the construction.
+    std::unique_ptr<session::Session> session = NewSession();
+
+    absl::MutexLock l(&mutex_);
+    session_pool_constructing_ = false;
+    if (terminating_) {
+      return;
+    }
+    if (generation != session_pool_generation_) {
+      // The engine has been reloaded during the construction.
+      continue;
+    }
+    ConfigureSession(session.get(),
+                     table_manager_->GetTable(*request_, *config_));
+    session_pool_.push_back(std::move(session));
+  }
+}
+
 bool SessionHandler::GetServerVersion(mozc::commands::Command *command) const {
   commands::Output::VersionInfo *version_info =
       command->mutable_output()->mutable_server_version();
@@ -481,6 +723,65 @@ bool SessionHandler::GetServerVersion(mozc::commands::Command *command) const {
   return true;
 }
 
+bool SessionHandler::GetServerStats(commands::Command *command) {
+  commands::ServerStats *stats =
+      command->mutable_output()->mutable_server_stats();
+  // The timings are sorted by name in the snapshot.
+  for (const auto &[name, timing] : stage_latencies_.GetSnapshot().timings) {
+    FillLatency(name, timing, stats->add_stage_latencies());
+  }
+  const usage_stats::MetricsSnapshot usage_stats =
+      UsageStats::GetMetricsSnapshot();
+  AddCache("Conversion", usage_stats, "ConversionCacheHit",
+           "ConversionCacheMiss", stats);
+  AddCache("Prediction", usage_stats, "PredictionCacheHit",
+           "PredictionCacheMiss", stats);
+  engine_->FillServerStats(stats);
+  stats->set_session_count(session_map_.size());
+  stats->set_pending_command_count(pending_command_count_.load());
+  stats->set_resident_memory_bytes(SystemUtil::GetResidentMemorySize());
+  return true;
+}
+
+bool SessionHandler::SendCommandList(commands::Command *command) {
+  if (!command->input().has_command_list()) {
+    LOG(WARNING) << "command_list is empty";
+    return false;
+  }
+  commands::CommandList *command_list =
+      command->mutable_input()->mutable_command_list();
+  const bool output_last_only = command_list->output_last_only();
+  commands::CommandList *output_list =
+      command->mutable_output()->mutable_command_list();
+  output_list->set_output_last_only(output_last_only);
+
+  // Nested command lists are not allowed to bound the evaluation cost. The
+  // whole list is validated first so that no command is evaluated on error.
+  for (const commands::Command &sub_command : command_list->commands()) {
+    if (sub_command.input().type() == commands::Input::SEND_COMMAND_LIST) {
+      LOG(WARNING) << "Nested SEND_COMMAND_LIST is not supported";
+      return false;
+    }
+  }
+
+  for (commands::Command &sub_command : *command_list->mutable_commands()) {
+    sub_command.clear_output();
+    const bool available = EvalCommandInternal(&sub_command);
+    if (output_last_only) {
+      output_list->clear_commands();
+    }
+    *output_list->add_commands() = std::move(sub_command);
+    if (!available) {
+      // The server is shutting down. The remaining commands are dropped.
+      break;
+    }
+  }
+  // The inputs are returned with the outputs. They are not necessary in
+  // the input any more.
+  command_list->clear_commands();
+  return true;
+}
+
 bool SessionHandler::CreateSession(commands::Command *command) {
   // prevent DOS attack
   // don't allow CreateSession in very short period.
@@ -501,24 +802,26 @@ bool SessionHandler::CreateSession(commands::Command *command) {
 
   last_create_session_time_ = current_time;
 
-  // if session map is FULL, remove the oldest item from the LRU
-  if (session_map_->Size() >= max_session_size_) {
-    SessionElement *oldest_element = session_map_->MutableTail();
-    if (oldest_element == nullptr) {
-      LOG(ERROR) << "oldest SessionElement is NULL";
+  // if session map is FULL, remove the least recently used session
+  if (session_map_.size() >= max_session_size_) {
+    const auto oldest = absl::c_min_element(
+        session_map_, [](const auto &lhs, const auto &rhs) {
+          return lhs.second->last_access < rhs.second->last_access;
+        });
+    if (oldest == session_map_.end()) {
+      LOG(ERROR) << "oldest SessionEntry is not found";
       return false;
     }
-
-    oldest_element->value.reset();
-    session_map_->Erase(oldest_element->key);
-    MOZC_VLOG(1) << "Session is FULL, oldest SessionID " << oldest_element->key
+    const SessionID oldest_id = oldest->first;
+    DeleteSessionID(oldest_id);
+    MOZC_VLOG(1) << "Session is FULL, oldest SessionID " << oldest_id
                  << " is removed";
   }
 
   // CreateSession is called on a relatively safer timing to reload engine_.
   MaybeReloadEngine(command);
 
-  std::unique_ptr<session::Session> session = NewSession();
+  std::unique_ptr<session::Session> session = TakePooledSession();
   if (!session) {
     LOG(ERROR) << "Cannot allocate new Session";
     return false;
@@ -533,8 +836,13 @@ bool SessionHandler::CreateSession(commands::Command *command) {
   }
 
   const SessionID new_id = CreateNewSessionID();
-  SessionElement *element = session_map_->Insert(new_id);
-  element->value = std::move(session);
+  auto entry = std::make_shared<SessionEntry>();
+  {
+    absl::MutexLock l(&entry->mutex);
+    entry->session = std::move(session);
+  }
+  entry->last_access = ++access_counter_;
+  session_map_.emplace(new_id, std::move(entry));
   command->mutable_output()->set_id(new_id);
 
   // The created session has not been fully initialized yet.
@@ -548,6 +856,9 @@ bool SessionHandler::CreateSession(commands::Command *command) {
 
   UsageStats::IncrementCount("SessionCreated");
 
+  // Prepares the sessions for the following CreateSession in background.
+  MaybeStartSessionPoolReplenisher();
+
   return true;
 }
 
@@ -596,21 +907,22 @@ bool SessionHandler::Cleanup(commands::Command *command) {
                    absl::Seconds(7200)));
 
   std::vector<SessionID> remove_ids;
-  for (const SessionElement &element : *session_map_) {
-    const session::Session *session = element.value.get();
+  for (const auto &[id, entry] : session_map_) {
+    absl::MutexLock l(&entry->mutex);
+    const session::Session *session = entry->session.get();
     if (!IsApplicationAlive(session)) {
-      MOZC_VLOG(2) << "Application is not alive. Removing: " << element.key;
-      remove_ids.push_back(element.key);
+      MOZC_VLOG(2) << "Application is not alive. Removing: " << id;
+      remove_ids.push_back(id);
     } else if (session->last_command_time() == absl::InfinitePast()) {
       // no command is executed
       if ((current_time - session->create_session_time()) >=
           create_session_timeout) {
-        remove_ids.push_back(element.key);
+        remove_ids.push_back(id);
       }
     } else {  // some commands are executed already
       if ((current_time - session->last_command_time()) >=
           last_command_timeout) {
-        remove_ids.push_back(element.key);
+        remove_ids.push_back(id);
       }
     }
   }
@@ -684,7 +996,7 @@ SessionID SessionHandler::CreateNewSessionID() {
     const SessionID id =
         absl::Uniform<SessionID>(absl::IntervalClosed, bitgen_, 1,
                                  std::numeric_limits<SessionID>::max());
-    if (!session_map_->HasKey(id)) {
+    if (!session_map_.contains(id)) {
       return id;
     }
 
@@ -693,18 +1005,23 @@ SessionID SessionHandler::CreateNewSessionID() {
 }
 
 bool SessionHandler::DeleteSessionID(SessionID id) {
-  std::unique_ptr<session::Session> *session = session_map_->MutableLookup(id);
-  if (session == nullptr || !*session) {
+  const auto it = session_map_.find(id);
+  if (it == session_map_.end()) {
     LOG_IF(WARNING, id != 0) << "cannot find SessionID " << id;
     return false;
   }
-  session->reset();
-
-  session_map_->Erase(id);  // remove from LRU
+  const std::shared_ptr<SessionEntry> entry = std::move(it->second);
+  session_map_.erase(it);
+  {
+    // Waits for the command in progress so that no command runs on the
+    // session after it is deleted.
+    absl::MutexLock l(&entry->mutex);
+    entry->session.reset();
+  }
 
   // if session gets empty, save the timestamp
   if (last_session_empty_time_ == absl::InfinitePast() &&
-      session_map_->Size() == 0) {
+      session_map_.empty()) {
     last_session_empty_time_ = Clock::GetAbslTime();
   }
 
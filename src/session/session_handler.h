@@ -32,13 +32,22 @@
 #ifndef MOZC_SESSION_SESSION_HANDLER_H_
 #define MOZC_SESSION_SESSION_HANDLER_H_
 
+#include <atomic>
+#include <cstddef>
 #include <cstdint>
 #include <memory>
 #include <optional>
+#include <vector>
 
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/functional/function_ref.h"
 #include "absl/random/random.h"
 #include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
 #include "absl/time/time.h"
+#include "base/thread.h"
+#include "base/trace.h"
 #include "composer/table.h"
 #include "engine/engine_interface.h"
 #include "protocol/commands.pb.h"
@@ -49,8 +58,8 @@
 #include "session/session_handler_interface.h"
 #include "session/session_observer_handler.h"
 #include "session/session_observer_interface.h"
-#include "storage/lru_cache.h"
 #include "testing/friend_test.h"
+#include "usage_stats/metrics_registry.h"
 
 #ifndef MOZC_DISABLE_SESSION_WATCHDOG
 #include "session/session_watch_dog.h"
@@ -58,26 +67,36 @@
 
 namespace mozc {
 
+// SessionHandler is thread-safe. EvalCommand() can be called from multiple
+// threads, e.g. by the IPC server threads. The commands sent to a session
+// (SEND_KEY, TEST_SEND_KEY and SEND_COMMAND) are serialized by the mutex of
+// the session, so that different sessions are evaluated in parallel. The
+// other commands, which modify the session map, the config or the engine, are
+// evaluated under mutex_. The lock order is mutex_, then the session mutex.
 class SessionHandler : public SessionHandlerInterface {
  public:
   explicit SessionHandler(std::unique_ptr<EngineInterface> engine);
   SessionHandler(const SessionHandler &) = delete;
   SessionHandler &operator=(const SessionHandler &) = delete;
-  ~SessionHandler() override = default;
+  ~SessionHandler() override;
 
   // Returns true if SessionHandle is available.
   bool IsAvailable() const override;
 
-  bool EvalCommand(commands::Command *command) override;
+  bool EvalCommand(commands::Command *command) override
+      ABSL_LOCKS_EXCLUDED(mutex_, observer_mutex_);
 
   // Starts watch dog timer to cleanup sessions.
-  void StartWatchDog() override;
+  void StartWatchDog() override ABSL_LOCKS_EXCLUDED(mutex_);
 
   // NewSession returns new Session.
   std::unique_ptr<session::Session> NewSession();
 
-  void AddObserver(session::SessionObserverInterface *observer) override;
-  absl::string_view GetDataVersion() const override {
+  void AddObserver(session::SessionObserverInterface *observer) override
+      ABSL_LOCKS_EXCLUDED(observer_mutex_);
+  absl::string_view GetDataVersion() const override
+      ABSL_LOCKS_EXCLUDED(mutex_) {
+    absl::ReaderMutexLock l(&mutex_);
     return engine_->GetDataVersion();
   }
 
@@ -87,19 +106,46 @@ class SessionHandler : public SessionHandlerInterface {
   FRIEND_TEST(SessionHandlerTest, KeyMapTest);
   FRIEND_TEST(SessionHandlerTest, EngineUpdateSuccessfulScenarioTest);
   FRIEND_TEST(SessionHandlerTest, EngineRollbackDataTest);
+  FRIEND_TEST(SessionHandlerTest, SessionPoolTest);
 
+  // A session and the mutex serializing the commands sent to it. The entry
+  // is shared with the commands in progress, so it outlives the removal from
+  // session_map_. The session itself is destroyed under the mutex.
+  struct SessionEntry {
+    absl::Mutex mutex;
+    std::unique_ptr<session::Session> session ABSL_GUARDED_BY(mutex);
+    // access_counter_ at the last lookup. The session with the smallest value
+    // is removed first when the map is full.
+    std::atomic<uint64_t> last_access = 0;
+  };
   using SessionMap =
-      mozc::storage::LruCache<SessionID, std::unique_ptr<session::Session>>;
-  using SessionElement = SessionMap::Element;
+      absl::flat_hash_map<SessionID, std::shared_ptr<SessionEntry>>;
+
+  // Evaluates |command| under the required locks. EvalCommand() wraps this
+  // with the tracing.
+  bool EvalCommandInternal(commands::Command *command)
+      ABSL_LOCKS_EXCLUDED(mutex_, observer_mutex_);
+  // Evaluates the commands other than the session commands under mutex_.
+  bool EvalHandlerCommand(commands::Command *command)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
   // Updates the config, if the |command| contains the config.
-  void MaybeUpdateConfig(commands::Command *command);
+  void MaybeUpdateConfig(commands::Command *command)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
-  bool CreateSession(commands::Command *command);
-  bool DeleteSession(commands::Command *command);
-  bool TestSendKey(commands::Command *command);
-  bool SendKey(commands::Command *command);
-  bool SendCommand(commands::Command *command);
+  bool CreateSession(commands::Command *command)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  bool DeleteSession(commands::Command *command)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // The session commands below are evaluated without mutex_.
+  bool TestSendKey(commands::Command *command) ABSL_LOCKS_EXCLUDED(mutex_);
+  bool SendKey(commands::Command *command) ABSL_LOCKS_EXCLUDED(mutex_);
+  bool SendCommand(commands::Command *command) ABSL_LOCKS_EXCLUDED(mutex_);
+  // Runs |eval| with the session of |command| under the session mutex.
+  // Returns false if the session is not found.
+  bool EvalSessionCommand(commands::Command *command,
+                          absl::FunctionRef<void(session::Session *)> eval)
+      ABSL_LOCKS_EXCLUDED(mutex_);
   // Syncs internal data to local file system and wait for finish.
   bool SyncData(commands::Command *command);
   bool ClearUserHistory(commands::Command *command);
@@ -108,51 +154,119 @@ class SessionHandler : public SessionHandlerInterface {
   bool Shutdown(commands::Command *command);
   // Reloads all the sessions.
   // Before that, UpdateSessions() is called to update them.
-  bool Reload(commands::Command *command);
+  bool Reload(commands::Command *command) ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
   // Reloads and waits for reloader finish.
-  bool ReloadAndWait(commands::Command *command);
-  bool GetConfig(commands::Command *command);
-  bool SetConfig(commands::Command *command);
+  bool ReloadAndWait(commands::Command *command)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  bool GetConfig(commands::Command *command)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  bool SetConfig(commands::Command *command)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
   // Updates all the sessions by UpdateSessions() with given |request|.
-  bool SetRequest(commands::Command *command);
+  bool SetRequest(commands::Command *command)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
   // Sets the given config, request, and derivative information
   // to all the sessions.
   // Then updates config_ and request_.
   // This method doesn't reload the sessions.
   void UpdateSessions(const config::Config &config,
-                      const commands::Request &request);
+                      const commands::Request &request)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Sets config_, request_, key_map_manager_ and |table| to |session|.
+  void ConfigureSession(session::Session *session,
+                        const composer::Table *table)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Returns a session from session_pool_ if available. Otherwise constructs
+  // a new one.
+  std::unique_ptr<session::Session> TakePooledSession()
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Starts the background thread filling session_pool_ if not started yet.
+  void MaybeStartSessionPoolReplenisher()
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // The body of the background thread. Constructs a session one by one while
+  // session_pool_ has less sessions than session_pool_size_.
+  void ReplenishSessionPool() ABSL_LOCKS_EXCLUDED(mutex_);
 
-  bool Cleanup(commands::Command *command);
+  bool Cleanup(commands::Command *command)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
   bool SendUserDictionaryCommand(commands::Command *command);
   bool SendEngineReloadRequest(commands::Command *command);
   bool NoOperation(commands::Command *command);
   bool ReloadSupplementalModel(commands::Command *command);
   bool GetServerVersion(commands::Command *command) const;
+  bool GetServerStats(commands::Command *command)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Evaluates the commands in input.command_list sequentially and stores
+  // their results to output.command_list.
+  bool SendCommandList(commands::Command *command)
+      ABSL_LOCKS_EXCLUDED(mutex_, observer_mutex_);
+
+  // Replaces the converter of engine_ with a new one if it is ready. The
+  // existing sessions keep using the previous converter.
+  void MaybeReloadEngine(commands::Command *command)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
-  // Replaces engine_ with a new instance if it is ready.
-  void MaybeReloadEngine(commands::Command *command);
+  // Returns the entry of the session |id|, or nullptr if not found. The entry
+  // is marked as the most recently used.
+  std::shared_ptr<SessionEntry> LookupSession(SessionID id)
+      ABSL_LOCKS_EXCLUDED(mutex_);
+  SessionID CreateNewSessionID() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  bool DeleteSessionID(SessionID id) ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
-  SessionID CreateNewSessionID();
-  bool DeleteSessionID(SessionID id);
+  // Guards the state below, except for the sessions which are guarded by
+  // their own mutexes.
+  mutable absl::Mutex mutex_;
 
-  std::unique_ptr<SessionMap> session_map_;
+  SessionMap session_map_ ABSL_GUARDED_BY(mutex_);
+  // Incremented on every session lookup to order the sessions by their last
+  // access.
+  std::atomic<uint64_t> access_counter_ = 0;
 #ifndef MOZC_DISABLE_SESSION_WATCHDOG
   std::optional<SessionWatchDog> session_watch_dog_;
 #endif  // MOZC_DISABLE_SESSION_WATCHDOG
-  bool is_available_ = false;
+  std::atomic<bool> is_available_ = false;
   uint32_t max_session_size_ = 0;
   absl::Time last_session_empty_time_ = absl::InfinitePast();
   absl::Time last_cleanup_time_ = absl::InfinitePast();
   absl::Time last_create_session_time_ = absl::InfinitePast();
 
   std::unique_ptr<EngineInterface> engine_;
-  std::unique_ptr<session::SessionObserverHandler> observer_handler_;
+  // Observers are not thread-safe, so they are notified one by one.
+  absl::Mutex observer_mutex_ ABSL_ACQUIRED_AFTER(mutex_);
+  std::unique_ptr<session::SessionObserverHandler> observer_handler_
+      ABSL_GUARDED_BY(observer_mutex_);
   std::unique_ptr<composer::TableManager> table_manager_;
   std::unique_ptr<const commands::Request> request_;
   std::unique_ptr<const config::Config> config_;
   std::unique_ptr<keymap::KeyMapManager> key_map_manager_;
 
+  // Pre-constructed sessions handed out by CreateSession. They are kept
+  // configured with the current config, request, keymap and table, and are
+  // discarded when the engine is reloaded.
+  std::vector<std::unique_ptr<session::Session>> session_pool_;
+  size_t session_pool_size_ = 0;
+  // Incremented when session_pool_ is discarded, so that the session
+  // constructed for the discarded pool is not added.
+  uint64_t session_pool_generation_ = 0;
+  // True while session_pool_replenisher_ constructs a session without mutex_.
+  // The session reads the converter of the engine, so the engine is not
+  // reloaded meanwhile.
+  bool session_pool_constructing_ = false;
+  // Set to true to stop session_pool_replenisher_.
+  bool terminating_ = false;
+  std::optional<Thread> session_pool_replenisher_;
+
   absl::BitGen bitgen_;
+
+  // Number of the EvalCommand() calls in progress, including the ones waiting
+  // for the locks.
+  std::atomic<uint32_t> pending_command_count_ = 0;
+  // Latency of each stage recorded in the spans, for GET_SERVER_STATS. They
+  // are recorded only with --record_stage_latencies, as otherwise the commands
+  // don't install a TraceBuffer and the spans cost nothing.
+  bool record_stage_latencies_ = false;
+  usage_stats::MetricsRegistry stage_latencies_;
 };
 
 }  // namespace mozc
@@ -32,6 +32,11 @@
 // Usage:
 // session_handler_main --input input.txt --profile /tmp/mozc
 //                      --dictionary oss --engine desktop
+//                      [--trace_output trace.json]
+//
+// With --trace_output, the latency of each stage of the evaluation is written
+// in the JSON format of Chrome trace events, which can be loaded into
+// chrome://tracing or Perfetto.
 //
 /* Example of input.txt (tsv format)
 # Enable IME
@@ -64,6 +69,7 @@ SHOW_LOG_BY_VALUE       ございました
 #include "base/file_stream.h"
 #include "base/init_mozc.h"
 #include "base/system_util.h"
+#include "base/trace.h"
 #include "absl/flags/flag.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
@@ -79,6 +85,8 @@ ABSL_FLAG(std::string, input, "", "Input file");
 ABSL_FLAG(std::string, profile, "", "User profile directory");
 ABSL_FLAG(std::string, engine, "", "Conversion engine: 'mobile' or 'desktop'");
 ABSL_FLAG(std::string, dictionary, "", "Dictionary: 'oss' or 'test'");
+ABSL_FLAG(std::string, trace_output, "",
+          "Output file of the latency trace in the Chrome trace event format");
 
 namespace mozc {
 void Show(const commands::Output &output) {
@@ -223,16 +231,28 @@ int main(int argc, char **argv) {
   }
   mozc::session::SessionHandlerInterpreter handler(*std::move(engine));
 
-  std::string line;
-  if (!absl::GetFlag(FLAGS_input).empty()) {
-    mozc::InputFileStream input(absl::GetFlag(FLAGS_input));
-    while (std::getline(input, line)) {
+  const std::string trace_output = absl::GetFlag(FLAGS_trace_output);
+  mozc::TraceBuffer trace_buffer;
+  {
+    mozc::ScopedTraceBuffer scoped_trace_buffer(
+        trace_output.empty() ? nullptr : &trace_buffer);
+
+    std::string line;
+    if (!absl::GetFlag(FLAGS_input).empty()) {
+      mozc::InputFileStream input(absl::GetFlag(FLAGS_input));
+      while (std::getline(input, line)) {
+        mozc::ParseLine(handler, line);
+      }
+    }
+
+    while (std::getline(std::cin, line)) {
       mozc::ParseLine(handler, line);
     }
   }
 
-  while (std::getline(std::cin, line)) {
-    mozc::ParseLine(handler, line);
+  if (!trace_output.empty()) {
+    mozc::OutputFileStream output(trace_output);
+    output << trace_buffer.ToChromeTraceJson();
   }
   return 0;
 }
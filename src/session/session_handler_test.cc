@@ -45,11 +45,17 @@
 #include "absl/random/random.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/synchronization/notification.h"
 #include "absl/time/time.h"
 #include "base/clock.h"
 #include "base/clock_mock.h"
+#include "base/thread.h"
 #include "composer/query.h"
 #include "config/config_handler.h"
+#include "converter/converter_interface.h"
+#include "converter/converter_mock.h"
+#include "converter/segments.h"
 #include "data_manager/data_manager.h"
 #include "data_manager/testing/mock_data_manager.h"
 #include "engine/engine.h"
@@ -59,6 +65,7 @@
 #include "engine/modules.h"
 #include "protocol/commands.pb.h"
 #include "protocol/config.pb.h"
+#include "request/conversion_request.h"
 #include "session/internal/keymap.h"
 #include "session/session_handler_interface.h"
 #include "session/session_handler_test_util.h"
@@ -71,6 +78,8 @@ ABSL_DECLARE_FLAG(int32_t, max_session_size);
 ABSL_DECLARE_FLAG(int32_t, create_session_min_interval);
 ABSL_DECLARE_FLAG(int32_t, last_command_timeout);
 ABSL_DECLARE_FLAG(int32_t, last_create_session_timeout);
+ABSL_DECLARE_FLAG(int32_t, session_pool_size);
+ABSL_DECLARE_FLAG(bool, record_stage_latencies);
 
 namespace mozc {
 namespace {
@@ -574,6 +583,230 @@ TEST_F(SessionHandlerTest, UpdateComposition) {
   }
 }
 
+TEST_F(SessionHandlerTest, SendCommandList) {
+  config::Config config;
+  config::ConfigHandler::GetConfig(&config);
+  config::ConfigHandler::SetConfig(config);
+  SessionHandler handler(CreateMockDataEngine());
+
+  uint64_t session_id = 0;
+  EXPECT_TRUE(CreateSession(handler, &session_id));
+
+  auto add_key = [session_id](commands::CommandList *list, char key_code) {
+    commands::Input *input = list->add_commands()->mutable_input();
+    input->set_id(session_id);
+    input->set_type(commands::Input::SEND_KEY);
+    input->mutable_key()->set_key_code(key_code);
+  };
+
+  {
+    commands::Command command;
+    commands::Input *input = command.mutable_input();
+    input->set_type(commands::Input::SEND_COMMAND_LIST);
+    commands::CommandList *list = input->mutable_command_list();
+    commands::Input *on = list->add_commands()->mutable_input();
+    on->set_id(session_id);
+    on->set_type(commands::Input::SEND_KEY);
+    on->mutable_key()->set_special_key(commands::KeyEvent::ON);
+    add_key(list, 'k');
+    add_key(list, 'a');
+    EXPECT_TRUE(handler.EvalCommand(&command));
+    EXPECT_EQ(command.output().error_code(), commands::Output::SESSION_SUCCESS);
+
+    const commands::CommandList &outputs = command.output().command_list();
+    ASSERT_EQ(outputs.commands_size(), 3);
+    EXPECT_EQ(outputs.commands(0).input().key().special_key(),
+              commands::KeyEvent::ON);
+    EXPECT_EQ(outputs.commands(1).output().preedit().segment(0).value(), "ｋ");
+    EXPECT_EQ(outputs.commands(2).output().preedit().segment(0).value(), "か");
+  }
+  {
+    commands::Command command;
+    commands::Input *input = command.mutable_input();
+    input->set_type(commands::Input::SEND_COMMAND_LIST);
+    commands::CommandList *list = input->mutable_command_list();
+    list->set_output_last_only(true);
+    add_key(list, 'n');
+    add_key(list, 'a');
+    EXPECT_TRUE(handler.EvalCommand(&command));
+
+    const commands::CommandList &outputs = command.output().command_list();
+    ASSERT_EQ(outputs.commands_size(), 1);
+    EXPECT_EQ(outputs.commands(0).input().key().key_code(), 'a');
+    EXPECT_EQ(outputs.commands(0).output().preedit().segment(0).value(),
+              "かな");
+  }
+}
+
+TEST_F(SessionHandlerTest, RequestIdIsCopiedToOutput) {
+  SessionHandler handler(CreateMockDataEngine());
+
+  commands::Command command;
+  command.mutable_input()->set_type(commands::Input::NO_OPERATION);
+  command.mutable_input()->set_request_id(12345);
+  EXPECT_TRUE(handler.EvalCommand(&command));
+  EXPECT_EQ(command.output().request_id(), 12345);
+
+  // The request id is also copied on failure.
+  commands::Command failed_command;
+  failed_command.mutable_input()->set_type(commands::Input::SEND_KEY);
+  failed_command.mutable_input()->set_id(1);
+  failed_command.mutable_input()->set_request_id(67890);
+  EXPECT_TRUE(handler.EvalCommand(&failed_command));
+  EXPECT_EQ(failed_command.output().error_code(),
+            commands::Output::SESSION_FAILURE);
+  EXPECT_EQ(failed_command.output().request_id(), 67890);
+}
+
+TEST_F(SessionHandlerTest, TraceIsFilledWhenEnabled) {
+  SessionHandler handler(CreateMockDataEngine());
+
+  commands::Command command;
+  command.mutable_input()->set_type(commands::Input::NO_OPERATION);
+  EXPECT_TRUE(handler.EvalCommand(&command));
+  EXPECT_FALSE(command.output().has_trace());
+
+  commands::Command traced_command;
+  traced_command.mutable_input()->set_type(commands::Input::NO_OPERATION);
+  traced_command.mutable_input()->set_enable_trace(true);
+  EXPECT_TRUE(handler.EvalCommand(&traced_command));
+  ASSERT_EQ(traced_command.output().trace().spans_size(), 1);
+  const commands::Trace::Span &span = traced_command.output().trace().spans(0);
+  EXPECT_EQ(span.name(), "SessionHandler::EvalCommand");
+  EXPECT_EQ(span.depth(), 0);
+  EXPECT_GE(span.duration_usec(), 0);
+}
+
+TEST_F(SessionHandlerTest, SendCommandListRejectsNestedList) {
+  SessionHandler handler(CreateMockDataEngine());
+
+  commands::Command command;
+  commands::Input *input = command.mutable_input();
+  input->set_type(commands::Input::SEND_COMMAND_LIST);
+  input->mutable_command_list()->add_commands()->mutable_input()->set_type(
+      commands::Input::SEND_COMMAND_LIST);
+  EXPECT_TRUE(handler.EvalCommand(&command));
+  EXPECT_EQ(command.output().error_code(), commands::Output::SESSION_FAILURE);
+
+  // The commands before the nested list are not evaluated either.
+  commands::Command partial_command;
+  input = partial_command.mutable_input();
+  input->set_type(commands::Input::SEND_COMMAND_LIST);
+  input->mutable_command_list()->add_commands()->mutable_input()->set_type(
+      commands::Input::CREATE_SESSION);
+  input->mutable_command_list()->add_commands()->mutable_input()->set_type(
+      commands::Input::SEND_COMMAND_LIST);
+  EXPECT_TRUE(handler.EvalCommand(&partial_command));
+  EXPECT_EQ(partial_command.output().error_code(),
+            commands::Output::SESSION_FAILURE);
+  EXPECT_EQ(partial_command.output().command_list().commands_size(), 0);
+  EXPECT_EQ(partial_command.input().command_list().commands_size(), 2);
+
+  commands::Command empty_command;
+  empty_command.mutable_input()->set_type(commands::Input::SEND_COMMAND_LIST);
+  EXPECT_TRUE(handler.EvalCommand(&empty_command));
+  EXPECT_EQ(empty_command.output().error_code(),
+            commands::Output::SESSION_FAILURE);
+}
+
+TEST_F(SessionHandlerTest, ConcurrentEvalCommand) {
+  config::Config config;
+  config::ConfigHandler::GetConfig(&config);
+  config::ConfigHandler::SetConfig(config);
+  SessionHandler handler(CreateMockDataEngine());
+
+  constexpr int kNumThreads = 4;
+  std::vector<uint64_t> session_ids(kNumThreads, 0);
+  for (uint64_t &id : session_ids) {
+    ASSERT_TRUE(CreateSession(handler, &id));
+  }
+
+  auto send_key = [&handler](uint64_t id, commands::KeyEvent key) {
+    commands::Command command;
+    command.mutable_input()->set_id(id);
+    command.mutable_input()->set_type(commands::Input::SEND_KEY);
+    *command.mutable_input()->mutable_key() = std::move(key);
+    EXPECT_TRUE(handler.EvalCommand(&command));
+    return command.output();
+  };
+
+  std::vector<std::string> preedits(kNumThreads);
+  std::vector<Thread> threads;
+  for (int i = 0; i < kNumThreads; ++i) {
+    threads.emplace_back([&, i] {
+      commands::KeyEvent on;
+      on.set_special_key(commands::KeyEvent::ON);
+      send_key(session_ids[i], on);
+      commands::Output output;
+      for (int j = 0; j < 20; ++j) {
+        commands::KeyEvent key;
+        key.set_key_code('a');
+        output = send_key(session_ids[i], key);
+      }
+      preedits[i] = output.preedit().segment(0).value();
+    });
+  }
+  for (Thread &thread : threads) {
+    thread.Join();
+  }
+
+  // Each session has its own composition.
+  std::string expected;
+  for (int j = 0; j < 20; ++j) {
+    expected += "あ";
+  }
+  for (const std::string &preedit : preedits) {
+    EXPECT_EQ(preedit, expected);
+  }
+}
+
+// A command sent to a session is evaluated while a command of another session
+// is in progress.
+TEST_F(SessionHandlerTest, EvalCommandRunsInParallelForDifferentSessions) {
+  MockConverter converter;
+  absl::Notification conversion_started, conversion_released;
+  EXPECT_CALL(converter, StartConversion(_, _))
+      .WillOnce([&](const ConversionRequest &request, Segments *segments) {
+        conversion_started.Notify();
+        conversion_released.WaitForNotification();
+        return false;
+      });
+  auto engine = std::make_unique<MockEngine>();
+  EXPECT_CALL(*engine, GetConverter()).WillRepeatedly(Return(&converter));
+  SessionHandler handler(std::move(engine));
+
+  auto send_key = [&handler](uint64_t id, commands::KeyEvent key) {
+    commands::Command command;
+    command.mutable_input()->set_id(id);
+    command.mutable_input()->set_type(commands::Input::SEND_KEY);
+    *command.mutable_input()->mutable_key() = std::move(key);
+    EXPECT_TRUE(handler.EvalCommand(&command));
+    return command.output();
+  };
+  commands::KeyEvent on, a, space;
+  on.set_special_key(commands::KeyEvent::ON);
+  a.set_key_code('a');
+  space.set_special_key(commands::KeyEvent::SPACE);
+
+  uint64_t id1 = 0, id2 = 0;
+  ASSERT_TRUE(CreateSession(handler, &id1));
+  ASSERT_TRUE(CreateSession(handler, &id2));
+
+  // The conversion of the first session is blocked in the converter.
+  send_key(id1, on);
+  send_key(id1, a);
+  Thread thread([&] { send_key(id1, space); });
+  conversion_started.WaitForNotification();
+
+  // The second session doesn't wait for the first one.
+  send_key(id2, on);
+  const commands::Output output = send_key(id2, a);
+  EXPECT_EQ(output.preedit().segment(0).value(), "あ");
+
+  conversion_released.Notify();
+  thread.Join();
+}
+
 TEST_F(SessionHandlerTest, KeyMapTest) {
   config::Config config;
   config::ConfigHandler::GetConfig(&config);
@@ -780,6 +1013,69 @@ TEST_F(SessionHandlerTest, EngineReloadSessionExistsTest) {
   EXPECT_EQ(handler_->GetDataVersion(), mock_version_);
 }
 
+TEST_F(SessionHandlerTest, SessionPoolTest) {
+  absl::SetFlag(&FLAGS_session_pool_size, 2);
+  std::unique_ptr<Engine> engine = CreateMockDataEngine();
+  engine->SetAlwaysWaitForTesting(true);
+  SessionHandler handler(std::move(engine));
+
+  auto wait_for_pool = [&handler](size_t size) {
+    absl::MutexLock l(&handler.mutex_);
+    const auto filled = [&handler, size]() {
+      return handler.session_pool_.size() >= size;
+    };
+    handler.mutex_.Await(absl::Condition(&filled));
+  };
+
+  auto pool_generation = [&handler]() {
+    absl::MutexLock l(&handler.mutex_);
+    return handler.session_pool_generation_;
+  };
+
+  // The pool is empty for the first session, and is filled after that.
+  uint64_t id1 = 0;
+  ASSERT_TRUE(CreateSession(handler, &id1));
+  EXPECT_COUNT_STATS("SessionPoolMiss", 1);
+  EXPECT_STATS_NOT_EXIST("SessionPoolHit");
+  wait_for_pool(2);
+
+  // The pooled session is handed out and works as a new session.
+  uint64_t id2 = 0;
+  ASSERT_TRUE(CreateSession(handler, &id2));
+  EXPECT_NE(id1, id2);
+  EXPECT_TRUE(IsGoodSession(handler, id2));
+  EXPECT_COUNT_STATS("SessionPoolMiss", 1);
+  EXPECT_COUNT_STATS("SessionPoolHit", 1);
+  wait_for_pool(2);
+
+  ASSERT_TRUE(DeleteSession(handler, id1));
+  ASSERT_TRUE(DeleteSession(handler, id2));
+
+  // The engine is reloaded on the next session creation. The pooled sessions
+  // refer to the previous converter, so they are discarded.
+  const uint64_t generation = pool_generation();
+  ASSERT_EQ(SendMockEngineReloadRequest(handler, oss_request_),
+            EngineReloadResponse::ACCEPTED);
+  uint64_t id3 = 0;
+  ASSERT_TRUE(CreateSession(handler, &id3));
+  EXPECT_EQ(handler.GetDataVersion(), oss_version_);
+  EXPECT_EQ(pool_generation(), generation + 1);
+  EXPECT_COUNT_STATS("SessionPoolMiss", 2);
+  EXPECT_COUNT_STATS("SessionPoolHit", 1);
+
+  // The pool is refilled with the sessions for the reloaded engine.
+  wait_for_pool(2);
+  uint64_t id4 = 0;
+  ASSERT_TRUE(CreateSession(handler, &id4));
+  EXPECT_TRUE(IsGoodSession(handler, id4));
+  EXPECT_EQ(pool_generation(), generation + 1);
+  EXPECT_COUNT_STATS("SessionPoolMiss", 2);
+  EXPECT_COUNT_STATS("SessionPoolHit", 2);
+
+  ASSERT_TRUE(DeleteSession(handler, id3));
+  ASSERT_TRUE(DeleteSession(handler, id4));
+}
+
 TEST_F(SessionHandlerTest, GetServerVersionTest) {
   auto engine = std::make_unique<MockEngine>();
   EXPECT_CALL(*engine, GetDataVersion())
@@ -792,6 +1088,34 @@ TEST_F(SessionHandlerTest, GetServerVersionTest) {
   EXPECT_EQ(command.output().server_version().data_version(), "24.20240101.01");
 }
 
+TEST_F(SessionHandlerTest, GetServerStatsTest) {
+  absl::SetFlag(&FLAGS_record_stage_latencies, true);
+  SessionHandler handler(CreateMockDataEngine());
+  uint64_t id = 0;
+  ASSERT_TRUE(CreateSession(handler, &id));
+
+  commands::Command command;
+  command.mutable_input()->set_type(commands::Input::GET_SERVER_STATS);
+  EXPECT_TRUE(handler.EvalCommand(&command));
+  const commands::ServerStats &stats = command.output().server_stats();
+  EXPECT_EQ(stats.session_count(), 1);
+  EXPECT_EQ(stats.pending_command_count(), 1);
+  EXPECT_GT(stats.data_size_bytes(), 0);
+
+  // Only CREATE_SESSION has finished. GET_SERVER_STATS is still in progress.
+  ASSERT_EQ(stats.stage_latencies_size(), 1);
+  EXPECT_EQ(stats.stage_latencies(0).name(), "SessionHandler::EvalCommand");
+  EXPECT_EQ(stats.stage_latencies(0).num(), 1);
+
+  std::vector<std::string> cache_names;
+  for (const commands::ServerStats::Cache &cache : stats.caches()) {
+    cache_names.push_back(cache.name());
+  }
+  EXPECT_THAT(cache_names,
+              ::testing::UnorderedElementsAre("Conversion", "Prediction",
+                                              "Connector"));
+}
+
 TEST_F(SessionHandlerTest, ReloadFromMinimalEngine) {
   std::unique_ptr<Engine> engine = Engine::CreateEngine();
 
@@ -48,7 +48,9 @@ ABSL_DECLARE_FLAG(int32_t, create_session_min_interval);
 ABSL_DECLARE_FLAG(int32_t, watch_dog_interval);
 ABSL_DECLARE_FLAG(int32_t, last_command_timeout);
 ABSL_DECLARE_FLAG(int32_t, last_create_session_timeout);
+ABSL_DECLARE_FLAG(int32_t, session_pool_size);
 ABSL_DECLARE_FLAG(bool, restricted);
+ABSL_DECLARE_FLAG(bool, record_stage_latencies);
 
 namespace mozc {
 namespace session {
@@ -110,7 +112,10 @@ void SessionHandlerTestBase::SetUp() {
       absl::GetFlag(FLAGS_last_command_timeout);
   flags_last_create_session_timeout_backup_ =
       absl::GetFlag(FLAGS_last_create_session_timeout);
+  flags_session_pool_size_backup_ = absl::GetFlag(FLAGS_session_pool_size);
   flags_restricted_backup_ = absl::GetFlag(FLAGS_restricted);
+  flags_record_stage_latencies_backup_ =
+      absl::GetFlag(FLAGS_record_stage_latencies);
 
   ConfigHandler::GetConfig(&config_backup_);
   ClearState();
@@ -128,7 +133,10 @@ void SessionHandlerTestBase::TearDown() {
                 flags_last_command_timeout_backup_);
   absl::SetFlag(&FLAGS_last_create_session_timeout,
                 flags_last_create_session_timeout_backup_);
+  absl::SetFlag(&FLAGS_session_pool_size, flags_session_pool_size_backup_);
   absl::SetFlag(&FLAGS_restricted, flags_restricted_backup_);
+  absl::SetFlag(&FLAGS_record_stage_latencies,
+                flags_record_stage_latencies_backup_);
 }
 
 void SessionHandlerTestBase::ClearState() {
@@ -103,6 +103,7 @@ bool IsSessionIndependentCommand(commands::Input::CommandType type) {
     case commands::Input::SET_REQUEST:
     case commands::Input::SEND_ENGINE_RELOAD_REQUEST:
     case commands::Input::RELOAD_SPELL_CHECKER:
+    case commands::Input::SEND_COMMAND_LIST:
       // LINT.ThenChange()
       return true;
     default:
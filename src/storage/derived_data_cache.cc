@@ -0,0 +1,250 @@
+// Copyright 2010-2021, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "storage/derived_data_cache.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ios>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/functional/function_ref.h"
+#include "absl/log/log.h"
+#include "absl/random/random.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
+#include "base/file_stream.h"
+#include "base/file_util.h"
+#include "base/hash.h"
+#include "base/mmap.h"
+#include "base/strings/zstring_view.h"
+#include "base/vlog.h"
+
+namespace mozc {
+namespace storage {
+namespace {
+
+// The file format is as follows. All the integers are uint32_t in the native
+// byte order, and the strings are padded with '\0' to 4-byte boundary.
+//
+// [magic][format version][key size][key]
+// [number of sections]
+// [name size][name][offset in ints][size in ints][checksum]  (for each section)
+// [section data]...
+constexpr uint32_t kMagic = 0x43445a4d;  // "MZDC"
+constexpr uint32_t kFormatVersion = 2;
+
+size_t PaddedSize(size_t size) { return (size + 3) & ~size_t{3}; }
+
+uint32_t GetChecksum(absl::Span<const int> section) {
+  return Fingerprint32(absl::string_view(
+      reinterpret_cast<const char *>(section.data()),
+      section.size() * sizeof(int)));
+}
+
+void AppendUint32(uint32_t value, std::string *output) {
+  output->append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+void AppendPaddedString(absl::string_view str, std::string *output) {
+  AppendUint32(str.size(), output);
+  output->append(str.data(), str.size());
+  output->append(PaddedSize(str.size()) - str.size(), '\0');
+}
+
+class Reader {
+ public:
+  explicit Reader(absl::string_view data) : data_(data) {}
+
+  std::optional<uint32_t> ReadUint32() {
+    if (data_.size() - pos_ < sizeof(uint32_t)) {
+      return std::nullopt;
+    }
+    uint32_t value;
+    memcpy(&value, data_.data() + pos_, sizeof(value));
+    pos_ += sizeof(value);
+    return value;
+  }
+
+  std::optional<absl::string_view> ReadPaddedString() {
+    const std::optional<uint32_t> size = ReadUint32();
+    if (!size.has_value() || data_.size() - pos_ < PaddedSize(*size)) {
+      return std::nullopt;
+    }
+    const absl::string_view str = data_.substr(pos_, *size);
+    pos_ += PaddedSize(*size);
+    return str;
+  }
+
+ private:
+  absl::string_view data_;
+  size_t pos_ = 0;
+};
+
+}  // namespace
+
+std::unique_ptr<DerivedDataCache> DerivedDataCache::Open(
+    zstring_view filename, absl::string_view key) {
+  auto cache = std::make_unique<DerivedDataCache>(key);
+  if (absl::Status s = FileUtil::FileExists(std::string(filename.view()));
+      !s.ok()) {
+    MOZC_VLOG(1) << "No derived data cache: " << filename;
+    return cache;
+  }
+  absl::StatusOr<Mmap> mmap = Mmap::Map(filename, Mmap::READ_ONLY);
+  if (!mmap.ok()) {
+    LOG(WARNING) << "Cannot map " << filename << ": " << mmap.status();
+    return cache;
+  }
+
+  const absl::string_view data = mmap->string_view();
+  Reader reader(data);
+  if (reader.ReadUint32() != kMagic ||
+      reader.ReadUint32() != kFormatVersion ||
+      reader.ReadPaddedString() != key) {
+    LOG(WARNING) << filename << " is not a derived data cache for " << key;
+    return cache;
+  }
+  const std::optional<uint32_t> num_sections = reader.ReadUint32();
+  if (!num_sections.has_value()) {
+    LOG(WARNING) << filename << " is broken";
+    return cache;
+  }
+  const absl::Span<const int> ints(reinterpret_cast<const int *>(mmap->data()),
+                                   data.size() / sizeof(int));
+  absl::btree_map<std::string, Section> sections;
+  for (uint32_t i = 0; i < *num_sections; ++i) {
+    const std::optional<absl::string_view> name = reader.ReadPaddedString();
+    const std::optional<uint32_t> offset = reader.ReadUint32();
+    const std::optional<uint32_t> size = reader.ReadUint32();
+    const std::optional<uint32_t> checksum = reader.ReadUint32();
+    if (!name.has_value() || !offset.has_value() || !size.has_value() ||
+        !checksum.has_value() || *offset > ints.size() ||
+        *size > ints.size() - *offset) {
+      LOG(WARNING) << filename << " is broken";
+      return cache;
+    }
+    sections.emplace(*name, Section{.data = ints.subspan(*offset, *size),
+                                    .checksum = *checksum});
+  }
+
+  cache->mmap_ = *std::move(mmap);
+  cache->sections_ = std::move(sections);
+  return cache;
+}
+
+absl::Span<const int> DerivedDataCache::GetOrBuild(
+    absl::string_view name, absl::FunctionRef<std::vector<int>()> build) {
+  return GetOrBuild(name, build,
+                    [](absl::Span<const int> section) { return true; });
+}
+
+absl::Span<const int> DerivedDataCache::GetOrBuild(
+    absl::string_view name, absl::FunctionRef<std::vector<int>()> build,
+    absl::FunctionRef<bool(absl::Span<const int>)> validate) {
+  const auto it = sections_.find(name);
+  if (it != sections_.end()) {
+    Section &section = it->second;
+    if (section.verified) {
+      return section.data;
+    }
+    if (GetChecksum(section.data) == section.checksum &&
+        validate(section.data)) {
+      section.verified = true;
+      return section.data;
+    }
+    LOG(WARNING) << "Invalid derived data in the cache: " << name;
+  }
+  MOZC_VLOG(1) << "Building derived data: " << name;
+  std::vector<int> &built = built_sections_.emplace_back(build());
+  sections_.insert_or_assign(
+      std::string(name),
+      Section{.data = built, .verified = true, .checksum = GetChecksum(built)});
+  return built;
+}
+
+absl::Status DerivedDataCache::Save(zstring_view filename) const {
+  static_assert(sizeof(int) == sizeof(uint32_t));
+
+  size_t header_size = 4 * sizeof(uint32_t) + PaddedSize(key_.size());
+  for (const auto &[name, section] : sections_) {
+    header_size += 4 * sizeof(uint32_t) + PaddedSize(name.size());
+  }
+
+  std::string header;
+  header.reserve(header_size);
+  AppendUint32(kMagic, &header);
+  AppendUint32(kFormatVersion, &header);
+  AppendPaddedString(key_, &header);
+  AppendUint32(sections_.size(), &header);
+  size_t offset = header_size / sizeof(int);
+  for (const auto &[name, section] : sections_) {
+    AppendPaddedString(name, &header);
+    AppendUint32(offset, &header);
+    AppendUint32(section.data.size(), &header);
+    // The checksum of a section which has not been verified is kept, so that
+    // the broken section is still detected by the later processes.
+    AppendUint32(section.checksum, &header);
+    offset += section.data.size();
+  }
+
+  // Writes to a temporary file with a random suffix, as other processes may
+  // save the same cache at the same time.
+  absl::BitGen bitgen;
+  const std::string tmp_filename =
+      absl::StrCat(filename.view(), ".tmp",
+                   absl::Hex(absl::Uniform<uint32_t>(bitgen)));
+  {
+    OutputFileStream ofs(tmp_filename, std::ios::out | std::ios::binary);
+    if (!ofs) {
+      return absl::PermissionDeniedError(
+          absl::StrCat("Cannot write ", tmp_filename));
+    }
+    ofs.write(header.data(), header.size());
+    for (const auto &[name, section] : sections_) {
+      ofs.write(reinterpret_cast<const char *>(section.data.data()),
+                section.data.size() * sizeof(int));
+    }
+    if (!ofs) {
+      return absl::DataLossError(absl::StrCat("Cannot write ", tmp_filename));
+    }
+  }
+  return FileUtil::AtomicRename(tmp_filename, std::string(filename.view()));
+}
+
+}  // namespace storage
+}  // namespace mozc
@@ -0,0 +1,120 @@
+// Copyright 2010-2021, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef MOZC_STORAGE_DERIVED_DATA_CACHE_H_
+#define MOZC_STORAGE_DERIVED_DATA_CACHE_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/container/btree_map.h"
+#include "absl/functional/function_ref.h"
+#include "absl/status/status.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
+#include "base/mmap.h"
+#include "base/strings/zstring_view.h"
+
+namespace mozc {
+namespace storage {
+
+// A file-backed cache of the read-only structures derived from a data set,
+// e.g. the rank indices of bit vectors. Every process using the same data set
+// maps the same cache file, so that the physical pages are shared instead of
+// building the structures on the heap of each process.
+//
+// A section is an array of int identified by a name. GetOrBuild() returns the
+// section mapped from the file. If the file doesn't have the section, or the
+// mapped one is broken, it is built and kept on the heap, and Save() writes it
+// for the later processes. Each section in the file has a checksum, which is
+// verified when the section is first requested.
+//
+// The sections are stored in the native byte order, so the file is meant to be
+// shared only among processes on the same machine. This class is not
+// thread-safe; it is expected to be used while the data set is loaded.
+class DerivedDataCache {
+ public:
+  // Creates a cache with no sections for the data set identified by `key`,
+  // e.g. its data version.
+  explicit DerivedDataCache(absl::string_view key) : key_(key) {}
+
+  DerivedDataCache(const DerivedDataCache &) = delete;
+  DerivedDataCache &operator=(const DerivedDataCache &) = delete;
+
+  // Maps the cache file. If the file doesn't exist or was written for another
+  // `key`, returns a cache with no sections.
+  static std::unique_ptr<DerivedDataCache> Open(zstring_view filename,
+                                                absl::string_view key);
+
+  // Returns the section of `name`. If the section is not in the cache,
+  // `build` is called to compute it. The returned span is valid while this
+  // instance is alive.
+  absl::Span<const int> GetOrBuild(absl::string_view name,
+                                   absl::FunctionRef<std::vector<int>()> build);
+
+  // Same as above, but the section mapped from the file is used only if
+  // `validate` returns true for it. Otherwise the section is rebuilt and
+  // replaces the mapped one, including in the file written by Save(). The
+  // built section is not validated.
+  absl::Span<const int> GetOrBuild(
+      absl::string_view name, absl::FunctionRef<std::vector<int>()> build,
+      absl::FunctionRef<bool(absl::Span<const int>)> validate);
+
+  // Returns true if some sections were built by GetOrBuild(), i.e. the cache
+  // file needs to be updated.
+  bool has_built_sections() const { return !built_sections_.empty(); }
+
+  // Writes all the sections to `filename`. The file is replaced atomically so
+  // that the processes mapping the previous file are not affected.
+  absl::Status Save(zstring_view filename) const;
+
+ private:
+  struct Section {
+    absl::Span<const int> data;
+    // True if `data` is built or has been verified by the checksum and the
+    // validator.
+    bool verified = false;
+    // Checksum of `data` to be written in the file. For a mapped section, it
+    // is the one read from the file.
+    uint32_t checksum = 0;
+  };
+
+  std::string key_;
+  Mmap mmap_;
+  absl::btree_map<std::string, Section> sections_;
+  // The buffers of the vectors are not moved when this vector grows.
+  std::vector<std::vector<int>> built_sections_;
+};
+
+}  // namespace storage
+}  // namespace mozc
+
+#endif  // MOZC_STORAGE_DERIVED_DATA_CACHE_H_
@@ -0,0 +1,205 @@
+// Copyright 2010-2021, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "storage/derived_data_cache.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/status/statusor.h"
+#include "absl/types/span.h"
+#include "base/file_util.h"
+#include "base/system_util.h"
+#include "testing/gmock.h"
+#include "testing/gunit.h"
+#include "testing/mozctest.h"
+
+namespace mozc {
+namespace storage {
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::IsEmpty;
+
+class DerivedDataCacheTest : public testing::TestWithTempUserProfile {
+ protected:
+  void SetUp() override {
+    filename_ = FileUtil::JoinPath(SystemUtil::GetUserProfileDirectory(),
+                                   "derived_data.cache");
+  }
+
+  std::string filename_;
+};
+
+TEST_F(DerivedDataCacheTest, BuildsMissingSections) {
+  std::unique_ptr<DerivedDataCache> cache =
+      DerivedDataCache::Open(filename_, "version");
+  EXPECT_FALSE(cache->has_built_sections());
+
+  int num_builds = 0;
+  const auto build = [&num_builds]() {
+    ++num_builds;
+    return std::vector<int>{1, 2, 3};
+  };
+  EXPECT_THAT(cache->GetOrBuild("a", build), ElementsAre(1, 2, 3));
+  EXPECT_EQ(num_builds, 1);
+  EXPECT_TRUE(cache->has_built_sections());
+
+  // The built section is reused.
+  EXPECT_THAT(cache->GetOrBuild("a", build), ElementsAre(1, 2, 3));
+  EXPECT_EQ(num_builds, 1);
+}
+
+TEST_F(DerivedDataCacheTest, SaveAndOpen) {
+  {
+    DerivedDataCache cache("version");
+    cache.GetOrBuild("a", []() { return std::vector<int>{1, 2, 3}; });
+    cache.GetOrBuild("b", []() { return std::vector<int>(); });
+    cache.GetOrBuild("c", []() { return std::vector<int>{-1}; });
+    ASSERT_OK(cache.Save(filename_));
+  }
+
+  std::unique_ptr<DerivedDataCache> cache =
+      DerivedDataCache::Open(filename_, "version");
+  const auto fail = []() -> std::vector<int> {
+    ADD_FAILURE() << "Section is not mapped";
+    return {};
+  };
+  const absl::Span<const int> a = cache->GetOrBuild("a", fail);
+  EXPECT_THAT(a, ElementsAre(1, 2, 3));
+  // The sections are aligned for int.
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(a.data()) % alignof(int), 0);
+  EXPECT_THAT(cache->GetOrBuild("b", fail), IsEmpty());
+  EXPECT_THAT(cache->GetOrBuild("c", fail), ElementsAre(-1));
+  EXPECT_FALSE(cache->has_built_sections());
+
+  // A new section is added to the mapped ones.
+  EXPECT_THAT(
+      cache->GetOrBuild("d", []() { return std::vector<int>{4, 5}; }),
+      ElementsAre(4, 5));
+  EXPECT_TRUE(cache->has_built_sections());
+  ASSERT_OK(cache->Save(filename_));
+
+  // The file is replaced while the previous one is still mapped.
+  EXPECT_THAT(a, ElementsAre(1, 2, 3));
+  cache = DerivedDataCache::Open(filename_, "version");
+  EXPECT_THAT(cache->GetOrBuild("a", fail), ElementsAre(1, 2, 3));
+  EXPECT_THAT(cache->GetOrBuild("d", fail), ElementsAre(4, 5));
+}
+
+TEST_F(DerivedDataCacheTest, KeyMismatch) {
+  {
+    DerivedDataCache cache("version1");
+    cache.GetOrBuild("a", []() { return std::vector<int>{1}; });
+    ASSERT_OK(cache.Save(filename_));
+  }
+
+  std::unique_ptr<DerivedDataCache> cache =
+      DerivedDataCache::Open(filename_, "version2");
+  EXPECT_THAT(cache->GetOrBuild("a", []() { return std::vector<int>{2}; }),
+              ElementsAre(2));
+  EXPECT_TRUE(cache->has_built_sections());
+}
+
+TEST_F(DerivedDataCacheTest, BrokenFile) {
+  {
+    DerivedDataCache cache("version");
+    cache.GetOrBuild("a", []() { return std::vector<int>{1, 2, 3}; });
+    ASSERT_OK(cache.Save(filename_));
+  }
+  absl::StatusOr<std::string> contents = FileUtil::GetContents(filename_);
+  ASSERT_OK(contents);
+  // Truncates the section data.
+  contents->resize(contents->size() - sizeof(int));
+  ASSERT_OK(FileUtil::SetContents(filename_, *contents));
+
+  std::unique_ptr<DerivedDataCache> cache =
+      DerivedDataCache::Open(filename_, "version");
+  EXPECT_THAT(cache->GetOrBuild("a", []() { return std::vector<int>{4}; }),
+              ElementsAre(4));
+}
+
+TEST_F(DerivedDataCacheTest, ChecksumMismatch) {
+  {
+    DerivedDataCache cache("version");
+    cache.GetOrBuild("a", []() { return std::vector<int>{1, 2, 3}; });
+    ASSERT_OK(cache.Save(filename_));
+  }
+  absl::StatusOr<std::string> contents = FileUtil::GetContents(filename_);
+  ASSERT_OK(contents);
+  // Breaks the last value of the section data.
+  contents->back() ^= 1;
+  ASSERT_OK(FileUtil::SetContents(filename_, *contents));
+
+  std::unique_ptr<DerivedDataCache> cache =
+      DerivedDataCache::Open(filename_, "version");
+  EXPECT_THAT(cache->GetOrBuild("a", []() { return std::vector<int>{4}; }),
+              ElementsAre(4));
+  EXPECT_TRUE(cache->has_built_sections());
+}
+
+TEST_F(DerivedDataCacheTest, RejectedSectionIsReplaced) {
+  {
+    DerivedDataCache cache("version");
+    cache.GetOrBuild("a", []() { return std::vector<int>{1, 2, 3}; });
+    cache.GetOrBuild("b", []() { return std::vector<int>{5}; });
+    ASSERT_OK(cache.Save(filename_));
+  }
+
+  const auto reject = [](absl::Span<const int> section) { return false; };
+  const auto accept = [](absl::Span<const int> section) { return true; };
+  const auto fail = []() -> std::vector<int> {
+    ADD_FAILURE() << "Section is not mapped";
+    return {};
+  };
+  {
+    std::unique_ptr<DerivedDataCache> cache =
+        DerivedDataCache::Open(filename_, "version");
+    EXPECT_THAT(
+        cache->GetOrBuild(
+            "a", []() { return std::vector<int>{4}; }, reject),
+        ElementsAre(4));
+    EXPECT_THAT(cache->GetOrBuild("b", fail, accept), ElementsAre(5));
+    EXPECT_TRUE(cache->has_built_sections());
+    ASSERT_OK(cache->Save(filename_));
+  }
+
+  // The rejected section is not written again.
+  std::unique_ptr<DerivedDataCache> cache =
+      DerivedDataCache::Open(filename_, "version");
+  EXPECT_THAT(cache->GetOrBuild("a", fail, accept), ElementsAre(4));
+  EXPECT_THAT(cache->GetOrBuild("b", fail, accept), ElementsAre(5));
+  EXPECT_FALSE(cache->has_built_sections());
+}
+
+}  // namespace
+}  // namespace storage
+}  // namespace mozc
@@ -30,18 +30,27 @@
 #include "storage/encrypted_string_storage.h"
 
 #include <cstddef>
+#include <cstdint>
 #include <ios>
+#include <ostream>
 #include <string>
+#include <utility>
+#include <vector>
 
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
 #include "absl/log/check.h"
 #include "absl/log/log.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
 #include "base/encryptor.h"
 #include "base/file_stream.h"
 #include "base/file_util.h"
 #include "base/mmap.h"
 #include "base/password_manager.h"
+#include "base/singleton.h"
 #include "base/vlog.h"
 
 #ifdef _WIN32
@@ -57,60 +66,94 @@ constexpr size_t kSaltSize = 32;
 
 // Maximum file size (64Mbyte)
 constexpr size_t kMaxFileSize = 64 * 1024 * 1024;
-}  // namespace
-
-bool EncryptedStringStorage::Load(std::string *output) const {
-  DCHECK(output);
 
-  std::string salt;
+// Size of the header of a journal record, which stores the size of the
+// encrypted body in little endian.
+constexpr size_t kRecordHeaderSize = 4;
+
+// Upper bound of the number of the keys in KeyCache. The cache is cleared when
+// it gets full.
+constexpr size_t kMaxCachedKeys = 256;
+
+// Size of the chunks of EncryptedStringStorage to be encrypted or decrypted at
+// once. This bounds the size of the temporary buffers; the chunks are processed
+// sequentially on the calling thread.
+constexpr size_t kChunkSize = 64 * 1024;
+
+// Cache of the keys derived from the password for each salt, which lives for
+// the process lifetime. Save() always generates a new salt, so it never hits
+// the cache; it only adds the key. The cache hits when the saved data, or a
+// journal record, is read back with the same salt in this process. Then
+// reading the password file, which the OS also decrypts on Windows and macOS,
+// and the key derivation are skipped.
+class KeyCache {
+ public:
+  bool GetKey(const std::string &salt, Encryptor::Key *key) {
+    {
+      absl::MutexLock l(&mutex_);
+      if (const auto it = keys_.find(salt); it != keys_.end()) {
+        *key = it->second;
+        return true;
+      }
+    }
 
-  // Reads encrypted message and salt from local file
-  {
-    const absl::StatusOr<Mmap> mmap = Mmap::Map(filename_, Mmap::READ_ONLY);
-    if (!mmap.ok()) {
-      LOG(ERROR) << "cannot open user history file: " << mmap.status();
+    std::string password;
+    if (!PasswordManager::GetPassword(&password)) {
+      LOG(ERROR) << "PasswordManager::GetPassword() failed";
       return false;
     }
 
-    if (mmap->size() < kSaltSize) {
-      LOG(ERROR) << "file size is too small";
+    if (password.empty()) {
+      LOG(ERROR) << "password is empty";
       return false;
     }
 
-    if (mmap->size() > kMaxFileSize) {
-      LOG(ERROR) << "file size is too big.";
+    Encryptor::Key derived_key;
+    if (!derived_key.DeriveFromPassword(password, salt)) {
+      LOG(ERROR) << "Encryptor::Key::DeriveFromPassword() failed";
       return false;
     }
 
-    // copy salt
-    salt.assign(mmap->begin(), kSaltSize);
-
-    // copy body
-    output->assign(mmap->begin() + kSaltSize, mmap->size() - kSaltSize);
+    absl::MutexLock l(&mutex_);
+    if (keys_.size() >= kMaxCachedKeys) {
+      keys_.clear();
+    }
+    keys_.emplace(salt, derived_key);
+    *key = derived_key;
+    return true;
   }
 
-  return Decrypt(salt, output);
+ private:
+  absl::Mutex mutex_;
+  absl::flat_hash_map<std::string, Encryptor::Key> keys_
+      ABSL_GUARDED_BY(mutex_);
+};
+
+bool GetKey(const std::string &salt, Encryptor::Key *key) {
+  return Singleton<KeyCache>::get()->GetKey(salt, key);
 }
 
-bool EncryptedStringStorage::Decrypt(const std::string &salt,
-                                     std::string *data) const {
+bool EncryptWithSalt(const std::string &salt, std::string *data) {
   DCHECK(data);
 
-  std::string password;
-  if (!PasswordManager::GetPassword(&password)) {
-    LOG(ERROR) << "PasswordManager::GetPassword() failed";
+  Encryptor::Key key;
+  if (!GetKey(salt, &key)) {
     return false;
   }
 
-  if (password.empty()) {
-    LOG(ERROR) << "password is empty";
+  if (!Encryptor::EncryptString(key, data)) {
+    LOG(ERROR) << "Encryptor::EncryptString() failed";
     return false;
   }
 
-  // Decrypt message
+  return true;
+}
+
+bool DecryptWithSalt(const std::string &salt, std::string *data) {
+  DCHECK(data);
+
   Encryptor::Key key;
-  if (!key.DeriveFromPassword(password, salt)) {
-    LOG(ERROR) << "Encryptor::Key::DeriveFromPassword failed";
+  if (!GetKey(salt, &key)) {
     return false;
   }
 
@@ -122,18 +165,72 @@ bool EncryptedStringStorage::Decrypt(const std::string &salt,
   return true;
 }
 
-bool EncryptedStringStorage::Save(const std::string &input) const {
-  // Generate salt.
-  const std::string salt = random_.ByteString(kSaltSize);
+#ifdef _WIN32
+void HideFile(const std::string &filename) {
+  if (!FileUtil::HideFile(filename)) {
+    LOG(ERROR) << "Cannot make hidden: " << filename << " " << ::GetLastError();
+  }
+}
+#endif  // _WIN32
+}  // namespace
+
+bool EncryptedStringStorage::Load(std::string *output) const {
+  DCHECK(output);
+
+  // Reads encrypted message and salt from local file
+  const absl::StatusOr<Mmap> mmap = Mmap::Map(filename_, Mmap::READ_ONLY);
+  if (!mmap.ok()) {
+    LOG(ERROR) << "cannot open user history file: " << mmap.status();
+    return false;
+  }
+
+  if (mmap->size() < kSaltSize) {
+    LOG(ERROR) << "file size is too small";
+    return false;
+  }
 
-  std::string output(input);
-  if (!Encrypt(salt, &output)) {
+  if (mmap->size() > kMaxFileSize) {
+    LOG(ERROR) << "file size is too big.";
+    return false;
+  }
+
+  const std::string salt(mmap->begin(), kSaltSize);
+  const absl::string_view body(mmap->begin() + kSaltSize,
+                               mmap->size() - kSaltSize);
+  return Decrypt(salt, body, output);
+}
+
+bool EncryptedStringStorage::Decrypt(const std::string &salt,
+                                     absl::string_view input,
+                                     std::string *output) const {
+  Encryptor::Key key;
+  if (!GetKey(salt, &key)) {
     return false;
   }
 
+  // Decrypts the mapped file chunk by chunk. The pages of a chunk are read on
+  // first access, so the I/O is not overlapped with the decryption.
+  Encryptor::StreamDecrypter decrypter(key);
+  output->clear();
+  output->reserve(input.size());
+  for (size_t pos = 0; pos < input.size(); pos += kChunkSize) {
+    decrypter.Update(input.substr(pos, kChunkSize), output);
+  }
+  if (!decrypter.Finish(output)) {
+    LOG(ERROR) << "Encryptor::StreamDecrypter::Finish() failed";
+    return false;
+  }
+  return true;
+}
+
+bool EncryptedStringStorage::Save(const std::string &input) const {
+  // Generate salt.
+  const std::string salt = random_.ByteString(kSaltSize);
+
   // Even if histoy is empty, save to them into a file to
   // make the file empty
   const std::string tmp_filename = filename_ + ".tmp";
+  bool encrypted = false;
   {
     OutputFileStream ofs(tmp_filename, std::ios::out | std::ios::binary);
     if (!ofs) {
@@ -143,7 +240,14 @@ bool EncryptedStringStorage::Save(const std::string &input) const {
 
     MOZC_VLOG(1) << "Syncing user history to: " << filename_;
     ofs.write(salt.data(), salt.size());
-    ofs.write(output.data(), output.size());
+    encrypted = Encrypt(salt, input, &ofs);
+  }
+
+  if (!encrypted) {
+    if (absl::Status s = FileUtil::UnlinkIfExists(tmp_filename); !s.ok()) {
+      LOG(ERROR) << "cannot remove " << tmp_filename << ": " << s;
+    }
+    return false;
   }
 
   if (absl::Status s = FileUtil::AtomicRename(tmp_filename, filename_);
@@ -154,43 +258,154 @@ bool EncryptedStringStorage::Save(const std::string &input) const {
   }
 
 #ifdef _WIN32
-  if (!FileUtil::HideFile(filename_)) {
-    LOG(ERROR) << "Cannot make hidden: " << filename_ << " "
-               << ::GetLastError();
-  }
+  HideFile(filename_);
 #endif  // _WIN32
 
   return true;
 }
 
 bool EncryptedStringStorage::Encrypt(const std::string &salt,
-                                     std::string *data) const {
-  DCHECK(data);
+                                     absl::string_view input,
+                                     std::ostream *output) const {
+  if (input.empty()) {
+    LOG(ERROR) << "data is empty";
+    return false;
+  }
 
-  std::string password;
-  if (!PasswordManager::GetPassword(&password)) {
-    LOG(ERROR) << "PasswordManager::GetPassword() failed";
+  Encryptor::Key key;
+  if (!GetKey(salt, &key)) {
     return false;
   }
 
-  if (password.empty()) {
-    LOG(ERROR) << "password is empty";
+  // Encrypts and writes the data chunk by chunk, so that the whole data is
+  // neither copied nor encrypted before the file I/O starts.
+  Encryptor::StreamEncrypter encrypter(key);
+  std::string buf;
+  buf.reserve(kChunkSize + Encryptor::kBlockSize);
+  for (size_t pos = 0; pos < input.size(); pos += kChunkSize) {
+    buf.clear();
+    encrypter.Update(input.substr(pos, kChunkSize), &buf);
+    output->write(buf.data(), buf.size());
+  }
+  buf.clear();
+  encrypter.Finish(&buf);
+  output->write(buf.data(), buf.size());
+  return output->good();
+}
+
+bool EncryptedJournalStorage::Load(std::vector<std::string> *records) const {
+  DCHECK(records);
+  records->clear();
+
+  if (absl::Status s = FileUtil::FileExists(filename_); !s.ok()) {
+    if (absl::IsNotFound(s)) {
+      return true;
+    }
+    LOG(ERROR) << "cannot access journal file: " << s;
     return false;
   }
 
-  Encryptor::Key key;
-  if (!key.DeriveFromPassword(password, salt)) {
-    LOG(ERROR) << "Encryptor::Key::DeriveFromPassword() failed";
+  const absl::StatusOr<Mmap> mmap = Mmap::Map(filename_, Mmap::READ_ONLY);
+  if (!mmap.ok()) {
+    LOG(ERROR) << "cannot open journal file: " << mmap.status();
     return false;
   }
 
-  if (!Encryptor::EncryptString(key, data)) {
-    LOG(ERROR) << "Encryptor::EncryptString() failed";
+  if (mmap->size() > kMaxFileSize) {
+    LOG(ERROR) << "file size is too big.";
+    return false;
+  }
+
+  absl::string_view data(mmap->begin(), mmap->size());
+  while (!data.empty()) {
+    if (data.size() < kRecordHeaderSize + kSaltSize) {
+      LOG(ERROR) << "journal record is truncated";
+      return false;
+    }
+    size_t body_size = 0;
+    for (size_t i = 0; i < kRecordHeaderSize; ++i) {
+      body_size |= static_cast<size_t>(static_cast<uint8_t>(data[i]))
+                   << (8 * i);
+    }
+    data.remove_prefix(kRecordHeaderSize);
+    if (data.size() < kSaltSize + body_size) {
+      LOG(ERROR) << "journal record is truncated";
+      return false;
+    }
+    const std::string salt(data.substr(0, kSaltSize));
+    std::string body(data.substr(kSaltSize, body_size));
+    data.remove_prefix(kSaltSize + body_size);
+    if (!Decrypt(salt, &body)) {
+      LOG(ERROR) << "journal record is broken";
+      return false;
+    }
+    records->push_back(std::move(body));
+  }
+
+  return true;
+}
+
+bool EncryptedJournalStorage::Append(const absl::string_view record) const {
+  const std::string salt = random_.ByteString(kSaltSize);
+
+  std::string body(record);
+  if (!Encrypt(salt, &body)) {
     return false;
   }
 
+  char header[kRecordHeaderSize];
+  for (size_t i = 0; i < kRecordHeaderSize; ++i) {
+    header[i] = static_cast<char>((body.size() >> (8 * i)) & 0xff);
+  }
+
+#ifdef _WIN32
+  const bool is_new_file = !FileUtil::FileExists(filename_).ok();
+#endif  // _WIN32
+
+  {
+    OutputFileStream ofs(filename_,
+                         std::ios::out | std::ios::app | std::ios::binary);
+    if (!ofs) {
+      LOG(ERROR) << "failed to write: " << filename_;
+      return false;
+    }
+
+    MOZC_VLOG(1) << "Appending a journal record to: " << filename_;
+    ofs.write(header, kRecordHeaderSize);
+    ofs.write(salt.data(), salt.size());
+    ofs.write(body.data(), body.size());
+    if (!ofs.flush()) {
+      LOG(ERROR) << "failed to write: " << filename_;
+      return false;
+    }
+  }
+
+#ifdef _WIN32
+  if (is_new_file) {
+    HideFile(filename_);
+  }
+#endif  // _WIN32
+
+  return true;
+}
+
+bool EncryptedJournalStorage::Remove() const {
+  if (absl::Status s = FileUtil::UnlinkIfExists(filename_); !s.ok()) {
+    LOG(ERROR) << "cannot remove journal file: " << s;
+    return false;
+  }
   return true;
 }
 
+bool EncryptedJournalStorage::Encrypt(const std::string &salt,
+                                      std::string *data) const {
+  return EncryptWithSalt(salt, data);
+}
+
+bool EncryptedJournalStorage::Decrypt(const std::string &salt,
+                                      std::string *data) const {
+  return DecryptWithSalt(salt, data);
+}
+
 }  // namespace storage
 }  // namespace mozc
@@ -30,7 +30,9 @@
 #ifndef MOZC_STORAGE_ENCRYPTED_STRING_STORAGE_H_
 #define MOZC_STORAGE_ENCRYPTED_STRING_STORAGE_H_
 
+#include <ostream>
 #include <string>
+#include <vector>
 
 #include "absl/strings/string_view.h"
 #include "base/random.h"
@@ -56,6 +58,43 @@ class EncryptedStringStorage : public StringStorageInterface {
   bool Load(std::string *output) const override;
   bool Save(const std::string &input) const override;
 
+ protected:
+  // Encrypts |input| and writes the result to |output|.
+  virtual bool Encrypt(const std::string &salt, absl::string_view input,
+                       std::ostream *output) const;
+  // Decrypts |input| into |output|.
+  virtual bool Decrypt(const std::string &salt, absl::string_view input,
+                       std::string *output) const;
+
+ private:
+  std::string filename_;
+  mutable mozc::Random random_;
+};
+
+// Append-only log of encrypted records. Unlike EncryptedStringStorage, which
+// rewrites the whole file on every save, a record can be appended without
+// reading or rewriting the existing ones. Each record is encrypted with its
+// own salt. A record truncated by a crash is ignored on load together with the
+// records following it.
+class EncryptedJournalStorage {
+ public:
+  explicit EncryptedJournalStorage(const absl::string_view filename)
+      : filename_(filename) {}
+  EncryptedJournalStorage(const EncryptedJournalStorage &) = delete;
+  EncryptedJournalStorage &operator=(const EncryptedJournalStorage &) = delete;
+  virtual ~EncryptedJournalStorage() = default;
+
+  // Loads all the records in the appended order. Returns true with no records
+  // if the file doesn't exist. Returns false if the file is broken, in which
+  // case |records| has the records before the broken one.
+  bool Load(std::vector<std::string> *records) const;
+
+  // Appends |record| to the end of the file. |record| must not be empty.
+  bool Append(absl::string_view record) const;
+
+  // Removes the file. Returns true if the file doesn't exist.
+  bool Remove() const;
+
  protected:
   virtual bool Encrypt(const std::string &salt, std::string *data) const;
   virtual bool Decrypt(const std::string &salt, std::string *data) const;
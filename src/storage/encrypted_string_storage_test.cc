@@ -33,11 +33,16 @@
 #include <ios>
 #include <iostream>
 #include <memory>
+#include <ostream>
 #include <string>
+#include <vector>
 
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
 #include "base/file_stream.h"
 #include "base/file_util.h"
 #include "base/system_util.h"
+#include "testing/gmock.h"
 #include "testing/gunit.h"
 #include "testing/mozctest.h"
 
@@ -55,19 +60,21 @@ class TestEncryptedStringStorage : public EncryptedStringStorage {
       : EncryptedStringStorage(filename) {}
 
  protected:
-  virtual bool Encrypt(const std::string &salt, std::string *data) const {
+  bool Encrypt(const std::string &salt, absl::string_view input,
+               std::ostream *output) const override {
     salt_ = salt;
-    original_data_ = *data;
-    *data = "123456789012345678901234567890";
+    original_data_ = std::string(input);
+    *output << "123456789012345678901234567890";
     return true;
   }
 
-  virtual bool Decrypt(const std::string &salt, std::string *data) const {
+  bool Decrypt(const std::string &salt, absl::string_view input,
+               std::string *output) const override {
     if (salt_ != salt) {
       return false;
     }
-    CHECK_EQ(*data, "123456789012345678901234567890");
-    *data = original_data_;
+    CHECK_EQ(input, "123456789012345678901234567890");
+    *output = original_data_;
     return true;
   }
 
@@ -126,6 +133,87 @@ TEST_F(EncryptedStringStorageTest, Encrypt) {
   EXPECT_LT(original_data.size(), result.size());
   EXPECT_TRUE(result.find(original_data) == std::string::npos);
 }
+
+TEST_F(EncryptedStringStorageTest, SaveAndLoadLargeData) {
+  // Larger than the chunk size of the encryption.
+  std::string data;
+  for (int i = 0; i < 100000; ++i) {
+    data += static_cast<char>(i % 251);
+  }
+  ASSERT_TRUE(storage_->Save(data));
+
+  std::string output;
+  ASSERT_TRUE(storage_->Load(&output));
+  EXPECT_EQ(output, data);
+
+  // Another instance can read the file.
+  EncryptedStringStorage storage(filename_);
+  output.clear();
+  ASSERT_TRUE(storage.Load(&output));
+  EXPECT_EQ(output, data);
+}
+
+TEST_F(EncryptedStringStorageTest, LoadBrokenFile) {
+  ASSERT_TRUE(storage_->Save("abcdefghijklmnopqrstuvwxyz"));
+  absl::StatusOr<std::string> contents = FileUtil::GetContents(filename_);
+  ASSERT_OK(contents);
+  contents->resize(contents->size() - 1);
+  ASSERT_OK(FileUtil::SetContents(filename_, *contents));
+
+  std::string output;
+  EXPECT_FALSE(storage_->Load(&output));
+}
+
+TEST_F(EncryptedStringStorageTest, SaveEmptyData) {
+  EXPECT_FALSE(storage_->Save(""));
+  EXPECT_FALSE(FileUtil::FileExists(filename_ + ".tmp").ok());
+}
+
+class EncryptedJournalStorageTest : public testing::TestWithTempUserProfile {
+ protected:
+  void SetUp() override {
+    filename_ = FileUtil::JoinPath(SystemUtil::GetUserProfileDirectory(),
+                                   "encrypted_journal_storage_for_test.db");
+  }
+
+  std::string filename_;
+};
+
+TEST_F(EncryptedJournalStorageTest, AppendAndLoad) {
+  EncryptedJournalStorage storage(filename_);
+
+  std::vector<std::string> records = {"dummy"};
+  ASSERT_TRUE(storage.Load(&records));
+  EXPECT_TRUE(records.empty());
+
+  ASSERT_TRUE(storage.Append("abcdefghijklmnopqrstuvwxyz"));
+  ASSERT_TRUE(storage.Append("0123456789"));
+
+  ASSERT_TRUE(storage.Load(&records));
+  EXPECT_THAT(records, ::testing::ElementsAre("abcdefghijklmnopqrstuvwxyz",
+                                              "0123456789"));
+
+  ASSERT_TRUE(storage.Remove());
+  ASSERT_TRUE(storage.Load(&records));
+  EXPECT_TRUE(records.empty());
+  EXPECT_TRUE(storage.Remove());
+}
+
+TEST_F(EncryptedJournalStorageTest, TruncatedRecord) {
+  EncryptedJournalStorage storage(filename_);
+  ASSERT_TRUE(storage.Append("abcdefghijklmnopqrstuvwxyz"));
+  ASSERT_TRUE(storage.Append("0123456789"));
+
+  // Simulates a crash while appending the second record.
+  absl::StatusOr<std::string> contents = FileUtil::GetContents(filename_);
+  ASSERT_OK(contents);
+  contents->resize(contents->size() - 3);
+  ASSERT_OK(FileUtil::SetContents(filename_, *contents));
+
+  std::vector<std::string> records;
+  EXPECT_FALSE(storage.Load(&records));
+  EXPECT_THAT(records, ::testing::ElementsAre("abcdefghijklmnopqrstuvwxyz"));
+}
 #endif  // __ANDROID__
 
 }  // namespace storage
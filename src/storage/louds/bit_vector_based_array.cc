@@ -33,7 +33,9 @@
 #include <cstdint>
 
 #include "absl/log/check.h"
+#include "absl/strings/string_view.h"
 #include "base/bits.h"
+#include "storage/derived_data_cache.h"
 #include "storage/louds/simple_succinct_bit_vector_index.h"
 
 namespace mozc {
@@ -48,13 +50,23 @@ constexpr size_t kLb1CacheSize = 0;
 }  // namespace
 
 void BitVectorBasedArray::Open(const uint8_t *image) {
+  Open(image, nullptr, "");
+}
+
+void BitVectorBasedArray::Open(const uint8_t *image, DerivedDataCache *cache,
+                               absl::string_view name) {
   const int index_length = LoadUnalignedAdvance<uint32_t>(image);
   const int base_length = LoadUnalignedAdvance<uint32_t>(image);
   const int step_length = LoadUnalignedAdvance<uint32_t>(image);
   // Check 0 padding.
   CHECK_EQ(LoadUnalignedAdvance<uint32_t>(image), 0);
 
-  index_.Init(image, index_length, kLb0CacheSize, kLb1CacheSize);
+  if (cache == nullptr) {
+    index_.Init(image, index_length, kLb0CacheSize, kLb1CacheSize);
+  } else {
+    index_.Init(image, index_length, kLb0CacheSize, kLb1CacheSize, cache,
+                name);
+  }
   base_length_ = base_length;
   step_length_ = step_length;
   data_ = reinterpret_cast<const char *>(image + index_length);
@@ -33,6 +33,8 @@
 #include <cstddef>
 #include <cstdint>
 
+#include "absl/strings/string_view.h"
+#include "storage/derived_data_cache.h"
 #include "storage/louds/simple_succinct_bit_vector_index.h"
 
 namespace mozc {
@@ -48,6 +50,9 @@ class BitVectorBasedArray {
   BitVectorBasedArray &operator=(const BitVectorBasedArray &) = delete;
 
   void Open(const uint8_t *image);
+  // Same as above, but the index is obtained from `cache` under `name`.
+  void Open(const uint8_t *image, DerivedDataCache *cache,
+            absl::string_view name);
   void Close();
 
   // Returns a pointer to the element and its length.
@@ -31,6 +31,13 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <vector>
+
+#include "absl/log/check.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
+#include "storage/derived_data_cache.h"
 
 namespace mozc {
 namespace storage {
@@ -40,7 +47,30 @@ void Louds::Init(const uint8_t *image, int length, size_t bitvec_lb0_cache_size,
                  size_t bitvec_lb1_cache_size, size_t select0_cache_size,
                  size_t select1_cache_size) {
   index_.Init(image, length, bitvec_lb0_cache_size, bitvec_lb1_cache_size);
+  SetSelectCacheSizes(select0_cache_size, select1_cache_size);
+  select_cache_storage_ = BuildSelectCache();
+  SetSelectCache(select_cache_storage_);
+}
 
+void Louds::Init(const uint8_t *image, int length, size_t bitvec_lb0_cache_size,
+                 size_t bitvec_lb1_cache_size, size_t select0_cache_size,
+                 size_t select1_cache_size, DerivedDataCache *cache,
+                 absl::string_view name) {
+  index_.Init(image, length, bitvec_lb0_cache_size, bitvec_lb1_cache_size,
+              cache, absl::StrCat(name, "/index"));
+  SetSelectCacheSizes(select0_cache_size, select1_cache_size);
+  const absl::Span<const int> select_cache = cache->GetOrBuild(
+      absl::StrCat(name, "/select"), [this]() { return BuildSelectCache(); },
+      [this](absl::Span<const int> select_cache) {
+        return IsValidSelectCache(select_cache);
+      });
+  CHECK(IsValidSelectCache(select_cache)) << name;
+  select_cache_storage_.clear();
+  SetSelectCache(select_cache);
+}
+
+void Louds::SetSelectCacheSizes(size_t select0_cache_size,
+                                size_t select1_cache_size) {
   // Cap the cache sizes.
   if (select0_cache_size > index_.GetNum0Bits()) {
     select0_cache_size = index_.GetNum0Bits();
@@ -48,41 +78,68 @@ void Louds::Init(const uint8_t *image, int length, size_t bitvec_lb0_cache_size,
   if (select1_cache_size > index_.GetNum1Bits()) {
     select1_cache_size = index_.GetNum1Bits();
   }
+  select0_cache_size_ = select0_cache_size;
+  select1_cache_size_ = select1_cache_size;
+}
 
+std::vector<int> Louds::BuildSelectCache() const {
   // Initialize Select0 and Select1 cache for speed.  In LOUDS traversal, nodes
   // close to the root are frequently accessed.  Thus, we precompute select0 and
   // select1 values for such nodes.  Since node IDs are assigned in BFS order,
   // the nodes close to the root are assigned smaller IDs.  Hence, a simple
   // array can be used for the mapping from ID to cached value.
-  select0_cache_size_ = select0_cache_size;
-  select1_cache_size_ = select1_cache_size;
-  const size_t cache_size = select0_cache_size + select1_cache_size;
-  if (cache_size == 0) {
-    return;
-  }
-  select_cache_.reset(new int[cache_size]);
+  std::vector<int> select_cache(select0_cache_size_ + select1_cache_size_);
 
-  if (select0_cache_size > 0) {
+  if (select0_cache_size_ > 0) {
     // Precompute Select0(i) + 1 for i in (0, select0_cache_size).
-    select_cache_[0] = 0;
-    for (size_t i = 1; i < select0_cache_size; ++i) {
-      select_cache_[i] = index_.Select0(i) + 1;
+    select_cache[0] = 0;
+    for (size_t i = 1; i < select0_cache_size_; ++i) {
+      select_cache[i] = index_.Select0(i) + 1;
     }
   }
 
-  if (select1_cache_size > 0) {
+  if (select1_cache_size_ > 0) {
     // Precompute Select1(i) for i in (0, select1_cache_size).
-    select1_cache_ptr_ = select_cache_.get() + select0_cache_size;
-    select1_cache_ptr_[0] = 0;
-    for (size_t i = 1; i < select1_cache_size; ++i) {
-      select1_cache_ptr_[i] = index_.Select1(i);
+    int *select1_cache = select_cache.data() + select0_cache_size_;
+    select1_cache[0] = 0;
+    for (size_t i = 1; i < select1_cache_size_; ++i) {
+      select1_cache[i] = index_.Select1(i);
     }
   }
+  return select_cache;
+}
+
+bool Louds::IsValidSelectCache(absl::Span<const int> select_cache) const {
+  if (select_cache.size() != select0_cache_size_ + select1_cache_size_) {
+    return false;
+  }
+  // Both of the caches start with 0 and are strictly increasing positions in
+  // the bit vector (Select0() + 1 may point to the end of it).
+  const int64_t num_bits =
+      static_cast<int64_t>(index_.GetNum0Bits()) + index_.GetNum1Bits();
+  auto is_valid = [num_bits](absl::Span<const int> cache) {
+    for (size_t i = 0; i < cache.size(); ++i) {
+      if (i == 0 ? cache[i] != 0
+                 : cache[i] <= cache[i - 1] || cache[i] > num_bits) {
+        return false;
+      }
+    }
+    return true;
+  };
+  return is_valid(select_cache.subspan(0, select0_cache_size_)) &&
+         is_valid(select_cache.subspan(select0_cache_size_));
+}
+
+void Louds::SetSelectCache(absl::Span<const int> select_cache) {
+  select_cache_ = select_cache.data();
+  select1_cache_ptr_ = select_cache.data() + select0_cache_size_;
 }
 
 void Louds::Reset() {
   index_.Reset();
-  select_cache_.reset();
+  select_cache_ = nullptr;
+  select1_cache_ptr_ = nullptr;
+  select_cache_storage_.clear();
   select0_cache_size_ = 0;
   select1_cache_size_ = 0;
 }
@@ -105,6 +105,7 @@
       ],
       'dependencies': [
         '<(mozc_oss_src_dir)/base/base.gyp:base',
+        '<(mozc_oss_src_dir)/storage/storage.gyp:derived_data_cache',
       ],
     },
     # Bit stream implementation for builders.
@@ -32,8 +32,11 @@
 
 #include <cstddef>
 #include <cstdint>
-#include <memory>
+#include <vector>
 
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
+#include "storage/derived_data_cache.h"
 #include "storage/louds/simple_succinct_bit_vector_index.h"
 
 namespace mozc {
@@ -96,6 +99,13 @@ class Louds {
             size_t bitvec_lb1_cache_size, size_t select0_cache_size,
             size_t select1_cache_size);
 
+  // Same as above, but the bit vector index and the select caches are obtained
+  // from `cache` under the names prefixed by `name`.
+  void Init(const uint8_t *image, int length, size_t bitvec_lb0_cache_size,
+            size_t bitvec_lb1_cache_size, size_t select0_cache_size,
+            size_t select1_cache_size, DerivedDataCache *cache,
+            absl::string_view name);
+
   // Explicitly clears the internal bit array.
   void Reset();
 
@@ -158,11 +168,23 @@ class Louds {
   }
 
  private:
+  // Caps the select cache sizes by the number of bits.
+  void SetSelectCacheSizes(size_t select0_cache_size,
+                           size_t select1_cache_size);
+  // Computes the select caches of the current sizes.
+  std::vector<int> BuildSelectCache() const;
+  void SetSelectCache(absl::Span<const int> select_cache);
+  // Returns true if `select_cache` has the current sizes and its values are
+  // plausible positions in the bit vector.
+  bool IsValidSelectCache(absl::Span<const int> select_cache) const;
+
   SimpleSuccinctBitVectorIndex index_;
   size_t select0_cache_size_ = 0;
   size_t select1_cache_size_ = 0;
-  std::unique_ptr<int[]> select_cache_;
-  int *select1_cache_ptr_;  // = select_cache_.get() + select0_cache_size_
+  // Points to either select_cache_storage_ or the section of DerivedDataCache.
+  const int *select_cache_ = nullptr;
+  const int *select1_cache_ptr_ = nullptr;  // = select_cache_ + select0 size
+  std::vector<int> select_cache_storage_;
 };
 
 }  // namespace louds
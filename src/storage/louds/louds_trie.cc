@@ -33,8 +33,10 @@
 #include <cstdint>
 
 #include "absl/log/check.h"
+#include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
 #include "base/bits.h"
+#include "storage/derived_data_cache.h"
 #include "storage/louds/louds.h"
 #include "storage/louds/simple_succinct_bit_vector_index.h"
 
@@ -47,6 +49,17 @@ bool LoudsTrie::Open(const uint8_t *image, size_t louds_lb0_cache_size,
                      size_t louds_select0_cache_size,
                      size_t louds_select1_cache_size,
                      size_t termvec_lb1_cache_size) {
+  return Open(image, louds_lb0_cache_size, louds_lb1_cache_size,
+              louds_select0_cache_size, louds_select1_cache_size,
+              termvec_lb1_cache_size, nullptr, "");
+}
+
+bool LoudsTrie::Open(const uint8_t *image, size_t louds_lb0_cache_size,
+                     size_t louds_lb1_cache_size,
+                     size_t louds_select0_cache_size,
+                     size_t louds_select1_cache_size,
+                     size_t termvec_lb1_cache_size, DerivedDataCache *cache,
+                     absl::string_view name) {
   // Reads a binary image data, which is compatible with rx.
   // The format is as follows:
   // [trie size: little endian 4byte int]
@@ -80,12 +93,22 @@ bool LoudsTrie::Open(const uint8_t *image, size_t louds_lb0_cache_size,
   const uint8_t *terminal_image = louds_image + louds_size;
   const uint8_t *edge_character = terminal_image + terminal_size;
 
-  louds_.Init(louds_image, louds_size, louds_lb0_cache_size,
-              louds_lb1_cache_size, louds_select0_cache_size,
-              louds_select1_cache_size);
-  terminal_bit_vector_.Init(terminal_image, terminal_size,
-                            0,  // Select0 is not carried out.
-                            termvec_lb1_cache_size);
+  if (cache == nullptr) {
+    louds_.Init(louds_image, louds_size, louds_lb0_cache_size,
+                louds_lb1_cache_size, louds_select0_cache_size,
+                louds_select1_cache_size);
+    terminal_bit_vector_.Init(terminal_image, terminal_size,
+                              0,  // Select0 is not carried out.
+                              termvec_lb1_cache_size);
+  } else {
+    louds_.Init(louds_image, louds_size, louds_lb0_cache_size,
+                louds_lb1_cache_size, louds_select0_cache_size,
+                louds_select1_cache_size, cache, absl::StrCat(name, "/louds"));
+    terminal_bit_vector_.Init(terminal_image, terminal_size,
+                              0,  // Select0 is not carried out.
+                              termvec_lb1_cache_size, cache,
+                              absl::StrCat(name, "/terminal"));
+  }
   edge_character_ = reinterpret_cast<const char *>(edge_character);
 
   return true;
@@ -34,6 +34,7 @@
 #include <cstdint>
 
 #include "absl/strings/string_view.h"
+#include "storage/derived_data_cache.h"
 #include "storage/louds/louds.h"
 #include "storage/louds/simple_succinct_bit_vector_index.h"
 
@@ -65,6 +66,14 @@ class LoudsTrie {
 
   bool Open(const uint8_t *data) { return Open(data, 0, 0, 0, 0, 0); }
 
+  // Same as above, but the derived structures, e.g. the bit vector indices,
+  // are obtained from `cache` under the names prefixed by `name`. `cache` needs
+  // to be alive until Close is invoked.
+  bool Open(const uint8_t *image, size_t louds_lb0_cache_size,
+            size_t louds_lb1_cache_size, size_t louds_select0_cache_size,
+            size_t louds_select1_cache_size, size_t termvec_lb1_cache_size,
+            DerivedDataCache *cache, absl::string_view name);
+
   // Destructs the internal data structure explicitly (the destructor will do
   // clean up too).
   void Close();
@@ -37,8 +37,10 @@
 
 #include "absl/log/check.h"
 #include "absl/numeric/bits.h"
+#include "absl/strings/string_view.h"
 #include "absl/types/span.h"
 #include "base/bits.h"
+#include "storage/derived_data_cache.h"
 
 namespace mozc {
 namespace storage {
@@ -164,9 +166,68 @@ void InitLowerBound1Cache(absl::Span<const int> index, int chunk_size,
 void SimpleSuccinctBitVectorIndex::Init(const uint8_t *data, int length,
                                         size_t lb0_cache_size,
                                         size_t lb1_cache_size) {
+  InitIndex(data, length, chunk_size_, &index_storage_);
+  InitWithIndex(data, length, index_storage_, lb0_cache_size, lb1_cache_size);
+}
+
+std::vector<int> SimpleSuccinctBitVectorIndex::BuildIndex(const uint8_t *data,
+                                                          int length,
+                                                          int chunk_size) {
+  std::vector<int> index;
+  InitIndex(data, length, chunk_size, &index);
+  return index;
+}
+
+bool SimpleSuccinctBitVectorIndex::IsValidIndex(int length, int chunk_size,
+                                                absl::Span<const int> index) {
+  // The index has an entry for each chunk and a sentinel.
+  const size_t chunk_length = (length + chunk_size - 1) / chunk_size;
+  if (index.size() != chunk_length + 1 || index[0] != 0) {
+    return false;
+  }
+  // Each chunk has at most chunk_size * 8 1-bits.
+  for (size_t i = 1; i < index.size(); ++i) {
+    const int64_t num_bits = static_cast<int64_t>(index[i]) - index[i - 1];
+    if (num_bits < 0 || num_bits > chunk_size * 8) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool SimpleSuccinctBitVectorIndex::Init(const uint8_t *data, int length,
+                                        absl::Span<const int> index,
+                                        size_t lb0_cache_size,
+                                        size_t lb1_cache_size) {
+  if (!IsValidIndex(length, chunk_size_, index)) {
+    return false;
+  }
+  index_storage_.clear();
+  InitWithIndex(data, length, index, lb0_cache_size, lb1_cache_size);
+  return true;
+}
+
+void SimpleSuccinctBitVectorIndex::Init(const uint8_t *data, int length,
+                                        size_t lb0_cache_size,
+                                        size_t lb1_cache_size,
+                                        DerivedDataCache *cache,
+                                        absl::string_view name) {
+  const absl::Span<const int> index = cache->GetOrBuild(
+      name, [&]() { return BuildIndex(data, length, chunk_size_); },
+      [&](absl::Span<const int> index) {
+        return IsValidIndex(length, chunk_size_, index);
+      });
+  CHECK(Init(data, length, index, lb0_cache_size, lb1_cache_size)) << name;
+}
+
+void SimpleSuccinctBitVectorIndex::InitWithIndex(const uint8_t *data,
+                                                 int length,
+                                                 absl::Span<const int> index,
+                                                 size_t lb0_cache_size,
+                                                 size_t lb1_cache_size) {
   data_ = data;
   length_ = length;
-  InitIndex(data, length, chunk_size_, &index_);
+  index_ = index;
 
   // TODO(noriyukit): Currently, we simply use uniform increment width for lower
   // bound cache.  Nonuniform increment width may improve performance.
@@ -190,7 +251,8 @@ void SimpleSuccinctBitVectorIndex::Init(const uint8_t *data, int length,
 void SimpleSuccinctBitVectorIndex::Reset() {
   data_ = nullptr;
   length_ = 0;
-  index_.clear();
+  index_ = {};
+  index_storage_.clear();
   lb0_cache_increment_ = 1;
   lb0_cache_.clear();
   lb1_cache_increment_ = 1;
@@ -34,6 +34,10 @@
 #include <cstdint>
 #include <vector>
 
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
+#include "storage/derived_data_cache.h"
+
 namespace mozc {
 namespace storage {
 namespace louds {
@@ -67,6 +71,32 @@ class SimpleSuccinctBitVectorIndex {
 
   void Init(const uint8_t *data, int length) { Init(data, length, 0, 0); }
 
+  // Returns the index (the cumulative number of 1-bits at each chunk) of the
+  // data, which can be passed to Init() below.
+  static std::vector<int> BuildIndex(const uint8_t *data, int length,
+                                     int chunk_size);
+
+  // Returns true if `index` is a well-formed index for `length` bytes of data,
+  // i.e. it has an entry for each chunk and a sentinel, starts with 0, and each
+  // chunk has between 0 and chunk_size * 8 1-bits.
+  static bool IsValidIndex(int length, int chunk_size,
+                           absl::Span<const int> index);
+
+  // Initializes the index with the precomputed `index`, e.g. a section of
+  // DerivedDataCache, instead of building it. Returns false if `index` is not
+  // valid for the data. This class doesn't have the ownership of
+  // `index`.
+  bool Init(const uint8_t *data, int length, absl::Span<const int> index,
+            size_t lb0_cache_size, size_t lb1_cache_size);
+
+  // Same as above, but the index is obtained from `cache` under `name` so that
+  // it is shared among the processes mapping the cache. A cached index that is
+  // not valid is rebuilt by the cache. `cache` needs to be
+  // alive while this instance is used.
+  void Init(const uint8_t *data, int length, size_t lb0_cache_size,
+            size_t lb1_cache_size, DerivedDataCache *cache,
+            absl::string_view name);
+
   // Resets the internal state, especially releases the allocated memory
   // for the index used internally.
   void Reset();
@@ -94,11 +124,17 @@ class SimpleSuccinctBitVectorIndex {
   int GetNum0Bits() const { return 8 * length_ - index_.back(); }
 
  private:
+  void InitWithIndex(const uint8_t *data, int length,
+                     absl::Span<const int> index, size_t lb0_cache_size,
+                     size_t lb1_cache_size);
+
   // The order of members is optimized to minimize the padding size.
   const uint8_t *data_;
   int length_;
   int chunk_size_;
-  std::vector<int> index_;
+  // Points to either index_storage_ or the section of DerivedDataCache.
+  absl::Span<const int> index_;
+  std::vector<int> index_storage_;
   std::vector<const int *> lb0_cache_;
   int lb0_cache_increment_;
   int lb1_cache_increment_;
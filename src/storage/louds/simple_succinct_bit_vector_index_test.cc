@@ -33,11 +33,14 @@
 #include <cstdint>
 #include <string>
 #include <utility>
+#include <vector>
 
+#include "storage/derived_data_cache.h"
 #include "testing/gunit.h"
 
 namespace {
 
+using ::mozc::storage::DerivedDataCache;
 using ::mozc::storage::louds::SimpleSuccinctBitVectorIndex;
 
 using CacheSizeParam = std::pair<size_t, size_t>;
@@ -192,4 +195,50 @@ TEST_P(SimpleSuccinctBitVectorIndexTest, Pattern2) {
 }
 INSTANTIATE_TEST_CASE(GenPattern2Test);
 
+TEST(SimpleSuccinctBitVectorIndexCacheTest, InitWithCache) {
+  // Repeat the bit pattern '0b10101010'.
+  const std::string data(1024, '\xAA');
+  const uint8_t *ptr = reinterpret_cast<const uint8_t *>(data.data());
+
+  SimpleSuccinctBitVectorIndex expected;
+  expected.Init(ptr, data.length(), 8, 8);
+
+  DerivedDataCache cache("test");
+  SimpleSuccinctBitVectorIndex bit_vector;
+  bit_vector.Init(ptr, data.length(), 8, 8, &cache, "index");
+  EXPECT_TRUE(cache.has_built_sections());
+  EXPECT_EQ(bit_vector.GetNum1Bits(), expected.GetNum1Bits());
+  for (int i = 0; i <= 8 * 1024; i += 7) {
+    EXPECT_EQ(bit_vector.Rank1(i), expected.Rank1(i)) << i;
+  }
+  for (int i = 1; i <= 4 * 1024; i += 5) {
+    EXPECT_EQ(bit_vector.Select0(i), expected.Select0(i)) << i;
+    EXPECT_EQ(bit_vector.Select1(i), expected.Select1(i)) << i;
+  }
+}
+
+TEST(SimpleSuccinctBitVectorIndexCacheTest, InitWithIndex) {
+  const std::string data(64, '\xFF');
+  const uint8_t *ptr = reinterpret_cast<const uint8_t *>(data.data());
+
+  const std::vector<int> index =
+      SimpleSuccinctBitVectorIndex::BuildIndex(ptr, data.length(), 32);
+  SimpleSuccinctBitVectorIndex bit_vector;
+  ASSERT_TRUE(bit_vector.Init(ptr, data.length(), index, 0, 0));
+  EXPECT_EQ(bit_vector.GetNum1Bits(), 64 * 8);
+  EXPECT_EQ(bit_vector.Rank1(100), 100);
+
+  // The index built for other data is rejected.
+  const std::vector<int> short_index =
+      SimpleSuccinctBitVectorIndex::BuildIndex(ptr, 32, 32);
+  EXPECT_FALSE(bit_vector.Init(ptr, data.length(), short_index, 0, 0));
+
+  // The values out of range are rejected.
+  std::vector<int> broken_index = index;
+  broken_index[1] = 32 * 8 + 1;
+  EXPECT_FALSE(bit_vector.Init(ptr, data.length(), broken_index, 0, 0));
+  broken_index[1] = -1;
+  EXPECT_FALSE(bit_vector.Init(ptr, data.length(), broken_index, 0, 0));
+}
+
 }  // namespace
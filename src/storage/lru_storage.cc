@@ -30,13 +30,13 @@
 #include "storage/lru_storage.h"
 
 #include <algorithm>
+#include <array>
+#include <cstddef>
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
 #include <ctime>
 #include <ios>
-#include <iterator>
-#include <list>
 #include <memory>
 #include <string>
 #include <utility>
@@ -46,6 +46,7 @@
 #include "absl/container/flat_hash_set.h"
 #include "absl/log/check.h"
 #include "absl/log/log.h"
+#include "absl/numeric/bits.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/string_view.h"
@@ -108,6 +109,32 @@ class CompareByTimeStamp {
   }
 };
 
+// Sorts |entries| by the upper 32 bits in ascending order, keeping the order
+// of the entries with the same upper bits. This is a radix sort so that
+// opening a storage is linear in the number of the items. The passes for the
+// bytes that all the entries share are skipped.
+void RadixSortByUpper32(std::vector<uint64_t> &entries) {
+  std::vector<uint64_t> buffer(entries.size());
+  for (int shift = 32; shift < 64; shift += 8) {
+    std::array<size_t, 257> offsets = {};
+    for (const uint64_t entry : entries) {
+      ++offsets[((entry >> shift) & 0xFF) + 1];
+    }
+    if (absl::c_any_of(offsets, [&](size_t count) {
+          return count == entries.size();
+        })) {
+      continue;
+    }
+    for (size_t i = 1; i < offsets.size(); ++i) {
+      offsets[i] += offsets[i - 1];
+    }
+    for (const uint64_t entry : entries) {
+      buffer[offsets[(entry >> shift) & 0xFF]++] = entry;
+    }
+    entries.swap(buffer);
+  }
+}
+
 }  // namespace
 
 std::unique_ptr<LruStorage> LruStorage::Create(const char *filename) {
@@ -178,7 +205,7 @@ bool LruStorage::CreateStorageFile(const char *filename, size_t value_size,
 // Reopen file after initializing mapped page.
 bool LruStorage::Clear() {
   // Don't need to clear the page if the lru list is empty
-  if (mmap_.empty() || lru_list_.empty()) {
+  if (mmap_.empty() || used_size_ == 0) {
     return true;
   }
   const size_t offset = sizeof(value_size_) + sizeof(size_) + sizeof(seed_);
@@ -186,8 +213,6 @@ bool LruStorage::Clear() {
     return false;
   }
   std::fill(mmap_.begin() + offset, mmap_.end(), 0);
-  lru_list_.clear();
-  lru_map_.clear();
   Open(mmap_.begin(), mmap_.size());
   return true;
 }
@@ -361,21 +386,38 @@ bool LruStorage::Open(char *ptr, size_t ptr_size) {
     return false;
   }
 
-  std::vector<char *> ary;
-  for (char *begin = begin_; begin < end_; begin += item_size()) {
-    ary.push_back(begin);
-  }
-  std::stable_sort(ary.begin(), ary.end(), CompareByTimeStamp());
-
-  lru_list_.clear();
-  lru_map_.clear();
+  // The sentinel at |size_| links to itself when the list is empty.
+  next_.assign(size_ + 1, size_);
+  prev_.assign(size_ + 1, size_);
+  used_size_ = 0;
+  // Keep the load factor of the index at most 2/3.
+  const size_t num_buckets = absl::bit_ceil(size_ + size_ / 2 + 1);
+  index_.assign(num_buckets, kNoSlot);
+  index_shift_ = 64 - absl::countr_zero(num_buckets);
+
+  // Sort the used items from new to old. Each entry holds the negated
+  // timestamp in the upper bits and the slot in the lower bits, so the items
+  // with the same timestamp are ordered by address.
+  std::vector<uint64_t> entries;
+  entries.reserve(size_);
   char *next = nullptr;
-  for (size_t i = 0; i < ary.size(); ++i) {
-    if (GetTimeStamp(ary[i]) != 0) {
-      lru_list_.push_back(ary[i]);
-      lru_map_[GetFP(ary[i])] = std::prev(lru_list_.end());
+  for (char *item = begin_; item < end_; item += item_size()) {
+    const uint32_t timestamp = GetTimeStamp(item);
+    if (timestamp != 0) {
+      entries.push_back(static_cast<uint64_t>(~timestamp) << 32 |
+                        GetSlot(item));
     } else if (next == nullptr) {
-      next = ary[i];
+      next = item;
+    }
+  }
+  RadixSortByUpper32(entries);
+
+  for (const uint64_t entry : entries) {
+    const uint32_t slot = static_cast<uint32_t>(entry);
+    PushBack(slot);
+    // If the same fingerprint appears twice, the newer one is indexed.
+    if (FindSlot(GetFP(GetItem(slot))) == kNoSlot) {
+      InsertIndex(slot);
     }
   }
   next_item_ = (next != nullptr) ? next : end_;
@@ -393,55 +435,59 @@ void LruStorage::Close() {
 
   filename_.clear();
   mmap_.Close();
-  lru_list_.clear();
-  lru_map_.clear();
+  next_.clear();
+  prev_.clear();
+  used_size_ = 0;
+  index_.clear();
 }
 
 const char *LruStorage::Lookup(const absl::string_view key,
                                uint32_t *last_access_time) const {
-  const uint64_t fp = FingerprintWithSeed(key, seed_);
-  const auto it = lru_map_.find(fp);
-  if (it == lru_map_.end()) {
+  const uint32_t slot = FindSlot(FingerprintWithSeed(key, seed_));
+  if (slot == kNoSlot) {
     return nullptr;
   }
-  const uint32_t timestamp = GetTimeStamp(*it->second);
+  const char *item = GetItem(slot);
+  const uint32_t timestamp = GetTimeStamp(item);
   if (IsOlderThan62Days(timestamp)) {
     return nullptr;
   }
   *last_access_time = timestamp;
-  return GetValue(*it->second);
+  return GetValue(item);
 }
 
 void LruStorage::GetAllValues(std::vector<std::string> *values) const {
   DCHECK(values);
   values->clear();
+  if (next_.empty()) {
+    return;
+  }
   // Iterate data from the most recently used element to the least recently used
   // element.
-  for (const char *ptr : lru_list_) {
-    const uint32_t timestamp = GetTimeStamp(ptr);
+  for (uint32_t slot = next_[size_]; slot != size_; slot = next_[slot]) {
+    const char *item = GetItem(slot);
+    const uint32_t timestamp = GetTimeStamp(item);
     if (IsOlderThan62Days(timestamp)) {
       break;
     }
     // Default constructor of string is not applicable
     // because value's size() must return value_size_.
-    DCHECK(ptr);
-    values->emplace_back(GetValue(ptr), value_size_);
+    values->emplace_back(GetValue(item), value_size_);
   }
 }
 
 bool LruStorage::Touch(const absl::string_view key) {
-  const uint64_t fp = FingerprintWithSeed(key, seed_);
-  auto it = lru_map_.find(fp);
-  if (it == lru_map_.end()) {
+  const uint32_t slot = FindSlot(FingerprintWithSeed(key, seed_));
+  if (slot == kNoSlot) {
     return false;
   }
-  const uint32_t timestamp = GetTimeStamp(*it->second);
+  char *item = GetItem(slot);
+  const uint32_t timestamp = GetTimeStamp(item);
   if (IsOlderThan62Days(timestamp)) {
     return false;
   }
-  Update(*it->second);
-  // Move the node pointed to by it->second to the front.
-  lru_list_.splice(lru_list_.begin(), lru_list_, it->second);
+  Update(item);
+  MoveToFront(slot);
   return true;
 }
 
@@ -452,34 +498,31 @@ bool LruStorage::Insert(const absl::string_view key, const char *value) {
   const uint64_t fp = FingerprintWithSeed(key, seed_);
 
   // If the data corresponding to |key| already exists in LRU, update it.
-  {
-    auto it = lru_map_.find(fp);
-    if (it != lru_map_.end()) {
-      // Overwrite the data pointed to by it->second and move it to the front.
-      Update(*it->second, fp, value, value_size_);
-      lru_list_.splice(lru_list_.begin(), lru_list_, it->second);
-      return true;
-    }
+  if (const uint32_t slot = FindSlot(fp); slot != kNoSlot) {
+    // Overwrite the data of the slot and move it to the front.
+    Update(GetItem(slot), fp, value, value_size_);
+    MoveToFront(slot);
+    return true;
   }
 
   // If the LRU is full or we run out of the mmap region, drop the least
   // recently used element (actually, the least recently used element is
   // overwritten with new data).
-  if (lru_map_.size() >= size_ || next_item_ == end_) {
-    auto it = std::prev(lru_list_.end());  // Least recently used data.
-    const uint64_t old_fp = GetFP(*it);
-    lru_map_.erase(old_fp);
-    lru_list_.splice(lru_list_.begin(), lru_list_, it);  // Move to front.
-    Update(*it, fp, value, value_size_);
-    lru_map_[fp] = it;
+  if (used_size_ >= size_ || next_item_ == end_) {
+    const uint32_t slot = prev_[size_];  // Least recently used data.
+    EraseIndex(slot);
+    Update(GetItem(slot), fp, value, value_size_);
+    InsertIndex(slot);
+    MoveToFront(slot);
     return true;
   }
 
   // A new item can be assigned in the mmap region.
   if (next_item_ < end_) {
+    const uint32_t slot = GetSlot(next_item_);
     Update(next_item_, fp, value, value_size_);
-    lru_list_.push_front(next_item_);
-    lru_map_[fp] = lru_list_.begin();
+    PushFront(slot);
+    InsertIndex(slot);
     // Advance next_item_ for next item.
     next_item_ += item_size();
     DCHECK_LE(next_item_, end_);
@@ -492,50 +535,40 @@ bool LruStorage::Insert(const absl::string_view key, const char *value) {
 
 bool LruStorage::TryInsert(const absl::string_view key, const char *value) {
   const uint64_t fp = FingerprintWithSeed(key, seed_);
-  auto it = lru_map_.find(fp);
-  if (it != lru_map_.end()) {
-    Update(*it->second, fp, value, value_size_);
-    lru_list_.splice(lru_list_.begin(), lru_list_, it->second);
+  if (const uint32_t slot = FindSlot(fp); slot != kNoSlot) {
+    Update(GetItem(slot), fp, value, value_size_);
+    MoveToFront(slot);
   }
   return true;
 }
 
 bool LruStorage::Delete(const absl::string_view key) {
-  const uint64_t fp = FingerprintWithSeed(key, seed_);
-  return Delete(fp);
-}
-
-bool LruStorage::Delete(uint64_t fp) {
-  auto it = lru_map_.find(fp);
-  return (it == lru_map_.end() || Delete(fp, it->second));
+  const uint32_t slot = FindSlot(FingerprintWithSeed(key, seed_));
+  return (slot == kNoSlot || Delete(slot));
 }
 
-bool LruStorage::Delete(std::list<char *>::iterator it) {
-  return (it == lru_list_.end() || Delete(GetFP(*it), it));
-}
-
-bool LruStorage::Delete(uint64_t fp, std::list<char *>::iterator it) {
+bool LruStorage::Delete(uint32_t slot) {
   // Determine the last element in the mmap region.
   if (next_item_ < begin_ + item_size()) {
     LOG(ERROR) << "next_item_ points to invalid location (broken?)";
     return false;
   }
   next_item_ -= item_size();
+  const uint32_t last_slot = GetSlot(next_item_);
 
-  // Backup the location of mmap region to which another element will be moved.
-  char *deleted_item_pos = *it;
-
-  // Erase the LRU structure for (fp, it).
-  lru_map_.erase(fp);
-  lru_list_.erase(it);
+  // Erase the LRU structure for the slot.
+  EraseIndex(slot);
+  Unlink(slot);
 
-  if (next_item_ != deleted_item_pos) {
+  if (last_slot != slot) {
     // Move the region for the last element to the deleted location.  Then,
-    // update the LRU structure for the moved element (the pointer to mmap
-    // region in the list node is updated.)
-    std::copy_n(next_item_, item_size(), deleted_item_pos);
-    const uint64_t fp = GetFP(next_item_);
-    *lru_map_[fp] = deleted_item_pos;
+    // the deleted slot takes over the links and the index of the last slot.
+    std::copy_n(next_item_, item_size(), GetItem(slot));
+    ReplaceIndex(last_slot, slot);
+    next_[slot] = next_[last_slot];
+    prev_[slot] = prev_[last_slot];
+    prev_[next_[slot]] = slot;
+    next_[prev_[slot]] = slot;
   }
 
   // Clear the region for the next_item_.
@@ -544,18 +577,107 @@ bool LruStorage::Delete(uint64_t fp, std::list<char *>::iterator it) {
   return true;
 }
 
+size_t LruStorage::GetBucket(uint64_t fp) const {
+  // Fibonacci hashing, which also spreads sequential fingerprints.
+  return static_cast<size_t>((fp * 0x9E3779B97F4A7C15ull) >> index_shift_);
+}
+
+uint32_t LruStorage::FindSlot(uint64_t fp) const {
+  if (index_.empty()) {
+    return kNoSlot;
+  }
+  const size_t mask = index_.size() - 1;
+  for (size_t i = GetBucket(fp); index_[i] != kNoSlot; i = (i + 1) & mask) {
+    if (GetFP(GetItem(index_[i])) == fp) {
+      return index_[i];
+    }
+  }
+  return kNoSlot;
+}
+
+void LruStorage::InsertIndex(uint32_t slot) {
+  const size_t mask = index_.size() - 1;
+  size_t i = GetBucket(GetFP(GetItem(slot)));
+  while (index_[i] != kNoSlot) {
+    i = (i + 1) & mask;
+  }
+  index_[i] = slot;
+}
+
+void LruStorage::EraseIndex(uint32_t slot) {
+  const size_t mask = index_.size() - 1;
+  size_t hole = GetBucket(GetFP(GetItem(slot)));
+  for (; index_[hole] != slot; hole = (hole + 1) & mask) {
+    if (index_[hole] == kNoSlot) {
+      // Not indexed because of a duplicated fingerprint.
+      return;
+    }
+  }
+  // Shift back the following entries of the cluster that can be found from
+  // their buckets only through the hole.
+  for (size_t i = (hole + 1) & mask; index_[i] != kNoSlot; i = (i + 1) & mask) {
+    const size_t bucket = GetBucket(GetFP(GetItem(index_[i])));
+    if (((i - bucket) & mask) >= ((i - hole) & mask)) {
+      index_[hole] = index_[i];
+      hole = i;
+    }
+  }
+  index_[hole] = kNoSlot;
+}
+
+void LruStorage::ReplaceIndex(uint32_t old_slot, uint32_t new_slot) {
+  const size_t mask = index_.size() - 1;
+  for (size_t i = GetBucket(GetFP(GetItem(new_slot))); index_[i] != kNoSlot;
+       i = (i + 1) & mask) {
+    if (index_[i] == old_slot) {
+      index_[i] = new_slot;
+      return;
+    }
+  }
+}
+
+void LruStorage::PushBack(uint32_t slot) {
+  next_[slot] = size_;
+  prev_[slot] = prev_[size_];
+  next_[prev_[size_]] = slot;
+  prev_[size_] = slot;
+  ++used_size_;
+}
+
+void LruStorage::PushFront(uint32_t slot) {
+  next_[slot] = next_[size_];
+  prev_[slot] = size_;
+  prev_[next_[size_]] = slot;
+  next_[size_] = slot;
+  ++used_size_;
+}
+
+void LruStorage::Unlink(uint32_t slot) {
+  next_[prev_[slot]] = next_[slot];
+  prev_[next_[slot]] = prev_[slot];
+  --used_size_;
+}
+
+void LruStorage::MoveToFront(uint32_t slot) {
+  if (next_[size_] == slot) {
+    return;
+  }
+  Unlink(slot);
+  PushFront(slot);
+}
+
 int LruStorage::DeleteElementsBefore(uint32_t timestamp) {
   if (mmap_.empty() || begin_ >= end_) {
     return 0;
   }
   int num_deleted = 0;
-  while (!lru_list_.empty()) {
-    auto it = std::prev(lru_list_.end());
-    const uint32_t last_access_time = GetTimeStamp(*it);
+  while (used_size_ > 0) {
+    const uint32_t slot = prev_[size_];  // Least recently used data.
+    const uint32_t last_access_time = GetTimeStamp(GetItem(slot));
     if (last_access_time >= timestamp) {
       break;
     }
-    if (Delete(it)) {
+    if (Delete(slot)) {
       ++num_deleted;
       continue;
     }
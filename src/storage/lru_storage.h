@@ -32,12 +32,10 @@
 
 #include <cstddef>
 #include <cstdint>
-#include <list>
 #include <memory>
 #include <string>
 #include <vector>
 
-#include "absl/container/flat_hash_map.h"
 #include "absl/strings/string_view.h"
 #include "base/mmap.h"
 
@@ -121,7 +119,7 @@ class LruStorage {
   size_t size() const { return size_; }
 
   // Returns the number of items in LRU.
-  size_t used_size() const { return lru_list_.size(); }
+  size_t used_size() const { return used_size_; }
 
   // Returns the seed used for fingerprinting.
   uint32_t seed() const { return seed_; }
@@ -157,15 +155,36 @@ class LruStorage {
   static constexpr size_t kItemHeaderSize = 12;
 
  private:
+  // Items are identified by their slot, i.e., the index in the mmap region.
+  // kNoSlot marks an empty bucket of the hash index.
+  static constexpr uint32_t kNoSlot = static_cast<uint32_t>(-1);
+
   // Initializes this LRU from memory buffer.
   bool Open(char *ptr, size_t ptr_size);
 
-  // Deletes the element from |fp| or |it|.
-  bool Delete(uint64_t fp);
-  bool Delete(std::list<char *>::iterator it);
+  // Deletes the item at |slot| and moves the last item in the mmap region to
+  // |slot| so that the used items are kept contiguous.
+  bool Delete(uint32_t slot);
+
+  char *GetItem(uint32_t slot) const { return begin_ + slot * item_size(); }
+  uint32_t GetSlot(const char *item) const {
+    return static_cast<uint32_t>((item - begin_) / item_size());
+  }
 
-  // Actual implementation of Delete() methods.
-  bool Delete(uint64_t fp, std::list<char *>::iterator it);
+  // Functions for the hash index from fingerprint to slot. The index is an
+  // open addressing table with linear probing, and the fingerprints are read
+  // from the items themselves.
+  size_t GetBucket(uint64_t fp) const;
+  uint32_t FindSlot(uint64_t fp) const;
+  void InsertIndex(uint32_t slot);
+  void EraseIndex(uint32_t slot);
+  void ReplaceIndex(uint32_t old_slot, uint32_t new_slot);
+
+  // Functions for the LRU list.
+  void PushBack(uint32_t slot);
+  void PushFront(uint32_t slot);
+  void Unlink(uint32_t slot);
+  void MoveToFront(uint32_t slot);
 
   size_t value_size_ = 0;
   size_t size_ = 0;
@@ -174,8 +193,14 @@ class LruStorage {
   char *begin_ = nullptr;
   char *end_ = nullptr;
   std::string filename_;
-  std::list<char *> lru_list_;  // Front is the most recently used data.
-  absl::flat_hash_map<uint64_t, std::list<char *>::iterator> lru_map_;
+  // The LRU list is a doubly linked list embedded in the arrays indexed by
+  // slot. The element at |size_| is the sentinel; its next is the most
+  // recently used item and its prev is the least recently used item.
+  std::vector<uint32_t> next_;
+  std::vector<uint32_t> prev_;
+  size_t used_size_ = 0;
+  std::vector<uint32_t> index_;  // Buckets holding slots or kNoSlot.
+  int index_shift_ = 0;
   Mmap mmap_;
 };
 
@@ -0,0 +1,167 @@
+// Copyright 2010-2021, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Measures the time to open an LruStorage and the throughput of its lookups and
+// updates at the sizes used by the user history rewriters and at the maximum
+// size.
+//
+// Usage: lru_storage_benchmark_main --ops=1000000
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "absl/flags/flag.h"
+#include "absl/log/check.h"
+#include "absl/random/random.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "base/file/temp_dir.h"
+#include "base/hash.h"
+#include "base/init_mozc.h"
+#include "base/stopwatch.h"
+#include "storage/lru_storage.h"
+
+ABSL_FLAG(int32_t, iterations, 5, "number of repetitions of each measurement");
+ABSL_FLAG(int32_t, ops, 1000000, "number of operations per measurement");
+
+namespace mozc {
+namespace storage {
+namespace {
+
+constexpr size_t kValueSize = 4;
+constexpr uint32_t kSeed = 0x1234;
+constexpr size_t kSizes[] = {20000, 1000000};
+
+std::string MakeKey(size_t i) { return absl::StrCat("key", i); }
+
+// Fills all the items of the storage file with timestamps spread over the last
+// 30 days, so that Open() has to sort them.
+void FillStorage(const std::string &filename, size_t size) {
+  CHECK(LruStorage::CreateStorageFile(filename.c_str(), kValueSize, size,
+                                      kSeed));
+  LruStorage storage;
+  CHECK(storage.Open(filename.c_str()));
+  absl::BitGen gen;
+  const uint32_t now = static_cast<uint32_t>(absl::ToUnixSeconds(absl::Now()));
+  const std::string value(kValueSize, 'v');
+  for (size_t i = 0; i < size; ++i) {
+    const uint32_t timestamp = now - absl::Uniform(gen, 0u, 30u * 24 * 3600);
+    storage.Write(i, FingerprintWithSeed(MakeKey(i), kSeed), value, timestamp);
+  }
+}
+
+// Returns the fastest duration of `func` over the iterations.
+template <typename Func>
+absl::Duration Measure(Func func) {
+  absl::Duration fastest = absl::InfiniteDuration();
+  for (int i = 0; i < absl::GetFlag(FLAGS_iterations); ++i) {
+    Stopwatch stopwatch = Stopwatch::StartNew();
+    func();
+    stopwatch.Stop();
+    fastest = std::min(fastest, stopwatch.GetElapsed());
+  }
+  return fastest;
+}
+
+void Report(size_t size, absl::string_view name, absl::string_view result) {
+  std::cout << std::left << std::setw(10) << size << std::setw(10) << name
+            << std::right << std::setw(16) << result << std::endl;
+}
+
+void ReportOps(size_t size, absl::string_view name, absl::Duration elapsed) {
+  const double ops = absl::GetFlag(FLAGS_ops) / absl::ToDoubleSeconds(elapsed);
+  Report(size, name, absl::StrCat(static_cast<int64_t>(ops), " ops/s"));
+}
+
+void Run(size_t size) {
+  absl::StatusOr<TempFile> file = TempDirectory::Default().CreateTempFile();
+  CHECK_OK(file);
+  const std::string &filename = file->path();
+  FillStorage(filename, size);
+
+  const absl::Duration open_time = Measure([&] {
+    LruStorage storage;
+    CHECK(storage.Open(filename.c_str()));
+    CHECK_EQ(storage.used_size(), size);
+  });
+  Report(size, "Open",
+         absl::StrCat(absl::ToDoubleMilliseconds(open_time), " ms"));
+
+  LruStorage storage;
+  CHECK(storage.Open(filename.c_str()));
+  const int ops = absl::GetFlag(FLAGS_ops);
+  std::vector<std::string> keys;
+  keys.reserve(ops);
+  absl::BitGen gen;
+  for (int i = 0; i < ops; ++i) {
+    keys.push_back(MakeKey(absl::Uniform<size_t>(gen, 0, size)));
+  }
+
+  size_t found = 0;
+  ReportOps(size, "Lookup", Measure([&] {
+              for (const std::string &key : keys) {
+                found += storage.Lookup(key) != nullptr;
+              }
+            }));
+  ReportOps(size, "Touch", Measure([&] {
+              for (const std::string &key : keys) {
+                found += storage.Touch(key);
+              }
+            }));
+  // Inserts new keys, each of which evicts the least recently used item.
+  size_t next_key = size;
+  const std::string value(kValueSize, 'w');
+  ReportOps(size, "Insert", Measure([&] {
+              for (int i = 0; i < ops; ++i) {
+                storage.Insert(MakeKey(next_key++), value.data());
+              }
+            }));
+  CHECK_GT(found, 0);
+}
+
+}  // namespace
+}  // namespace storage
+}  // namespace mozc
+
+int main(int argc, char **argv) {
+  mozc::InitMozc(argv[0], &argc, &argv);
+  for (const size_t size : mozc::storage::kSizes) {
+    mozc::storage::Run(size);
+  }
+  return 0;
+}
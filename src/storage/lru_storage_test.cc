@@ -40,8 +40,10 @@
 #include <utility>
 #include <vector>
 
+#include "absl/algorithm/container.h"
 #include "absl/log/check.h"
 #include "absl/random/random.h"
+#include "absl/strings/str_format.h"
 #include "absl/time/time.h"
 #include "base/clock_mock.h"
 #include "base/file/temp_dir.h"
@@ -557,5 +559,60 @@ TEST_F(LruStorageTest, OldDataAreNotLookedUp) {
   EXPECT_TRUE(storage.Touch("4444"));
 }
 
+TEST_F(LruStorageTest, RecencyOrderIsKeptOnReopen) {
+  ScopedClockMock clock(absl::FromUnixSeconds(1000));
+
+  constexpr size_t kValueSize = 4;
+  constexpr size_t kNumElements = 1000;
+  TempFile file(testing::MakeTempFileOrDie());
+  std::vector<std::string> expected;  // From new to old.
+  {
+    LruStorage storage;
+    ASSERT_TRUE(storage.OpenOrCreate(file.path().c_str(), kValueSize,
+                                     kNumElements, kSeed));
+    for (int i = 0; i < kNumElements; ++i) {
+      clock->Advance(absl::Seconds(1));
+      const std::string value = absl::StrFormat("%04d", i);
+      ASSERT_TRUE(storage.Insert(value, value.data()));
+    }
+    // Touch a half of the items in a random order.
+    std::vector<int> touched(kNumElements / 2);
+    absl::c_iota(touched, 0);
+    absl::c_shuffle(touched, absl::BitGen());
+    for (const int i : touched) {
+      clock->Advance(absl::Seconds(1));
+      ASSERT_TRUE(storage.Touch(absl::StrFormat("%04d", i)));
+    }
+    storage.GetAllValues(&expected);
+    ASSERT_EQ(expected.size(), kNumElements);
+  }
+
+  LruStorage storage;
+  ASSERT_TRUE(storage.Open(file.path().c_str()));
+  std::vector<std::string> values;
+  storage.GetAllValues(&values);
+  EXPECT_EQ(values, expected);
+
+  // Deletion moves the last item in the file to the deleted position. All the
+  // remaining items must still be found.
+  for (int i = 0; i < kNumElements; i += 2) {
+    EXPECT_TRUE(storage.Delete(absl::StrFormat("%04d", i)));
+  }
+  EXPECT_EQ(storage.used_size(), kNumElements / 2);
+  for (int i = 0; i < kNumElements; ++i) {
+    const std::string key = absl::StrFormat("%04d", i);
+    if (i % 2 == 0) {
+      EXPECT_EQ(storage.Lookup(key), nullptr);
+    } else {
+      EXPECT_EQ(storage.LookupAsString(key), key);
+    }
+  }
+  std::erase_if(expected, [](const std::string &value) {
+    return (value.back() - '0') % 2 == 0;
+  });
+  storage.GetAllValues(&values);
+  EXPECT_EQ(values, expected);
+}
+
 }  // namespace storage
 }  // namespace mozc
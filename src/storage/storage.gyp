@@ -48,5 +48,17 @@
         '<(mozc_oss_src_dir)/base/base_test.gyp:clock_mock',
       ],
     },
+    {
+      'target_name': 'derived_data_cache',
+      'type': 'static_library',
+      'toolsets': ['target', 'host'],
+      'sources': [
+        'derived_data_cache.cc',
+      ],
+      'dependencies': [
+        '<(mozc_oss_src_dir)/base/absl.gyp:absl_strings',
+        '<(mozc_oss_src_dir)/base/base.gyp:base',
+      ],
+    },
   ],
 }
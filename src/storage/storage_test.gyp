@@ -33,6 +33,7 @@
       'target_name': 'storage_test',
       'type': 'executable',
       'sources': [
+        'derived_data_cache_test.cc',
         'encrypted_string_storage_test.cc',
         'existence_filter_test.cc',
         'lru_cache_test.cc',
@@ -43,6 +44,7 @@
       'dependencies': [
         '<(mozc_oss_src_dir)/testing/testing.gyp:gtest_main',
         '<(mozc_oss_src_dir)/testing/testing.gyp:mozctest',
+        'storage.gyp:derived_data_cache',
         'storage.gyp:storage',
       ],
       'variables': {
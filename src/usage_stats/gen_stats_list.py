@@ -54,7 +54,9 @@ def main():
   parser.add_argument('input', type=argparse.FileType('r', encoding='utf-8'))
   args = parser.parse_args()
 
-  stats_list = GetStatsNameList(args.input)
+  # Sorted so that names can be looked up by binary search. The index in
+  # kStatsList is used as the id of the stats in MetricsRegistry.
+  stats_list = sorted(GetStatsNameList(args.input))
   args.output.write('// This header file is generated by gen_stats_list.py\n')
   for stats in stats_list:
     args.output.write(
@@ -0,0 +1,272 @@
+// Copyright 2010-2021, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "usage_stats/metrics_registry.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <string>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/log/check.h"
+#include "absl/numeric/bits.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
+
+namespace mozc {
+namespace usage_stats {
+namespace {
+
+// Number of counts in a cache line.
+constexpr size_t kCountsPerCacheLine = 64 / sizeof(std::atomic<uint64_t>);
+
+// Returns a small number unique to the calling thread.
+size_t GetThreadIndex() {
+  // Constant-initialized so that accessing it needs no initialization guard.
+  constexpr size_t kUnassigned = std::numeric_limits<size_t>::max();
+  thread_local size_t index = kUnassigned;
+  if (index == kUnassigned) {
+    static std::atomic<size_t> next_index = 0;
+    index = next_index.fetch_add(1, std::memory_order_relaxed);
+  }
+  return index;
+}
+
+}  // namespace
+
+size_t LatencyHistogram::GetBucket(uint32_t value) {
+  if (value < kNumSubBuckets) {
+    return value;
+  }
+  // The position of the highest bit, which is kSubBucketBits or larger.
+  const int exponent = absl::bit_width(value) - 1;
+  const int shift = exponent - kSubBucketBits;
+  const size_t sub_bucket = (value >> shift) & (kNumSubBuckets - 1);
+  return kNumSubBuckets + shift * kNumSubBuckets + sub_bucket;
+}
+
+uint64_t LatencyHistogram::GetLowerBound(size_t bucket) {
+  DCHECK_LT(bucket, kNumBuckets);
+  if (bucket < kNumSubBuckets) {
+    return bucket;
+  }
+  const size_t shift = (bucket - kNumSubBuckets) / kNumSubBuckets;
+  const size_t sub_bucket = (bucket - kNumSubBuckets) % kNumSubBuckets;
+  return static_cast<uint64_t>(kNumSubBuckets + sub_bucket) << shift;
+}
+
+uint64_t MetricsSnapshot::Timing::GetPercentile(double percentile) const {
+  uint64_t size = 0;
+  for (const uint64_t count : buckets) {
+    size += count;
+  }
+  if (size == 0) {
+    return 0;
+  }
+  const double rank = std::ceil(percentile / 100.0 * size);
+  const uint64_t target =
+      std::clamp<uint64_t>(static_cast<uint64_t>(std::max(rank, 1.0)), 1, size);
+  uint64_t cumulative = 0;
+  for (size_t i = 0; i < buckets.size(); ++i) {
+    cumulative += buckets[i];
+    if (cumulative >= target) {
+      return LatencyHistogram::GetLowerBound(i);
+    }
+  }
+  return LatencyHistogram::GetLowerBound(buckets.size() - 1);
+}
+
+struct MetricsRegistry::Timing {
+  std::atomic<uint64_t> num = 0;
+  std::atomic<uint64_t> total = 0;
+  std::atomic<uint32_t> min = std::numeric_limits<uint32_t>::max();
+  std::atomic<uint32_t> max = 0;
+  std::atomic<uint64_t> buckets[LatencyHistogram::kNumBuckets] = {};
+};
+
+MetricsRegistry::MetricsRegistry(absl::Span<const absl::string_view> names)
+    : names_(names),
+      shard_stride_((names.size() + kCountsPerCacheLine - 1) /
+                    kCountsPerCacheLine * kCountsPerCacheLine),
+      counts_(std::make_unique<std::atomic<uint64_t>[]>(kNumShards *
+                                                         shard_stride_)),
+      timings_(std::make_unique<std::atomic<Timing *>[]>(names.size())),
+      values_(std::make_unique<std::atomic<int64_t>[]>(names.size())),
+      value_types_(std::make_unique<std::atomic<ValueType>[]>(names.size())) {
+  ids_.reserve(names.size());
+  for (size_t id = 0; id < names.size(); ++id) {
+    const bool inserted = ids_.emplace(names[id], id).second;
+    DCHECK(inserted) << names[id] << " is duplicated";
+  }
+}
+
+MetricsRegistry::~MetricsRegistry() {
+  for (size_t id = 0; id < names_.size(); ++id) {
+    delete timings_[id].load(std::memory_order_acquire);
+  }
+}
+
+std::optional<size_t> MetricsRegistry::GetId(absl::string_view name) const {
+  const auto it = ids_.find(name);
+  if (it == ids_.end()) {
+    return std::nullopt;
+  }
+  return it->second;
+}
+
+void MetricsRegistry::IncrementCountBy(size_t id, uint64_t val) {
+  DCHECK_LT(id, names_.size());
+  GetCount(GetThreadIndex() % kNumShards, id)
+      .fetch_add(val, std::memory_order_relaxed);
+}
+
+MetricsRegistry::Timing &MetricsRegistry::GetOrCreateTiming(size_t id) {
+  Timing *timing = timings_[id].load(std::memory_order_acquire);
+  if (timing != nullptr) {
+    return *timing;
+  }
+  auto new_timing = std::make_unique<Timing>();
+  if (timings_[id].compare_exchange_strong(timing, new_timing.get(),
+                                           std::memory_order_acq_rel)) {
+    return *new_timing.release();
+  }
+  // Another thread has created it.
+  return *timing;
+}
+
+void MetricsRegistry::UpdateTiming(size_t id, uint32_t val) {
+  DCHECK_LT(id, names_.size());
+  Timing &timing = GetOrCreateTiming(id);
+  timing.num.fetch_add(1, std::memory_order_relaxed);
+  timing.total.fetch_add(val, std::memory_order_relaxed);
+  timing.buckets[LatencyHistogram::GetBucket(val)].fetch_add(
+      1, std::memory_order_relaxed);
+  uint32_t min = timing.min.load(std::memory_order_relaxed);
+  while (val < min && !timing.min.compare_exchange_weak(
+                          min, val, std::memory_order_relaxed)) {
+  }
+  uint32_t max = timing.max.load(std::memory_order_relaxed);
+  while (val > max && !timing.max.compare_exchange_weak(
+                          max, val, std::memory_order_relaxed)) {
+  }
+}
+
+void MetricsRegistry::SetInteger(size_t id, int val) {
+  DCHECK_LT(id, names_.size());
+  values_[id].store(val, std::memory_order_relaxed);
+  value_types_[id].store(kInteger, std::memory_order_release);
+}
+
+void MetricsRegistry::SetBoolean(size_t id, bool val) {
+  DCHECK_LT(id, names_.size());
+  values_[id].store(val, std::memory_order_relaxed);
+  value_types_[id].store(kBoolean, std::memory_order_release);
+}
+
+void MetricsRegistry::ClearAccumulated() {
+  for (size_t i = 0; i < kNumShards * shard_stride_; ++i) {
+    counts_[i].store(0, std::memory_order_relaxed);
+  }
+  for (size_t id = 0; id < names_.size(); ++id) {
+    Timing *timing = timings_[id].load(std::memory_order_acquire);
+    if (timing == nullptr) {
+      continue;
+    }
+    // Timings are reset instead of deleted, as other threads may be updating
+    // them.
+    timing->num.store(0, std::memory_order_relaxed);
+    timing->total.store(0, std::memory_order_relaxed);
+    timing->min.store(std::numeric_limits<uint32_t>::max(),
+                      std::memory_order_relaxed);
+    timing->max.store(0, std::memory_order_relaxed);
+    for (std::atomic<uint64_t> &bucket : timing->buckets) {
+      bucket.store(0, std::memory_order_relaxed);
+    }
+  }
+}
+
+void MetricsRegistry::ClearAll() {
+  ClearAccumulated();
+  for (size_t id = 0; id < names_.size(); ++id) {
+    value_types_[id].store(kNone, std::memory_order_relaxed);
+  }
+}
+
+MetricsSnapshot MetricsRegistry::GetSnapshot() const {
+  MetricsSnapshot snapshot;
+  for (size_t id = 0; id < names_.size(); ++id) {
+    const std::string name(names_[id]);
+
+    uint64_t count = 0;
+    for (size_t shard = 0; shard < kNumShards; ++shard) {
+      count += GetCount(shard, id).load(std::memory_order_relaxed);
+    }
+    if (count > 0) {
+      snapshot.counts.emplace(name, count);
+    }
+
+    switch (value_types_[id].load(std::memory_order_acquire)) {
+      case kInteger:
+        snapshot.integers.emplace(
+            name,
+            static_cast<int>(values_[id].load(std::memory_order_relaxed)));
+        break;
+      case kBoolean:
+        snapshot.booleans.emplace(
+            name, values_[id].load(std::memory_order_relaxed) != 0);
+        break;
+      default:
+        break;
+    }
+
+    const Timing *timing = timings_[id].load(std::memory_order_acquire);
+    if (timing == nullptr || timing->num.load(std::memory_order_relaxed) == 0) {
+      continue;
+    }
+    MetricsSnapshot::Timing &result = snapshot.timings[name];
+    result.num = timing->num.load(std::memory_order_relaxed);
+    result.total = timing->total.load(std::memory_order_relaxed);
+    result.min = timing->min.load(std::memory_order_relaxed);
+    result.max = timing->max.load(std::memory_order_relaxed);
+    result.buckets.reserve(LatencyHistogram::kNumBuckets);
+    for (const std::atomic<uint64_t> &bucket : timing->buckets) {
+      result.buckets.push_back(bucket.load(std::memory_order_relaxed));
+    }
+  }
+  return snapshot;
+}
+
+}  // namespace usage_stats
+}  // namespace mozc
@@ -0,0 +1,154 @@
+// Copyright 2010-2021, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef MOZC_USAGE_STATS_METRICS_REGISTRY_H_
+#define MOZC_USAGE_STATS_METRICS_REGISTRY_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
+
+namespace mozc {
+namespace usage_stats {
+
+// Log-linear bucketing of latency values. Values below kNumSubBuckets have
+// their own buckets, and every range [2^k, 2^(k+1)) above is split into
+// kNumSubBuckets buckets of the same width, so that the relative error of a
+// bucket is at most 1 / kNumSubBuckets.
+class LatencyHistogram {
+ public:
+  static constexpr int kSubBucketBits = 3;
+  static constexpr size_t kNumSubBuckets = 1 << kSubBucketBits;
+  static constexpr size_t kNumBuckets =
+      kNumSubBuckets + (32 - kSubBucketBits) * kNumSubBuckets;
+
+  // Returns the index of the bucket containing |value|.
+  static size_t GetBucket(uint32_t value);
+
+  // Returns the smallest value in the bucket |bucket|.
+  static uint64_t GetLowerBound(size_t bucket);
+
+  LatencyHistogram() = delete;
+};
+
+// Copy of the values of all the metrics at some point.
+struct MetricsSnapshot {
+  struct Timing {
+    uint64_t num = 0;
+    uint64_t total = 0;
+    uint32_t min = 0;
+    uint32_t max = 0;
+    // Number of values in each bucket of LatencyHistogram.
+    std::vector<uint64_t> buckets;
+
+    // Returns the lower bound of the bucket containing the |percentile|-th
+    // (0-100) value, or 0 if there is no value.
+    uint64_t GetPercentile(double percentile) const;
+  };
+
+  // Only the metrics updated since they were last cleared are included.
+  std::map<std::string, uint64_t> counts;
+  std::map<std::string, int> integers;
+  std::map<std::string, bool> booleans;
+  std::map<std::string, Timing> timings;
+};
+
+// In-process registry of the metrics updated through UsageStats. The metrics
+// are kept only in memory and never uploaded.
+//
+// Metrics are identified by their indices in the list passed to the
+// constructor. All the methods are thread-safe and don't take locks; counts
+// are sharded per thread so that frequent updates from different threads
+// don't contend on the same cache line.
+class MetricsRegistry {
+ public:
+  // |names| must be unique and must outlive this instance.
+  explicit MetricsRegistry(absl::Span<const absl::string_view> names);
+  MetricsRegistry(const MetricsRegistry &) = delete;
+  MetricsRegistry &operator=(const MetricsRegistry &) = delete;
+  ~MetricsRegistry();
+
+  // Returns the id of |name|, or std::nullopt if it is not in the list.
+  std::optional<size_t> GetId(absl::string_view name) const;
+
+  void IncrementCountBy(size_t id, uint64_t val);
+  void UpdateTiming(size_t id, uint32_t val);
+  void SetInteger(size_t id, int val);
+  void SetBoolean(size_t id, bool val);
+
+  // Clears counts and timings. Integers and booleans are kept as they don't
+  // accumulate.
+  void ClearAccumulated();
+
+  // Clears all the metrics.
+  void ClearAll();
+
+  MetricsSnapshot GetSnapshot() const;
+
+ private:
+  struct Timing;
+
+  enum ValueType : uint8_t {
+    kNone,
+    kInteger,
+    kBoolean,
+  };
+
+  // Number of the count shards. Threads are assigned to shards in turn.
+  static constexpr size_t kNumShards = 8;
+
+  std::atomic<uint64_t> &GetCount(size_t shard, size_t id) const {
+    return counts_[shard * shard_stride_ + id];
+  }
+  Timing &GetOrCreateTiming(size_t id);
+
+  const absl::Span<const absl::string_view> names_;
+  absl::flat_hash_map<absl::string_view, size_t> ids_;
+  // Counts of the shards, each of which is padded to cache lines.
+  const size_t shard_stride_;
+  std::unique_ptr<std::atomic<uint64_t>[]> counts_;
+  // Timings are allocated on the first update as they are large.
+  std::unique_ptr<std::atomic<Timing *>[]> timings_;
+  std::unique_ptr<std::atomic<int64_t>[]> values_;
+  std::unique_ptr<std::atomic<ValueType>[]> value_types_;
+};
+
+}  // namespace usage_stats
+}  // namespace mozc
+
+#endif  // MOZC_USAGE_STATS_METRICS_REGISTRY_H_
@@ -0,0 +1,157 @@
+// Copyright 2010-2021, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "usage_stats/metrics_registry.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "absl/strings/string_view.h"
+#include "base/thread.h"
+#include "testing/gmock.h"
+#include "testing/gunit.h"
+
+namespace mozc {
+namespace usage_stats {
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::Pair;
+
+constexpr absl::string_view kNames[] = {"Boolean", "Count", "Integer",
+                                        "Timing"};
+
+TEST(LatencyHistogramTest, GetBucket) {
+  for (uint32_t value = 0; value < 8; ++value) {
+    EXPECT_EQ(LatencyHistogram::GetBucket(value), value);
+  }
+  EXPECT_EQ(LatencyHistogram::GetBucket(8), 8);
+  EXPECT_EQ(LatencyHistogram::GetBucket(15), 15);
+  EXPECT_EQ(LatencyHistogram::GetBucket(16), 16);
+  EXPECT_EQ(LatencyHistogram::GetBucket(17), 16);
+  EXPECT_EQ(LatencyHistogram::GetBucket(18), 17);
+  EXPECT_EQ(LatencyHistogram::GetBucket(0xffffffff),
+            LatencyHistogram::kNumBuckets - 1);
+
+  // Every value is in the bucket of its lower bound, and the buckets are
+  // contiguous.
+  for (uint32_t value : {0u, 7u, 8u, 100u, 1000u, 12345u, 1u << 20,
+                         (1u << 20) + 12345u, 0x80000000u, 0xffffffffu}) {
+    const size_t bucket = LatencyHistogram::GetBucket(value);
+    EXPECT_LE(LatencyHistogram::GetLowerBound(bucket), value);
+    if (bucket + 1 < LatencyHistogram::kNumBuckets) {
+      EXPECT_GT(LatencyHistogram::GetLowerBound(bucket + 1), value);
+    }
+    const uint64_t lower_bound = LatencyHistogram::GetLowerBound(bucket);
+    EXPECT_EQ(LatencyHistogram::GetBucket(static_cast<uint32_t>(lower_bound)),
+              bucket);
+  }
+}
+
+TEST(MetricsRegistryTest, GetId) {
+  MetricsRegistry registry(kNames);
+  EXPECT_EQ(registry.GetId("Boolean"), 0);
+  EXPECT_EQ(registry.GetId("Timing"), 3);
+  EXPECT_EQ(registry.GetId("Unknown"), std::nullopt);
+  EXPECT_EQ(registry.GetId(""), std::nullopt);
+}
+
+TEST(MetricsRegistryTest, Snapshot) {
+  MetricsRegistry registry(kNames);
+  EXPECT_TRUE(registry.GetSnapshot().counts.empty());
+
+  registry.IncrementCountBy(1, 3);
+  registry.IncrementCountBy(1, 4);
+  registry.SetInteger(2, -5);
+  registry.SetBoolean(0, true);
+  for (uint32_t value = 1; value <= 100; ++value) {
+    registry.UpdateTiming(3, value);
+  }
+
+  MetricsSnapshot snapshot = registry.GetSnapshot();
+  EXPECT_THAT(snapshot.counts, ElementsAre(Pair("Count", 7)));
+  EXPECT_THAT(snapshot.integers, ElementsAre(Pair("Integer", -5)));
+  EXPECT_THAT(snapshot.booleans, ElementsAre(Pair("Boolean", true)));
+  ASSERT_EQ(snapshot.timings.size(), 1);
+  const MetricsSnapshot::Timing &timing = snapshot.timings["Timing"];
+  EXPECT_EQ(timing.num, 100);
+  EXPECT_EQ(timing.total, 5050);
+  EXPECT_EQ(timing.min, 1);
+  EXPECT_EQ(timing.max, 100);
+  EXPECT_EQ(timing.GetPercentile(0), 1);
+  // The 50th value, 50, is in the bucket [48, 52).
+  EXPECT_EQ(timing.GetPercentile(50), 48);
+  // The 100th value, 100, is in the bucket [96, 104).
+  EXPECT_EQ(timing.GetPercentile(100), 96);
+
+  // Integers and booleans are not accumulated.
+  registry.ClearAccumulated();
+  snapshot = registry.GetSnapshot();
+  EXPECT_TRUE(snapshot.counts.empty());
+  EXPECT_TRUE(snapshot.timings.empty());
+  EXPECT_EQ(snapshot.integers.size(), 1);
+  EXPECT_EQ(snapshot.booleans.size(), 1);
+
+  registry.ClearAll();
+  snapshot = registry.GetSnapshot();
+  EXPECT_TRUE(snapshot.integers.empty());
+  EXPECT_TRUE(snapshot.booleans.empty());
+}
+
+TEST(MetricsRegistryTest, MultiThread) {
+  constexpr int kNumThreads = 16;
+  constexpr int kNumUpdates = 10000;
+  MetricsRegistry registry(kNames);
+
+  std::vector<Thread> threads;
+  for (int i = 0; i < kNumThreads; ++i) {
+    threads.push_back(Thread([&registry] {
+      for (int j = 0; j < kNumUpdates; ++j) {
+        registry.IncrementCountBy(1, 1);
+        registry.UpdateTiming(3, j);
+      }
+    }));
+  }
+  for (Thread &thread : threads) {
+    thread.Join();
+  }
+
+  MetricsSnapshot snapshot = registry.GetSnapshot();
+  EXPECT_EQ(snapshot.counts["Count"], kNumThreads * kNumUpdates);
+  const MetricsSnapshot::Timing &timing = snapshot.timings["Timing"];
+  EXPECT_EQ(timing.num, kNumThreads * kNumUpdates);
+  EXPECT_EQ(timing.min, 0);
+  EXPECT_EQ(timing.max, kNumUpdates - 1);
+}
+
+}  // namespace
+}  // namespace usage_stats
+}  // namespace mozc
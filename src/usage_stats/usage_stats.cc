@@ -29,18 +29,22 @@
 
 #include "usage_stats/usage_stats.h"
 
+#include <algorithm>
 #include <cstddef>
 #include <cstdint>
 #include <iterator>
 #include <map>
+#include <optional>
 #include <string>
 
+#include "absl/base/no_destructor.h"
 #include "absl/log/check.h"
 #include "absl/log/log.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
 #include "base/vlog.h"
 #include "storage/registry.h"
+#include "usage_stats/metrics_registry.h"
 #include "usage_stats/usage_stats.pb.h"
 #include "usage_stats/usage_stats_uploader.h"
 
@@ -52,6 +56,24 @@ constexpr absl::string_view kRegistryPrefix = "usage_stats.";
 
 #include "usage_stats/usage_stats_list.inc"
 
+MetricsRegistry &GetMetricsRegistry() {
+  static absl::NoDestructor<MetricsRegistry> registry(kStatsList);
+  return *registry;
+}
+
+std::optional<size_t> GetMetricsId(const absl::string_view name) {
+  const std::optional<size_t> id = GetMetricsRegistry().GetId(name);
+  DCHECK(id.has_value()) << name << " is not in the list";
+  return id;
+}
+
+void EraseAllStats() {
+  for (size_t i = 0; i < std::size(kStatsList); ++i) {
+    const std::string key = absl::StrCat(kRegistryPrefix, kStatsList[i]);
+    storage::Registry::Erase(key);
+  }
+}
+
 bool LoadStats(const absl::string_view name, Stats *stats) {
   DCHECK(UsageStats::IsListed(name)) << name << " is not in the list";
   std::string stats_str;
@@ -83,12 +105,12 @@ bool GetterInternal(const absl::string_view name, Stats::Type type,
 }  // namespace
 
 bool UsageStats::IsListed(const absl::string_view name) {
-  for (size_t i = 0; i < std::size(kStatsList); ++i) {
-    if (name == kStatsList[i]) {
-      return true;
-    }
-  }
-  return false;
+  return std::binary_search(std::begin(kStatsList), std::end(kStatsList),
+                            name);
+}
+
+MetricsSnapshot UsageStats::GetMetricsSnapshot() {
+  return GetMetricsRegistry().GetSnapshot();
 }
 
 void UsageStats::ClearStats() {
@@ -110,33 +132,38 @@ void UsageStats::ClearStats() {
       storage::Registry::Erase(key);
     }
   }
+  GetMetricsRegistry().ClearAccumulated();
 }
 
 void UsageStats::ClearAllStats() {
-  for (size_t i = 0; i < std::size(kStatsList); ++i) {
-    const std::string key = absl::StrCat(kRegistryPrefix, kStatsList[i]);
-    storage::Registry::Erase(key);
-  }
+  EraseAllStats();
+  GetMetricsRegistry().ClearAll();
 }
 
+// The stats are only recorded in MetricsRegistry, and not stored in the
+// registry for upload.
 void UsageStats::IncrementCountBy(const absl::string_view name, uint32_t val) {
-  DCHECK(IsListed(name)) << name << " is not in the list";
-  // Does nothing
+  if (const std::optional<size_t> id = GetMetricsId(name); id.has_value()) {
+    GetMetricsRegistry().IncrementCountBy(*id, val);
+  }
 }
 
 void UsageStats::UpdateTiming(const absl::string_view name, uint32_t val) {
-  DCHECK(IsListed(name)) << name << " is not in the list";
-  // Does nothing
+  if (const std::optional<size_t> id = GetMetricsId(name); id.has_value()) {
+    GetMetricsRegistry().UpdateTiming(*id, val);
+  }
 }
 
 void UsageStats::SetInteger(const absl::string_view name, int val) {
-  DCHECK(IsListed(name)) << name << " is not in the list";
-  // Does nothing
+  if (const std::optional<size_t> id = GetMetricsId(name); id.has_value()) {
+    GetMetricsRegistry().SetInteger(*id, val);
+  }
 }
 
 void UsageStats::SetBoolean(const absl::string_view name, bool val) {
-  DCHECK(IsListed(name)) << name << " is not in the list";
-  // Does nothing
+  if (const std::optional<size_t> id = GetMetricsId(name); id.has_value()) {
+    GetMetricsRegistry().SetBoolean(*id, val);
+  }
 }
 
 bool UsageStats::GetCountForTest(const absl::string_view name,
@@ -250,7 +277,7 @@ void UsageStats::StoreTouchEventStats(
 }
 
 bool UsageStats::Sync() {
-  ClearAllStats();                      // Clears accumulated data.
+  EraseAllStats();                      // Clears accumulated data.
   UsageStatsUploader::ClearMetaData();  // Clears meta data to send usage stats.
   if (!storage::Registry::Sync()) {
     LOG(ERROR) << "sync failed";
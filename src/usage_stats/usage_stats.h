@@ -35,6 +35,7 @@
 #include <string>
 
 #include "absl/strings/string_view.h"
+#include "usage_stats/metrics_registry.h"
 #include "usage_stats/usage_stats.pb.h"
 
 namespace mozc {
@@ -66,6 +67,10 @@ class UsageStats {
   // (for debugging)
   static bool IsListed(absl::string_view name);
 
+  // Returns the current values of the stats updated by the methods above.
+  // They are kept only in memory of this process.
+  static MetricsSnapshot GetMetricsSnapshot();
+
   // Stores virtual keyboard touch event stats.
   // The map "touch_stats" structure is as following
   //   (keyboard_name_01 : (source_id_1 : TouchEventStats,
@@ -38,6 +38,7 @@
       'type': 'static_library',
       'hard_dependency': 1,
       'sources': [
+        'metrics_registry.cc',
         'usage_stats.cc',
       ],
       'dependencies': [
@@ -39,6 +39,7 @@
 #include "storage/tiny_storage.h"
 #include "testing/gunit.h"
 #include "testing/mozctest.h"
+#include "usage_stats/metrics_registry.h"
 #include "usage_stats/usage_stats.pb.h"
 
 namespace mozc {
@@ -67,6 +68,41 @@ TEST_F(UsageStatsTest, IsListedTest) {
   EXPECT_FALSE(UsageStats::IsListed("WeDoNotDefinedThisStats"));
 }
 
+TEST_F(UsageStatsTest, MetricsSnapshotTest) {
+  UsageStats::ClearAllStats();
+  UsageStats::IncrementCount("ShutDown");
+  UsageStats::IncrementCountBy("ShutDown", 2);
+  UsageStats::SetInteger("UserRegisteredWord", 10);
+  UsageStats::SetBoolean("ConfigUseDictionarySuggest", true);
+  UsageStats::UpdateTiming("ElapsedTimeUSec", 5);
+  UsageStats::UpdateTiming("ElapsedTimeUSec", 7);
+
+  MetricsSnapshot snapshot = UsageStats::GetMetricsSnapshot();
+  EXPECT_EQ(snapshot.counts["ShutDown"], 3);
+  EXPECT_EQ(snapshot.integers["UserRegisteredWord"], 10);
+  EXPECT_TRUE(snapshot.booleans["ConfigUseDictionarySuggest"]);
+  EXPECT_EQ(snapshot.timings["ElapsedTimeUSec"].num, 2);
+  EXPECT_EQ(snapshot.timings["ElapsedTimeUSec"].total, 12);
+  EXPECT_EQ(snapshot.timings["ElapsedTimeUSec"].min, 5);
+  EXPECT_EQ(snapshot.timings["ElapsedTimeUSec"].max, 7);
+
+  // The metrics are kept across sync as they are not uploaded.
+  EXPECT_TRUE(UsageStats::Sync());
+  EXPECT_EQ(UsageStats::GetMetricsSnapshot().counts.size(), 1);
+
+  UsageStats::ClearStats();
+  snapshot = UsageStats::GetMetricsSnapshot();
+  EXPECT_TRUE(snapshot.counts.empty());
+  EXPECT_TRUE(snapshot.timings.empty());
+  EXPECT_EQ(snapshot.integers.size(), 1);
+  EXPECT_EQ(snapshot.booleans.size(), 1);
+
+  UsageStats::ClearAllStats();
+  snapshot = UsageStats::GetMetricsSnapshot();
+  EXPECT_TRUE(snapshot.integers.empty());
+  EXPECT_TRUE(snapshot.booleans.empty());
+}
+
 TEST_F(UsageStatsTest, StoreTest) {
   // Use actual items, but they do not matter with practical usages.
   constexpr char kCountKey[] = "ShutDown";
@@ -62,6 +62,21 @@
         'test_size': 'small',
       },
     },
+    {
+      'target_name': 'metrics_registry_test',
+      'type': 'executable',
+      'sources': [
+        'metrics_registry_test.cc',
+      ],
+      'dependencies': [
+        '<(mozc_oss_src_dir)/base/base.gyp:base',
+        '<(mozc_oss_src_dir)/testing/testing.gyp:gtest_main',
+        'usage_stats_base.gyp:usage_stats',
+      ],
+      'variables': {
+        'test_size': 'small',
+      },
+    },
     {
       'target_name': 'usage_stats_uploader_test',
       'type': 'executable',
@@ -84,6 +99,7 @@
       'target_name': 'usage_stats_all_test',
       'type': 'none',
       'dependencies': [
+        'metrics_registry_test',
         'usage_stats_test',
         'usage_stats_uploader_test',
       ],